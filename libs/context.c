@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "quickjs/quickjs.h"
 
 #include <glad/glad.h>
@@ -42,175 +49,1127 @@ void framebuffer_size_callback(GLFWwindow* window, int newWidth, int newHeight)
 
 GLFWwindow* window;
 
+// headless mode: no window and no GPU, the clock advances a fixed step per swapBuffers and
+// getKey replays a scripted input track, so a run is reproducible frame for frame
+// ---------------------------------------------------------------------------------------------
+struct InputEvent {
+    uint32_t frame;
+    int key;
+    int down;
+};
 
-static JSValue js_resize() {
-    float scaleX;
-    float scaleY;
-    glfwGetWindowContentScale(window, &scaleX, &scaleY);
-    glViewport(0, 0, width * scaleX, height * scaleY);
-    return JS_UNDEFINED;
+struct Headless {
+    int enabled;
+    double timestep;
+    // 0 runs until terminate
+    uint32_t frames;
+    uint32_t frame;
+    struct InputEvent* events;
+    size_t eventCount;
+    size_t nextEvent;
+    unsigned char keys[GLFW_KEY_LAST + 1];
+} headless;
+
+// applies every scripted event up to the current frame, the track is sorted by frame
+static void playHeadlessInput() {
+    while (headless.nextEvent < headless.eventCount
+        && headless.events[headless.nextEvent].frame <= headless.frame) {
+        struct InputEvent* event = &headless.events[headless.nextEvent++];
+        if (event->key >= 0 && event->key <= GLFW_KEY_LAST) {
+            headless.keys[event->key] = event->down;
+        }
+    }
 }
 
-static JSValue js_loadImage(JSContext* ctx,
+// wall clock for the profiler, glfw's timer is not running in headless mode
+static double getWallTime() {
+    if (headless.enabled) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+    }
+    return glfwGetTime();
+}
+
+// null GL: glad is loaded with stubs so every GL call is a cheap no-op. Only the entry
+// points whose results the loader or this file reads do anything: names count up,
+// uniform locations are small per program, shaders compile, queries are ready at once
+// ---------------------------------------------------------------------------------------------
+static GLuint nullGLNextName = 1;
+
+static void APIENTRY nullGLNoop(void) {
+}
+
+static const GLubyte* APIENTRY nullGLGetString(GLenum name) {
+    switch (name) {
+    case GL_VERSION:
+        return (const GLubyte*)"3.3 Null";
+    case GL_SHADING_LANGUAGE_VERSION:
+        return (const GLubyte*)"3.30";
+    default:
+        return (const GLubyte*)"Null";
+    }
+}
+
+static const GLubyte* APIENTRY nullGLGetStringi(GLenum name, GLuint index) {
+    return (const GLubyte*)"GL_NULL_context";
+}
+
+static void APIENTRY nullGLGetIntegerv(GLenum name, GLint* data) {
+    switch (name) {
+    case GL_MAJOR_VERSION:
+    case GL_MINOR_VERSION:
+        *data = 3;
+        break;
+    case GL_NUM_EXTENSIONS:
+        // glad fails to load with an empty extension list
+        *data = 1;
+        break;
+    default:
+        *data = 0;
+        break;
+    }
+}
+
+static void APIENTRY nullGLGen(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; i++) {
+        names[i] = nullGLNextName++;
+    }
+}
+
+static GLuint APIENTRY nullGLCreateProgram(void) {
+    return nullGLNextName++;
+}
+
+static GLuint APIENTRY nullGLCreateShader(GLenum type) {
+    return nullGLNextName++;
+}
+
+// like a driver, a program numbers its uniforms from 0 and a name keeps its location
+struct NullGLUniform {
+    GLuint program;
+    char* name;
+};
+
+static struct NullGLUniform* nullGLUniforms = NULL;
+static int nullGLUniformCount = 0;
+
+static GLint APIENTRY nullGLGetUniformLocation(GLuint program, const GLchar* name) {
+    GLint location = 0;
+    for (int i = 0; i < nullGLUniformCount; i++) {
+        if (nullGLUniforms[i].program == program) {
+            if (strcmp(nullGLUniforms[i].name, name) == 0) {
+                return location;
+            }
+            location++;
+        }
+    }
+    struct NullGLUniform* list = realloc(nullGLUniforms, (nullGLUniformCount + 1) * sizeof(*list));
+    if (!list) {
+        return -1;
+    }
+    nullGLUniforms = list;
+    list[nullGLUniformCount].program = program;
+    list[nullGLUniformCount].name = strdup(name);
+    if (!list[nullGLUniformCount].name) {
+        return -1;
+    }
+    nullGLUniformCount++;
+    return location;
+}
+
+static void APIENTRY nullGLGetObjectiv(GLuint object, GLenum name, GLint* params) {
+    // compile, link and query availability all report success
+    *params = name == GL_COMPILE_STATUS || name == GL_LINK_STATUS || name == GL_QUERY_RESULT_AVAILABLE;
+}
+
+static void APIENTRY nullGLGetQueryObjectui64v(GLuint id, GLenum name, GLuint64* params) {
+    *params = 0;
+}
+
+static void APIENTRY nullGLGetInfoLog(GLuint object, GLsizei size, GLsizei* length, GLchar* log) {
+    if (length) {
+        *length = 0;
+    }
+    if (size > 0) {
+        log[0] = '\0';
+    }
+}
+
+static void APIENTRY nullGLReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) {
+    if (format == GL_RGBA && type == GL_UNSIGNED_BYTE) {
+        memset(pixels, 0, (size_t)width * height * 4);
+    }
+}
+
+static GLuint APIENTRY nullGLGetUniformBlockIndex(GLuint program, const GLchar* name) {
+    return 0;
+}
+
+static GLenum APIENTRY nullGLCheckFramebufferStatus(GLenum target) {
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static GLenum APIENTRY nullGLGetError(void) {
+    return GL_NO_ERROR;
+}
+
+static const struct {
+    const char* name;
+    void* proc;
+} nullGLProcs[] = {
+    { "glGetString", (void*)nullGLGetString },
+    { "glGetStringi", (void*)nullGLGetStringi },
+    { "glGetIntegerv", (void*)nullGLGetIntegerv },
+    { "glGenBuffers", (void*)nullGLGen },
+    { "glGenFramebuffers", (void*)nullGLGen },
+    { "glGenQueries", (void*)nullGLGen },
+    { "glGenRenderbuffers", (void*)nullGLGen },
+    { "glGenTextures", (void*)nullGLGen },
+    { "glGenVertexArrays", (void*)nullGLGen },
+    { "glCreateProgram", (void*)nullGLCreateProgram },
+    { "glCreateShader", (void*)nullGLCreateShader },
+    { "glGetUniformLocation", (void*)nullGLGetUniformLocation },
+    { "glGetUniformBlockIndex", (void*)nullGLGetUniformBlockIndex },
+    { "glGetShaderiv", (void*)nullGLGetObjectiv },
+    { "glGetProgramiv", (void*)nullGLGetObjectiv },
+    { "glGetQueryObjectiv", (void*)nullGLGetObjectiv },
+    { "glGetQueryObjectui64v", (void*)nullGLGetQueryObjectui64v },
+    { "glGetShaderInfoLog", (void*)nullGLGetInfoLog },
+    { "glGetProgramInfoLog", (void*)nullGLGetInfoLog },
+    { "glReadPixels", (void*)nullGLReadPixels },
+    { "glCheckFramebufferStatus", (void*)nullGLCheckFramebufferStatus },
+    { "glGetError", (void*)nullGLGetError },
+};
+
+// every other entry point returns void and only reads its arguments, the no-op stands in
+static void* getNullGLProcAddress(const char* name) {
+    for (size_t i = 0; i < countof(nullGLProcs); i++) {
+        if (strcmp(nullGLProcs[i].name, name) == 0) {
+            return nullGLProcs[i].proc;
+        }
+    }
+    return (void*)nullGLNoop;
+}
+
+// gl state cache: shadow copies of the bindings and uniforms JS sets every draw, so
+// calls that would not change anything never reach the driver
+// ---------------------------------------------------------------------------------------------
+#define MAX_TEXTURE_UNITS 16
+#define MAX_UNIFORM_BINDINGS 8
+#define UNKNOWN_BINDING 0xFFFFFFFFu
+
+struct UniformSlot {
+    int size;
+    unsigned char value[16 * sizeof(float)];
+};
+
+struct ProgramUniforms {
+    unsigned int program;
+    int count;
+    struct UniformSlot* slots;
+};
+
+struct GLStateCache {
+    unsigned int program;
+    unsigned int vao;
+    unsigned int arrayBuffer;
+    // element buffer binding is vao state, it becomes unknown whenever the vao changes
+    unsigned int elementBuffer;
+    unsigned int uniformBuffer;
+    unsigned int uniformBindings[MAX_UNIFORM_BINDINGS];
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS];
+    struct ProgramUniforms* uniforms;
+    int uniformsCount;
+    double issued;
+    double skipped;
+};
+
+struct GLStateCache glState;
+
+static int glStateChanged(unsigned int* cached, unsigned int value) {
+    if (*cached == value) {
+        glState.skipped++;
+        return 0;
+    }
+    *cached = value;
+    glState.issued++;
+    return 1;
+}
+
+static void cachedUseProgram(unsigned int program) {
+    if (glStateChanged(&glState.program, program)) {
+        glUseProgram(program);
+    }
+}
+
+static void cachedBindVertexArray(unsigned int vao) {
+    if (glStateChanged(&glState.vao, vao)) {
+        glBindVertexArray(vao);
+        glState.elementBuffer = UNKNOWN_BINDING;
+    }
+}
+
+static void cachedBindBuffer(GLenum target, unsigned int buffer) {
+    unsigned int* cached = target == GL_ELEMENT_ARRAY_BUFFER ? &glState.elementBuffer
+        : target == GL_UNIFORM_BUFFER                        ? &glState.uniformBuffer
+                                                             : &glState.arrayBuffer;
+    if (glStateChanged(cached, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// binding a range also binds the generic GL_UNIFORM_BUFFER target
+static void cachedBindBufferBase(unsigned int binding, unsigned int buffer) {
+    if (binding >= MAX_UNIFORM_BINDINGS) {
+        glState.issued++;
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        glState.uniformBuffer = buffer;
+    } else if (glStateChanged(&glState.uniformBindings[binding], buffer)) {
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        glState.uniformBuffer = buffer;
+    }
+}
+
+static void cachedActiveTexture(unsigned int unit) {
+    if (glStateChanged(&glState.activeUnit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+static void cachedBindTexture(unsigned int texture) {
+    if (glState.activeUnit >= MAX_TEXTURE_UNITS) {
+        glState.issued++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+    } else if (glStateChanged(&glState.textures[glState.activeUnit], texture)) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+}
+
+// returns 1 when the uniform at `location` of the current program differs from `value`
+// and records the new value, 0 when the glUniform call can be skipped
+static int uniformChanged(int location, const void* value, int size) {
+    if (location < 0) {
+        glState.skipped++;
+        return 0;
+    }
+    struct ProgramUniforms* uniforms = NULL;
+    for (int i = 0; i < glState.uniformsCount; i++) {
+        if (glState.uniforms[i].program == glState.program) {
+            uniforms = &glState.uniforms[i];
+            break;
+        }
+    }
+    if (!uniforms) {
+        struct ProgramUniforms* list = realloc(glState.uniforms, (glState.uniformsCount + 1) * sizeof(*list));
+        if (!list) {
+            glState.issued++;
+            return 1;
+        }
+        glState.uniforms = list;
+        uniforms = &list[glState.uniformsCount++];
+        uniforms->program = glState.program;
+        uniforms->count = 0;
+        uniforms->slots = NULL;
+    }
+    if (location >= uniforms->count) {
+        struct UniformSlot* slots = realloc(uniforms->slots, (location + 1) * sizeof(*slots));
+        if (!slots) {
+            glState.issued++;
+            return 1;
+        }
+        memset(slots + uniforms->count, 0, (location + 1 - uniforms->count) * sizeof(*slots));
+        uniforms->slots = slots;
+        uniforms->count = location + 1;
+    }
+    struct UniformSlot* slot = &uniforms->slots[location];
+    if (slot->size == size && memcmp(slot->value, value, size) == 0) {
+        glState.skipped++;
+        return 0;
+    }
+    slot->size = size;
+    memcpy(slot->value, value, size);
+    glState.issued++;
+    return 1;
+}
+
+// GL reuses program names, so a deleted program must not leave cached uniform values behind
+static void cachedDeleteProgram(unsigned int program) {
+    for (int i = 0; i < glState.uniformsCount; i++) {
+        if (glState.uniforms[i].program == program) {
+            free(glState.uniforms[i].slots);
+            glState.uniforms[i] = glState.uniforms[--glState.uniformsCount];
+            break;
+        }
+    }
+    if (glState.program == program) {
+        glState.program = UNKNOWN_BINDING;
+    }
+    glDeleteProgram(program);
+}
+
+static void resetGLStateCache() {
+    for (int i = 0; i < glState.uniformsCount; i++) {
+        free(glState.uniforms[i].slots);
+    }
+    free(glState.uniforms);
+    memset(&glState, 0, sizeof(glState));
+}
+
+static JSValue js_getGLStateStats(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    const char* filename = JS_ToCString(ctx, argv[0]);
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(filename, &width, &height, &nrChannels, 0);
-    if (!data) {
-        return JS_EXCEPTION;
-    }
     JSValue ret = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, ret, "width", JS_NewInt32(ctx, width));
-    JS_SetPropertyStr(ctx, ret, "height", JS_NewInt32(ctx, height));
-    JS_SetPropertyStr(ctx, ret, "data", JS_NewArrayBufferCopy(ctx, data, width * height * nrChannels));
-    stbi_image_free(data);
+    JS_SetPropertyStr(ctx, ret, "issued", JS_NewFloat64(ctx, glState.issued));
+    JS_SetPropertyStr(ctx, ret, "skipped", JS_NewFloat64(ctx, glState.skipped));
+    if (argc > 0 && JS_ToBool(ctx, argv[0])) {
+        glState.issued = 0;
+        glState.skipped = 0;
+    }
     return ret;
 }
 
-static JSValue js_createTexture(JSContext* ctx,
+
+// render commands: the GL calls JS makes every frame, as plain C records. Without the render
+// thread a command runs as soon as JS submits it. With the render thread it is copied into the
+// frame JS is recording, and the render thread, which owns the GL context, replays it later
+// ---------------------------------------------------------------------------------------------
+#define RENDER_FRAMES 4
+#define RENDER_MIN_FRAME_SIZE (64 * 1024)
+
+struct RenderCommand;
+typedef void (*RenderCommandFn)(const struct RenderCommand* command);
+
+// how the render thread blends a payload with the same command of the frame before
+enum RenderLerp {
+    RENDER_LERP_NONE,
+    // every float of the payload
+    RENDER_LERP_FLOATS,
+    // x and y of every SPRITE_RECORD_SIZE record
+    RENDER_LERP_SPRITES,
+};
+
+struct RenderCommand {
+    RenderCommandFn run;
+    int lerp;
+    int args[5];
+    float values[4];
+    // payload bytes, a recorded payload is stored right after its command
+    uint32_t size;
+    const void* data;
+};
+
+enum RenderFrameState {
+    RENDER_FRAME_FREE,
+    RENDER_FRAME_RECORDING,
+    // published by swapBuffers, waiting for the render thread
+    RENDER_FRAME_READY,
+    // the previous or current frame of the render thread
+    RENDER_FRAME_SHOWN,
+};
+
+struct RenderFrame {
+    uint8_t* commands;
+    size_t size;
+    size_t capacity;
+    // bytes of `commands` a borrowed context already ran while the frame was recording
+    size_t replayed;
+    // glfwGetTime() when JS published the frame
+    double time;
+    uint64_t sequence;
+    enum RenderFrameState state;
+};
+
+struct RenderThread {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int running;
+    int stop;
+    // JS wants the GL context for a call that can't be recorded, and the render thread let go
+    int borrowRequested;
+    int lent;
+    struct RenderFrame frames[RENDER_FRAMES];
+    int recording;
+    uint64_t published;
+    // interpolated payloads, only touched by the render thread
+    float* scratch;
+    size_t scratchSize;
+};
+
+struct RenderThread renderThread = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+    .recording = -1,
+};
+
+static size_t renderPayloadSize(uint32_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// runs the command now, or records it into the current frame while the render thread runs
+static JSValue submitRenderCommand(JSContext* ctx, const struct RenderCommand* command) {
+    if (!renderThread.running) {
+        command->run(command);
+        return JS_UNDEFINED;
+    }
+    struct RenderFrame* frame = &renderThread.frames[renderThread.recording];
+    size_t needed = frame->size + sizeof(*command) + renderPayloadSize(command->size);
+    if (needed > frame->capacity) {
+        size_t capacity = frame->capacity ? frame->capacity * 2 : RENDER_MIN_FRAME_SIZE;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint8_t* commands = realloc(frame->commands, capacity);
+        if (!commands) {
+            return JS_ThrowOutOfMemory(ctx);
+        }
+        frame->commands = commands;
+        frame->capacity = capacity;
+    }
+    uint8_t* at = frame->commands + frame->size;
+    memcpy(at, command, sizeof(*command));
+    if (command->size) {
+        memcpy(at + sizeof(*command), command->data, command->size);
+    }
+    frame->size = needed;
+    return JS_UNDEFINED;
+}
+
+
+// profiler: CPU zones timed with the wall clock, GPU zones timed with GL_TIME_ELAPSED queries
+// and per-frame counters. Finished frames go to a ring of records JS reads without copies,
+// and every zone instance goes to an event ring that can be dumped as a Chrome trace
+// ---------------------------------------------------------------------------------------------
+// the profile buffer is one double holding the number of finished frames, followed by
+// PROFILE_FRAMES records of PROFILE_FRAME_SIZE doubles:
+//   frame, start (s), duration (ms)
+//   drawCalls, nativeCalls, heapSize (bytes), gcRuns, allocations, gcPause (ms)
+//   PROFILE_MAX_ZONES CPU ms, one per zone, summed over the frame
+//   PROFILE_MAX_ZONES GPU ms, written PROFILE_GPU_LATENCY frames after the frame ends
+//   PROFILE_MAX_ZONES QuickJS allocations, one per zone, nested zones included
+#define PROFILE_FRAMES 256
+#define PROFILE_MAX_ZONES 16
+#define PROFILE_COUNTERS 9
+#define PROFILE_FRAME_SIZE (PROFILE_COUNTERS + 3 * PROFILE_MAX_ZONES)
+#define PROFILE_MAX_DEPTH 32
+#define PROFILE_MAX_EVENTS 65536
+// GPU results are read this many frames later so reading them never stalls the pipeline
+#define PROFILE_GPU_LATENCY 4
+#define PROFILE_MAX_QUERIES 32
+
+enum ProfileCounter {
+    PROFILE_FRAME,
+    PROFILE_START,
+    PROFILE_DURATION,
+    PROFILE_DRAW_CALLS,
+    PROFILE_NATIVE_CALLS,
+    PROFILE_HEAP_SIZE,
+    PROFILE_GC_RUNS,
+    PROFILE_ALLOCATIONS,
+    PROFILE_GC_PAUSE,
+};
+
+struct ProfileEvent {
+    double begin;
+    double duration;
+    int zone;
+    int gpu;
+    size_t allocations;
+};
+
+struct ProfileQuery {
+    unsigned int query;
+    int zone;
+    int event;
+};
+
+struct Profiler {
+    char* names[PROFILE_MAX_ZONES];
+    int zoneCount;
+    double buffer[1 + PROFILE_FRAMES * PROFILE_FRAME_SIZE];
+    uint64_t frame;
+    double frameStart;
+    uint32_t drawCalls;
+    uint32_t nativeCalls;
+    int64_t gcCount;
+    // JSGCStats.total_pause_us when the frame started
+    int64_t gcPause;
+    // JSMallocState.malloc_total when the frame started
+    size_t allocations;
+    struct {
+        int zone;
+        double begin;
+        size_t allocations;
+    } stack[PROFILE_MAX_DEPTH];
+    int depth;
+    struct ProfileEvent events[PROFILE_MAX_EVENTS];
+    uint64_t eventCount;
+    // one query set per frame in flight
+    struct ProfileQuery queries[PROFILE_GPU_LATENCY][PROFILE_MAX_QUERIES];
+    int queryCount[PROFILE_GPU_LATENCY];
+    int queriesCreated;
+    int gpuZone;
+};
+
+struct Profiler profiler = { .gpuZone = -1 };
+
+static double* getProfileFrame(uint64_t frame) {
+    return profiler.buffer + 1 + (frame % PROFILE_FRAMES) * PROFILE_FRAME_SIZE;
+}
+
+static int getProfileZone(JSContext* ctx, JSValueConst value) {
+    int zone;
+    if (JS_ToInt32(ctx, &zone, value) || zone < 0 || zone >= profiler.zoneCount) {
+        JS_ThrowRangeError(ctx, "Invalid profile zone");
+        return -1;
+    }
+    return zone;
+}
+
+static int addProfileEvent(int zone, int gpu, double begin, double duration, size_t allocations) {
+    int event = profiler.eventCount++ % PROFILE_MAX_EVENTS;
+    profiler.events[event] = (struct ProfileEvent) { begin, duration, zone, gpu, allocations };
+    return event;
+}
+
+// every block QuickJS has allocated so far, the difference between two reads is the churn
+static size_t getAllocationTotal(JSContext* ctx) {
+    JSMallocState memory;
+    JS_GetMallocState(JS_GetRuntime(ctx), &memory);
+    return memory.malloc_total;
+}
+
+static JSValue js_createProfileZone(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    return JS_NewInt32(ctx, texture);
+    if (profiler.zoneCount == PROFILE_MAX_ZONES) {
+        return JS_ThrowRangeError(ctx, "too many profile zones");
+    }
+    const char* name = JS_ToCString(ctx, argv[0]);
+    if (!name) {
+        return JS_EXCEPTION;
+    }
+    profiler.names[profiler.zoneCount] = strdup(name);
+    JS_FreeCString(ctx, name);
+    return JS_NewInt32(ctx, profiler.zoneCount++);
 }
 
-static JSValue js_bindTexture(JSContext* ctx,
+static JSValue js_beginProfileZone(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    unsigned int texture;
-    JS_ToUint32(ctx, &texture, argv[0]);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    int zone = getProfileZone(ctx, argv[0]);
+    if (zone < 0) {
+        return JS_EXCEPTION;
+    }
+    if (profiler.depth == PROFILE_MAX_DEPTH) {
+        return JS_ThrowRangeError(ctx, "profile zones nested too deep");
+    }
+    profiler.stack[profiler.depth].zone = zone;
+    profiler.stack[profiler.depth].begin = getWallTime();
+    profiler.stack[profiler.depth].allocations = getAllocationTotal(ctx);
+    profiler.depth++;
     return JS_UNDEFINED;
 }
 
-static JSValue js_activeTexture(JSContext* ctx,
+// closes the innermost open zone
+static JSValue js_endProfileZone(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int texture;
-    JS_ToInt32(ctx, &texture, argv[0]);
-    glActiveTexture(GL_TEXTURE0 + texture);
+    if (profiler.depth == 0) {
+        return JS_ThrowRangeError(ctx, "no open profile zone");
+    }
+    profiler.depth--;
+    int zone = profiler.stack[profiler.depth].zone;
+    double begin = profiler.stack[profiler.depth].begin;
+    double duration = getWallTime() - begin;
+    size_t allocations = getAllocationTotal(ctx) - profiler.stack[profiler.depth].allocations;
+    double* record = getProfileFrame(profiler.frame);
+    record[PROFILE_COUNTERS + zone] += duration * 1000;
+    record[PROFILE_COUNTERS + 2 * PROFILE_MAX_ZONES + zone] += allocations;
+    addProfileEvent(zone, 0, begin, duration, allocations);
     return JS_UNDEFINED;
 }
 
-static JSValue js_updateTexture(JSContext* ctx,
+// GL_TIME_ELAPSED queries can't nest, a GPU zone opened inside another one is not timed
+static JSValue js_beginGPUZone(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int width;
-    int height;
-    size_t size;
-    JSValue data = JS_GetPropertyStr(ctx, argv[0], "data");
-    JS_ToInt32(ctx, &width, JS_GetPropertyStr(ctx, argv[0], "width"));
-    JS_ToInt32(ctx, &height, JS_GetPropertyStr(ctx, argv[0], "height"));
-    unsigned char* pixels = JS_GetArrayBuffer(ctx, &size, data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    GLenum format = GL_RGBA;
-    if (size == width * height * 3) {
-        format = GL_RGB;
+    int zone = getProfileZone(ctx, argv[0]);
+    if (zone < 0) {
+        return JS_EXCEPTION;
     }
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    JS_FreeValue(ctx, data);
+    // the render thread draws the frame later, there is nothing to time on this thread
+    if (renderThread.running) {
+        return JS_UNDEFINED;
+    }
+    int set = profiler.frame % PROFILE_GPU_LATENCY;
+    if (profiler.gpuZone >= 0 || profiler.queryCount[set] == PROFILE_MAX_QUERIES) {
+        return JS_UNDEFINED;
+    }
+    if (!profiler.queriesCreated) {
+        for (int i = 0; i < PROFILE_GPU_LATENCY; i++) {
+            for (int j = 0; j < PROFILE_MAX_QUERIES; j++) {
+                glGenQueries(1, &profiler.queries[i][j].query);
+            }
+        }
+        profiler.queriesCreated = 1;
+    }
+    struct ProfileQuery* query = &profiler.queries[set][profiler.queryCount[set]++];
+    query->zone = zone;
+    // the GPU time is filled in once the query result arrives
+    query->event = addProfileEvent(zone, 1, getWallTime(), 0, 0);
+    glBeginQuery(GL_TIME_ELAPSED, query->query);
+    profiler.gpuZone = zone;
     return JS_UNDEFINED;
 }
 
-static JSValue js_loadText(JSContext* ctx,
-                           JSValueConst this_val,
-                           int argc,
-                           JSValueConst* argv) {
-    const char* filename = JS_ToCString(ctx, argv[0]);
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        return JS_EXCEPTION;
+static JSValue js_endGPUZone(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    if (profiler.gpuZone >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler.gpuZone = -1;
     }
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    char* buffer = malloc(length + 1);
-    fread(buffer, 1, length, file);
-    buffer[length] = '\0';
-    fclose(file);
-    JSValue ret = JS_NewString(ctx, buffer);
-    free(buffer);
-    return ret;
-}
-char* concat(const char *s1, const char *s2)
-{
-    char *result = malloc(strlen(s1) + strlen(s2) + 1); // +1 for the null-terminator
-    // in real code you would check for errors in malloc here
-    strcpy(result, s1);
-    strcat(result, s2);
-    return result;
+    return JS_UNDEFINED;
 }
-const char* GLSL_HEADER = "#version 330 core\n";
-
 
-float* getNumbers(JSContext* ctx, JSValueConst value) {
-    JSValue length = JS_GetPropertyStr(ctx, value, "length");
-    uint32_t len = JS_VALUE_GET_INT(length);
-    float* numbers = malloc(len * sizeof(float));
-    for (uint32_t i = 0; i < len; i++) {
-        JSValue element = JS_GetPropertyUint32(ctx, value, i);
-        if (JS_IsNumber(element)) {
-            double num;
-            JS_ToFloat64(ctx, &num, element);
-            numbers[i] = num;
+// adds the results of the queries issued `PROFILE_GPU_LATENCY - 1` frames ago to that
+// frame's record, results that are still not available are dropped
+static void collectGPUZones(uint64_t frame) {
+    int set = frame % PROFILE_GPU_LATENCY;
+    double* record = getProfileFrame(frame);
+    for (int i = 0; i < profiler.queryCount[set]; i++) {
+        struct ProfileQuery* query = &profiler.queries[set][i];
+        GLint available = 0;
+        glGetQueryObjectiv(query->query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query->query, GL_QUERY_RESULT, &elapsed);
+        record[PROFILE_COUNTERS + PROFILE_MAX_ZONES + query->zone] += elapsed / 1e6;
+        struct ProfileEvent* event = &profiler.events[query->event];
+        if (event->gpu && event->zone == query->zone) {
+            event->duration = elapsed / 1e9;
         }
-        JS_FreeValue(ctx, element);
     }
-    return numbers;
+    profiler.queryCount[set] = 0;
 }
 
-static JSValue js_uniformMatrix4fv(JSContext* ctx,
+// finishes the current frame record and starts the next one
+static JSValue js_endProfileFrame(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int location;
-    int transpose;
-    const void* value = getNumbers(ctx, argv[2]);
-    JS_ToInt32(ctx, &location, argv[0]);
-    JS_ToInt32(ctx, &transpose, argv[1]);
-    glUniformMatrix4fv(location, 1, transpose, value);
+    JSRuntime* rt = JS_GetRuntime(ctx);
+    JSMallocState memory;
+    JS_GetMallocState(rt, &memory);
+    int64_t gcCount = JS_GetGCCount(rt);
+    JSGCStats gc;
+    JS_GetGCStats(rt, &gc);
+    double now = getWallTime();
+    double* record = getProfileFrame(profiler.frame);
+    record[PROFILE_FRAME] = profiler.frame;
+    record[PROFILE_START] = profiler.frameStart;
+    record[PROFILE_DURATION] = profiler.frame ? (now - profiler.frameStart) * 1000 : 0;
+    record[PROFILE_DRAW_CALLS] = profiler.drawCalls;
+    record[PROFILE_NATIVE_CALLS] = profiler.nativeCalls;
+    record[PROFILE_HEAP_SIZE] = memory.malloc_size;
+    record[PROFILE_GC_RUNS] = gcCount - profiler.gcCount;
+    record[PROFILE_ALLOCATIONS] = memory.malloc_total - profiler.allocations;
+    record[PROFILE_GC_PAUSE] = (gc.total_pause_us - profiler.gcPause) / 1000.0;
+    if (profiler.frame + 1 >= PROFILE_GPU_LATENCY) {
+        collectGPUZones(profiler.frame + 1 - PROFILE_GPU_LATENCY);
+    }
+    profiler.frame++;
+    profiler.buffer[0] = profiler.frame;
+    profiler.frameStart = now;
+    profiler.drawCalls = 0;
+    profiler.nativeCalls = 0;
+    profiler.gcCount = gcCount;
+    profiler.gcPause = gc.total_pause_us;
+    profiler.allocations = memory.malloc_total;
+    memset(getProfileFrame(profiler.frame), 0, PROFILE_FRAME_SIZE * sizeof(double));
     return JS_UNDEFINED;
 }
 
-static JSValue js_uniform1f(JSContext* ctx,
+// { buffer, frames, frameSize, zones, counters, gpuLatency }, the buffer is the live ring
+static JSValue js_getProfileBuffer(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int location;
-    double v0;
-    JS_ToInt32(ctx, &location, argv[0]);
-    JS_ToFloat64(ctx, &v0, argv[1]);
-    glUniform1f(location, v0);
-    return JS_UNDEFINED;
+    JSValue ret = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, ret, "buffer", JS_NewArrayBuffer(ctx, (uint8_t*)profiler.buffer, sizeof(profiler.buffer), NULL, NULL, 0));
+    JS_SetPropertyStr(ctx, ret, "frames", JS_NewInt32(ctx, PROFILE_FRAMES));
+    JS_SetPropertyStr(ctx, ret, "frameSize", JS_NewInt32(ctx, PROFILE_FRAME_SIZE));
+    JS_SetPropertyStr(ctx, ret, "zones", JS_NewInt32(ctx, PROFILE_MAX_ZONES));
+    JS_SetPropertyStr(ctx, ret, "counters", JS_NewInt32(ctx, PROFILE_COUNTERS));
+    JS_SetPropertyStr(ctx, ret, "gpuLatency", JS_NewInt32(ctx, PROFILE_GPU_LATENCY));
+    return ret;
 }
 
-static JSValue js_uniform3f(JSContext* ctx,
+static void writeTraceString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*text >= 0x20) {
+            fputc(*text, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// writes the event ring and the frame counters as Chrome trace JSON (chrome://tracing, Perfetto)
+static JSValue js_writeProfileTrace(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int location;
-    double v0;
-    double v1;
-    double v2;
-    JS_ToInt32(ctx, &location, argv[0]);
-    JS_ToFloat64(ctx, &v0, argv[1]);
-    JS_ToFloat64(ctx, &v1, argv[2]);
-    JS_ToFloat64(ctx, &v2, argv[3]);
-    glUniform3f(location, v0, v1, v2);
+    const char* path = JS_ToCString(ctx, argv[0]);
+    if (!path) {
+        return JS_EXCEPTION;
+    }
+    FILE* file = fopen(path, "w");
+    JS_FreeCString(ctx, path);
+    if (!file) {
+        return JS_FALSE;
+    }
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n", file);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}", file);
+    uint64_t first = profiler.eventCount > PROFILE_MAX_EVENTS ? profiler.eventCount - PROFILE_MAX_EVENTS : 0;
+    for (uint64_t i = first; i < profiler.eventCount; i++) {
+        const struct ProfileEvent* event = &profiler.events[i % PROFILE_MAX_EVENTS];
+        fputs(",\n{\"name\":", file);
+        writeTraceString(file, profiler.names[event->zone]);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+            event->gpu ? 2 : 1, event->begin * 1e6, event->duration * 1e6);
+        if (!event->gpu) {
+            fprintf(file, ",\"args\":{\"allocations\":%zu}", event->allocations);
+        }
+        fputc('}', file);
+    }
+    uint64_t firstFrame = profiler.frame > PROFILE_FRAMES ? profiler.frame - PROFILE_FRAMES : 0;
+    for (uint64_t frame = firstFrame; frame < profiler.frame; frame++) {
+        const double* record = getProfileFrame(frame);
+        fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":"
+            "{\"drawCalls\":%.0f,\"nativeCalls\":%.0f,\"heapSize\":%.0f,\"gcRuns\":%.0f,\"allocations\":%.0f,\"gcPause\":%.3f}}",
+            record[PROFILE_START] * 1e6, record[PROFILE_DRAW_CALLS], record[PROFILE_NATIVE_CALLS],
+            record[PROFILE_HEAP_SIZE], record[PROFILE_GC_RUNS], record[PROFILE_ALLOCATIONS],
+            record[PROFILE_GC_PAUSE]);
+    }
+    fputs("\n]}\n", file);
+    int ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    return JS_NewBool(ctx, ok);
+}
+
+static void runViewport(const struct RenderCommand* command) {
+    glViewport(0, 0, command->args[0], command->args[1]);
+}
+
+static JSValue js_resize(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    float scaleX = 1;
+    float scaleY = 1;
+    if (!headless.enabled) {
+        glfwGetWindowContentScale(window, &scaleX, &scaleY);
+    }
+    struct RenderCommand command = { .run = runViewport, .args = { width * scaleX, height * scaleY } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static JSValue js_createTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    return JS_NewInt32(ctx, texture);
+}
+
+static void runBindTexture(const struct RenderCommand* command) {
+    cachedBindTexture(command->args[0]);
+}
+
+static JSValue js_bindTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int texture;
+    JS_ToUint32(ctx, &texture, argv[0]);
+    struct RenderCommand command = { .run = runBindTexture, .args = { texture } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runActiveTexture(const struct RenderCommand* command) {
+    cachedActiveTexture(command->args[0]);
+}
+
+static JSValue js_activeTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int texture;
+    JS_ToInt32(ctx, &texture, argv[0]);
+    struct RenderCommand command = { .run = runActiveTexture, .args = { texture } };
+    return submitRenderCommand(ctx, &command);
+}
+
+// size and format of the level 0 storage of every texture updateTexture allocated, indexed
+// by texture name, so a same-sized update reuses the storage and its sampler parameters.
+// Mipmaps of an updated texture are rebuilt once before the next draw, not per update
+struct TextureAllocation {
+    int width;
+    int height;
+    GLenum format;
+    int mipmapped;
+    int mipmapsStale;
+};
+
+struct TextureAllocation* textureAllocations;
+unsigned int textureAllocationCount;
+unsigned int staleMipmapCount;
+
+static struct TextureAllocation* getTextureAllocation(unsigned int texture) {
+    if (texture >= textureAllocationCount) {
+        unsigned int count = texture + 16;
+        struct TextureAllocation* list = realloc(textureAllocations, count * sizeof(*list));
+        if (!list) {
+            return NULL;
+        }
+        memset(list + textureAllocationCount, 0, (count - textureAllocationCount) * sizeof(*list));
+        textureAllocations = list;
+        textureAllocationCount = count;
+    }
+    return &textureAllocations[texture];
+}
+
+// called before every draw, regenerates the mipmaps of the textures updated since the last one
+static void flushStaleMipmaps() {
+    if (!staleMipmapCount) {
+        return;
+    }
+    unsigned int bound = glState.activeUnit < MAX_TEXTURE_UNITS ? glState.textures[glState.activeUnit] : 0;
+    for (unsigned int texture = 0; texture < textureAllocationCount && staleMipmapCount; texture++) {
+        if (textureAllocations[texture].mipmapsStale) {
+            textureAllocations[texture].mipmapsStale = 0;
+            staleMipmapCount--;
+            cachedBindTexture(texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+    cachedBindTexture(bound);
+}
+
+static JSValue js_updateTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int width;
+    int height;
+    size_t size;
+    JSValue data = JS_GetPropertyStr(ctx, argv[0], "data");
+    JS_ToInt32(ctx, &width, JS_GetPropertyStr(ctx, argv[0], "width"));
+    JS_ToInt32(ctx, &height, JS_GetPropertyStr(ctx, argv[0], "height"));
+    unsigned char* pixels = JS_GetArrayBuffer(ctx, &size, data);
+    GLenum format = GL_RGBA;
+    if (size == width * height * 3) {
+        format = GL_RGB;
+    }
+    unsigned int texture = glState.activeUnit < MAX_TEXTURE_UNITS ? glState.textures[glState.activeUnit] : 0;
+    struct TextureAllocation* allocation = texture ? getTextureAllocation(texture) : NULL;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (allocation && allocation->width == width && allocation->height == height && allocation->format == format) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
+    } else {
+        if (!allocation || allocation->width == 0) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (allocation) {
+                allocation->mipmapped = 1;
+            }
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        if (allocation) {
+            allocation->width = width;
+            allocation->height = height;
+            allocation->format = format;
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (!allocation) {
+        // untracked, no later flush will see it
+        glGenerateMipmap(GL_TEXTURE_2D);
+    } else if (allocation->mipmapped && !allocation->mipmapsStale) {
+        allocation->mipmapsStale = 1;
+        staleMipmapCount++;
+    }
+    JS_FreeValue(ctx, data);
     return JS_UNDEFINED;
 }
 
+char* concat(const char *s1, const char *s2)
+{
+    char *result = malloc(strlen(s1) + strlen(s2) + 1); // +1 for the null-terminator
+    // in real code you would check for errors in malloc here
+    strcpy(result, s1);
+    strcat(result, s2);
+    return result;
+}
+const char* GLSL_HEADER = "#version 330 core\n";
+
+
+// typed arrays: hand the backing store of a TypedArray/ArrayBuffer straight to GL
+// ---------------------------------------------------------------------------------------------
+// returns NULL (without a pending exception) for plain JS arrays and other values
+static uint8_t* getArrayBufferView(JSContext* ctx, JSValueConst value, size_t* size, size_t* bytesPerElement) {
+    size_t offset;
+    size_t length;
+    uint8_t* data;
+    if (JS_IsArrayBuffer(value)) {
+        *bytesPerElement = 1;
+        data = JS_GetArrayBuffer(ctx, size, value);
+        if (!data) {
+            // detached
+            JS_FreeValue(ctx, JS_GetException(ctx));
+        }
+        return data;
+    }
+    if (!JS_IsTypedArray(value)) {
+        return NULL;
+    }
+    JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &length, bytesPerElement);
+    if (JS_IsException(buffer)) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return NULL;
+    }
+    // the view keeps its buffer alive, so the pointer stays valid after the free
+    data = JS_GetArrayBuffer(ctx, size, buffer);
+    JS_FreeValue(ctx, buffer);
+    if (!data) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return NULL;
+    }
+    *size = length;
+    return data + offset;
+}
+
+// the `length` of an array-like, 0 if it has none
+static uint32_t getLength(JSContext* ctx, JSValueConst value) {
+    uint32_t length = 0;
+    JSValue property = JS_GetPropertyStr(ctx, value, "length");
+    JS_ToUint32(ctx, &length, property);
+    JS_FreeValue(ctx, property);
+    return length;
+}
+
+// slow path for plain JS arrays: fills at most `max` floats and returns the count written
+uint32_t getNumbers(JSContext* ctx, JSValueConst value, float* numbers, uint32_t max) {
+    uint32_t len = getLength(ctx, value);
+    if (len > max) {
+        len = max;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        JSValue element = JS_GetPropertyUint32(ctx, value, i);
+        double num = 0;
+        if (JS_IsNumber(element)) {
+            JS_ToFloat64(ctx, &num, element);
+        }
+        numbers[i] = num;
+        JS_FreeValue(ctx, element);
+    }
+    return len;
+}
+
+static void runUniformMatrix4fv(const struct RenderCommand* command) {
+    if (uniformChanged(command->args[0], command->data, command->size)) {
+        glUniformMatrix4fv(command->args[0], 1, command->args[1], command->data);
+    }
+}
+
+static JSValue js_uniformMatrix4fv(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int location;
+    int transpose;
+    size_t size;
+    size_t bytesPerElement;
+    float matrix[16] = { 0 };
+    const float* value = (const float*)getArrayBufferView(ctx, argv[2], &size, &bytesPerElement);
+    if (!value || bytesPerElement != sizeof(float) || size < sizeof(matrix)) {
+        getNumbers(ctx, argv[2], matrix, countof(matrix));
+        value = matrix;
+    }
+    JS_ToInt32(ctx, &location, argv[0]);
+    JS_ToInt32(ctx, &transpose, argv[1]);
+    struct RenderCommand command = {
+        .run = runUniformMatrix4fv,
+        .args = { location, transpose },
+        .size = sizeof(matrix),
+        .data = value,
+    };
+    return submitRenderCommand(ctx, &command);
+}
+
+// uniform1f, uniform3f and uniform4f, `args[1]` is the component count
+static void runUniformNf(const struct RenderCommand* command) {
+    int location = command->args[0];
+    int count = command->args[1];
+    if (!uniformChanged(location, command->values, count * sizeof(float))) {
+        return;
+    }
+    if (count == 1) {
+        glUniform1f(location, command->values[0]);
+    } else if (count == 3) {
+        glUniform3fv(location, 1, command->values);
+    } else {
+        glUniform4fv(location, 1, command->values);
+    }
+}
+
+static JSValue js_uniform1f(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int location;
+    double v0;
+    JS_ToInt32(ctx, &location, argv[0]);
+    JS_ToFloat64(ctx, &v0, argv[1]);
+    struct RenderCommand command = { .run = runUniformNf, .args = { location, 1 }, .values = { v0 } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static JSValue js_uniform3f(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int location;
+    double v0;
+    double v1;
+    double v2;
+    JS_ToInt32(ctx, &location, argv[0]);
+    JS_ToFloat64(ctx, &v0, argv[1]);
+    JS_ToFloat64(ctx, &v1, argv[2]);
+    JS_ToFloat64(ctx, &v2, argv[3]);
+    struct RenderCommand command = { .run = runUniformNf, .args = { location, 3 }, .values = { v0, v1, v2 } };
+    return submitRenderCommand(ctx, &command);
+}
+
 static JSValue js_uniform4f(JSContext* ctx,
     JSValueConst this_val,
     int argc,
@@ -225,8 +1184,14 @@ static JSValue js_uniform4f(JSContext* ctx,
     JS_ToFloat64(ctx, &v1, argv[2]);
     JS_ToFloat64(ctx, &v2, argv[3]);
     JS_ToFloat64(ctx, &v3, argv[4]);
-    glUniform4f(location, v0, v1, v2, v3);
-    return JS_UNDEFINED;
+    struct RenderCommand command = { .run = runUniformNf, .args = { location, 4 }, .values = { v0, v1, v2, v3 } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runUniform1i(const struct RenderCommand* command) {
+    if (uniformChanged(command->args[0], &command->args[1], sizeof(command->args[1]))) {
+        glUniform1i(command->args[0], command->args[1]);
+    }
 }
 
 static JSValue js_uniform1i(JSContext* ctx,
@@ -237,8 +1202,8 @@ static JSValue js_uniform1i(JSContext* ctx,
     int v0;
     JS_ToInt32(ctx, &location, argv[0]);
     JS_ToInt32(ctx, &v0, argv[1]);
-    glUniform1i(location, v0);
-    return JS_UNDEFINED;
+    struct RenderCommand command = { .run = runUniform1i, .args = { location, v0 } };
+    return submitRenderCommand(ctx, &command);
 }
 
 static JSValue js_getUniformLocation(JSContext* ctx,
@@ -247,101 +1212,689 @@ static JSValue js_getUniformLocation(JSContext* ctx,
     JSValueConst* argv) {
     int program;
     const char* name = JS_ToCString(ctx, argv[1]);
+    if (!name) {
+        return JS_EXCEPTION;
+    }
     JS_ToInt32(ctx, &program, argv[0]);
-    return JS_NewInt32(ctx, glGetUniformLocation(program, name));
+    GLint location = glGetUniformLocation(program, name);
+    JS_FreeCString(ctx, name);
+    return JS_NewInt32(ctx, location);
 }
 
 
-static JSValue js_createShaderProgram(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    const char* vertexShaderSource = concat(GLSL_HEADER, JS_ToCString(ctx, argv[0]));
-    const char* fragmentShaderSource = concat(GLSL_HEADER, JS_ToCString(ctx, argv[1]));
+// math: gl-matrix compatible mat4 kernels that work in place on Float32Array storage, with
+// SSE or NEON paths for the column products. Every kernel computes into a local matrix and
+// copies it out last, so `out` may alias any input like it can in gl-matrix
+// ---------------------------------------------------------------------------------------------
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define MATH_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MATH_NEON
+#endif
 
+// a Float32Array argument straight from its buffer, anything else is copied into `scratch`
+static float* getFloatArgument(JSContext* ctx, JSValueConst value, float* scratch, uint32_t count) {
+    size_t size;
+    size_t bytesPerElement;
+    float* data = (float*)getArrayBufferView(ctx, value, &size, &bytesPerElement);
+    if (data && bytesPerElement == sizeof(float) && size >= count * sizeof(float)) {
+        return data;
+    }
+    memset(scratch, 0, count * sizeof(float));
+    getNumbers(ctx, value, scratch, count);
+    return scratch;
+}
 
-    // build and compile our shader program
-    // ------------------------------------
-    // vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    // check for shader compile errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
+// stores a result in `out` and returns it, plain arrays are written element by element
+static JSValue returnMatrix(JSContext* ctx, JSValueConst out, const float* matrix) {
+    float scratch[16];
+    float* data = getFloatArgument(ctx, out, scratch, 16);
+    if (data != scratch) {
+        memcpy(data, matrix, sizeof(scratch));
+    } else {
+        for (uint32_t i = 0; i < 16; i++) {
+            JS_SetPropertyUint32(ctx, out, i, JS_NewFloat64(ctx, matrix[i]));
+        }
     }
-    // fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
+    return JS_DupValue(ctx, out);
+}
+
+static void mat4SetIdentity(float* out) {
+    memset(out, 0, 16 * sizeof(float));
+    out[0] = out[5] = out[10] = out[15] = 1;
+}
+
+// column major like GL: column j of a * b is the columns of a weighted by column j of b
+static void mat4Mul(float* out, const float* a, const float* b) {
+#if defined(MATH_SSE)
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+    __m128 c3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 4; j++) {
+        const float* w = b + j * 4;
+        __m128 column = _mm_mul_ps(c0, _mm_set1_ps(w[0]));
+        column = _mm_add_ps(column, _mm_mul_ps(c1, _mm_set1_ps(w[1])));
+        column = _mm_add_ps(column, _mm_mul_ps(c2, _mm_set1_ps(w[2])));
+        column = _mm_add_ps(column, _mm_mul_ps(c3, _mm_set1_ps(w[3])));
+        _mm_storeu_ps(out + j * 4, column);
     }
-    // link shaders
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    // check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
+#elif defined(MATH_NEON)
+    float32x4_t c0 = vld1q_f32(a);
+    float32x4_t c1 = vld1q_f32(a + 4);
+    float32x4_t c2 = vld1q_f32(a + 8);
+    float32x4_t c3 = vld1q_f32(a + 12);
+    for (int j = 0; j < 4; j++) {
+        const float* w = b + j * 4;
+        float32x4_t column = vmulq_n_f32(c0, w[0]);
+        column = vmlaq_n_f32(column, c1, w[1]);
+        column = vmlaq_n_f32(column, c2, w[2]);
+        column = vmlaq_n_f32(column, c3, w[3]);
+        vst1q_f32(out + j * 4, column);
     }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    return JS_NewInt32(ctx, shaderProgram);
+#else
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            out[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+        }
+    }
+#endif
 }
-static JSValue js_bufferData(JSContext* ctx,
+
+// a * translation(v): only the last column changes
+static void mat4Translated(float* out, const float* a, const float* v) {
+    memcpy(out, a, 12 * sizeof(float));
+#if defined(MATH_SSE)
+    __m128 column = _mm_mul_ps(_mm_loadu_ps(a), _mm_set1_ps(v[0]));
+    column = _mm_add_ps(column, _mm_mul_ps(_mm_loadu_ps(a + 4), _mm_set1_ps(v[1])));
+    column = _mm_add_ps(column, _mm_mul_ps(_mm_loadu_ps(a + 8), _mm_set1_ps(v[2])));
+    _mm_storeu_ps(out + 12, _mm_add_ps(column, _mm_loadu_ps(a + 12)));
+#elif defined(MATH_NEON)
+    float32x4_t column = vmlaq_n_f32(vld1q_f32(a + 12), vld1q_f32(a), v[0]);
+    column = vmlaq_n_f32(column, vld1q_f32(a + 4), v[1]);
+    vst1q_f32(out + 12, vmlaq_n_f32(column, vld1q_f32(a + 8), v[2]));
+#else
+    for (int i = 0; i < 4; i++) {
+        out[12 + i] = a[i] * v[0] + a[4 + i] * v[1] + a[8 + i] * v[2] + a[12 + i];
+    }
+#endif
+}
+
+// a * scaling(v): the first three columns are scaled
+static void mat4Scaled(float* out, const float* a, const float* v) {
+    for (int j = 0; j < 3; j++) {
+#if defined(MATH_SSE)
+        _mm_storeu_ps(out + j * 4, _mm_mul_ps(_mm_loadu_ps(a + j * 4), _mm_set1_ps(v[j])));
+#elif defined(MATH_NEON)
+        vst1q_f32(out + j * 4, vmulq_n_f32(vld1q_f32(a + j * 4), v[j]));
+#else
+        for (int i = 0; i < 4; i++) {
+            out[j * 4 + i] = a[j * 4 + i] * v[j];
+        }
+#endif
+    }
+    memcpy(out + 12, a + 12, 4 * sizeof(float));
+}
+
+static JSValue js_mat4Identity(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    JSValue buffer = argv[0];
-    JSValue bufferLength = JS_GetPropertyStr(ctx, buffer, "length");
-    uint32_t length = JS_VALUE_GET_INT(bufferLength);
-    float* data = malloc(length * sizeof(float));
-    for (uint32_t i = 0; i < length; i++) {
-        JSValue element = JS_GetPropertyUint32(ctx, buffer, i);
-        if (JS_IsNumber(element)) {
-            double num;
-            JS_ToFloat64(ctx, &num, element);
-            data[i] = num;
-        }
-        JS_FreeValue(ctx, element);
-    }
-    glBufferData(GL_ARRAY_BUFFER, length * sizeof(float), data, GL_STATIC_DRAW);
-    free(data);
-    return JS_UNDEFINED;
+    float result[16];
+    mat4SetIdentity(result);
+    return returnMatrix(ctx, argv[0], result);
 }
-static JSValue js_bufferDataElement(JSContext* ctx,
+
+static JSValue js_mat4Multiply(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    JSValue buffer = argv[0];
-    JSValue bufferLength = JS_GetPropertyStr(ctx, buffer, "length");
-    uint32_t length = JS_VALUE_GET_INT(bufferLength);
-    unsigned int* data = malloc(length * sizeof(unsigned int));
-    for (uint32_t i = 0; i < length; i++) {
-        JSValue element = JS_GetPropertyUint32(ctx, buffer, i);
-        if (JS_IsNumber(element)) {
-            unsigned int num;
-            JS_ToUint32(ctx, &num, element);
-            data[i] = num;
-        }
-        JS_FreeValue(ctx, element);
-    }
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, length * sizeof(unsigned int), data, GL_STATIC_DRAW);
-    free(data);
-    return JS_UNDEFINED;
+    float a[16];
+    float b[16];
+    float result[16];
+    mat4Mul(result, getFloatArgument(ctx, argv[1], a, 16), getFloatArgument(ctx, argv[2], b, 16));
+    return returnMatrix(ctx, argv[0], result);
 }
-static JSValue js_createVAO(JSContext* ctx,
+
+static JSValue js_mat4Translate(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    float a[16];
+    float v[3];
+    float result[16];
+    mat4Translated(result, getFloatArgument(ctx, argv[1], a, 16), getFloatArgument(ctx, argv[2], v, 3));
+    return returnMatrix(ctx, argv[0], result);
+}
+
+static JSValue js_mat4Scale(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    float a[16];
+    float v[3];
+    float result[16];
+    mat4Scaled(result, getFloatArgument(ctx, argv[1], a, 16), getFloatArgument(ctx, argv[2], v, 3));
+    return returnMatrix(ctx, argv[0], result);
+}
+
+static JSValue js_mat4FromTranslation(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    float v[3];
+    float result[16];
+    const float* translation = getFloatArgument(ctx, argv[1], v, 3);
+    mat4SetIdentity(result);
+    result[12] = translation[0];
+    result[13] = translation[1];
+    result[14] = translation[2];
+    return returnMatrix(ctx, argv[0], result);
+}
+
+// once per frame, so these stay scalar and in double like gl-matrix
+static JSValue js_mat4Ortho(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    double left;
+    double right;
+    double bottom;
+    double top;
+    double near;
+    double far;
+    float result[16] = { 0 };
+    JS_ToFloat64(ctx, &left, argv[1]);
+    JS_ToFloat64(ctx, &right, argv[2]);
+    JS_ToFloat64(ctx, &bottom, argv[3]);
+    JS_ToFloat64(ctx, &top, argv[4]);
+    JS_ToFloat64(ctx, &near, argv[5]);
+    JS_ToFloat64(ctx, &far, argv[6]);
+    double lr = 1 / (left - right);
+    double bt = 1 / (bottom - top);
+    double nf = 1 / (near - far);
+    result[0] = -2 * lr;
+    result[5] = -2 * bt;
+    result[10] = 2 * nf;
+    result[12] = (left + right) * lr;
+    result[13] = (top + bottom) * bt;
+    result[14] = (far + near) * nf;
+    result[15] = 1;
+    return returnMatrix(ctx, argv[0], result);
+}
+
+static void normalize3(double* v) {
+    double len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (len) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+static JSValue js_mat4LookAt(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    float eyeScratch[3];
+    float centerScratch[3];
+    float upScratch[3];
+    float result[16];
+    const float* eye = getFloatArgument(ctx, argv[1], eyeScratch, 3);
+    const float* center = getFloatArgument(ctx, argv[2], centerScratch, 3);
+    const float* up = getFloatArgument(ctx, argv[3], upScratch, 3);
+    double z[3] = { eye[0] - center[0], eye[1] - center[1], eye[2] - center[2] };
+    if (fabs(z[0]) < 1e-6 && fabs(z[1]) < 1e-6 && fabs(z[2]) < 1e-6) {
+        mat4SetIdentity(result);
+        return returnMatrix(ctx, argv[0], result);
+    }
+    normalize3(z);
+    double x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+    normalize3(x);
+    double y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+    normalize3(y);
+    for (int i = 0; i < 3; i++) {
+        result[i * 4] = x[i];
+        result[i * 4 + 1] = y[i];
+        result[i * 4 + 2] = z[i];
+        result[i * 4 + 3] = 0;
+    }
+    result[12] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+    result[13] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+    result[14] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+    result[15] = 1;
+    return returnMatrix(ctx, argv[0], result);
+}
+
+// batch: `count` model matrices translation(x, y, 0) * scaling(sx, sy, 1) written back to
+// back into `out`, from vec2 pairs in `positions` and `scales`. All three must be Float32Arrays
+static JSValue js_mat4FromTranslationScaleBatch(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t count;
+    size_t sizes[3];
+    size_t bytesPerElement[3];
+    float* arrays[3];
+    if (JS_ToUint32(ctx, &count, argv[3])) {
+        return JS_EXCEPTION;
+    }
+    size_t floats[3] = { count * (size_t)16, count * (size_t)2, count * (size_t)2 };
+    for (int i = 0; i < 3; i++) {
+        arrays[i] = (float*)getArrayBufferView(ctx, argv[i], &sizes[i], &bytesPerElement[i]);
+        if (!arrays[i] || bytesPerElement[i] != sizeof(float) || sizes[i] < floats[i] * sizeof(float)) {
+            return JS_ThrowRangeError(ctx, "Expected a Float32Array of at least %zu elements", floats[i]);
+        }
+    }
+    float* out = arrays[0];
+    const float* positions = arrays[1];
+    const float* scales = arrays[2];
+    for (uint32_t i = 0; i < count; i++, out += 16) {
+        const float* p = positions + i * 2;
+        const float* s = scales + i * 2;
+#if defined(MATH_SSE)
+        _mm_storeu_ps(out, _mm_set_ps(0, 0, 0, s[0]));
+        _mm_storeu_ps(out + 4, _mm_set_ps(0, 0, s[1], 0));
+        _mm_storeu_ps(out + 8, _mm_set_ps(0, 1, 0, 0));
+        _mm_storeu_ps(out + 12, _mm_set_ps(1, 0, p[1], p[0]));
+#else
+        memset(out, 0, 16 * sizeof(float));
+        out[0] = s[0];
+        out[5] = s[1];
+        out[10] = 1;
+        out[12] = p[0];
+        out[13] = p[1];
+        out[15] = 1;
+#endif
+    }
+    return JS_UNDEFINED;
+}
+
+
+// shader cache: linked programs are stored with glGetProgramBinary, keyed by a hash of both
+// sources and the driver strings, and reloaded with glProgramBinary on the next launch. Any
+// miss or rejected binary falls back to compiling the sources
+// ---------------------------------------------------------------------------------------------
+// GL_ARB_get_program_binary is core only from 4.1, glad is generated for 3.3
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT_ARB 0x8257
+#define GL_PROGRAM_BINARY_LENGTH_ARB 0x8741
+#define SHADER_CACHE_DIR ".shadercache"
+#define SHADER_CACHE_MAGIC 0x50485353u // "SSHP"
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint32_t length;
+};
+
+GetProgramBinaryProc getProgramBinary;
+ProgramBinaryProc programBinary;
+ProgramParameteriProc programParameteri;
+
+static void initShaderCache() {
+    getProgramBinary = NULL;
+    programBinary = NULL;
+    programParameteri = NULL;
+    if (!glfwExtensionSupported("GL_ARB_get_program_binary")) {
+        return;
+    }
+    getProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+    programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+    programParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+    if (!getProgramBinary || !programBinary || !programParameteri) {
+        getProgramBinary = NULL;
+        programBinary = NULL;
+    }
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t getShaderCacheKey(const char* vertexShaderSource, const char* fragmentShaderSource) {
+    // the binary is only valid for the driver that produced it
+    const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < countof(strings); i++) {
+        const char* value = (const char*)glGetString(strings[i]);
+        if (value) {
+            hash = hashBytes(hash, value, strlen(value) + 1);
+        }
+    }
+    hash = hashBytes(hash, vertexShaderSource, strlen(vertexShaderSource) + 1);
+    return hashBytes(hash, fragmentShaderSource, strlen(fragmentShaderSource) + 1);
+}
+
+static void getShaderCachePath(char* path, size_t size, uint64_t key) {
+    snprintf(path, size, SHADER_CACHE_DIR "/%016llx.bin", (unsigned long long)key);
+}
+
+// returns the linked program, or 0 when there is no usable binary for the key
+static unsigned int loadCachedProgram(uint64_t key) {
+    char path[64];
+    struct ShaderCacheHeader header;
+    if (!programBinary) {
+        return 0;
+    }
+    getShaderCachePath(path, sizeof(path), key);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    void* binary = NULL;
+    int ok = fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == SHADER_CACHE_MAGIC
+        && header.key == key
+        && (binary = malloc(header.length)) != NULL
+        && fread(binary, 1, header.length, file) == header.length;
+    fclose(file);
+    if (!ok) {
+        free(binary);
+        return 0;
+    }
+    unsigned int program = glCreateProgram();
+    programBinary(program, header.binaryFormat, binary, header.length);
+    free(binary);
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // driver update or corrupt file, drop it and recompile
+        cachedDeleteProgram(program);
+        remove(path);
+        return 0;
+    }
+    return program;
+}
+
+static void storeCachedProgram(unsigned int program, uint64_t key) {
+    char path[64];
+    int length = 0;
+    if (!getProgramBinary) {
+        return;
+    }
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_ARB, &length);
+    void* binary = length > 0 ? malloc(length) : NULL;
+    if (!binary) {
+        return;
+    }
+    GLenum binaryFormat;
+    getProgramBinary(program, length, &length, &binaryFormat, binary);
+    struct ShaderCacheHeader header = {
+        .magic = SHADER_CACHE_MAGIC,
+        .binaryFormat = binaryFormat,
+        .key = key,
+        .length = length,
+    };
+    mkdir(SHADER_CACHE_DIR, 0755);
+    getShaderCachePath(path, sizeof(path), key);
+    FILE* file = fopen(path, "wb");
+    if (file) {
+        int ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(binary, 1, length, file) == (size_t)length;
+        if (fclose(file) != 0 || !ok) {
+            remove(path);
+        }
+    }
+    free(binary);
+}
+
+static JSValue js_createShaderProgram(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    const char* vertexSource = JS_ToCString(ctx, argv[0]);
+    const char* fragmentSource = JS_ToCString(ctx, argv[1]);
+    if (!vertexSource || !fragmentSource) {
+        JS_FreeCString(ctx, vertexSource);
+        JS_FreeCString(ctx, fragmentSource);
+        return JS_EXCEPTION;
+    }
+    char* vertexShaderSource = concat(GLSL_HEADER, vertexSource);
+    char* fragmentShaderSource = concat(GLSL_HEADER, fragmentSource);
+    JS_FreeCString(ctx, vertexSource);
+    JS_FreeCString(ctx, fragmentSource);
+    uint64_t key = getShaderCacheKey(vertexShaderSource, fragmentShaderSource);
+    unsigned int shaderProgram = loadCachedProgram(key);
+    if (shaderProgram) {
+        free(vertexShaderSource);
+        free(fragmentShaderSource);
+        return JS_NewInt32(ctx, shaderProgram);
+    }
+
+    // build and compile our shader program
+    // ------------------------------------
+    // vertex shader
+    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, (const char**)&vertexShaderSource, NULL);
+    glCompileShader(vertexShader);
+    // check for shader compile errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    // fragment shader
+    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, (const char**)&fragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
+    // check for shader compile errors
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+    free(vertexShaderSource);
+    free(fragmentShaderSource);
+    // link shaders
+    shaderProgram = glCreateProgram();
+    if (programParameteri && getProgramBinary) {
+        programParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT_ARB, GL_TRUE);
+    }
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+    // check for linking errors
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
+    } else {
+        storeCachedProgram(shaderProgram, key);
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return JS_NewInt32(ctx, shaderProgram);
+}
+// `args[0]` is the target, `args[1]` the usage
+static void runBufferData(const struct RenderCommand* command) {
+    glBufferData(command->args[0], command->size, command->data, command->args[1]);
+}
+
+static JSValue js_bufferData(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    JSValue buffer = argv[0];
+    size_t size;
+    size_t bytesPerElement;
+    uint8_t* bytes = getArrayBufferView(ctx, buffer, &size, &bytesPerElement);
+    if (bytes) {
+        struct RenderCommand command = { .run = runBufferData, .args = { GL_ARRAY_BUFFER, GL_STATIC_DRAW }, .size = size, .data = bytes };
+        return submitRenderCommand(ctx, &command);
+    }
+    uint32_t length = getLength(ctx, buffer);
+    float* data = malloc(length * sizeof(float));
+    for (uint32_t i = 0; i < length; i++) {
+        JSValue element = JS_GetPropertyUint32(ctx, buffer, i);
+        if (JS_IsNumber(element)) {
+            double num;
+            JS_ToFloat64(ctx, &num, element);
+            data[i] = num;
+        }
+        JS_FreeValue(ctx, element);
+    }
+    struct RenderCommand command = { .run = runBufferData, .args = { GL_ARRAY_BUFFER, GL_STATIC_DRAW }, .size = length * sizeof(float), .data = data };
+    JSValue ret = submitRenderCommand(ctx, &command);
+    free(data);
+    return ret;
+}
+static JSValue js_bufferDataElement(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    JSValue buffer = argv[0];
+    size_t size;
+    size_t bytesPerElement;
+    uint8_t* bytes = getArrayBufferView(ctx, buffer, &size, &bytesPerElement);
+    if (bytes) {
+        struct RenderCommand command = { .run = runBufferData, .args = { GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW }, .size = size, .data = bytes };
+        return submitRenderCommand(ctx, &command);
+    }
+    uint32_t length = getLength(ctx, buffer);
+    unsigned int* data = malloc(length * sizeof(unsigned int));
+    for (uint32_t i = 0; i < length; i++) {
+        JSValue element = JS_GetPropertyUint32(ctx, buffer, i);
+        if (JS_IsNumber(element)) {
+            unsigned int num;
+            JS_ToUint32(ctx, &num, element);
+            data[i] = num;
+        }
+        JS_FreeValue(ctx, element);
+    }
+    struct RenderCommand command = { .run = runBufferData, .args = { GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW }, .size = length * sizeof(unsigned int), .data = data };
+    JSValue ret = submitRenderCommand(ctx, &command);
+    free(data);
+    return ret;
+}
+// `args[0]` is the target, `args[1]` the byte offset
+static void runBufferSubData(const struct RenderCommand* command) {
+    glBufferSubData(command->args[0], command->args[1], command->size, command->data);
+}
+
+// overwrites part of the bound array buffer, `offset` is in bytes
+static JSValue js_bufferSubData(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t offset;
+    size_t size;
+    size_t bytesPerElement;
+    JS_ToUint32(ctx, &offset, argv[0]);
+    uint8_t* bytes = getArrayBufferView(ctx, argv[1], &size, &bytesPerElement);
+    if (!bytes) {
+        return JS_ThrowTypeError(ctx, "bufferSubData expects a TypedArray or ArrayBuffer");
+    }
+    struct RenderCommand command = { .run = runBufferSubData, .args = { GL_ARRAY_BUFFER, offset }, .size = size, .data = bytes };
+    return submitRenderCommand(ctx, &command);
+}
+
+// uniform buffers: std140 blocks shared by every program that binds the same binding point,
+// so per-frame state goes up once instead of once per program and draw
+static JSValue js_createUniformBuffer(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t size;
+    unsigned int UBO;
+    JS_ToUint32(ctx, &size, argv[0]);
+    glGenBuffers(1, &UBO);
+    cachedBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    return JS_NewInt32(ctx, UBO);
+}
+
+static void runBindUniformBuffer(const struct RenderCommand* command) {
+    cachedBindBufferBase(command->args[0], command->args[1]);
+}
+
+static JSValue js_bindUniformBuffer(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t binding;
+    unsigned int UBO;
+    JS_ToUint32(ctx, &binding, argv[0]);
+    JS_ToUint32(ctx, &UBO, argv[1]);
+    struct RenderCommand command = { .run = runBindUniformBuffer, .args = { binding, UBO } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runUpdateUniformBuffer(const struct RenderCommand* command) {
+    cachedBindBuffer(GL_UNIFORM_BUFFER, command->args[0]);
+    glBufferSubData(GL_UNIFORM_BUFFER, command->args[1], command->size, command->data);
+}
+
+// overwrites the uniform buffer from `offset` bytes on with the first `count` elements of
+// `data`, all of it when `count` is left out. With `interpolate` set, `data` is floats the
+// render thread may blend with the previous frame's
+static JSValue js_updateUniformBuffer(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int UBO;
+    uint32_t offset;
+    uint32_t count;
+    size_t size;
+    size_t bytesPerElement;
+    JS_ToUint32(ctx, &UBO, argv[0]);
+    JS_ToUint32(ctx, &offset, argv[1]);
+    uint8_t* bytes = getArrayBufferView(ctx, argv[2], &size, &bytesPerElement);
+    if (!bytes) {
+        return JS_ThrowTypeError(ctx, "updateUniformBuffer expects a TypedArray or ArrayBuffer");
+    }
+    if (argc > 3 && !JS_IsUndefined(argv[3])) {
+        JS_ToUint32(ctx, &count, argv[3]);
+        if (count * bytesPerElement < size) {
+            size = count * bytesPerElement;
+        }
+    }
+    struct RenderCommand command = {
+        .run = runUpdateUniformBuffer,
+        .lerp = argc > 4 && JS_ToBool(ctx, argv[4]) ? RENDER_LERP_FLOATS : RENDER_LERP_NONE,
+        .args = { UBO, offset },
+        .size = size,
+        .data = bytes,
+    };
+    return submitRenderCommand(ctx, &command);
+}
+
+// points the uniform block `name` of `program` at a binding point, false when the program
+// has no such block (the compiler drops unused ones)
+static JSValue js_setUniformBlockBinding(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int program;
+    uint32_t binding;
+    JS_ToUint32(ctx, &program, argv[0]);
+    JS_ToUint32(ctx, &binding, argv[2]);
+    const char* name = JS_ToCString(ctx, argv[1]);
+    if (!name) {
+        return JS_EXCEPTION;
+    }
+    GLuint index = glGetUniformBlockIndex(program, name);
+    JS_FreeCString(ctx, name);
+    if (index == GL_INVALID_INDEX) {
+        return JS_FALSE;
+    }
+    glUniformBlockBinding(program, index, binding);
+    return JS_TRUE;
+}
+
+static JSValue js_createVAO(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
@@ -350,116 +1903,1924 @@ static JSValue js_createVAO(JSContext* ctx,
     return JS_NewInt32(ctx, VAO);
 }
 
-static JSValue js_createBuffer(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    return JS_NewInt32(ctx, VBO);
+static JSValue js_createBuffer(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int VBO;
+    glGenBuffers(1, &VBO);
+    return JS_NewInt32(ctx, VBO);
+}
+
+static void runBindVertexArray(const struct RenderCommand* command) {
+    cachedBindVertexArray(command->args[0]);
+}
+
+static JSValue js_bindVAO(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int VAO;
+    JS_ToUint32(ctx, &VAO, argv[0]);
+    struct RenderCommand command = { .run = runBindVertexArray, .args = { VAO } };
+    return submitRenderCommand(ctx, &command);
+}
+
+// `args[0]` is the target
+static void runBindBuffer(const struct RenderCommand* command) {
+    cachedBindBuffer(command->args[0], command->args[1]);
+}
+
+static JSValue js_bindVBO(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int VBO;
+    JS_ToUint32(ctx, &VBO, argv[0]);
+    struct RenderCommand command = { .run = runBindBuffer, .args = { GL_ARRAY_BUFFER, VBO } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static JSValue js_bindEBO(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    unsigned int EBO;
+    JS_ToUint32(ctx, &EBO, argv[0]);
+    struct RenderCommand command = { .run = runBindBuffer, .args = { GL_ELEMENT_ARRAY_BUFFER, EBO } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runVertexAttributePointer(const struct RenderCommand* command) {
+    const int* args = command->args;
+    glVertexAttribPointer(args[0], args[1], GL_FLOAT, args[2], args[3] * sizeof(float), (void*)(args[4] * sizeof(float)));
+}
+
+static JSValue js_setVertexAttributePointer(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    int size;
+    int normalized;
+    int stride;
+    int offset;
+    JS_ToInt32(ctx, &index, argv[0]);
+    JS_ToInt32(ctx, &size, argv[1]);
+    JS_ToInt32(ctx, &normalized, argv[2]);
+    JS_ToInt32(ctx, &stride, argv[3]);
+    JS_ToInt32(ctx, &offset, argv[4]);
+    struct RenderCommand command = { .run = runVertexAttributePointer, .args = { index, size, normalized, stride, offset } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runEnableVertexAttribute(const struct RenderCommand* command) {
+    glEnableVertexAttribArray(command->args[0]);
+}
+
+static JSValue js_enableVertexAttribute(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    JS_ToInt32(ctx, &index, argv[0]);
+    struct RenderCommand command = { .run = runEnableVertexAttribute, .args = { index } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runVertexAttributeDivisor(const struct RenderCommand* command) {
+    glVertexAttribDivisor(command->args[0], command->args[1]);
+}
+
+static JSValue js_setVertexAttributeDivisor(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    int divisor;
+    JS_ToInt32(ctx, &index, argv[0]);
+    JS_ToInt32(ctx, &divisor, argv[1]);
+    struct RenderCommand command = { .run = runVertexAttributeDivisor, .args = { index, divisor } };
+    return submitRenderCommand(ctx, &command);
+}
+
+// `args[0]` is the first index, `args[1]` the index count, `args[2]` the instance count
+static void runDrawElementsInstanced(const struct RenderCommand* command) {
+    const int* args = command->args;
+    flushStaleMipmaps();
+    glDrawElementsInstanced(GL_TRIANGLES, args[1], GL_UNSIGNED_INT, (void *)(uintptr_t)(args[0] * 4), args[2]);
+}
+
+static JSValue js_drawElementsInstanced(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int offset;
+    int count;
+    int instanceCount;
+    JS_ToInt32(ctx, &offset, argv[0]);
+    JS_ToInt32(ctx, &count, argv[1]);
+    JS_ToInt32(ctx, &instanceCount, argv[2]);
+    profiler.drawCalls++;
+    struct RenderCommand command = { .run = runDrawElementsInstanced, .args = { offset, count, instanceCount } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runDrawElements(const struct RenderCommand* command) {
+    flushStaleMipmaps();
+    glDrawElements(GL_TRIANGLES, command->args[1], GL_UNSIGNED_INT, (void *)(uintptr_t)(command->args[0] * 4));
+}
+
+static JSValue js_drawElements(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int offset;
+    int count;
+    JS_ToInt32(ctx, &offset, argv[0]);
+    JS_ToInt32(ctx, &count, argv[1]);
+    profiler.drawCalls++;
+    struct RenderCommand command = { .run = runDrawElements, .args = { offset, count } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runUseProgram(const struct RenderCommand* command) {
+    cachedUseProgram(command->args[0]);
+}
+
+static JSValue js_useProgram(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int program;
+    JS_ToInt32(ctx, &program, argv[0]);
+    struct RenderCommand command = { .run = runUseProgram, .args = { program } };
+    return submitRenderCommand(ctx, &command);
+}
+
+static void runClear(const struct RenderCommand* command) {
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+static JSValue js_clear(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct RenderCommand command = { .run = runClear };
+    return submitRenderCommand(ctx, &command);
+}
+
+
+// sprite batch: JS fills a Float32Array with one SPRITE_RECORD_SIZE record per sprite,
+// C expands the records into quads and draws all of them with a single glDrawElements
+// ---------------------------------------------------------------------------------------------
+// record layout (floats):
+//   0 x, 1 y                 world position of the sprite origin
+//   2 scaleX, 3 scaleY       applied to offset and size, negative values mirror
+//   4 offsetX, 5 offsetY     quad center relative to the origin
+//   6 width, 7 height        quad size in pixels
+//   8 u, 9 v, 10 uw, 11 vh   atlas rect of frame 0 in atlas pixels
+//   12 frame                 frame index, each frame advances u by uw
+//   13 rotated               1 when the atlas stores the image rotated
+#define SPRITE_RECORD_SIZE 14
+#define SPRITE_VERTEX_SIZE 8
+
+struct SpriteBatch {
+    unsigned int vao;
+    unsigned int vbo;
+    unsigned int ebo;
+    uint32_t capacity;
+    float* vertices;
+};
+
+struct SpriteBatch* spriteBatches;
+int spriteBatchCount = 0;
+
+static JSValue js_createSpriteBatch(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t capacity;
+    JS_ToUint32(ctx, &capacity, argv[0]);
+    if (capacity == 0 || capacity > (UINT32_MAX / 4)) {
+        return JS_ThrowRangeError(ctx, "invalid sprite batch capacity: %u", capacity);
+    }
+    struct SpriteBatch* batches = realloc(spriteBatches, (spriteBatchCount + 1) * sizeof(*batches));
+    unsigned int* indices = malloc(capacity * 6 * sizeof(unsigned int));
+    float* vertices = malloc(capacity * 4 * SPRITE_VERTEX_SIZE * sizeof(float));
+    if (!batches || !indices || !vertices) {
+        free(indices);
+        free(vertices);
+        if (batches) {
+            spriteBatches = batches;
+        }
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    spriteBatches = batches;
+    struct SpriteBatch* batch = &spriteBatches[spriteBatchCount];
+    batch->capacity = capacity;
+    batch->vertices = vertices;
+    for (uint32_t i = 0; i < capacity; i++) {
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 3;
+        indices[i * 6 + 3] = i * 4 + 1;
+        indices[i * 6 + 4] = i * 4 + 2;
+        indices[i * 6 + 5] = i * 4 + 3;
+    }
+    glGenVertexArrays(1, &batch->vao);
+    glGenBuffers(1, &batch->vbo);
+    glGenBuffers(1, &batch->ebo);
+    cachedBindVertexArray(batch->vao);
+    cachedBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * 4 * SPRITE_VERTEX_SIZE * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * 6 * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, SPRITE_VERTEX_SIZE * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, SPRITE_VERTEX_SIZE * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, SPRITE_VERTEX_SIZE * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    // keep later bindEBO calls from rebinding the batch element buffer
+    cachedBindVertexArray(0);
+    free(indices);
+    return JS_NewInt32(ctx, spriteBatchCount++);
+}
+
+// `args[0]` is the batch, `args[1]` the record count, `values[0]` the atlas size
+static void runDrawSpriteBatch(const struct RenderCommand* command) {
+    struct SpriteBatch* batch = &spriteBatches[command->args[0]];
+    uint32_t count = command->args[1];
+    float atlasSize = command->values[0];
+    const float* records = command->data;
+    static const float corners[4][2] = { { 1, 1 }, { 1, -1 }, { -1, -1 }, { -1, 1 } };
+    float* vertex = batch->vertices;
+    for (uint32_t i = 0; i < count; i++) {
+        const float* r = records + i * SPRITE_RECORD_SIZE;
+        float u0 = (r[8] + r[12] * r[10]) / atlasSize;
+        float v0 = r[9] / atlasSize;
+        float u1 = u0 + r[10] / atlasSize;
+        float v1 = v0 + r[11] / atlasSize;
+        float uv[4][2] = { { u1, v1 }, { u1, v0 }, { u0, v0 }, { u0, v1 } };
+        for (int c = 0; c < 4; c++) {
+            float lx = corners[c][0] * r[6] / 2;
+            float ly = corners[c][1] * r[7] / 2;
+            if (r[13] != 0) {
+                float tmp = lx;
+                lx = -ly;
+                ly = tmp;
+            }
+            vertex[0] = r[0] + r[2] * (r[4] + lx);
+            vertex[1] = r[1] + r[3] * (r[5] + ly);
+            vertex[2] = 0.0f;
+            vertex[3] = 1.0f;
+            vertex[4] = 1.0f;
+            vertex[5] = 1.0f;
+            vertex[6] = uv[c][0];
+            vertex[7] = uv[c][1];
+            vertex += SPRITE_VERTEX_SIZE;
+        }
+    }
+    cachedBindVertexArray(batch->vao);
+    cachedBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * 4 * SPRITE_VERTEX_SIZE * sizeof(float), batch->vertices);
+    flushStaleMipmaps();
+    glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_INT, 0);
+}
+
+static JSValue js_drawSpriteBatch(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    uint32_t count;
+    double atlasSize;
+    size_t size;
+    size_t bytesPerElement;
+    JS_ToInt32(ctx, &index, argv[0]);
+    JS_ToUint32(ctx, &count, argv[2]);
+    JS_ToFloat64(ctx, &atlasSize, argv[3]);
+    if (index < 0 || index >= spriteBatchCount) {
+        return JS_ThrowRangeError(ctx, "invalid sprite batch: %d", index);
+    }
+    const float* records = (const float*)getArrayBufferView(ctx, argv[1], &size, &bytesPerElement);
+    if (!records || bytesPerElement != sizeof(float)) {
+        return JS_ThrowTypeError(ctx, "sprite records must be a Float32Array");
+    }
+    struct SpriteBatch* batch = &spriteBatches[index];
+    if (count > batch->capacity) {
+        count = batch->capacity;
+    }
+    if (count > size / (SPRITE_RECORD_SIZE * sizeof(float))) {
+        count = size / (SPRITE_RECORD_SIZE * sizeof(float));
+    }
+    if (count == 0) {
+        return JS_UNDEFINED;
+    }
+    profiler.drawCalls++;
+    struct RenderCommand command = {
+        .run = runDrawSpriteBatch,
+        .lerp = RENDER_LERP_SPRITES,
+        .args = { index, count },
+        .values = { atlasSize },
+        .size = count * SPRITE_RECORD_SIZE * sizeof(float),
+        .data = records,
+    };
+    return submitRenderCommand(ctx, &command);
+}
+
+
+// physics: a body table in SoA layout shared with JS without copies. Dynamic bodies are
+// integrated and collided against the tile map here, then a sort-and-sweep broadphase over
+// every active body writes the overlapping pairs into a flat contact list
+// ---------------------------------------------------------------------------------------------
+// the world block is one ArrayBuffer, `capacity` entries per column in this order:
+//   x, y             AABB center
+//   oldX, oldY       center before the last step
+//   speedX, speedY   units per second
+//   halfX, halfY     AABB half size
+//   flags            uint32 PHYSICS_* bits
+// followed by `maxContacts` records of 4 floats: body a, body b, overlapX, overlapY
+// where the overlap is the signed push that separates a from b
+#define PHYSICS_COLUMNS 9
+#define PHYSICS_CONTACT_SIZE 4
+
+#define PHYSICS_ACTIVE 0x1
+#define PHYSICS_DYNAMIC 0x2
+#define PHYSICS_PUSHES_LEFT 0x10
+#define PHYSICS_PUSHES_RIGHT 0x20
+#define PHYSICS_PUSHES_BOTTOM 0x40
+#define PHYSICS_PUSHES_TOP 0x80
+#define PHYSICS_PUSHES (PHYSICS_PUSHES_LEFT | PHYSICS_PUSHES_RIGHT | PHYSICS_PUSHES_BOTTOM | PHYSICS_PUSHES_TOP)
+
+// tile classes, JS maps its TileCollisionType values onto these
+#define PHYSICS_TILE_EMPTY 0
+#define PHYSICS_TILE_SOLID 1
+#define PHYSICS_TILE_ONE_WAY 2
+
+#define PHYSICS_EDGE_EPSILON 0.001f
+
+struct PhysicsWorld {
+    uint32_t capacity;
+    uint32_t maxContacts;
+    float* x;
+    float* y;
+    float* oldX;
+    float* oldY;
+    float* speedX;
+    float* speedY;
+    float* halfX;
+    float* halfY;
+    uint32_t* flags;
+    float* contacts;
+    // broadphase order, kept between steps so the insertion sort sees nearly sorted input
+    uint32_t* order;
+    uint32_t orderCount;
+    unsigned char* tiles;
+    int tilesWidth;
+    int tilesHeight;
+    float tileSize;
+    float originX;
+    float originY;
+};
+
+struct PhysicsWorld* physicsWorlds;
+int physicsWorldCount = 0;
+
+static struct PhysicsWorld* getPhysicsWorld(JSContext* ctx, JSValueConst value) {
+    int id;
+    if (JS_ToInt32(ctx, &id, value) || id < 0 || id >= physicsWorldCount) {
+        JS_ThrowRangeError(ctx, "Invalid physics world");
+        return NULL;
+    }
+    return &physicsWorlds[id];
+}
+
+static JSValue js_createPhysicsWorld(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t capacity;
+    uint32_t maxContacts;
+    JS_ToUint32(ctx, &capacity, argv[0]);
+    JS_ToUint32(ctx, &maxContacts, argv[1]);
+    if (capacity == 0 || capacity > (1u << 24) || maxContacts > (1u << 24)) {
+        // body indices travel through the float contact list, keep them exact
+        return JS_ThrowRangeError(ctx, "invalid physics world capacity: %u", capacity);
+    }
+    size_t size = ((size_t)capacity * PHYSICS_COLUMNS + (size_t)maxContacts * PHYSICS_CONTACT_SIZE) * sizeof(float);
+    struct PhysicsWorld* worlds = realloc(physicsWorlds, (physicsWorldCount + 1) * sizeof(*worlds));
+    if (worlds) {
+        physicsWorlds = worlds;
+    }
+    float* block = calloc(1, size);
+    uint32_t* order = malloc(capacity * sizeof(*order));
+    if (!worlds || !block || !order) {
+        free(block);
+        free(order);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    struct PhysicsWorld* world = &physicsWorlds[physicsWorldCount];
+    memset(world, 0, sizeof(*world));
+    world->capacity = capacity;
+    world->maxContacts = maxContacts;
+    float** columns[] = { &world->x, &world->y, &world->oldX, &world->oldY, &world->speedX, &world->speedY, &world->halfX, &world->halfY };
+    for (size_t i = 0; i < countof(columns); i++) {
+        *columns[i] = block + i * capacity;
+    }
+    world->flags = (uint32_t*)(block + countof(columns) * capacity);
+    world->contacts = block + PHYSICS_COLUMNS * capacity;
+    world->order = order;
+    // worlds live as long as the program, the buffer never frees the block
+    JSValue ret = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, ret, "id", JS_NewInt32(ctx, physicsWorldCount++));
+    JS_SetPropertyStr(ctx, ret, "buffer", JS_NewArrayBuffer(ctx, (uint8_t*)block, size, NULL, NULL, 0));
+    return ret;
+}
+
+static JSValue js_setPhysicsTiles(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct PhysicsWorld* world = getPhysicsWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    int tilesWidth;
+    int tilesHeight;
+    double tileSize;
+    double originX;
+    double originY;
+    size_t size;
+    size_t bytesPerElement;
+    JS_ToInt32(ctx, &tilesWidth, argv[2]);
+    JS_ToInt32(ctx, &tilesHeight, argv[3]);
+    JS_ToFloat64(ctx, &tileSize, argv[4]);
+    JS_ToFloat64(ctx, &originX, argv[5]);
+    JS_ToFloat64(ctx, &originY, argv[6]);
+    const uint8_t* classes = getArrayBufferView(ctx, argv[1], &size, &bytesPerElement);
+    if (!classes || bytesPerElement != 1 || tilesWidth <= 0 || tilesHeight <= 0 || size < (size_t)tilesWidth * tilesHeight || tileSize <= 0) {
+        return JS_ThrowTypeError(ctx, "tiles must be a Uint8Array of width * height tile classes");
+    }
+    unsigned char* tiles = realloc(world->tiles, (size_t)tilesWidth * tilesHeight);
+    if (!tiles) {
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    memcpy(tiles, classes, (size_t)tilesWidth * tilesHeight);
+    world->tiles = tiles;
+    world->tilesWidth = tilesWidth;
+    world->tilesHeight = tilesHeight;
+    world->tileSize = tileSize;
+    world->originX = originX;
+    world->originY = originY;
+    return JS_UNDEFINED;
+}
+
+// tile j is centered on origin + j * tileSize, like Map.getMapTileAtPoint
+static int physicsTileAt(const struct PhysicsWorld* world, float value, float origin) {
+    return (int)floorf((value - origin) / world->tileSize + 0.5f);
+}
+
+// outside of the map counts as solid so bodies stay inside it
+static int physicsTileClass(const struct PhysicsWorld* world, int tx, int ty) {
+    if (tx < 0 || ty < 0 || tx >= world->tilesWidth || ty >= world->tilesHeight) {
+        return PHYSICS_TILE_SOLID;
+    }
+    return world->tiles[ty * world->tilesWidth + tx];
+}
+
+static int physicsColumnBlocked(const struct PhysicsWorld* world, int tx, int ty0, int ty1) {
+    for (int ty = ty0; ty <= ty1; ty++) {
+        if (physicsTileClass(world, tx, ty) == PHYSICS_TILE_SOLID) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int physicsRowBlocked(const struct PhysicsWorld* world, int ty, int tx0, int tx1, int falling) {
+    for (int tx = tx0; tx <= tx1; tx++) {
+        int tile = physicsTileClass(world, tx, ty);
+        if (tile == PHYSICS_TILE_SOLID || (falling && tile == PHYSICS_TILE_ONE_WAY)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// moves one axis at a time and stops at the first blocking tile edge
+static void integratePhysicsBody(struct PhysicsWorld* world, uint32_t i, float dt, float gravity, float maxFallingSpeed) {
+    const float size = world->tileSize;
+    float hx = world->halfX[i];
+    float hy = world->halfY[i];
+    uint32_t flags = world->flags[i] & ~PHYSICS_PUSHES;
+    world->oldX[i] = world->x[i];
+    world->oldY[i] = world->y[i];
+    world->speedY[i] += gravity * dt;
+    if (world->speedY[i] < maxFallingSpeed) {
+        world->speedY[i] = maxFallingSpeed;
+    }
+    float x = world->x[i];
+    float y = world->y[i];
+    float nx = x + world->speedX[i] * dt;
+    if (world->tiles) {
+        int ty0 = physicsTileAt(world, y - hy, world->originY);
+        int ty1 = physicsTileAt(world, y + hy - PHYSICS_EDGE_EPSILON, world->originY);
+        if (nx > x) {
+            int tx1 = physicsTileAt(world, nx + hx - PHYSICS_EDGE_EPSILON, world->originX);
+            for (int tx = physicsTileAt(world, x + hx - PHYSICS_EDGE_EPSILON, world->originX) + 1; tx <= tx1; tx++) {
+                if (physicsColumnBlocked(world, tx, ty0, ty1)) {
+                    nx = world->originX + (tx - 0.5f) * size - hx;
+                    world->speedX[i] = 0;
+                    flags |= PHYSICS_PUSHES_RIGHT;
+                    break;
+                }
+            }
+        } else if (nx < x) {
+            int tx1 = physicsTileAt(world, nx - hx, world->originX);
+            for (int tx = physicsTileAt(world, x - hx, world->originX) - 1; tx >= tx1; tx--) {
+                if (physicsColumnBlocked(world, tx, ty0, ty1)) {
+                    nx = world->originX + (tx + 0.5f) * size + hx;
+                    world->speedX[i] = 0;
+                    flags |= PHYSICS_PUSHES_LEFT;
+                    break;
+                }
+            }
+        }
+    }
+    float ny = y + world->speedY[i] * dt;
+    if (world->tiles) {
+        int tx0 = physicsTileAt(world, nx - hx, world->originX);
+        int tx1 = physicsTileAt(world, nx + hx - PHYSICS_EDGE_EPSILON, world->originX);
+        if (ny > y) {
+            int ty1 = physicsTileAt(world, ny + hy - PHYSICS_EDGE_EPSILON, world->originY);
+            for (int ty = physicsTileAt(world, y + hy - PHYSICS_EDGE_EPSILON, world->originY) + 1; ty <= ty1; ty++) {
+                if (physicsRowBlocked(world, ty, tx0, tx1, 0)) {
+                    ny = world->originY + (ty - 0.5f) * size - hy;
+                    world->speedY[i] = 0;
+                    flags |= PHYSICS_PUSHES_TOP;
+                    break;
+                }
+            }
+        } else if (ny < y) {
+            // rows strictly below the old bottom, so one-way tiles are only ever landed on
+            int ty1 = physicsTileAt(world, ny - hy, world->originY);
+            for (int ty = physicsTileAt(world, y - hy, world->originY) - 1; ty >= ty1; ty--) {
+                if (physicsRowBlocked(world, ty, tx0, tx1, 1)) {
+                    ny = world->originY + (ty + 0.5f) * size + hy;
+                    world->speedY[i] = 0;
+                    flags |= PHYSICS_PUSHES_BOTTOM;
+                    break;
+                }
+            }
+        }
+    }
+    world->x[i] = nx;
+    world->y[i] = ny;
+    world->flags[i] = flags;
+}
+
+static float physicsSign(float value) {
+    return value >= 0 ? 1.0f : -1.0f;
+}
+
+static uint32_t findPhysicsContacts(struct PhysicsWorld* world, uint32_t count) {
+    uint32_t* order = world->order;
+    // keep last step's order for bodies still in range and append new ones
+    uint32_t n = 0;
+    for (uint32_t k = 0; k < world->orderCount; k++) {
+        if (order[k] < count) {
+            order[n++] = order[k];
+        }
+    }
+    for (uint32_t i = world->orderCount < count ? world->orderCount : count; i < count; i++) {
+        order[n++] = i;
+    }
+    world->orderCount = n;
+    const float* x = world->x;
+    const float* halfX = world->halfX;
+    for (uint32_t k = 1; k < n; k++) {
+        uint32_t body = order[k];
+        float minX = x[body] - halfX[body];
+        uint32_t j = k;
+        while (j > 0 && x[order[j - 1]] - halfX[order[j - 1]] > minX) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = body;
+    }
+    uint32_t contacts = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t a = order[k];
+        if (!(world->flags[a] & PHYSICS_ACTIVE) || world->halfX[a] == 0 || world->halfY[a] == 0) {
+            continue;
+        }
+        float maxX = x[a] + halfX[a];
+        for (uint32_t m = k + 1; m < n; m++) {
+            uint32_t b = order[m];
+            if (x[b] - halfX[b] > maxX) {
+                break;
+            }
+            if (!(world->flags[b] & PHYSICS_ACTIVE) || world->halfX[b] == 0 || world->halfY[b] == 0) {
+                continue;
+            }
+            float dx = x[a] - x[b];
+            float dy = world->y[a] - world->y[b];
+            float sumX = halfX[a] + halfX[b];
+            float sumY = world->halfY[a] + world->halfY[b];
+            if (fabsf(dx) > sumX || fabsf(dy) > sumY) {
+                continue;
+            }
+            if (contacts == world->maxContacts) {
+                return contacts;
+            }
+            float* contact = world->contacts + contacts++ * PHYSICS_CONTACT_SIZE;
+            contact[0] = a;
+            contact[1] = b;
+            contact[2] = physicsSign(dx) * (sumX - fabsf(dx));
+            contact[3] = physicsSign(dy) * (sumY - fabsf(dy));
+        }
+    }
+    return contacts;
+}
+
+// integrates the dynamic bodies among the first `count`, then returns the number of contacts
+static JSValue js_stepPhysics(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct PhysicsWorld* world = getPhysicsWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    uint32_t count;
+    double dt;
+    double gravity = 0;
+    double maxFallingSpeed = -INFINITY;
+    JS_ToUint32(ctx, &count, argv[1]);
+    JS_ToFloat64(ctx, &dt, argv[2]);
+    if (argc > 3) {
+        JS_ToFloat64(ctx, &gravity, argv[3]);
+    }
+    if (argc > 4) {
+        JS_ToFloat64(ctx, &maxFallingSpeed, argv[4]);
+    }
+    if (count > world->capacity) {
+        return JS_ThrowRangeError(ctx, "physics body count %u exceeds capacity %u", count, world->capacity);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if ((world->flags[i] & (PHYSICS_ACTIVE | PHYSICS_DYNAMIC)) == (PHYSICS_ACTIVE | PHYSICS_DYNAMIC)) {
+            integratePhysicsBody(world, i, dt, gravity, maxFallingSpeed);
+        }
+    }
+    return JS_NewUint32(ctx, findPhysicsContacts(world, count));
+}
+
+// ecs: entities are rows of a SoA table in native memory. A component is a run of 4-byte
+// columns plus a bit in the row mask. Rows stay packed in [0, count) because destroying an
+// entity moves the last row into its place, so a query comes back as a few dense row ranges
+// that systems walk in C or JS without pointer chasing
+// ---------------------------------------------------------------------------------------------
+// the world block is one ArrayBuffer of uint32 cells:
+//   header           ECS_HEADER_SIZE cells, [0] is the row count
+//   masks            component bits per row
+//   entities         entity id per row
+//   rows             row per entity id, ECS_NO_ROW while the id is free
+//   ranges           [start, end) row pairs written by queryEntities
+//   cells            `columns` x `capacity`, float or uint32 as the component declares
+#define ECS_HEADER_SIZE 4
+#define ECS_NO_ROW 0xFFFFFFFFu
+
+struct ECSWorld {
+    uint32_t capacity;
+    uint32_t columns;
+    uint32_t* header;
+    uint32_t* masks;
+    uint32_t* entities;
+    uint32_t* rows;
+    uint32_t* ranges;
+    uint32_t* cells;
+    // freed entity ids, reused last in first out
+    uint32_t* freeIds;
+    uint32_t freeCount;
+    uint32_t nextId;
+};
+
+struct ECSWorld* ecsWorlds;
+int ecsWorldCount = 0;
+
+static struct ECSWorld* getECSWorld(JSContext* ctx, JSValueConst value) {
+    int id;
+    if (JS_ToInt32(ctx, &id, value) || id < 0 || id >= ecsWorldCount) {
+        JS_ThrowRangeError(ctx, "Invalid ecs world");
+        return NULL;
+    }
+    return &ecsWorlds[id];
+}
+
+static JSValue js_createECSWorld(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    uint32_t capacity;
+    uint32_t columns;
+    JS_ToUint32(ctx, &capacity, argv[0]);
+    JS_ToUint32(ctx, &columns, argv[1]);
+    if (capacity == 0 || capacity > (1u << 24) || columns > 256) {
+        return JS_ThrowRangeError(ctx, "invalid ecs world size: %u entities, %u columns", capacity, columns);
+    }
+    size_t cellCount = ECS_HEADER_SIZE + (size_t)capacity * (5 + columns);
+    struct ECSWorld* worlds = realloc(ecsWorlds, (ecsWorldCount + 1) * sizeof(*worlds));
+    if (worlds) {
+        ecsWorlds = worlds;
+    }
+    uint32_t* block = calloc(cellCount, sizeof(*block));
+    uint32_t* freeIds = malloc(capacity * sizeof(*freeIds));
+    if (!worlds || !block || !freeIds) {
+        free(block);
+        free(freeIds);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    struct ECSWorld* world = &ecsWorlds[ecsWorldCount];
+    memset(world, 0, sizeof(*world));
+    world->capacity = capacity;
+    world->columns = columns;
+    world->header = block;
+    world->masks = block + ECS_HEADER_SIZE;
+    world->entities = world->masks + capacity;
+    world->rows = world->entities + capacity;
+    world->ranges = world->rows + capacity;
+    world->cells = world->ranges + 2 * (size_t)capacity;
+    world->freeIds = freeIds;
+    memset(world->rows, 0xFF, capacity * sizeof(*world->rows));
+    // worlds live as long as the program, the buffer never frees the block
+    JSValue ret = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, ret, "id", JS_NewInt32(ctx, ecsWorldCount++));
+    JS_SetPropertyStr(ctx, ret, "buffer", JS_NewArrayBuffer(ctx, (uint8_t*)block, cellCount * sizeof(*block), NULL, NULL, 0));
+    return ret;
+}
+
+// appends a zeroed row with the given component bits and returns the new entity id
+static JSValue js_createEntity(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct ECSWorld* world = getECSWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    uint32_t mask;
+    JS_ToUint32(ctx, &mask, argv[1]);
+    uint32_t row = world->header[0];
+    if (row == world->capacity) {
+        return JS_ThrowRangeError(ctx, "ecs world is full: %u entities", world->capacity);
+    }
+    uint32_t entity = world->freeCount ? world->freeIds[--world->freeCount] : world->nextId++;
+    for (uint32_t c = 0; c < world->columns; c++) {
+        world->cells[(size_t)c * world->capacity + row] = 0;
+    }
+    world->masks[row] = mask;
+    world->entities[row] = entity;
+    world->rows[entity] = row;
+    world->header[0] = row + 1;
+    return JS_NewUint32(ctx, entity);
+}
+
+// moves the last row into the destroyed one so the table stays packed
+static JSValue js_destroyEntity(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct ECSWorld* world = getECSWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    uint32_t entity;
+    JS_ToUint32(ctx, &entity, argv[1]);
+    if (entity >= world->nextId || world->rows[entity] == ECS_NO_ROW) {
+        return JS_ThrowRangeError(ctx, "Invalid entity %u", entity);
+    }
+    uint32_t row = world->rows[entity];
+    uint32_t last = --world->header[0];
+    if (row != last) {
+        for (uint32_t c = 0; c < world->columns; c++) {
+            uint32_t* column = world->cells + (size_t)c * world->capacity;
+            column[row] = column[last];
+        }
+        world->masks[row] = world->masks[last];
+        world->entities[row] = world->entities[last];
+        world->rows[world->entities[row]] = row;
+    }
+    world->rows[entity] = ECS_NO_ROW;
+    world->freeIds[world->freeCount++] = entity;
+    return JS_UNDEFINED;
+}
+
+static uint32_t findEntityRanges(struct ECSWorld* world, uint32_t mask) {
+    uint32_t count = world->header[0];
+    uint32_t ranges = 0;
+    uint32_t row = 0;
+    while (row < count) {
+        while (row < count && (world->masks[row] & mask) != mask) {
+            row++;
+        }
+        if (row == count) {
+            break;
+        }
+        world->ranges[ranges * 2] = row;
+        while (row < count && (world->masks[row] & mask) == mask) {
+            row++;
+        }
+        world->ranges[ranges * 2 + 1] = row;
+        ranges++;
+    }
+    return ranges;
+}
+
+// writes the [start, end) row ranges holding every component in `mask`, returns their count
+static JSValue js_queryEntities(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct ECSWorld* world = getECSWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    uint32_t mask;
+    JS_ToUint32(ctx, &mask, argv[1]);
+    return JS_NewUint32(ctx, findEntityRanges(world, mask));
+}
+
+// runs the physics integration over the entities in `mask`. Their body component must hold
+// PHYSICS_COLUMNS columns from `firstColumn` in the physics world's order, the tile map is
+// borrowed from the physics world. Returns the range count like queryEntities, the ranges
+// are left in the world block for the next system over the same mask
+static JSValue js_stepEntityPhysics(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct ECSWorld* world = getECSWorld(ctx, argv[0]);
+    if (!world) {
+        return JS_EXCEPTION;
+    }
+    struct PhysicsWorld* physics = getPhysicsWorld(ctx, argv[1]);
+    if (!physics) {
+        return JS_EXCEPTION;
+    }
+    uint32_t mask;
+    uint32_t firstColumn;
+    double dt;
+    double gravity = 0;
+    double maxFallingSpeed = -INFINITY;
+    JS_ToUint32(ctx, &mask, argv[2]);
+    JS_ToUint32(ctx, &firstColumn, argv[3]);
+    JS_ToFloat64(ctx, &dt, argv[4]);
+    if (argc > 5) {
+        JS_ToFloat64(ctx, &gravity, argv[5]);
+    }
+    if (argc > 6) {
+        JS_ToFloat64(ctx, &maxFallingSpeed, argv[6]);
+    }
+    if (firstColumn > world->columns || world->columns - firstColumn < PHYSICS_COLUMNS) {
+        return JS_ThrowRangeError(ctx, "body columns %u..%u out of range", firstColumn, firstColumn + PHYSICS_COLUMNS);
+    }
+    struct PhysicsWorld view = *physics;
+    float** columns[] = { &view.x, &view.y, &view.oldX, &view.oldY, &view.speedX, &view.speedY, &view.halfX, &view.halfY };
+    for (size_t i = 0; i < countof(columns); i++) {
+        *columns[i] = (float*)(world->cells + (firstColumn + i) * (size_t)world->capacity);
+    }
+    view.flags = world->cells + (firstColumn + countof(columns)) * (size_t)world->capacity;
+    uint32_t ranges = findEntityRanges(world, mask);
+    for (uint32_t r = 0; r < ranges; r++) {
+        for (uint32_t row = world->ranges[r * 2]; row < world->ranges[r * 2 + 1]; row++) {
+            integratePhysicsBody(&view, row, dt, gravity, maxFallingSpeed);
+        }
+    }
+    return JS_NewUint32(ctx, ranges);
+}
+
+
+// text layout: msdf-atlas fonts are turned into a codepoint-indexed glyph table once, then
+// text is word wrapped and written as quads straight into the caller's vertex buffers.
+// ASCII and the CJK Unified Ideographs block are dense lookups, any other codepoint is a
+// binary search over the glyphs sorted by codepoint
+// ---------------------------------------------------------------------------------------------
+#define FONT_CJK_FIRST 0x4E00
+#define FONT_CJK_LAST 0x9FFF
+// lines are given up after this many characters without progress, like an unbreakable glyph
+#define FONT_MAX_STALLS 100
+
+struct FontGlyph {
+    uint32_t codepoint;
+    float advance;
+    float left;
+    float bottom;
+    float right;
+    float top;
+    float u;
+    float v;
+    float uw;
+    float vh;
+    int space;
+};
+
+struct FontKerning {
+    uint32_t first;
+    uint32_t second;
+    float amount;
+};
+
+struct Font {
+    // sorted by codepoint, one glyph per codepoint
+    struct FontGlyph* glyphs;
+    uint32_t glyphCount;
+    struct FontKerning* kerning;
+    uint32_t kerningCount;
+    // glyph index + 1, 0 when the font has no glyph
+    uint16_t ascii[128];
+    uint16_t* cjk;
+    int space;
+};
+
+struct LayoutGlyph {
+    const struct FontGlyph* glyph;
+    float x;
+};
+
+struct LayoutLine {
+    uint32_t first;
+    float width;
+};
+
+struct Font* fonts;
+int fontCount = 0;
+
+// scratch space reused by every layout
+uint32_t* layoutCodepoints;
+struct LayoutGlyph* layoutGlyphs;
+struct LayoutLine* layoutLines;
+size_t layoutCapacity = 0;
+
+static struct Font* getFont(JSContext* ctx, JSValueConst value) {
+    int id;
+    if (JS_ToInt32(ctx, &id, value) || id < 0 || id >= fontCount) {
+        JS_ThrowRangeError(ctx, "Invalid font");
+        return NULL;
+    }
+    return &fonts[id];
+}
+
+// 0 for missing objects, like the bounds of a glyph without ink
+static double getNumberProperty(JSContext* ctx, JSValueConst object, const char* name) {
+    double number = 0;
+    if (!JS_IsObject(object)) {
+        return 0;
+    }
+    JSValue value = JS_GetPropertyStr(ctx, object, name);
+    JS_ToFloat64(ctx, &number, value);
+    JS_FreeValue(ctx, value);
+    return number;
+}
+
+static uint32_t getLengthProperty(JSContext* ctx, JSValueConst array) {
+    return (uint32_t)getNumberProperty(ctx, array, "length");
+}
+
+// the same characters as /\s/
+static int isFontSpace(uint32_t c) {
+    return (c >= 0x09 && c <= 0x0d) || c == 0x20 || c == 0xa0 || c == 0x1680
+        || (c >= 0x2000 && c <= 0x200a) || c == 0x2028 || c == 0x2029 || c == 0x202f
+        || c == 0x205f || c == 0x3000 || c == 0xfeff;
+}
+
+// sorts by codepoint and then by load order, so the last variant defining a glyph wins
+static int compareFontGlyphs(const void* a, const void* b) {
+    const struct FontGlyph* x = a;
+    const struct FontGlyph* y = b;
+    if (x->codepoint != y->codepoint) {
+        return x->codepoint < y->codepoint ? -1 : 1;
+    }
+    return x->space < y->space ? -1 : x->space > y->space;
+}
+
+static int compareFontKerning(const void* a, const void* b) {
+    const struct FontKerning* x = a;
+    const struct FontKerning* y = b;
+    if (x->first != y->first) {
+        return x->first < y->first ? -1 : 1;
+    }
+    return x->second < y->second ? -1 : x->second > y->second;
+}
+
+static const struct FontGlyph* findFontGlyph(const struct Font* font, uint32_t codepoint) {
+    int index = 0;
+    if (codepoint < countof(font->ascii)) {
+        index = font->ascii[codepoint];
+    } else if (font->cjk && codepoint >= FONT_CJK_FIRST && codepoint <= FONT_CJK_LAST) {
+        index = font->cjk[codepoint - FONT_CJK_FIRST];
+    } else {
+        uint32_t lo = 0;
+        uint32_t hi = font->glyphCount;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (font->glyphs[mid].codepoint < codepoint) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < font->glyphCount && font->glyphs[lo].codepoint == codepoint) {
+            index = lo + 1;
+        }
+    }
+    if (!index) {
+        index = font->space;
+    }
+    return index ? &font->glyphs[index - 1] : NULL;
+}
+
+static float findFontKerning(const struct Font* font, uint32_t first, uint32_t second) {
+    struct FontKerning key = { first, second, 0 };
+    const struct FontKerning* pair = font->kerningCount
+        ? bsearch(&key, font->kerning, font->kerningCount, sizeof(key), compareFontKerning)
+        : NULL;
+    return pair ? pair->amount : 0;
+}
+
+// builds the glyph table from a parsed msdf-atlas-gen JSON document
+static JSValue js_createFont(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    JSValue atlas = JS_GetPropertyStr(ctx, argv[0], "atlas");
+    double texW = getNumberProperty(ctx, atlas, "width");
+    double texH = getNumberProperty(ctx, atlas, "height");
+    JS_FreeValue(ctx, atlas);
+    if (texW <= 0 || texH <= 0) {
+        return JS_ThrowTypeError(ctx, "font atlas has no size");
+    }
+    JSValue variants = JS_GetPropertyStr(ctx, argv[0], "variants");
+    uint32_t variantCount = getLengthProperty(ctx, variants);
+    uint32_t glyphCount = 0;
+    uint32_t kerningCount = 0;
+    for (uint32_t i = 0; i < variantCount; i++) {
+        JSValue variant = JS_GetPropertyUint32(ctx, variants, i);
+        JSValue glyphs = JS_GetPropertyStr(ctx, variant, "glyphs");
+        JSValue kerning = JS_GetPropertyStr(ctx, variant, "kerning");
+        glyphCount += getLengthProperty(ctx, glyphs);
+        kerningCount += getLengthProperty(ctx, kerning);
+        JS_FreeValue(ctx, kerning);
+        JS_FreeValue(ctx, glyphs);
+        JS_FreeValue(ctx, variant);
+    }
+    if (glyphCount >= UINT16_MAX) {
+        JS_FreeValue(ctx, variants);
+        return JS_ThrowRangeError(ctx, "font has too many glyphs: %u", glyphCount);
+    }
+    struct Font* table = realloc(fonts, (fontCount + 1) * sizeof(*table));
+    if (table) {
+        fonts = table;
+    }
+    struct FontGlyph* glyphs = malloc((glyphCount + 1) * sizeof(*glyphs));
+    struct FontKerning* kerning = malloc((kerningCount + 1) * sizeof(*kerning));
+    if (!table || !glyphs || !kerning) {
+        free(glyphs);
+        free(kerning);
+        JS_FreeValue(ctx, variants);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    uint32_t g = 0;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < variantCount; i++) {
+        JSValue variant = JS_GetPropertyUint32(ctx, variants, i);
+        JSValue list = JS_GetPropertyStr(ctx, variant, "glyphs");
+        uint32_t length = getLengthProperty(ctx, list);
+        for (uint32_t j = 0; j < length && g < glyphCount; j++, g++) {
+            JSValue item = JS_GetPropertyUint32(ctx, list, j);
+            JSValue plane = JS_GetPropertyStr(ctx, item, "planeBounds");
+            JSValue bounds = JS_GetPropertyStr(ctx, item, "atlasBounds");
+            struct FontGlyph* glyph = &glyphs[g];
+            glyph->codepoint = (uint32_t)getNumberProperty(ctx, item, "unicode");
+            glyph->advance = getNumberProperty(ctx, item, "advance");
+            glyph->left = getNumberProperty(ctx, plane, "left");
+            glyph->bottom = getNumberProperty(ctx, plane, "bottom");
+            glyph->right = getNumberProperty(ctx, plane, "right");
+            glyph->top = getNumberProperty(ctx, plane, "top");
+            double left = getNumberProperty(ctx, bounds, "left");
+            double bottom = getNumberProperty(ctx, bounds, "bottom");
+            double right = getNumberProperty(ctx, bounds, "right");
+            double top = getNumberProperty(ctx, bounds, "top");
+            glyph->u = left / texW;
+            glyph->uw = (right - left) / texW;
+            glyph->v = 1.0 - top / texH;
+            glyph->vh = (bottom - top) / texH;
+            // load order for the sort, the real flag is set once the table is unique
+            glyph->space = g;
+            JS_FreeValue(ctx, bounds);
+            JS_FreeValue(ctx, plane);
+            JS_FreeValue(ctx, item);
+        }
+        JS_FreeValue(ctx, list);
+        list = JS_GetPropertyStr(ctx, variant, "kerning");
+        length = getLengthProperty(ctx, list);
+        for (uint32_t j = 0; j < length && k < kerningCount; j++, k++) {
+            JSValue item = JS_GetPropertyUint32(ctx, list, j);
+            kerning[k].first = (uint32_t)getNumberProperty(ctx, item, "first");
+            kerning[k].second = (uint32_t)getNumberProperty(ctx, item, "second");
+            kerning[k].amount = getNumberProperty(ctx, item, "amount");
+            JS_FreeValue(ctx, item);
+        }
+        JS_FreeValue(ctx, list);
+        JS_FreeValue(ctx, variant);
+    }
+    JS_FreeValue(ctx, variants);
+    qsort(glyphs, g, sizeof(*glyphs), compareFontGlyphs);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < g; i++) {
+        if (unique && glyphs[unique - 1].codepoint == glyphs[i].codepoint) {
+            unique--;
+        }
+        glyphs[unique++] = glyphs[i];
+    }
+    qsort(kerning, k, sizeof(*kerning), compareFontKerning);
+    struct Font* font = &fonts[fontCount];
+    memset(font, 0, sizeof(*font));
+    font->glyphs = glyphs;
+    font->glyphCount = unique;
+    font->kerning = kerning;
+    font->kerningCount = k;
+    for (uint32_t i = 0; i < unique; i++) {
+        struct FontGlyph* glyph = &glyphs[i];
+        glyph->space = isFontSpace(glyph->codepoint);
+        if (glyph->codepoint < countof(font->ascii)) {
+            font->ascii[glyph->codepoint] = i + 1;
+        } else if (glyph->codepoint >= FONT_CJK_FIRST && glyph->codepoint <= FONT_CJK_LAST) {
+            if (!font->cjk) {
+                font->cjk = calloc(FONT_CJK_LAST - FONT_CJK_FIRST + 1, sizeof(*font->cjk));
+            }
+            if (font->cjk) {
+                font->cjk[glyph->codepoint - FONT_CJK_FIRST] = i + 1;
+            }
+        }
+    }
+    // without a dense table the binary search still finds every glyph
+    font->space = font->ascii[' '];
+    return JS_NewInt32(ctx, fontCount++);
+}
+
+static int reserveLayout(size_t capacity) {
+    if (capacity <= layoutCapacity) {
+        return 1;
+    }
+    uint32_t* codepoints = realloc(layoutCodepoints, capacity * sizeof(*codepoints));
+    if (codepoints) {
+        layoutCodepoints = codepoints;
+    }
+    struct LayoutGlyph* glyphs = realloc(layoutGlyphs, capacity * sizeof(*glyphs));
+    if (glyphs) {
+        layoutGlyphs = glyphs;
+    }
+    // a line per character at most, plus the one that is always open
+    struct LayoutLine* lines = realloc(layoutLines, (capacity + 1) * sizeof(*lines));
+    if (lines) {
+        layoutLines = lines;
+    }
+    if (!codepoints || !glyphs || !lines) {
+        return 0;
+    }
+    layoutCapacity = capacity;
+    return 1;
+}
+
+// starts a line at the current end of the glyph list, NULL once the scratch space is full
+static struct LayoutLine* openLayoutLine(size_t* lineCount, size_t glyphCount) {
+    if (*lineCount > layoutCapacity) {
+        return NULL;
+    }
+    struct LayoutLine* line = &layoutLines[(*lineCount)++];
+    line->first = glyphCount;
+    line->width = 0;
+    return line;
+}
+
+static size_t decodeUtf8(const char* text, size_t length, uint32_t* codepoints) {
+    const unsigned char* p = (const unsigned char*)text;
+    const unsigned char* end = p + length;
+    size_t count = 0;
+    while (p < end) {
+        uint32_t c = *p++;
+        int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+        if (extra) {
+            c &= 0x3f >> extra;
+        }
+        for (; extra > 0 && p < end; extra--) {
+            c = (c << 6) | (*p++ & 0x3f);
+        }
+        codepoints[count++] = c;
+    }
+    return count;
+}
+
+static float* getLayoutBuffer(JSContext* ctx, JSValueConst buffers, const char* name, size_t* count) {
+    size_t size;
+    size_t bytesPerElement;
+    JSValue value = JS_GetPropertyStr(ctx, buffers, name);
+    // the buffers object keeps the view alive
+    float* data = (float*)getArrayBufferView(ctx, value, &size, &bytesPerElement);
+    JS_FreeValue(ctx, value);
+    *count = data && bytesPerElement == 4 ? size / 4 : 0;
+    return *count ? data : NULL;
+}
+
+// lays out `text` like MTSDFText into the position/uv/index/id arrays of `buffers`, every
+// character owns one quad slot and unused slots are zeroed. Returns { lines, width }
+static JSValue js_layoutText(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct Font* font = getFont(ctx, argv[0]);
+    if (!font) {
+        return JS_EXCEPTION;
+    }
+    double size;
+    double width;
+    double letterSpacing;
+    double lineHeight;
+    double wordSpacing;
+    JS_ToFloat64(ctx, &size, argv[2]);
+    JS_ToFloat64(ctx, &width, argv[3]);
+    const char* align = JS_ToCString(ctx, argv[4]);
+    if (!align) {
+        return JS_EXCEPTION;
+    }
+    int center = strcmp(align, "center") == 0;
+    int right = strcmp(align, "right") == 0;
+    JS_FreeCString(ctx, align);
+    JS_ToFloat64(ctx, &letterSpacing, argv[5]);
+    JS_ToFloat64(ctx, &lineHeight, argv[6]);
+    JS_ToFloat64(ctx, &wordSpacing, argv[7]);
+    int wordBreak = JS_ToBool(ctx, argv[8]);
+    size_t positionCount;
+    size_t uvCount;
+    size_t indexCount;
+    size_t idCount;
+    float* position = getLayoutBuffer(ctx, argv[9], "position", &positionCount);
+    float* uv = getLayoutBuffer(ctx, argv[9], "uv", &uvCount);
+    uint32_t* index = (uint32_t*)getLayoutBuffer(ctx, argv[9], "index", &indexCount);
+    float* id = getLayoutBuffer(ctx, argv[9], "id", &idCount);
+    // missing or empty arrays, as for empty text, leave no room for quads
+    size_t quads = positionCount / 12 < uvCount / 8 ? positionCount / 12 : uvCount / 8;
+    size_t length;
+    const char* text = JS_ToCStringLen(ctx, &length, argv[1]);
+    if (!text) {
+        return JS_EXCEPTION;
+    }
+    if (!reserveLayout(length + 1)) {
+        JS_FreeCString(ctx, text);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    size_t count = decodeUtf8(text, length, layoutCodepoints);
+    JS_FreeCString(ctx, text);
+
+    const uint32_t* chars = layoutCodepoints;
+    struct LayoutGlyph* glyphs = layoutGlyphs;
+    struct LayoutLine* lines = layoutLines;
+    float scale = size;
+    size_t glyphCount = 0;
+    size_t lineCount = 0;
+    struct LayoutLine* line = openLayoutLine(&lineCount, glyphCount);
+    size_t cursor = 0;
+    size_t wordCursor = 0;
+    float wordWidth = 0;
+    int stalls = 0;
+    while (cursor < count && stalls < FONT_MAX_STALLS) {
+        stalls++;
+        uint32_t c = chars[cursor];
+        if (c == '\n') {
+            cursor++;
+            if (!(line = openLayoutLine(&lineCount, glyphCount))) {
+                break;
+            }
+            wordCursor = cursor;
+            wordWidth = 0;
+            continue;
+        }
+        const struct FontGlyph* glyph = findFontGlyph(font, c);
+        if (!glyph) {
+            cursor++;
+            stalls = 0;
+            continue;
+        }
+        if (glyphCount > line->first) {
+            float kern = findFontKerning(font, glyphs[glyphCount - 1].glyph->codepoint, glyph->codepoint) * scale;
+            line->width += kern;
+            wordWidth += kern;
+        }
+        glyphs[glyphCount].glyph = glyph;
+        glyphs[glyphCount].x = line->width;
+        glyphCount++;
+        float advance = 0;
+        if (isFontSpace(c)) {
+            wordCursor = cursor;
+            wordWidth = 0;
+            advance += wordSpacing * size;
+        } else {
+            advance += letterSpacing * size;
+        }
+        advance += glyph->advance * scale;
+        line->width += advance;
+        wordWidth += advance;
+        if (line->width > width) {
+            if (wordBreak && glyphCount - line->first > 1) {
+                // move the glyph that overflowed to a new line
+                line->width -= advance;
+                glyphCount--;
+                if (!(line = openLayoutLine(&lineCount, glyphCount))) {
+                    break;
+                }
+                wordCursor = cursor;
+                wordWidth = 0;
+                continue;
+            } else if (!wordBreak && wordWidth != line->width) {
+                // move the whole word, from its leading space on, to a new line
+                size_t wordGlyphs = cursor - wordCursor + 1;
+                if (wordGlyphs > glyphCount - line->first) {
+                    wordGlyphs = glyphCount - line->first;
+                }
+                glyphCount -= wordGlyphs;
+                cursor = wordCursor;
+                line->width -= wordWidth;
+                if (!(line = openLayoutLine(&lineCount, glyphCount))) {
+                    break;
+                }
+                wordCursor = cursor;
+                wordWidth = 0;
+                continue;
+            }
+        }
+        cursor++;
+        stalls = 0;
+    }
+    if (line && !line->width) {
+        lineCount--;
+    }
+
+    size_t j = 0;
+    float y = size;
+    float maxWidth = 0;
+    for (size_t l = 0; l < lineCount; l++) {
+        size_t end = l + 1 < lineCount ? lines[l + 1].first : glyphCount;
+        float lineWidth = lines[l].width;
+        if (lineWidth > maxWidth) {
+            maxWidth = lineWidth;
+        }
+        for (size_t i = lines[l].first; i < end && j < quads; i++) {
+            const struct FontGlyph* glyph = glyphs[i].glyph;
+            if (glyph->space) {
+                continue;
+            }
+            float x = glyphs[i].x;
+            if (center) {
+                x -= lineWidth * 0.5f;
+            } else if (right) {
+                x -= lineWidth;
+            }
+            x += glyph->left * scale;
+            float top = y - glyph->top * scale;
+            float w = (glyph->right - glyph->left) * scale;
+            float h = (glyph->bottom - glyph->top) * scale;
+            float* p = position + j * 12;
+            p[0] = x;     p[1] = top - h;  p[2] = 0;
+            p[3] = x;     p[4] = top;      p[5] = 0;
+            p[6] = x + w; p[7] = top - h;  p[8] = 0;
+            p[9] = x + w; p[10] = top;     p[11] = 0;
+            float* t = uv + j * 8;
+            t[0] = glyph->u;             t[1] = glyph->v - glyph->vh;
+            t[2] = glyph->u;             t[3] = glyph->v;
+            t[4] = glyph->u + glyph->uw; t[5] = glyph->v - glyph->vh;
+            t[6] = glyph->u + glyph->uw; t[7] = glyph->v;
+            j++;
+        }
+        y += size * lineHeight;
+    }
+    if (position) {
+        memset(position + j * 12, 0, (positionCount - j * 12) * sizeof(float));
+    }
+    if (uv) {
+        memset(uv + j * 8, 0, (uvCount - j * 8) * sizeof(float));
+    }
+    if (index) {
+        for (size_t i = 0; i < indexCount / 6; i++) {
+            uint32_t* q = index + i * 6;
+            uint32_t v = i * 4;
+            q[0] = v;
+            q[1] = v + 2;
+            q[2] = v + 1;
+            q[3] = v + 1;
+            q[4] = v + 2;
+            q[5] = v + 3;
+        }
+    }
+    if (id) {
+        for (size_t i = 0; i < idCount; i++) {
+            id[i] = i / 4;
+        }
+    }
+    JSValue ret = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, ret, "lines", JS_NewUint32(ctx, lineCount));
+    JS_SetPropertyStr(ctx, ret, "width", JS_NewFloat64(ctx, maxWidth));
+    return ret;
+}
+
+
+// audio: every clip is decoded once by the engine's resource manager into a prototype
+// sound. Plays take a voice from a fixed pool and copy the prototype, which shares the
+// decoded PCM, so playing never touches the disk or the decoder
+// ---------------------------------------------------------------------------------------------
+#define MAX_VOICES 16
+
+ma_engine* pEngine;
+
+struct AudioClip {
+    ma_sound prototype;
+    int ready;
+};
+
+struct Voice {
+    ma_sound sound;
+    int clip;
+    int initialized;
+    int looping;
+    unsigned long long startedAt;
+};
+
+// clips are allocated one by one so a worker decoding into one never sees it move
+struct AudioClip** audioClips;
+int audioClipCount = 0;
+struct Voice voices[MAX_VOICES];
+unsigned long long voicePlays = 0;
+
+// a voice already holding the clip is restarted in place. Otherwise an idle voice is
+// used, and when all are busy the oldest one-shot is stolen
+static struct Voice* acquireVoice(int clip) {
+    struct Voice* idle = NULL;
+    struct Voice* oldest = NULL;
+    for (int i = 0; i < MAX_VOICES; i++) {
+        struct Voice* voice = &voices[i];
+        int playing = voice->initialized && ma_sound_is_playing(&voice->sound);
+        if (!playing) {
+            if (voice->initialized && voice->clip == clip) {
+                return voice;
+            }
+            if (!idle || (idle->initialized && !voice->initialized)) {
+                idle = voice;
+            }
+        } else if (!voice->looping && (!oldest || voice->startedAt < oldest->startedAt)) {
+            oldest = voice;
+        }
+    }
+    return idle ? idle : oldest;
+}
+
+static JSValue js_playAudio(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    double volume;
+    int loop;
+    JS_ToInt32(ctx, &index, argv[0]);
+    JS_ToFloat64(ctx, &volume, argv[1]);
+    loop = JS_ToBool(ctx, argv[2]);
+    if (index < 0 || index >= audioClipCount || !audioClips[index]->ready) {
+        return JS_ThrowRangeError(ctx, "Invalid audio id: %d", index);
+    }
+    struct Voice* voice = acquireVoice(index);
+    if (!voice) {
+        // every voice is a looping track, drop the sound rather than cut the music
+        return JS_NewInt32(ctx, -1);
+    }
+    if (voice->initialized && voice->clip == index) {
+        ma_sound_stop(&voice->sound);
+        ma_sound_seek_to_pcm_frame(&voice->sound, 0);
+    } else {
+        if (voice->initialized) {
+            ma_sound_uninit(&voice->sound);
+            voice->initialized = 0;
+        }
+        if (ma_sound_init_copy(pEngine, &audioClips[index]->prototype, 0, NULL, &voice->sound) != MA_SUCCESS) {
+            return JS_ThrowInternalError(ctx, "Failed to start audio: %d", index);
+        }
+        voice->initialized = 1;
+        voice->clip = index;
+    }
+    voice->looping = loop;
+    voice->startedAt = ++voicePlays;
+    ma_sound_set_volume(&voice->sound, volume);
+    ma_sound_set_looping(&voice->sound, loop);
+    ma_sound_start(&voice->sound);
+    return JS_NewInt32(ctx, voice - voices);
+}
+
+// stops every voice playing the clip
+static JSValue js_stopAudio(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int index;
+    JS_ToInt32(ctx, &index, argv[0]);
+    for (int i = 0; i < MAX_VOICES; i++) {
+        if (voices[i].initialized && voices[i].clip == index) {
+            ma_sound_stop(&voices[i].sound);
+        }
+    }
+    return JS_UNDEFINED;
+}
+
+
+// texture objects: decoded pixels owned by C instead of a JS ArrayBuffer. They are uploaded
+// with glTexSubImage2D, all at once or a few rows per call, and freed after the last row
+// ---------------------------------------------------------------------------------------------
+struct TextureObject {
+    int used;
+    unsigned int texture;
+    int width;
+    int height;
+    int channels;
+    int uploadedRows;
+    unsigned char* pixels;
+};
+
+struct TextureObject* textureObjects;
+int textureObjectCount;
+
+static int reserveTextureObject() {
+    for (int i = 0; i < textureObjectCount; i++) {
+        if (!textureObjects[i].used) {
+            memset(&textureObjects[i], 0, sizeof(textureObjects[i]));
+            textureObjects[i].used = 1;
+            return i;
+        }
+    }
+    struct TextureObject* list = realloc(textureObjects, (textureObjectCount + 1) * sizeof(*list));
+    if (!list) {
+        return -1;
+    }
+    textureObjects = list;
+    memset(&list[textureObjectCount], 0, sizeof(*list));
+    list[textureObjectCount].used = 1;
+    return textureObjectCount++;
+}
+
+static struct TextureObject* getTextureObject(JSContext* ctx, JSValueConst value) {
+    int id;
+    if (JS_ToInt32(ctx, &id, value) || id < 0 || id >= textureObjectCount || !textureObjects[id].used) {
+        JS_ThrowRangeError(ctx, "Invalid texture object");
+        return NULL;
+    }
+    return &textureObjects[id];
+}
+
+static JSValue js_uploadTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct TextureObject* object = getTextureObject(ctx, argv[0]);
+    if (!object) {
+        return JS_EXCEPTION;
+    }
+    int rows = object->height;
+    if (argc > 1 && !JS_IsUndefined(argv[1])) {
+        JS_ToInt32(ctx, &rows, argv[1]);
+    }
+    GLenum format = object->channels == 3 ? GL_RGB : GL_RGBA;
+    if (!object->texture) {
+        // storage and sampler parameters are set once, later calls only stream rows
+        glGenTextures(1, &object->texture);
+        cachedBindTexture(object->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, object->width, object->height, 0, format, GL_UNSIGNED_BYTE, NULL);
+    } else {
+        cachedBindTexture(object->texture);
+    }
+    if (object->pixels && rows > 0) {
+        if (rows > object->height - object->uploadedRows) {
+            rows = object->height - object->uploadedRows;
+        }
+        size_t stride = (size_t)object->width * object->channels;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, object->uploadedRows, object->width, rows, format, GL_UNSIGNED_BYTE, object->pixels + object->uploadedRows * stride);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        object->uploadedRows += rows;
+        if (object->uploadedRows == object->height) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            stbi_image_free(object->pixels);
+            object->pixels = NULL;
+        }
+    }
+    return JS_NewInt32(ctx, object->texture);
+}
+
+static JSValue js_isTextureComplete(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct TextureObject* object = getTextureObject(ctx, argv[0]);
+    if (!object) {
+        return JS_EXCEPTION;
+    }
+    return JS_NewBool(ctx, object->texture && !object->pixels);
+}
+
+static JSValue js_releaseTexture(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    struct TextureObject* object = getTextureObject(ctx, argv[0]);
+    if (!object) {
+        return JS_EXCEPTION;
+    }
+    if (object->texture) {
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++) {
+            if (glState.textures[i] == object->texture) {
+                glState.textures[i] = 0;
+            }
+        }
+        if (object->texture < textureAllocationCount) {
+            if (textureAllocations[object->texture].mipmapsStale) {
+                staleMipmapCount--;
+            }
+            memset(&textureAllocations[object->texture], 0, sizeof(struct TextureAllocation));
+        }
+        glDeleteTextures(1, &object->texture);
+    }
+    stbi_image_free(object->pixels);
+    memset(object, 0, sizeof(*object));
+    return JS_UNDEFINED;
+}
+
+
+// asset loader: a small thread pool reads and decodes files off the JS thread. Finished
+// tasks go on a completion list that a job on the QuickJS job queue drains, so every
+// promise is resolved on the JS thread
+// ---------------------------------------------------------------------------------------------
+#define MAX_ASSET_WORKERS 8
+
+enum AssetKind {
+    ASSET_TEXT,
+    ASSET_IMAGE,
+    ASSET_AUDIO,
+    ASSET_TEXTURE,
+};
+
+struct AssetTask {
+    enum AssetKind kind;
+    char* filename;
+    JSValue resolvingFuncs[2];
+    int ok;
+    unsigned char* data;
+    size_t size;
+    int width;
+    int height;
+    int channels;
+    int slot;
+    // written by the worker, must not move while the task is in flight
+    void* target;
+    struct AssetTask* next;
+};
+
+struct AssetLoader {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t finished;
+    struct AssetTask* queue;
+    struct AssetTask* done;
+    int pending;
+    int pumping;
+    int workers;
+};
+
+struct AssetLoader assetLoader = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queued = PTHREAD_COND_INITIALIZER,
+    .finished = PTHREAD_COND_INITIALIZER,
+};
+
+static void runAssetTask(struct AssetTask* task) {
+    switch (task->kind) {
+    case ASSET_TEXT: {
+        FILE* file = fopen(task->filename, "rb");
+        if (!file) {
+            return;
+        }
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        task->data = malloc(length + 1);
+        if (task->data) {
+            task->size = fread(task->data, 1, length, file);
+            task->data[task->size] = '\0';
+            task->ok = 1;
+        }
+        fclose(file);
+        break;
+    }
+    case ASSET_IMAGE:
+    case ASSET_TEXTURE: {
+        int nrChannels;
+        task->data = stbi_load(task->filename, &task->width, &task->height, &nrChannels, 0);
+        if (task->data) {
+            task->size = (size_t)task->width * task->height * nrChannels;
+            task->channels = nrChannels;
+            task->ok = 1;
+        }
+        break;
+    }
+    case ASSET_AUDIO: {
+        // decoded up front, the resource manager keeps the PCM for every copy of the prototype
+        task->ok = ma_sound_init_from_file(pEngine, task->filename, MA_SOUND_FLAG_DECODE, NULL, NULL, task->target) == MA_SUCCESS;
+        break;
+    }
+    }
+}
+
+static void* assetWorker(void* arg) {
+    pthread_mutex_lock(&assetLoader.lock);
+    for (;;) {
+        while (!assetLoader.queue) {
+            pthread_cond_wait(&assetLoader.queued, &assetLoader.lock);
+        }
+        struct AssetTask* task = assetLoader.queue;
+        assetLoader.queue = task->next;
+        pthread_mutex_unlock(&assetLoader.lock);
+        runAssetTask(task);
+        pthread_mutex_lock(&assetLoader.lock);
+        task->next = assetLoader.done;
+        assetLoader.done = task;
+        pthread_cond_signal(&assetLoader.finished);
+    }
+    return NULL;
 }
 
-static JSValue js_bindVAO(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    unsigned int VAO;
-    JS_ToUint32(ctx, &VAO, argv[0]);
-    glBindVertexArray(VAO);
-    return JS_UNDEFINED;
+static void freeImageData(JSRuntime* rt, void* opaque, void* ptr) {
+    stbi_image_free(ptr);
 }
 
-static JSValue js_bindVBO(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    unsigned int VBO;
-    JS_ToUint32(ctx, &VBO, argv[0]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    return JS_UNDEFINED;
+static JSValue newAssetError(JSContext* ctx, const char* message, const char* filename) {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "%s: %s", message, filename);
+    JSValue error = JS_NewError(ctx);
+    JS_SetPropertyStr(ctx, error, "message", JS_NewString(ctx, buffer));
+    return error;
 }
 
-static JSValue js_bindEBO(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    unsigned int EBO;
-    JS_ToUint32(ctx, &EBO, argv[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    return JS_UNDEFINED;
+static void settleAssetTask(JSContext* ctx, struct AssetTask* task) {
+    JSValue value;
+    int rejected = !task->ok;
+    if (rejected) {
+        value = newAssetError(ctx, "Failed to load asset", task->filename);
+        free(task->data);
+        if (task->kind == ASSET_TEXTURE) {
+            textureObjects[task->slot].used = 0;
+        }
+    } else if (task->kind == ASSET_TEXT) {
+        value = JS_NewStringLen(ctx, (const char*)task->data, task->size);
+        free(task->data);
+    } else if (task->kind == ASSET_IMAGE) {
+        // the ArrayBuffer takes ownership of the decoded pixels, no copy
+        value = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, value, "width", JS_NewInt32(ctx, task->width));
+        JS_SetPropertyStr(ctx, value, "height", JS_NewInt32(ctx, task->height));
+        JS_SetPropertyStr(ctx, value, "data", JS_NewArrayBuffer(ctx, task->data, task->size, freeImageData, NULL, 0));
+    } else if (task->kind == ASSET_TEXTURE) {
+        // the pixels stay native until uploadTexture has sent the last row to GL
+        struct TextureObject* object = &textureObjects[task->slot];
+        object->width = task->width;
+        object->height = task->height;
+        object->channels = task->channels;
+        object->pixels = task->data;
+        value = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, value, "id", JS_NewInt32(ctx, task->slot));
+        JS_SetPropertyStr(ctx, value, "width", JS_NewInt32(ctx, task->width));
+        JS_SetPropertyStr(ctx, value, "height", JS_NewInt32(ctx, task->height));
+    } else {
+        audioClips[task->slot]->ready = 1;
+        value = JS_NewInt32(ctx, task->slot);
+    }
+    JSValue ret = JS_Call(ctx, task->resolvingFuncs[rejected], JS_UNDEFINED, 1, (JSValueConst*)&value);
+    JS_FreeValue(ctx, ret);
+    JS_FreeValue(ctx, value);
+    JS_FreeValue(ctx, task->resolvingFuncs[0]);
+    JS_FreeValue(ctx, task->resolvingFuncs[1]);
+    free(task->filename);
+    free(task);
 }
 
-static JSValue js_setVertexAttributePointer(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    int index;
-    int size;
-    int normalized;
-    int stride;
-    int offset;
-    JS_ToInt32(ctx, &index, argv[0]);
-    JS_ToInt32(ctx, &size, argv[1]);
-    JS_ToInt32(ctx, &normalized, argv[2]);
-    JS_ToInt32(ctx, &stride, argv[3]);
-    JS_ToInt32(ctx, &offset, argv[4]);
-    glVertexAttribPointer(index, size, GL_FLOAT, normalized, stride * sizeof(float), (void*)(offset * sizeof(float)));
+// settles finished tasks and re-queues itself while tasks are in flight; it only blocks
+// waiting for a worker when there is no other job to run
+static JSValue assetPumpJob(JSContext* ctx, int argc, JSValueConst* argv) {
+    pthread_mutex_lock(&assetLoader.lock);
+    while (!assetLoader.done && !JS_IsJobPending(JS_GetRuntime(ctx))) {
+        pthread_cond_wait(&assetLoader.finished, &assetLoader.lock);
+    }
+    struct AssetTask* done = assetLoader.done;
+    assetLoader.done = NULL;
+    pthread_mutex_unlock(&assetLoader.lock);
+    while (done) {
+        struct AssetTask* next = done->next;
+        assetLoader.pending--;
+        settleAssetTask(ctx, done);
+        done = next;
+    }
+    if (assetLoader.pending > 0) {
+        JS_EnqueueJob(ctx, assetPumpJob, 0, NULL);
+    } else {
+        assetLoader.pumping = 0;
+    }
     return JS_UNDEFINED;
 }
 
-static JSValue js_enableVertexAttribute(JSContext* ctx,
-    JSValueConst this_val,
-    int argc,
-    JSValueConst* argv) {
-    int index;
-    JS_ToInt32(ctx, &index, argv[0]);
-    glEnableVertexAttribArray(index);
-    return JS_UNDEFINED;
+static JSValue submitAssetTask(JSContext* ctx, enum AssetKind kind, JSValueConst filename, int slot, void* target) {
+    if (assetLoader.workers == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        int count = cores < 2 ? 2 : cores > MAX_ASSET_WORKERS ? MAX_ASSET_WORKERS : cores;
+        for (int i = 0; i < count; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, assetWorker, NULL) == 0) {
+                pthread_detach(thread);
+                assetLoader.workers++;
+            }
+        }
+        if (assetLoader.workers == 0) {
+            return JS_ThrowInternalError(ctx, "Failed to start asset workers");
+        }
+    }
+    const char* name = JS_ToCString(ctx, filename);
+    if (!name) {
+        return JS_EXCEPTION;
+    }
+    struct AssetTask* task = calloc(1, sizeof(*task));
+    if (!task || !(task->filename = strdup(name))) {
+        free(task);
+        JS_FreeCString(ctx, name);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    JS_FreeCString(ctx, name);
+    JSValue promise = JS_NewPromiseCapability(ctx, task->resolvingFuncs);
+    if (JS_IsException(promise)) {
+        free(task->filename);
+        free(task);
+        return promise;
+    }
+    task->kind = kind;
+    task->slot = slot;
+    task->target = target;
+    pthread_mutex_lock(&assetLoader.lock);
+    task->next = assetLoader.queue;
+    assetLoader.queue = task;
+    pthread_cond_signal(&assetLoader.queued);
+    pthread_mutex_unlock(&assetLoader.lock);
+    assetLoader.pending++;
+    if (!assetLoader.pumping) {
+        assetLoader.pumping = 1;
+        JS_EnqueueJob(ctx, assetPumpJob, 0, NULL);
+    }
+    return promise;
 }
 
-static JSValue js_drawElements(JSContext* ctx,
+static JSValue js_loadText(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int offset;
-    int count;
-    JS_ToInt32(ctx, &offset, argv[0]);
-    JS_ToInt32(ctx, &count, argv[1]);
-    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void *)(uintptr_t)(offset * 4));
-    return JS_UNDEFINED;
+    return submitAssetTask(ctx, ASSET_TEXT, argv[0], 0, NULL);
 }
 
-static JSValue js_useProgram(JSContext* ctx,
+static JSValue js_loadImage(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int program;
-    JS_ToInt32(ctx, &program, argv[0]);
-    glUseProgram(program);
-    return JS_UNDEFINED;
+    return submitAssetTask(ctx, ASSET_IMAGE, argv[0], 0, NULL);
 }
 
-static JSValue js_clear(JSContext* ctx,
+static JSValue js_loadTexture(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    glClear(GL_COLOR_BUFFER_BIT);
-    return JS_UNDEFINED;
+    int slot = reserveTextureObject();
+    if (slot < 0) {
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    JSValue promise = submitAssetTask(ctx, ASSET_TEXTURE, argv[0], slot, NULL);
+    if (JS_IsException(promise)) {
+        textureObjects[slot].used = 0;
+    }
+    return promise;
 }
 
-
-
-ma_engine* pEngine;
-
-struct Audio {
-    ma_sound* sound;
-    const char* filename;
-};
-
-#define MAX_AUDIO 4
-struct Audio audios[MAX_AUDIO];
-int audioCount = 0;
-
 static JSValue js_loadAudio(JSContext* ctx,
     JSValueConst this_val,
     int argc,
@@ -467,64 +3828,261 @@ static JSValue js_loadAudio(JSContext* ctx,
     ma_result result;
     if (pEngine == NULL) {
         pEngine = malloc(sizeof(*pEngine));
-        result = ma_engine_init(NULL, pEngine);
+        ma_engine_config config = ma_engine_config_init();
+        if (headless.enabled) {
+            // nothing pulls frames from a device-less engine, sounds play silently
+            config.noDevice = MA_TRUE;
+            config.channels = 2;
+            config.sampleRate = 48000;
+        }
+        result = ma_engine_init(&config, pEngine);
         if (result != MA_SUCCESS) {
-            printf("Failed to initialize audio engine.\n");
-            return JS_EXCEPTION;
+            free(pEngine);
+            pEngine = NULL;
+            return JS_ThrowInternalError(ctx, "Failed to initialize audio engine");
         }
     }
-    if (audioCount >= MAX_AUDIO) {
-        printf("Too many audio files loaded.\n");
-        return JS_EXCEPTION;
+    // the clip is reserved now so the worker only touches its own prototype
+    struct AudioClip** list = realloc(audioClips, (audioClipCount + 1) * sizeof(*list));
+    if (!list) {
+        return JS_ThrowOutOfMemory(ctx);
     }
-    audios[audioCount].filename = JS_ToCString(ctx, argv[0]);
-    audios[audioCount].sound = malloc(sizeof(*(audios[audioCount].sound)));
-    result = ma_sound_init_from_file(pEngine, audios[audioCount].filename, 0, NULL, NULL, (audios[audioCount].sound));
-    if (result != MA_SUCCESS) {
-        printf("Failed to load audio file: %s\n", audios[audioCount].filename);
-        return JS_EXCEPTION;
+    audioClips = list;
+    audioClips[audioClipCount] = calloc(1, sizeof(struct AudioClip));
+    if (!audioClips[audioClipCount]) {
+        return JS_ThrowOutOfMemory(ctx);
     }
-    return JS_NewInt32(ctx, audioCount++);
+    struct AudioClip* clip = audioClips[audioClipCount];
+    return submitAssetTask(ctx, ASSET_AUDIO, argv[0], audioClipCount++, &clip->prototype);
 }
 
-static JSValue js_playAudio(JSContext* ctx,
+
+// render thread: owns the GL context while it runs and replays the frames JS publishes with
+// swapBuffers. It keeps the last two frames and draws the newer one blended from the older
+// one by how far the clock got into the next frame interval, so the picture moves at the
+// display rate while the simulation steps at its fixed rate. Calls that need an answer from
+// GL can't be recorded, JS borrows the context for them between two replayed frames
+// ---------------------------------------------------------------------------------------------
+static void* getRenderScratch(size_t size) {
+    if (size > renderThread.scratchSize) {
+        float* scratch = realloc(renderThread.scratch, size);
+        if (!scratch) {
+            return NULL;
+        }
+        renderThread.scratch = scratch;
+        renderThread.scratchSize = size;
+    }
+    return renderThread.scratch;
+}
+
+// the next command at or after `at` that has a lerp mode, NULL past the end
+static const struct RenderCommand* nextLerpCommand(const struct RenderFrame* frame, size_t* at) {
+    while (*at < frame->size) {
+        const struct RenderCommand* command = (const struct RenderCommand*)(frame->commands + *at);
+        *at += sizeof(*command) + renderPayloadSize(command->size);
+        if (command->lerp != RENDER_LERP_NONE) {
+            return command;
+        }
+    }
+    return NULL;
+}
+
+// runs the commands of `frame` from byte `at` on. The n-th lerped command is blended with the
+// n-th lerped command of `previous` when both come from the same call on the same target with
+// the same payload size, anything else is drawn as recorded
+static void replayRenderFrame(const struct RenderFrame* frame, size_t at, const struct RenderFrame* previous, float alpha) {
+    size_t previousAt = 0;
+    while (at < frame->size) {
+        struct RenderCommand command = *(const struct RenderCommand*)(frame->commands + at);
+        const float* to = (const float*)(frame->commands + at + sizeof(command));
+        at += sizeof(command) + renderPayloadSize(command.size);
+        command.data = to;
+        const struct RenderCommand* from = NULL;
+        if (command.lerp != RENDER_LERP_NONE && previous) {
+            from = nextLerpCommand(previous, &previousAt);
+        }
+        float* blended = NULL;
+        if (from && alpha < 1 && from->run == command.run && from->size == command.size && from->args[0] == command.args[0]) {
+            blended = getRenderScratch(command.size);
+        }
+        if (blended) {
+            const float* start = (const float*)(from + 1);
+            uint32_t count = command.size / sizeof(float);
+            memcpy(blended, to, command.size);
+            if (command.lerp == RENDER_LERP_SPRITES) {
+                for (uint32_t i = 0; i + 1 < count; i += SPRITE_RECORD_SIZE) {
+                    blended[i] = start[i] + (to[i] - start[i]) * alpha;
+                    blended[i + 1] = start[i + 1] + (to[i + 1] - start[i + 1]) * alpha;
+                }
+            } else {
+                for (uint32_t i = 0; i < count; i++) {
+                    blended[i] = start[i] + (to[i] - start[i]) * alpha;
+                }
+            }
+            command.data = blended;
+        }
+        command.run(&command);
+    }
+}
+
+static void* renderThreadMain(void* arg) {
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
+    int previous = -1;
+    int current = -1;
+    pthread_mutex_lock(&renderThread.lock);
+    while (!renderThread.stop) {
+        if (renderThread.borrowRequested) {
+            glfwMakeContextCurrent(NULL);
+            renderThread.lent = 1;
+            pthread_cond_broadcast(&renderThread.changed);
+            while (renderThread.lent && !renderThread.stop) {
+                pthread_cond_wait(&renderThread.changed, &renderThread.lock);
+            }
+            glfwMakeContextCurrent(window);
+            continue;
+        }
+        // the oldest published frame becomes current, the frame before it is kept to blend from
+        int next = -1;
+        for (int i = 0; i < RENDER_FRAMES; i++) {
+            struct RenderFrame* frame = &renderThread.frames[i];
+            if (frame->state == RENDER_FRAME_READY && (next < 0 || frame->sequence < renderThread.frames[next].sequence)) {
+                next = i;
+            }
+        }
+        if (next >= 0) {
+            if (previous >= 0) {
+                renderThread.frames[previous].state = RENDER_FRAME_FREE;
+            }
+            previous = current;
+            current = next;
+            renderThread.frames[current].state = RENDER_FRAME_SHOWN;
+            pthread_cond_broadcast(&renderThread.changed);
+        } else if (current < 0) {
+            // nothing to show yet, sleep until JS publishes a frame or asks for the context. Both
+            // broadcast `changed`, and the loop checks them again before waiting
+            pthread_cond_wait(&renderThread.changed, &renderThread.lock);
+            continue;
+        }
+        // shown frames belong to this thread until it frees them
+        const struct RenderFrame* to = &renderThread.frames[current];
+        const struct RenderFrame* from = previous >= 0 ? &renderThread.frames[previous] : NULL;
+        pthread_mutex_unlock(&renderThread.lock);
+        float alpha = 1;
+        if (from && to->time > from->time) {
+            alpha = (glfwGetTime() - to->time) / (to->time - from->time);
+            alpha = alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+        }
+        replayRenderFrame(to, 0, from, alpha);
+        // blocks until vsync, which paces this loop
+        glfwSwapBuffers(window);
+        pthread_mutex_lock(&renderThread.lock);
+    }
+    pthread_mutex_unlock(&renderThread.lock);
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+// runs `function` on the JS thread with the GL context borrowed from the render thread. What
+// JS recorded since the last borrow runs first, so the call sees the state those commands set.
+// The commands stay in the frame, the render thread still draws all of them
+static JSValue callWithRenderContext(JSCFunction* function,
+    JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int index;
-    double volume;
-    int loop;
-    JS_ToInt32(ctx, &index, argv[0]);
-    JS_ToFloat64(ctx, &volume, argv[1]);
-    JS_ToInt32(ctx, &loop, argv[2]);
-    audios[index].sound = malloc(sizeof(*(audios[index].sound)));
-    ma_result result;
-    result = ma_sound_init_from_file(pEngine, audios[index].filename, 0, NULL, NULL, (audios[index].sound));
-    if (result != MA_SUCCESS) {
-        printf("Failed to load audio file: %s\n", audios[index].filename);
-        return JS_EXCEPTION;
+    pthread_mutex_lock(&renderThread.lock);
+    renderThread.borrowRequested = 1;
+    pthread_cond_broadcast(&renderThread.changed);
+    while (!renderThread.lent) {
+        pthread_cond_wait(&renderThread.changed, &renderThread.lock);
     }
-    ma_sound_set_volume(audios[index].sound, volume);
-    ma_sound_set_looping(audios[index].sound, loop);
-    ma_sound_start(audios[index].sound);
-    return JS_UNDEFINED;
+    pthread_mutex_unlock(&renderThread.lock);
+    glfwMakeContextCurrent(window);
+    struct RenderFrame* frame = &renderThread.frames[renderThread.recording];
+    replayRenderFrame(frame, frame->replayed, NULL, 1);
+    frame->replayed = frame->size;
+    JSValue result = function(ctx, this_val, argc, argv);
+    glfwMakeContextCurrent(NULL);
+    pthread_mutex_lock(&renderThread.lock);
+    renderThread.borrowRequested = 0;
+    renderThread.lent = 0;
+    pthread_cond_broadcast(&renderThread.changed);
+    pthread_mutex_unlock(&renderThread.lock);
+    return result;
 }
 
-static JSValue js_stopAudio(JSContext* ctx,
+// hands the recording frame to the render thread and starts the next one. Waits while every
+// other frame is still queued or shown, so JS never runs more than a frame ahead
+static void publishRenderFrame(void) {
+    pthread_mutex_lock(&renderThread.lock);
+    struct RenderFrame* frame = &renderThread.frames[renderThread.recording];
+    frame->time = glfwGetTime();
+    frame->sequence = ++renderThread.published;
+    frame->state = RENDER_FRAME_READY;
+    pthread_cond_broadcast(&renderThread.changed);
+    for (;;) {
+        for (int i = 0; i < RENDER_FRAMES; i++) {
+            if (renderThread.frames[i].state == RENDER_FRAME_FREE) {
+                renderThread.frames[i].state = RENDER_FRAME_RECORDING;
+                renderThread.frames[i].size = 0;
+                renderThread.frames[i].replayed = 0;
+                renderThread.recording = i;
+                pthread_mutex_unlock(&renderThread.lock);
+                return;
+            }
+        }
+        pthread_cond_wait(&renderThread.changed, &renderThread.lock);
+    }
+}
+
+static void stopRenderThread(void) {
+    if (!renderThread.running) {
+        return;
+    }
+    pthread_mutex_lock(&renderThread.lock);
+    renderThread.stop = 1;
+    pthread_cond_broadcast(&renderThread.changed);
+    pthread_mutex_unlock(&renderThread.lock);
+    pthread_join(renderThread.thread, NULL);
+    renderThread.running = 0;
+    glfwMakeContextCurrent(window);
+}
+
+// moves GL to the render thread, returns false when there is no window or it already runs
+static JSValue js_startRenderThread(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    int index;
-    JS_ToInt32(ctx, &index, argv[0]);
-    ma_sound_stop(audios[index].sound);
-    return JS_UNDEFINED;
+    if (headless.enabled || !window || renderThread.running) {
+        return JS_FALSE;
+    }
+    for (int i = 0; i < RENDER_FRAMES; i++) {
+        renderThread.frames[i].state = RENDER_FRAME_FREE;
+        renderThread.frames[i].size = 0;
+        renderThread.frames[i].replayed = 0;
+    }
+    renderThread.frames[0].state = RENDER_FRAME_RECORDING;
+    renderThread.recording = 0;
+    renderThread.stop = 0;
+    renderThread.borrowRequested = 0;
+    renderThread.lent = 0;
+    glfwMakeContextCurrent(NULL);
+    if (pthread_create(&renderThread.thread, NULL, renderThreadMain, NULL) != 0) {
+        glfwMakeContextCurrent(window);
+        return JS_FALSE;
+    }
+    renderThread.running = 1;
+    return JS_TRUE;
 }
 
-
 static JSValue js_shouldCloseWindow(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
+    if (headless.enabled) {
+        return JS_NewBool(ctx, headless.frames && headless.frame >= headless.frames);
+    }
     return JS_NewBool(ctx, glfwWindowShouldClose(window));
 }
 
@@ -532,6 +4090,14 @@ static JSValue js_swapBuffers(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
+    if (headless.enabled) {
+        headless.frame++;
+        return JS_UNDEFINED;
+    }
+    if (renderThread.running) {
+        publishRenderFrame();
+        return JS_UNDEFINED;
+    }
     glfwSwapBuffers(window);
     return JS_UNDEFINED;
 }
@@ -540,22 +4106,118 @@ static JSValue js_pollEvents(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
-    glfwPollEvents();
+    if (headless.enabled) {
+        playHeadlessInput();
+        return JS_UNDEFINED;
+    }
+    // with a timeout the JS thread sleeps until input arrives or the next tick is due
+    double timeout = 0;
+    if (argc > 0 && JS_ToFloat64(ctx, &timeout, argv[0])) {
+        return JS_EXCEPTION;
+    }
+    if (timeout > 0) {
+        glfwWaitEventsTimeout(timeout);
+    } else {
+        glfwPollEvents();
+    }
+    return JS_UNDEFINED;
+}
+
+// in manual mode QuickJS never collects inside an allocation, only in collectGarbage
+static JSValue js_setManualGC(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    JS_SetGCMode(JS_GetRuntime(ctx), JS_ToBool(ctx, argv[0]) ? JS_GC_MODE_MANUAL : JS_GC_MODE_AUTO);
     return JS_UNDEFINED;
 }
 
+// collects the young objects, and the whole heap when due and it fits in `budget` seconds
+static JSValue js_collectGarbage(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    double budget;
+    if (JS_ToFloat64(ctx, &budget, argv[0])) {
+        return JS_EXCEPTION;
+    }
+    return JS_NewBool(ctx, JS_RunGCStep(JS_GetRuntime(ctx), budget * 1e6));
+}
+
 static JSValue js_getTime(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
+    if (headless.enabled) {
+        return JS_NewFloat64(ctx, headless.frame * headless.timestep);
+    }
     return JS_NewFloat64(ctx, glfwGetTime());
 }
 
 
+// reads the [frame, key, down] triples of the scripted input track, in frame order
+static int readInputEvents(JSContext* ctx, JSValueConst input) {
+    uint32_t count = getLengthProperty(ctx, input);
+    free(headless.events);
+    headless.events = NULL;
+    headless.eventCount = 0;
+    headless.nextEvent = 0;
+    if (count == 0) {
+        return 0;
+    }
+    headless.events = malloc(count * sizeof(*headless.events));
+    if (!headless.events) {
+        JS_ThrowOutOfMemory(ctx);
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        JSValue event = JS_GetPropertyUint32(ctx, input, i);
+        headless.events[i].frame = (uint32_t)getNumberProperty(ctx, event, "0");
+        headless.events[i].key = (int)getNumberProperty(ctx, event, "1");
+        headless.events[i].down = getNumberProperty(ctx, event, "2") != 0;
+        JS_FreeValue(ctx, event);
+        if (i > 0 && headless.events[i].frame < headless.events[i - 1].frame) {
+            JS_ThrowRangeError(ctx, "Input events must be sorted by frame");
+            return -1;
+        }
+    }
+    headless.eventCount = count;
+    return 0;
+}
+
 static JSValue js_initContext(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
+    JSValueConst options = argc > 0 ? argv[0] : JS_UNDEFINED;
+    JSValue value = JS_IsObject(options) ? JS_GetPropertyStr(ctx, options, "headless") : JS_UNDEFINED;
+    headless.enabled = JS_ToBool(ctx, value);
+    JS_FreeValue(ctx, value);
+    if (headless.enabled) {
+        headless.timestep = getNumberProperty(ctx, options, "timestep");
+        if (headless.timestep <= 0) {
+            headless.timestep = 1.0 / 60.0;
+        }
+        headless.frames = (uint32_t)getNumberProperty(ctx, options, "frames");
+        headless.frame = 0;
+        memset(headless.keys, 0, sizeof(headless.keys));
+        JSValue input = JS_GetPropertyStr(ctx, options, "input");
+        int result = readInputEvents(ctx, input);
+        JS_FreeValue(ctx, input);
+        if (result < 0) {
+            return JS_EXCEPTION;
+        }
+        playHeadlessInput();
+        resetGLStateCache();
+        if (!gladLoadGLLoader((GLADloadproc)getNullGLProcAddress)) {
+            return JS_ThrowInternalError(ctx, "Failed to initialize null GL");
+        }
+        // program binaries need a driver, the shader cache stays off
+        getProgramBinary = NULL;
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        return JS_UNDEFINED;
+    }
 
     // glfw: initialize and configure
     // ------------------------------
@@ -578,6 +4240,7 @@ static JSValue js_initContext(JSContext* ctx,
         return JS_UNDEFINED;
     }
     glfwMakeContextCurrent(window);
+    resetGLStateCache();
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
     // glad: load all OpenGL function pointers
@@ -587,6 +4250,7 @@ static JSValue js_initContext(JSContext* ctx,
         printf("Failed to initialize GLAD\n");
         return JS_UNDEFINED;
     }    
+    initShaderCache();
     glfwSwapInterval(1);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -596,6 +4260,7 @@ static JSValue js_terminate(JSContext* ctx,
     JSValueConst this_val,
     int argc,
     JSValueConst* argv) {
+    stopRenderThread();
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
@@ -614,6 +4279,10 @@ static JSValue js_getScreenHeight(JSContext* ctx,
      JSValueConst* argv) {
     return JS_NewInt32(ctx, height);
 }
+static void runClearColor(const struct RenderCommand* command) {
+    glClearColor(command->values[0], command->values[1], command->values[2], command->values[3]);
+}
+
 static JSValue js_clearColor(JSContext* ctx,
     JSValueConst this_val,
     int argc,
@@ -626,8 +4295,8 @@ static JSValue js_clearColor(JSContext* ctx,
     JS_ToFloat64(ctx, &g, argv[1]);
     JS_ToFloat64(ctx, &b, argv[2]);
     JS_ToFloat64(ctx, &a, argv[3]);
-    glClearColor(r, g, b, a);
-    return JS_UNDEFINED;
+    struct RenderCommand command = { .run = runClearColor, .values = { r, g, b, a } };
+    return submitRenderCommand(ctx, &command);
 }
 
 
@@ -637,6 +4306,9 @@ static JSValue js_getKey(JSContext* ctx,
     JSValueConst* argv) {
     int key;
     JS_ToInt32(ctx, &key, argv[0]);
+    if (headless.enabled) {
+        return JS_NewBool(ctx, key >= 0 && key <= GLFW_KEY_LAST && headless.keys[key]);
+    }
     return JS_NewBool(ctx, glfwGetKey(window, key) == GLFW_PRESS);
 }
 
@@ -653,7 +4325,7 @@ static JSValue js_createFramebuffer(JSContext* ctx,
     glGenFramebuffers(1, &fbo);
     unsigned int texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    cachedBindTexture(texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -696,32 +4368,267 @@ static JSValue js_endFramebuffer(JSContext* ctx,
     return JS_UNDEFINED;
 }
 
+// atlas cache: the packed atlas pixels and its rect table baked into one file, so later
+// launches skip the PNG decode and the bin packing. Layout:
+//   header | sources ("\n" joined) | rect table (JSON, NUL terminated) | atlasSize * atlasSize RGBA pixels
+// the cache is stale when the source list changed or any source is newer than the file
+// ---------------------------------------------------------------------------------------------
+#define ATLAS_CACHE_MAGIC 0x434c5441u // "ATLC"
+#define ATLAS_CACHE_VERSION 1
+
+struct AtlasCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t atlasSize;
+    uint32_t sourcesLength;
+    uint32_t tableLength;
+};
+
+struct AtlasCacheMapping {
+    void* base;
+    size_t length;
+};
+
+// joins the source paths and finds the newest mtime, NULL when a source is missing
+static char* getAtlasSources(JSContext* ctx, JSValueConst sources, size_t* length, time_t* newest) {
+    uint32_t count = getLength(ctx, sources);
+    char* joined = malloc(1);
+    if (!joined) {
+        return NULL;
+    }
+    *length = 0;
+    *newest = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        JSValue element = JS_GetPropertyUint32(ctx, sources, i);
+        size_t size;
+        const char* path = JS_ToCStringLen(ctx, &size, element);
+        JS_FreeValue(ctx, element);
+        struct stat st;
+        char* grown = path ? realloc(joined, *length + size + 2) : NULL;
+        if (!grown || stat(path, &st) != 0) {
+            JS_FreeCString(ctx, path);
+            free(grown ? grown : joined);
+            return NULL;
+        }
+        joined = grown;
+        if (i > 0) {
+            joined[(*length)++] = '\n';
+        }
+        memcpy(joined + *length, path, size);
+        *length += size;
+        if (st.st_mtime > *newest) {
+            *newest = st.st_mtime;
+        }
+        JS_FreeCString(ctx, path);
+    }
+    joined[*length] = '\0';
+    return joined;
+}
+
+static void freeAtlasCacheMapping(JSRuntime* rt, void* opaque, void* ptr) {
+    struct AtlasCacheMapping* mapping = opaque;
+    munmap(mapping->base, mapping->length);
+    free(mapping);
+}
+
+static JSValue js_readAtlasCache(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    size_t sourcesLength;
+    time_t newest;
+    char* sources = getAtlasSources(ctx, argv[1], &sourcesLength, &newest);
+    if (!sources) {
+        return JS_NULL;
+    }
+    const char* path = JS_ToCString(ctx, argv[0]);
+    int fd = path ? open(path, O_RDONLY) : -1;
+    JS_FreeCString(ctx, path);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_mtime < newest || (size_t)st.st_size < sizeof(struct AtlasCacheHeader)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(sources);
+        return JS_NULL;
+    }
+    size_t length = st.st_size;
+    unsigned char* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        free(sources);
+        return JS_NULL;
+    }
+    struct AtlasCacheHeader header;
+    memcpy(&header, base, sizeof(header));
+    size_t pixelsOffset = sizeof(header) + (size_t)header.sourcesLength + header.tableLength;
+    size_t pixelsLength = (size_t)header.atlasSize * header.atlasSize * 4;
+    int valid = header.magic == ATLAS_CACHE_MAGIC
+        && header.version == ATLAS_CACHE_VERSION
+        && header.sourcesLength == sourcesLength
+        && header.tableLength > 0
+        && pixelsOffset + pixelsLength == length
+        && memcmp(base + sizeof(header), sources, sourcesLength) == 0
+        && base[pixelsOffset - 1] == '\0';
+    free(sources);
+    struct AtlasCacheMapping* mapping = valid ? malloc(sizeof(*mapping)) : NULL;
+    if (!mapping) {
+        munmap(base, length);
+        return JS_NULL;
+    }
+    // the table is stored with its terminator, which the JSON parser needs
+    JSValue atlasData = JS_ParseJSON(ctx, (const char*)base + sizeof(header) + sourcesLength, header.tableLength - 1, "<atlas cache>");
+    if (JS_IsException(atlasData)) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        munmap(base, length);
+        free(mapping);
+        return JS_NULL;
+    }
+    mapping->base = base;
+    mapping->length = length;
+    JSValue ret = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, ret, "atlasSize", JS_NewInt32(ctx, header.atlasSize));
+    JS_SetPropertyStr(ctx, ret, "atlasData", atlasData);
+    // the pixels stay in the mapping until the ArrayBuffer is collected
+    JS_SetPropertyStr(ctx, ret, "data", JS_NewArrayBuffer(ctx, base + pixelsOffset, pixelsLength, freeAtlasCacheMapping, mapping, 0));
+    return ret;
+}
+
+static JSValue js_writeAtlasCache(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int fbo;
+    int atlasSize;
+    size_t sourcesLength;
+    if (headless.enabled) {
+        // null GL reads back blank pixels, a cache written now would hide the real atlas
+        return JS_FALSE;
+    }
+    time_t newest;
+    JS_ToInt32(ctx, &fbo, JS_GetPropertyStr(ctx, argv[1], "fbo"));
+    JS_ToInt32(ctx, &atlasSize, JS_GetPropertyStr(ctx, argv[1], "width"));
+    char* sources = getAtlasSources(ctx, argv[3], &sourcesLength, &newest);
+    if (!sources) {
+        return JS_FALSE;
+    }
+    JSValue table = JS_JSONStringify(ctx, argv[2], JS_UNDEFINED, JS_UNDEFINED);
+    size_t tableLength;
+    const char* tableJSON = JS_ToCStringLen(ctx, &tableLength, table);
+    JS_FreeValue(ctx, table);
+    size_t pixelsLength = (size_t)atlasSize * atlasSize * 4;
+    unsigned char* pixels = tableJSON ? malloc(pixelsLength) : NULL;
+    if (!pixels) {
+        JS_FreeCString(ctx, tableJSON);
+        free(sources);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, atlasSize, atlasSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    struct AtlasCacheHeader header = {
+        .magic = ATLAS_CACHE_MAGIC,
+        .version = ATLAS_CACHE_VERSION,
+        .atlasSize = atlasSize,
+        .sourcesLength = sourcesLength,
+        .tableLength = tableLength + 1,
+    };
+    // write next to the cache and rename, a crash never leaves a torn file behind
+    const char* path = JS_ToCString(ctx, argv[0]);
+    char* tmpPath = path ? concat(path, ".tmp") : NULL;
+    FILE* file = tmpPath ? fopen(tmpPath, "wb") : NULL;
+    int ok = file
+        && fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(sources, 1, sourcesLength, file) == sourcesLength
+        && fwrite(tableJSON, 1, tableLength + 1, file) == tableLength + 1
+        && fwrite(pixels, 1, pixelsLength, file) == pixelsLength;
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(tmpPath, path) == 0;
+        if (!ok) {
+            remove(tmpPath);
+        }
+    }
+    free(tmpPath);
+    JS_FreeCString(ctx, path);
+    JS_FreeCString(ctx, tableJSON);
+    free(pixels);
+    free(sources);
+    return JS_NewBool(ctx, ok);
+}
+
+// uploads cached atlas pixels with the sampling of a framebuffer-built atlas
+static JSValue js_uploadAtlasCache(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv) {
+    int atlasSize;
+    size_t size;
+    JS_ToInt32(ctx, &atlasSize, JS_GetPropertyStr(ctx, argv[0], "atlasSize"));
+    JSValue data = JS_GetPropertyStr(ctx, argv[0], "data");
+    unsigned char* pixels = JS_GetArrayBuffer(ctx, &size, data);
+    if (!pixels || size < (size_t)atlasSize * atlasSize * 4) {
+        JS_FreeValue(ctx, data);
+        return JS_ThrowRangeError(ctx, "Atlas cache pixels are too short");
+    }
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    cachedBindTexture(texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    JS_FreeValue(ctx, data);
+    return JS_NewInt32(ctx, texture);
+}
+
 static const JSCFunctionListEntry js_context_funcs[] = {
     JS_CFUNC_DEF("loadText", 1, js_loadText),
     JS_CFUNC_DEF("createShaderProgram", 2, js_createShaderProgram),
     JS_CFUNC_DEF("bufferData", 3, js_bufferData),
     JS_CFUNC_DEF("bufferDataElement", 3, js_bufferDataElement),
+    JS_CFUNC_DEF("bufferSubData", 2, js_bufferSubData),
     JS_CFUNC_DEF("createVAO", 0, js_createVAO),
     JS_CFUNC_DEF("createBuffer", 0, js_createBuffer),
+    JS_CFUNC_DEF("createUniformBuffer", 1, js_createUniformBuffer),
+    JS_CFUNC_DEF("bindUniformBuffer", 2, js_bindUniformBuffer),
+    JS_CFUNC_DEF("updateUniformBuffer", 5, js_updateUniformBuffer),
+    JS_CFUNC_DEF("setUniformBlockBinding", 3, js_setUniformBlockBinding),
     JS_CFUNC_DEF("bindVAO", 1, js_bindVAO),
     JS_CFUNC_DEF("bindVBO", 1, js_bindVBO),
     JS_CFUNC_DEF("bindEBO", 1, js_bindEBO),
     JS_CFUNC_DEF("setVertexAttributePointer", 5, js_setVertexAttributePointer),
     JS_CFUNC_DEF("enableVertexAttribute", 1, js_enableVertexAttribute),
     JS_CFUNC_DEF("drawElements", 4, js_drawElements),
+    JS_CFUNC_DEF("drawElementsInstanced", 3, js_drawElementsInstanced),
+    JS_CFUNC_DEF("setVertexAttributeDivisor", 2, js_setVertexAttributeDivisor),
     JS_CFUNC_DEF("uniformMatrix4fv", 4, js_uniformMatrix4fv),
     JS_CFUNC_DEF("uniform1f", 2, js_uniform1f),
     JS_CFUNC_DEF("uniform3f", 4, js_uniform3f),
     JS_CFUNC_DEF("uniform4f", 5, js_uniform4f),
     JS_CFUNC_DEF("uniform1i", 2, js_uniform1i),
     JS_CFUNC_DEF("getUniformLocation", 2, js_getUniformLocation),
+    JS_CFUNC_DEF("mat4Identity", 1, js_mat4Identity),
+    JS_CFUNC_DEF("mat4Multiply", 3, js_mat4Multiply),
+    JS_CFUNC_DEF("mat4Translate", 3, js_mat4Translate),
+    JS_CFUNC_DEF("mat4Scale", 3, js_mat4Scale),
+    JS_CFUNC_DEF("mat4FromTranslation", 2, js_mat4FromTranslation),
+    JS_CFUNC_DEF("mat4Ortho", 7, js_mat4Ortho),
+    JS_CFUNC_DEF("mat4LookAt", 4, js_mat4LookAt),
+    JS_CFUNC_DEF("mat4FromTranslationScaleBatch", 4, js_mat4FromTranslationScaleBatch),
     JS_CFUNC_DEF("useProgram", 1, js_useProgram),
     JS_CFUNC_DEF("clear", 0, js_clear),
     JS_CFUNC_DEF("getScreenWidth", 0, js_getScreenWidth),
     JS_CFUNC_DEF("getScreenHeight", 0, js_getScreenHeight),
     JS_CFUNC_DEF("shouldCloseWindow", 1, js_shouldCloseWindow),
     JS_CFUNC_DEF("swapBuffers", 1, js_swapBuffers),
-    JS_CFUNC_DEF("pollEvents", 0, js_pollEvents),
+    JS_CFUNC_DEF("pollEvents", 1, js_pollEvents),
+    JS_CFUNC_DEF("setManualGC", 1, js_setManualGC),
+    JS_CFUNC_DEF("collectGarbage", 1, js_collectGarbage),
+    JS_CFUNC_DEF("startRenderThread", 0, js_startRenderThread),
     JS_CFUNC_DEF("getTime", 0, js_getTime),
     JS_CFUNC_DEF("initContext", 0, js_initContext),
     JS_CFUNC_DEF("terminate", 0, js_terminate),
@@ -730,28 +4637,93 @@ static const JSCFunctionListEntry js_context_funcs[] = {
     JS_CFUNC_DEF("createTexture", 0, js_createTexture),
     JS_CFUNC_DEF("bindTexture", 1, js_bindTexture),
     JS_CFUNC_DEF("updateTexture", 2, js_updateTexture),
+    JS_CFUNC_DEF("loadTexture", 1, js_loadTexture),
+    JS_CFUNC_DEF("uploadTexture", 2, js_uploadTexture),
+    JS_CFUNC_DEF("isTextureComplete", 1, js_isTextureComplete),
+    JS_CFUNC_DEF("releaseTexture", 1, js_releaseTexture),
     JS_CFUNC_DEF("activeTexture", 1, js_activeTexture),
     JS_CFUNC_DEF("resize", 0, js_resize),
     JS_CFUNC_DEF("getKey", 1, js_getKey),
     JS_CFUNC_DEF("createFramebuffer", 2, js_createFramebuffer),
     JS_CFUNC_DEF("beginFramebuffer", 1, js_beginFramebuffer),
     JS_CFUNC_DEF("endFramebuffer", 1, js_endFramebuffer),
+    JS_CFUNC_DEF("readAtlasCache", 2, js_readAtlasCache),
+    JS_CFUNC_DEF("writeAtlasCache", 4, js_writeAtlasCache),
+    JS_CFUNC_DEF("uploadAtlasCache", 1, js_uploadAtlasCache),
     JS_CFUNC_DEF("loadAudio", 1, js_loadAudio),
     JS_CFUNC_DEF("playAudio", 3, js_playAudio),
     JS_CFUNC_DEF("stopAudio", 1, js_stopAudio),
+    JS_CFUNC_DEF("createSpriteBatch", 1, js_createSpriteBatch),
+    JS_CFUNC_DEF("drawSpriteBatch", 4, js_drawSpriteBatch),
+    JS_CFUNC_DEF("getGLStateStats", 1, js_getGLStateStats),
+    JS_CFUNC_DEF("createPhysicsWorld", 2, js_createPhysicsWorld),
+    JS_CFUNC_DEF("setPhysicsTiles", 7, js_setPhysicsTiles),
+    JS_CFUNC_DEF("stepPhysics", 5, js_stepPhysics),
+    JS_CFUNC_DEF("createECSWorld", 2, js_createECSWorld),
+    JS_CFUNC_DEF("createEntity", 2, js_createEntity),
+    JS_CFUNC_DEF("destroyEntity", 2, js_destroyEntity),
+    JS_CFUNC_DEF("queryEntities", 2, js_queryEntities),
+    JS_CFUNC_DEF("stepEntityPhysics", 7, js_stepEntityPhysics),
+    JS_CFUNC_DEF("createFont", 1, js_createFont),
+    JS_CFUNC_DEF("layoutText", 10, js_layoutText),
+    JS_CFUNC_DEF("createProfileZone", 1, js_createProfileZone),
+    JS_CFUNC_DEF("beginProfileZone", 1, js_beginProfileZone),
+    JS_CFUNC_DEF("endProfileZone", 0, js_endProfileZone),
+    JS_CFUNC_DEF("beginGPUZone", 1, js_beginGPUZone),
+    JS_CFUNC_DEF("endGPUZone", 0, js_endGPUZone),
+    JS_CFUNC_DEF("endProfileFrame", 0, js_endProfileFrame),
+    JS_CFUNC_DEF("getProfileBuffer", 0, js_getProfileBuffer),
+    JS_CFUNC_DEF("writeProfileTrace", 1, js_writeProfileTrace),
+};
+
+// the exported functions all go through this trampoline so the profiler can count
+// JS to C calls, `magic` is the index into js_context_funcs
+static JSCFunctionListEntry js_profiled_funcs[countof(js_context_funcs)];
+
+// exports that return what GL answers, they borrow the context while the render thread runs
+static const char* const renderThreadSyncCalls[] = {
+    "createShaderProgram", "createVAO", "createBuffer", "createUniformBuffer",
+    "setUniformBlockBinding", "getUniformLocation", "createTexture", "updateTexture",
+    "uploadTexture", "releaseTexture", "createFramebuffer", "beginFramebuffer",
+    "endFramebuffer", "writeAtlasCache", "uploadAtlasCache", "createSpriteBatch",
+    "getGLStateStats",
 };
+static int js_sync_funcs[countof(js_context_funcs)];
+
+static JSValue js_profiledCall(JSContext* ctx,
+    JSValueConst this_val,
+    int argc,
+    JSValueConst* argv,
+    int magic) {
+    profiler.nativeCalls++;
+    if (renderThread.running && js_sync_funcs[magic]) {
+        return callWithRenderContext(js_context_funcs[magic].u.func.cfunc.generic, ctx, this_val, argc, argv);
+    }
+    return js_context_funcs[magic].u.func.cfunc.generic(ctx, this_val, argc, argv);
+}
 
 
 
 static int js_context_init(JSContext* ctx, JSModuleDef* m) {
-    return JS_SetModuleExportList(ctx, m, js_context_funcs, countof(js_context_funcs));
+    return JS_SetModuleExportList(ctx, m, js_profiled_funcs, countof(js_profiled_funcs));
 }
 
 JSModuleDef* js_init_module(JSContext* ctx, const char* module_name) {
     JSModuleDef* m;
+    for (size_t i = 0; i < countof(js_context_funcs); i++) {
+        js_profiled_funcs[i] = js_context_funcs[i];
+        js_profiled_funcs[i].magic = i;
+        js_profiled_funcs[i].u.func.cproto = JS_CFUNC_generic_magic;
+        js_profiled_funcs[i].u.func.cfunc.generic_magic = js_profiledCall;
+        for (size_t j = 0; j < countof(renderThreadSyncCalls); j++) {
+            if (strcmp(js_context_funcs[i].name, renderThreadSyncCalls[j]) == 0) {
+                js_sync_funcs[i] = 1;
+            }
+        }
+    }
     m = JS_NewCModule(ctx, module_name, js_context_init);
     if (!m)
         return NULL;
-    JS_AddModuleExportList(ctx, m, js_context_funcs, countof(js_context_funcs));
+    JS_AddModuleExportList(ctx, m, js_profiled_funcs, countof(js_profiled_funcs));
     return m;
 }
@@ -14,16 +14,110 @@ const context = {
     audio: new AudioContext()
 }
 const keyset = new Set();
+/**
+ * Headless mode: a fixed clock advanced by swapBuffers and a scripted input track replayed by pollEvents.
+ * @type {{
+ *   enabled: boolean,
+ *   timestep: number,
+ *   frames: number,
+ *   frame: number,
+ *   events: Array<[number, number, number]>,
+ *   nextEvent: number
+ * }}
+ */
+const headless = {
+    enabled: false,
+    timestep: 1 / 60,
+    frames: 0,
+    frame: 0,
+    events: [],
+    nextEvent: 0,
+};
 const vaos = new Set();
 const vbos = new Set();
 const GLSL_HEADER = `#version 300 es\nprecision highp float;`;
 
-const MAX_AUDIO = 4;
+/**
+ * Shadow copies of the bindings and uniforms set every draw, used to skip no-op GL calls.
+ * The element buffer binding belongs to the VAO, so it is reset to undefined (unknown) on VAO changes.
+ * @type {{
+ *   program: WebGLProgram | null,
+ *   vao: WebGLVertexArrayObject | null,
+ *   arrayBuffer: WebGLBuffer | null,
+ *   elementBuffer: WebGLBuffer | null | undefined,
+ *   uniformBuffer: WebGLBuffer | null,
+ *   uniformBindings: (WebGLBuffer | null)[],
+ *   activeUnit: number,
+ *   textures: (WebGLTexture | null)[],
+ *   issued: number,
+ *   skipped: number
+ * }}
+ */
+const glState = {
+    program: null,
+    vao: null,
+    arrayBuffer: null,
+    elementBuffer: null,
+    uniformBuffer: null,
+    uniformBindings: [],
+    activeUnit: 0,
+    textures: [],
+    issued: 0,
+    skipped: 0,
+};
+/** @type {WeakMap<WebGLUniformLocation, Float32Array>} */
+const uniformValues = new WeakMap();
+/**
+ * Records `values` for `location` and returns whether they differ from the last upload.
+ * @param {WebGLUniformLocation} location
+ * @param {ArrayLike<number>} values
+ * @returns {boolean}
+ */
+function uniformChanged(location, values) {
+    const cached = uniformValues.get(location);
+    if (cached && cached.length === values.length) {
+        let same = true;
+        for (let i = 0; i < values.length; i++) {
+            if (cached[i] !== Math.fround(values[i])) {
+                same = false;
+                break;
+            }
+        }
+        if (same) {
+            glState.skipped++;
+            return false;
+        }
+        cached.set(values);
+    } else {
+        uniformValues.set(location, Float32Array.from(values));
+    }
+    glState.issued++;
+    return true;
+}
+/**
+ * Get how many cacheable GL calls were issued and how many were skipped as no-ops.
+ * @param {boolean} [reset] - Zero the counters after reading them.
+ * @returns {{issued: number, skipped: number}}
+ */
+export function getGLStateStats(reset = false) {
+    const stats = { issued: glState.issued, skipped: glState.skipped };
+    if (reset) {
+        glState.issued = 0;
+        glState.skipped = 0;
+    }
+    return stats;
+}
+
+const MAX_VOICES = 16;
 /**
  * @type {{filename: string, buffer: unknown}[]}
  */
 const audiobuffers = [];
-const audioNodes = new Array(MAX_AUDIO);
+/**
+ * @type {{ source: AudioBufferSourceNode | null, clip: number, looping: boolean, playing: boolean, startedAt: number }[]}
+ */
+const voices = [];
+let voicePlays = 0;
 
 /**
  * 
@@ -51,16 +145,36 @@ export async function loadAudio(filename) {
     })
 }
 /**
- * 
+ * Plays the clip on a voice from a fixed pool, stealing the oldest one-shot when all are busy.
  * @param {number} id 
  * @param {number} volume 
  * @param {boolean} loop 
+ * @returns {number} the voice, -1 when every voice is a looping track
  */
 export function playAudio(id, volume, loop) {
-    const buffer = audiobuffers[id].buffer;
+    const buffer = audiobuffers[id] && audiobuffers[id].buffer;
     if (!buffer) {
         throw new Error(`Failed to get audio buffer: ${id}`);
     }
+    let index = voices.findIndex(voice => !voice.playing);
+    if (index === -1 && voices.length < MAX_VOICES) {
+        index = voices.push({ source: null, clip: -1, looping: false, playing: false, startedAt: 0 }) - 1;
+    }
+    if (index === -1) {
+        for (let i = 0; i < voices.length; i++) {
+            if (!voices[i].looping && (index === -1 || voices[i].startedAt < voices[index].startedAt)) {
+                index = i;
+            }
+        }
+        if (index === -1) {
+            return -1;
+        }
+    }
+    const voice = voices[index];
+    if (voice.source) {
+        voice.source.onended = null;
+        voice.source.stop();
+    }
     const source = context.audio.createBufferSource();
     source.buffer = buffer;
     source.loop = loop;
@@ -68,18 +182,28 @@ export function playAudio(id, volume, loop) {
     gain.gain.value = volume;
     source.connect(gain);
     gain.connect(context.audio.destination);
+    source.onended = () => voice.playing = false;
     source.start();
-    audioNodes[id] = source;
+    voice.source = source;
+    voice.clip = id;
+    voice.looping = loop;
+    voice.playing = true;
+    voice.startedAt = ++voicePlays;
+    return index;
 }
 /**
- * 
+ * Stops every voice playing the clip.
  * @param {number} id 
  */
 export function stopAudio(id) {
-    if (id >= MAX_AUDIO) {
+    if (!audiobuffers[id]) {
         throw new Error(`Invalid audio id: ${id}`);
     }
-    audioNodes[id].stop();
+    for (const voice of voices) {
+        if (voice.playing && voice.clip === id && voice.source) {
+            voice.source.stop();
+        }
+    }
 }
 
 /**
@@ -154,6 +278,94 @@ export function bufferDataElement(buffer) {
     gl.bufferData(gl.ELEMENT_ARRAY_BUFFER, buffer, gl.STATIC_DRAW);
 }
 
+/**
+ * Overwrite part of the bound array buffer.
+ * @param {number} offset - Byte offset into the buffer.
+ * @param {ArrayBufferView} data - The data to write.
+ */
+export function bufferSubData(offset, data) {
+    const gl = context.gl;
+    gl.bufferSubData(gl.ARRAY_BUFFER, offset, data);
+}
+
+/**
+ * @param {WebGLBuffer} ubo
+ */
+function bindUniformBufferTarget(ubo) {
+    if (glState.uniformBuffer === ubo) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.uniformBuffer = ubo;
+    context.gl.bindBuffer(context.gl.UNIFORM_BUFFER, ubo);
+}
+
+/**
+ * Create a uniform buffer for std140 blocks shared across programs.
+ * @param {number} size - Size in bytes.
+ * @returns {WebGLBuffer} The UBO ID.
+ */
+export function createUniformBuffer(size) {
+    const gl = context.gl;
+    const ubo = gl.createBuffer();
+    if (!ubo) {
+        throw new Error("Failed to create UBO");
+    }
+    vbos.add(ubo);
+    bindUniformBufferTarget(ubo);
+    gl.bufferData(gl.UNIFORM_BUFFER, size, gl.DYNAMIC_DRAW);
+    return ubo;
+}
+
+/**
+ * Attach a uniform buffer to a binding point.
+ * @param {number} binding - The binding point.
+ * @param {WebGLBuffer} ubo - The UBO ID.
+ */
+export function bindUniformBuffer(binding, ubo) {
+    if (glState.uniformBindings[binding] === ubo) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.uniformBindings[binding] = ubo;
+    // binding a range also binds the generic UNIFORM_BUFFER target
+    glState.uniformBuffer = ubo;
+    context.gl.bindBufferBase(context.gl.UNIFORM_BUFFER, binding, ubo);
+}
+
+/**
+ * Overwrite part of a uniform buffer.
+ * @param {WebGLBuffer} ubo - The UBO ID.
+ * @param {number} offset - Byte offset into the buffer.
+ * @param {ArrayBufferView} data - The data to write.
+ * @param {number} [count] - Elements of `data` to write, all of them by default.
+ * @param {boolean} [interpolate] - Let the render thread blend the data between frames, the browser has none.
+ */
+export function updateUniformBuffer(ubo, offset, data, count, interpolate) {
+    const gl = context.gl;
+    bindUniformBufferTarget(ubo);
+    gl.bufferSubData(gl.UNIFORM_BUFFER, offset, data, 0, count);
+}
+
+/**
+ * Point a uniform block of a program at a binding point.
+ * @param {WebGLProgram} program - The program.
+ * @param {string} name - The block name.
+ * @param {number} binding - The binding point.
+ * @returns {boolean} False when the program has no such block.
+ */
+export function setUniformBlockBinding(program, name, binding) {
+    const gl = context.gl;
+    const index = gl.getUniformBlockIndex(program, name);
+    if (index === gl.INVALID_INDEX) {
+        return false;
+    }
+    gl.uniformBlockBinding(program, index, binding);
+    return true;
+}
+
 /**
  * Create a Vertex Array Object (VAO).
  * @returns {WebGLVertexArrayObject} The VAO ID.
@@ -186,10 +398,17 @@ export function createBuffer() {
 
 /**
  * Bind a Vertex Array Object (VAO).
- * @param {WebGLVertexArrayObject} vao - The VAO ID.
+ * @param {WebGLVertexArrayObject | null} vao - The VAO ID.
  */
 export function bindVAO(vao) {
     // Implementation of bindVAO
+    if (glState.vao === vao) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.vao = vao;
+    glState.elementBuffer = undefined;
     context.gl.bindVertexArray(vao);
 }
 
@@ -199,6 +418,12 @@ export function bindVAO(vao) {
  */
 export function bindVBO(vbo) {
     // Implementation of bindVBO
+    if (glState.arrayBuffer === vbo) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.arrayBuffer = vbo;
     context.gl.bindBuffer(context.gl.ARRAY_BUFFER, vbo);
 }
 
@@ -208,6 +433,12 @@ export function bindVBO(vbo) {
  */
 export function bindEBO(ebo) {
     // Implementation of bindEBO
+    if (glState.elementBuffer === ebo) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.elementBuffer = ebo;
     context.gl.bindBuffer(context.gl.ELEMENT_ARRAY_BUFFER, ebo);
 }
 const SIZE_OF_FLOAT = 4;
@@ -244,6 +475,117 @@ export function drawElements(offset, count) {
     // Implementation of drawElements
     const gl = context.gl
     gl.drawElements(gl.TRIANGLES, count, gl.UNSIGNED_INT, offset * 4);
+    profiler.drawCalls++;
+}
+
+/**
+ * Draw instanced elements from array data.
+ * @param {number} offset - The starting offset in the array.
+ * @param {number} count - The number of elements per instance.
+ * @param {number} instanceCount - The number of instances to be rendered.
+ */
+export function drawElementsInstanced(offset, count, instanceCount) {
+    const gl = context.gl
+    gl.drawElementsInstanced(gl.TRIANGLES, count, gl.UNSIGNED_INT, offset * 4, instanceCount);
+    profiler.drawCalls++;
+}
+
+/**
+ * Set how often a vertex attribute advances during instanced draws.
+ * @param {number} index - The index of the generic vertex attribute.
+ * @param {number} divisor - 0 to advance per vertex, n to advance every n instances.
+ */
+export function setVertexAttributeDivisor(index, divisor) {
+    context.gl.vertexAttribDivisor(index, divisor);
+}
+
+const SPRITE_RECORD_SIZE = 14;
+const SPRITE_VERTEX_SIZE = 8;
+/**
+ * @type {{vao: WebGLVertexArrayObject, vbo: WebGLBuffer, capacity: number, vertices: Float32Array}[]}
+ */
+const spriteBatches = [];
+/**
+ * Create a sprite batch that can draw up to `capacity` sprites in one call.
+ * @param {number} capacity - The maximum number of sprites per draw.
+ * @returns {number} The sprite batch ID.
+ */
+export function createSpriteBatch(capacity) {
+    const gl = context.gl;
+    const vao = createVAO();
+    const vbo = createBuffer();
+    const ebo = createBuffer();
+    const indices = new Uint32Array(capacity * 6);
+    for (let i = 0; i < capacity; i++) {
+        indices.set([i * 4 + 0, i * 4 + 1, i * 4 + 3, i * 4 + 1, i * 4 + 2, i * 4 + 3], i * 6);
+    }
+    const vertices = new Float32Array(capacity * 4 * SPRITE_VERTEX_SIZE);
+    bindVAO(vao);
+    bindVBO(vbo);
+    gl.bufferData(gl.ARRAY_BUFFER, vertices.byteLength, gl.DYNAMIC_DRAW);
+    bindEBO(ebo);
+    gl.bufferData(gl.ELEMENT_ARRAY_BUFFER, indices, gl.STATIC_DRAW);
+    setVertexAttributePointer(0, 3, false, SPRITE_VERTEX_SIZE, 0);
+    enableVertexAttribute(0);
+    setVertexAttributePointer(1, 3, false, SPRITE_VERTEX_SIZE, 3);
+    enableVertexAttribute(1);
+    setVertexAttributePointer(2, 2, false, SPRITE_VERTEX_SIZE, 6);
+    enableVertexAttribute(2);
+    bindVAO(null);
+    spriteBatches.push({ vao, vbo, capacity, vertices });
+    return spriteBatches.length - 1;
+}
+
+const SPRITE_CORNERS = [[1, 1], [1, -1], [-1, -1], [-1, 1]];
+/**
+ * Expand sprite records into quads and draw them with a single draw call.
+ * @param {number} id - The sprite batch ID.
+ * @param {Float32Array} records - SPRITE_RECORD_SIZE floats per sprite.
+ * @param {number} count - The number of records to draw.
+ * @param {number} atlasSize - The atlas size in pixels, used to normalize the rects.
+ */
+export function drawSpriteBatch(id, records, count, atlasSize) {
+    const gl = context.gl;
+    const batch = spriteBatches[id];
+    if (!batch) {
+        throw new Error(`Invalid sprite batch: ${id}`);
+    }
+    count = Math.min(count, batch.capacity, Math.floor(records.length / SPRITE_RECORD_SIZE));
+    if (count === 0) {
+        return;
+    }
+    const vertices = batch.vertices;
+    let j = 0;
+    for (let i = 0; i < count; i++) {
+        const r = i * SPRITE_RECORD_SIZE;
+        const u0 = (records[r + 8] + records[r + 12] * records[r + 10]) / atlasSize;
+        const v0 = records[r + 9] / atlasSize;
+        const u1 = u0 + records[r + 10] / atlasSize;
+        const v1 = v0 + records[r + 11] / atlasSize;
+        for (let c = 0; c < 4; c++) {
+            let lx = SPRITE_CORNERS[c][0] * records[r + 6] / 2;
+            let ly = SPRITE_CORNERS[c][1] * records[r + 7] / 2;
+            if (records[r + 13] !== 0) {
+                const tmp = lx;
+                lx = -ly;
+                ly = tmp;
+            }
+            vertices[j + 0] = records[r + 0] + records[r + 2] * (records[r + 4] + lx);
+            vertices[j + 1] = records[r + 1] + records[r + 3] * (records[r + 5] + ly);
+            vertices[j + 2] = 0;
+            vertices[j + 3] = 1;
+            vertices[j + 4] = 1;
+            vertices[j + 5] = 1;
+            vertices[j + 6] = c < 2 ? u1 : u0;
+            vertices[j + 7] = c === 0 || c === 3 ? v1 : v0;
+            j += SPRITE_VERTEX_SIZE;
+        }
+    }
+    bindVAO(batch.vao);
+    bindVBO(batch.vbo);
+    gl.bufferSubData(gl.ARRAY_BUFFER, 0, vertices, 0, j);
+    gl.drawElements(gl.TRIANGLES, count * 6, gl.UNSIGNED_INT, 0);
+    profiler.drawCalls++;
 }
 
 /**
@@ -251,6 +593,12 @@ export function drawElements(offset, count) {
  * @param {WebGLProgram} program - The shader program.
  */
 export function useProgram(program) {
+    if (glState.program === program) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.program = program;
     context.gl.useProgram(program);
 }
 /**
@@ -275,7 +623,9 @@ export function getUniformLocation(program, name) {
  * @param {number} value - The new value to be set for the uniform variable.
  */
 export function uniform1f(location, value) {
-    context.gl.uniform1f(location, value);
+    if (uniformChanged(location, [value])) {
+        context.gl.uniform1f(location, value);
+    }
 }
 
 /**
@@ -286,7 +636,44 @@ export function uniform1f(location, value) {
  * @param {Float32List} value - The matrix data to be set.
  */
 export function uniformMatrix4fv(location, transpose, value) {
-    context.gl.uniformMatrix4fv(location, transpose, value);
+    if (uniformChanged(location, value)) {
+        context.gl.uniformMatrix4fv(location, transpose, value);
+    }
+}
+
+// the native build has SIMD mat4 kernels, the browser keeps gl-matrix's own
+export {
+    identity as mat4Identity,
+    multiply as mat4Multiply,
+    translate as mat4Translate,
+    scale as mat4Scale,
+    fromTranslation as mat4FromTranslation,
+    ortho as mat4Ortho,
+    lookAt as mat4LookAt,
+} from "./gl-matrix/mat4.js";
+
+/**
+ * Writes `count` model matrices translation(x, y, 0) * scaling(sx, sy, 1) back to back.
+ *
+ * @param {Float32Array} out - 16 floats per matrix.
+ * @param {Float32Array} positions - x, y per matrix.
+ * @param {Float32Array} scales - sx, sy per matrix.
+ * @param {number} count
+ */
+export function mat4FromTranslationScaleBatch(out, positions, scales, count) {
+    if (out.length < count * 16 || positions.length < count * 2 || scales.length < count * 2) {
+        throw new RangeError("Expected a Float32Array of at least " + count * 16 + " elements");
+    }
+    out.fill(0, 0, count * 16);
+    for (let i = 0; i < count; i++) {
+        const m = i * 16;
+        out[m] = scales[i * 2];
+        out[m + 5] = scales[i * 2 + 1];
+        out[m + 10] = 1;
+        out[m + 12] = positions[i * 2];
+        out[m + 13] = positions[i * 2 + 1];
+        out[m + 15] = 1;
+    }
 }
 
 
@@ -299,7 +686,9 @@ export function uniformMatrix4fv(location, transpose, value) {
  * @param {number} v2 - The new value to be set for the uniform variable.
  */
 export function uniform3f(location, v0, v1, v2) {
-    context.gl.uniform3f(location, v0, v1, v2);
+    if (uniformChanged(location, [v0, v1, v2])) {
+        context.gl.uniform3f(location, v0, v1, v2);
+    }
 }
 
 /**
@@ -312,7 +701,9 @@ export function uniform3f(location, v0, v1, v2) {
  * @param {number} v3 - The new value to be set for the uniform variable.
  */
 export function uniform4f(location, v0, v1, v2, v3) {
-    context.gl.uniform4f(location, v0, v1, v2, v3);
+    if (uniformChanged(location, [v0, v1, v2, v3])) {
+        context.gl.uniform4f(location, v0, v1, v2, v3);
+    }
 }
 
 /**
@@ -322,7 +713,9 @@ export function uniform4f(location, v0, v1, v2, v3) {
  * @param {number} value - The new value to be set for the uniform variable.
  */
 export function uniform1i(location, value) {
-    context.gl.uniform1i(location, value);
+    if (uniformChanged(location, [value])) {
+        context.gl.uniform1i(location, value);
+    }
 }
 
 /**
@@ -353,6 +746,9 @@ export function clearColor(r, g, b, a) {
  */
 export function shouldCloseWindow() {
     // Implementation of shouldCloseWindow
+    if (headless.enabled) {
+        return headless.frames > 0 && headless.frame >= headless.frames;
+    }
     return false;
 }
 
@@ -361,22 +757,69 @@ export function shouldCloseWindow() {
  */
 export function swapBuffers() {
     // Implementation of swapBuffers
+    if (headless.enabled) {
+        headless.frame++;
+    }
 }
 
 /**
  * Poll for and process events.
+ * @param {number} [timeout] - Seconds to wait for events natively, the browser never waits.
  */
-export function pollEvents() {
+export function pollEvents(timeout) {
     // Implementation of pollEvents
+    if (headless.enabled) {
+        playHeadlessInput();
+        return;
+    }
     keyset.clear();
 }
 
+/**
+ * Leave the garbage collection to collectGarbage.
+ * @param {boolean} manual
+ */
+export function setManualGC(manual) {
+}
+
+/**
+ * Collect the cycles of the recent objects, and of the whole heap when due.
+ * @param {number} budget - Seconds the whole heap collection may take.
+ * @returns {boolean} False if the whole heap is still due, the browser always collects on its own.
+ */
+export function collectGarbage(budget) {
+    return true;
+}
+
+/**
+ * Move GL to a render thread that interpolates between published frames.
+ * @returns {boolean} False, the browser draws on its own schedule.
+ */
+export function startRenderThread() {
+    return false;
+}
+
+function playHeadlessInput() {
+    const { events } = headless;
+    while (headless.nextEvent < events.length && events[headless.nextEvent][0] <= headless.frame) {
+        const [, key, down] = events[headless.nextEvent++];
+        if (down) {
+            keyset.add(key);
+        } else {
+            keyset.delete(key);
+        }
+    }
+}
+
 /**
  * Get the current time.
  * @returns {number} The current time in seconds.
  */
 export function getTime() {
     // Implementation of getTime
+    if (headless.enabled) {
+        return headless.frame * headless.timestep;
+    }
     return performance.now() / 1000; // Return the current time in seconds
 }
 /**
@@ -389,9 +832,36 @@ export function getKey(keyCode) {
 }
 /**
  * Initialize the library.
+ * @param {{headless?: boolean, timestep?: number, frames?: number, input?: Array<[number, number, number]>}} [options]
+ * headless renders to an offscreen canvas on a fixed clock, input is a [frame, key, down] track sorted by frame
  */
-export function initContext() {
+export function initContext(options) {
     // Implementation of init
+    if (options?.headless) {
+        const events = options.input ?? [];
+        for (let i = 1; i < events.length; i++) {
+            if (events[i][0] < events[i - 1][0]) {
+                throw new RangeError("Input events must be sorted by frame");
+            }
+        }
+        headless.enabled = true;
+        headless.timestep = options.timestep && options.timestep > 0 ? options.timestep : 1 / 60;
+        headless.frames = options.frames ?? 0;
+        headless.frame = 0;
+        headless.events = events;
+        headless.nextEvent = 0;
+        keyset.clear();
+        playHeadlessInput();
+        // the browser has no null GL, an offscreen canvas keeps the page untouched
+        const gl = new OffscreenCanvas(getScreenWidth(), getScreenHeight()).getContext("webgl2");
+        if (!gl) {
+            throw new Error("WebGL2 is not supported");
+        }
+        context.gl = /** @type {WebGL2RenderingContext} */ (/** @type {unknown} */ (gl));
+        gl.enable(gl.BLEND);
+        gl.blendFunc(gl.SRC_ALPHA, gl.ONE_MINUS_SRC_ALPHA);
+        return;
+    }
     document.addEventListener("keydown", (event) => {
         keyset.add(event.keyCode);
     });
@@ -551,6 +1021,9 @@ export function getScreenHeight() {
 }
 
 export function resize() {
+    if (headless.enabled) {
+        return;
+    }
     const gl = context.gl;
     const canvas = gl.canvas;
     if (canvas.width !== window.innerWidth || canvas.height !== window.innerHeight) {
@@ -577,6 +1050,80 @@ export async function loadImage(url) {
         img.src = url;
     });
 }
+/**
+ * @type {{ image: HTMLImageElement | null, texture: WebGLTexture | null }[]}
+ */
+const textureObjects = [];
+/**
+ * Loads an image into a texture object, upload it with uploadTexture once the context exists.
+ * @param {string} url 
+ * @returns {Promise<TextureObject>}
+ */
+export async function loadTexture(url) {
+    const { width, height, data } = await loadImage(url);
+    const id = textureObjects.length;
+    textureObjects.push({ image: data, texture: null });
+    return { id, width, height };
+}
+/**
+ * Uploads the texture object and binds it. The browser decodes images whole, so `rows`
+ * is accepted for parity with the native build and the first call uploads everything.
+ * @param {number} id 
+ * @param {number} [rows] 
+ * @returns {WebGLTexture}
+ */
+export function uploadTexture(id, rows) {
+    const gl = context.gl;
+    const object = textureObjects[id];
+    if (!object) {
+        throw new Error("Invalid texture object");
+    }
+    if (!object.texture) {
+        object.texture = createTexture();
+        bindTexture(object.texture);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.LINEAR);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.LINEAR);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.REPEAT);
+        gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.REPEAT);
+    } else {
+        bindTexture(object.texture);
+    }
+    if (object.image) {
+        gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, gl.RGBA, gl.UNSIGNED_BYTE, object.image);
+        gl.generateMipmap(gl.TEXTURE_2D);
+        object.image = null;
+    }
+    return object.texture;
+}
+/**
+ * 
+ * @param {number} id 
+ * @returns {boolean}
+ */
+export function isTextureComplete(id) {
+    const object = textureObjects[id];
+    return !!object && !!object.texture && !object.image;
+}
+/**
+ * 
+ * @param {number} id 
+ */
+export function releaseTexture(id) {
+    const object = textureObjects[id];
+    if (!object) {
+        throw new Error("Invalid texture object");
+    }
+    if (object.texture) {
+        for (let unit = 0; unit < glState.textures.length; unit++) {
+            if (glState.textures[unit] === object.texture) {
+                glState.textures[unit] = null;
+            }
+        }
+        context.gl.deleteTexture(object.texture);
+    }
+    object.image = null;
+    object.texture = null;
+}
 /**
  * 
  * @returns {WebGLTexture}
@@ -595,6 +1142,12 @@ export function createTexture() {
  */
 export function bindTexture(texture) {
     const gl = context.gl;
+    if (glState.textures[glState.activeUnit] === texture) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.textures[glState.activeUnit] = texture;
     gl.bindTexture(gl.TEXTURE_2D, texture);
 }
 
@@ -617,6 +1170,12 @@ export function updateTexture(image) {
  */
 export function activeTexture(unit) {
     const gl = context.gl;
+    if (glState.activeUnit === unit) {
+        glState.skipped++;
+        return;
+    }
+    glState.issued++;
+    glState.activeUnit = unit;
     gl.activeTexture(gl.TEXTURE0 + unit);
 }
 
@@ -633,7 +1192,7 @@ export function createFramebuffer(width, height) {
     if (!fbo) throw new Error("createFramebuffer failed");
     const texture = gl.createTexture();
     if (!texture) throw new Error("createTexture failed");
-    gl.bindTexture(gl.TEXTURE_2D, texture);
+    bindTexture(texture);
     gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, width, height, 0, gl.RGBA, gl.UNSIGNED_BYTE, null);
     gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
     gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
@@ -660,4 +1219,761 @@ export function endFramebuffer() {
     gl.pixelStorei(gl.UNPACK_FLIP_Y_WEBGL, 0);
     gl.viewport(0, 0, getScreenWidth(), getScreenHeight());
     gl.scissor(0, 0, getScreenWidth(), getScreenHeight());
-}
\ No newline at end of file
+}
+/**
+ * The web build has no file system to bake into, the atlas is always packed at startup.
+ * @param {string} path
+ * @param {string[]} sources
+ * @returns {{ atlasSize: number, atlasData: Record<string, Rectangle>, data: ArrayBuffer } | null}
+ */
+export function readAtlasCache(path, sources) {
+    return null;
+}
+/**
+ *
+ * @param {string} path
+ * @param {Framebuffer} framebuffer
+ * @param {Record<string, Rectangle>} atlasData
+ * @param {string[]} sources
+ * @returns {boolean}
+ */
+export function writeAtlasCache(path, framebuffer, atlasData, sources) {
+    return false;
+}
+/**
+ *
+ * @param {{ atlasSize: number, data: ArrayBuffer }} cache
+ * @returns {WebGLTexture}
+ */
+export function uploadAtlasCache(cache) {
+    const { gl } = context;
+    const texture = gl.createTexture();
+    if (!texture) throw new Error("createTexture failed");
+    bindTexture(texture);
+    gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, cache.atlasSize, cache.atlasSize, 0, gl.RGBA, gl.UNSIGNED_BYTE, new Uint8Array(cache.data));
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST);
+    gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.NEAREST);
+    return texture;
+}
+
+const PHYSICS_COLUMNS = 9;
+const PHYSICS_CONTACT_SIZE = 4;
+const PHYSICS_ACTIVE = 0x1;
+const PHYSICS_DYNAMIC = 0x2;
+const PHYSICS_PUSHES = 0xf0;
+const PHYSICS_TILE_SOLID = 1;
+const PHYSICS_TILE_ONE_WAY = 2;
+const PHYSICS_EDGE_EPSILON = 0.001;
+/**
+ * Same layout and algorithm as the native physics module in libs/context.c.
+ * @type {{
+ *   capacity: number,
+ *   maxContacts: number,
+ *   x: Float32Array, y: Float32Array, oldX: Float32Array, oldY: Float32Array,
+ *   speedX: Float32Array, speedY: Float32Array, halfX: Float32Array, halfY: Float32Array,
+ *   flags: Uint32Array,
+ *   contacts: Float32Array,
+ *   order: number[],
+ *   tiles: Uint8Array | null,
+ *   tilesWidth: number, tilesHeight: number, tileSize: number, originX: number, originY: number
+ * }[]}
+ */
+const physicsWorlds = [];
+/**
+ * 
+ * @param {number} capacity 
+ * @param {number} maxContacts 
+ * @returns {{ id: number, buffer: ArrayBuffer }}
+ */
+export function createPhysicsWorld(capacity, maxContacts) {
+    const buffer = new ArrayBuffer((capacity * PHYSICS_COLUMNS + maxContacts * PHYSICS_CONTACT_SIZE) * 4);
+    const column = (/** @type {number} */ index) => new Float32Array(buffer, index * capacity * 4, capacity);
+    physicsWorlds.push({
+        capacity,
+        maxContacts,
+        x: column(0), y: column(1), oldX: column(2), oldY: column(3),
+        speedX: column(4), speedY: column(5), halfX: column(6), halfY: column(7),
+        flags: new Uint32Array(buffer, 8 * capacity * 4, capacity),
+        contacts: new Float32Array(buffer, PHYSICS_COLUMNS * capacity * 4, maxContacts * PHYSICS_CONTACT_SIZE),
+        order: [],
+        tiles: null,
+        tilesWidth: 0, tilesHeight: 0, tileSize: 1, originX: 0, originY: 0,
+    });
+    return { id: physicsWorlds.length - 1, buffer };
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {Uint8Array} tiles 
+ * @param {number} width 
+ * @param {number} height 
+ * @param {number} tileSize 
+ * @param {number} originX 
+ * @param {number} originY 
+ */
+export function setPhysicsTiles(id, tiles, width, height, tileSize, originX, originY) {
+    const world = physicsWorlds[id];
+    world.tiles = tiles.slice(0, width * height);
+    world.tilesWidth = width;
+    world.tilesHeight = height;
+    world.tileSize = tileSize;
+    world.originX = originX;
+    world.originY = originY;
+}
+/**
+ * Moves one axis at a time and stops at the first blocking tile edge.
+ * @param {typeof physicsWorlds[number]} world
+ * @param {number} i
+ * @param {number} dt
+ * @param {number} gravity
+ * @param {number} maxFallingSpeed
+ */
+function integratePhysicsBody(world, i, dt, gravity, maxFallingSpeed) {
+    const { x, y, speedX, speedY, halfX, halfY, flags, tiles, tileSize, originX, originY } = world;
+    const tileAt = (/** @type {number} */ value, /** @type {number} */ origin) => Math.floor((value - origin) / tileSize + 0.5);
+    const tileClass = (/** @type {number} */ tx, /** @type {number} */ ty) =>
+        !tiles || tx < 0 || ty < 0 || tx >= world.tilesWidth || ty >= world.tilesHeight ? PHYSICS_TILE_SOLID : tiles[ty * world.tilesWidth + tx];
+    const hx = halfX[i];
+    const hy = halfY[i];
+    let bodyFlags = flags[i] & ~PHYSICS_PUSHES;
+    world.oldX[i] = x[i];
+    world.oldY[i] = y[i];
+    speedY[i] = Math.max(maxFallingSpeed, speedY[i] + gravity * dt);
+    let nx = x[i] + speedX[i] * dt;
+    if (tiles) {
+        const ty0 = tileAt(y[i] - hy, originY);
+        const ty1 = tileAt(y[i] + hy - PHYSICS_EDGE_EPSILON, originY);
+        const blocked = (/** @type {number} */ tx) => {
+            for (let ty = ty0; ty <= ty1; ty++) {
+                if (tileClass(tx, ty) === PHYSICS_TILE_SOLID) return true;
+            }
+            return false;
+        };
+        if (nx > x[i]) {
+            for (let tx = tileAt(x[i] + hx - PHYSICS_EDGE_EPSILON, originX) + 1; tx <= tileAt(nx + hx - PHYSICS_EDGE_EPSILON, originX); tx++) {
+                if (blocked(tx)) {
+                    nx = originX + (tx - 0.5) * tileSize - hx;
+                    speedX[i] = 0;
+                    bodyFlags |= 0x20;
+                    break;
+                }
+            }
+        } else if (nx < x[i]) {
+            for (let tx = tileAt(x[i] - hx, originX) - 1; tx >= tileAt(nx - hx, originX); tx--) {
+                if (blocked(tx)) {
+                    nx = originX + (tx + 0.5) * tileSize + hx;
+                    speedX[i] = 0;
+                    bodyFlags |= 0x10;
+                    break;
+                }
+            }
+        }
+    }
+    let ny = y[i] + speedY[i] * dt;
+    if (tiles) {
+        const tx0 = tileAt(nx - hx, originX);
+        const tx1 = tileAt(nx + hx - PHYSICS_EDGE_EPSILON, originX);
+        const blocked = (/** @type {number} */ ty, /** @type {boolean} */ falling) => {
+            for (let tx = tx0; tx <= tx1; tx++) {
+                const tile = tileClass(tx, ty);
+                if (tile === PHYSICS_TILE_SOLID || (falling && tile === PHYSICS_TILE_ONE_WAY)) return true;
+            }
+            return false;
+        };
+        if (ny > y[i]) {
+            for (let ty = tileAt(y[i] + hy - PHYSICS_EDGE_EPSILON, originY) + 1; ty <= tileAt(ny + hy - PHYSICS_EDGE_EPSILON, originY); ty++) {
+                if (blocked(ty, false)) {
+                    ny = originY + (ty - 0.5) * tileSize - hy;
+                    speedY[i] = 0;
+                    bodyFlags |= 0x80;
+                    break;
+                }
+            }
+        } else if (ny < y[i]) {
+            for (let ty = tileAt(y[i] - hy, originY) - 1; ty >= tileAt(ny - hy, originY); ty--) {
+                if (blocked(ty, true)) {
+                    ny = originY + (ty + 0.5) * tileSize + hy;
+                    speedY[i] = 0;
+                    bodyFlags |= 0x40;
+                    break;
+                }
+            }
+        }
+    }
+    x[i] = nx;
+    y[i] = ny;
+    flags[i] = bodyFlags;
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {number} count 
+ * @param {number} dt 
+ * @param {number} [gravity] 
+ * @param {number} [maxFallingSpeed] 
+ * @returns {number}
+ */
+export function stepPhysics(id, count, dt, gravity = 0, maxFallingSpeed = -Infinity) {
+    const world = physicsWorlds[id];
+    if (!world) {
+        throw new Error("Invalid physics world");
+    }
+    if (count > world.capacity) {
+        throw new Error(`physics body count ${count} exceeds capacity ${world.capacity}`);
+    }
+    const { x, y, halfX, halfY, flags } = world;
+    for (let i = 0; i < count; i++) {
+        if ((flags[i] & (PHYSICS_ACTIVE | PHYSICS_DYNAMIC)) === (PHYSICS_ACTIVE | PHYSICS_DYNAMIC)) {
+            integratePhysicsBody(world, i, dt, gravity, maxFallingSpeed);
+        }
+    }
+    const order = world.order.filter(body => body < count);
+    for (let i = world.order.length; i < count; i++) {
+        order.push(i);
+    }
+    order.sort((a, b) => (x[a] - halfX[a]) - (x[b] - halfX[b]));
+    world.order = order;
+    let contacts = 0;
+    for (let k = 0; k < order.length; k++) {
+        const a = order[k];
+        if (!(flags[a] & PHYSICS_ACTIVE) || halfX[a] === 0 || halfY[a] === 0) continue;
+        const maxX = x[a] + halfX[a];
+        for (let m = k + 1; m < order.length; m++) {
+            const b = order[m];
+            if (x[b] - halfX[b] > maxX) break;
+            if (!(flags[b] & PHYSICS_ACTIVE) || halfX[b] === 0 || halfY[b] === 0) continue;
+            const dx = x[a] - x[b];
+            const dy = y[a] - y[b];
+            const sumX = halfX[a] + halfX[b];
+            const sumY = halfY[a] + halfY[b];
+            if (Math.abs(dx) > sumX || Math.abs(dy) > sumY) continue;
+            if (contacts === world.maxContacts) return contacts;
+            const c = contacts++ * PHYSICS_CONTACT_SIZE;
+            world.contacts[c] = a;
+            world.contacts[c + 1] = b;
+            world.contacts[c + 2] = (dx >= 0 ? 1 : -1) * (sumX - Math.abs(dx));
+            world.contacts[c + 3] = (dy >= 0 ? 1 : -1) * (sumY - Math.abs(dy));
+        }
+    }
+    return contacts;
+}
+const ECS_HEADER_SIZE = 4;
+const ECS_NO_ROW = 0xFFFFFFFF;
+/**
+ * Same layout as the native ecs module in libs/context.c.
+ * @type {{
+ *   capacity: number,
+ *   columns: number,
+ *   header: Uint32Array,
+ *   masks: Uint32Array,
+ *   entities: Uint32Array,
+ *   rows: Uint32Array,
+ *   ranges: Uint32Array,
+ *   cells: Uint32Array,
+ *   buffer: ArrayBuffer,
+ *   freeIds: number[],
+ *   nextId: number
+ * }[]}
+ */
+const ecsWorlds = [];
+/**
+ * @param {number} id
+ */
+function getECSWorld(id) {
+    const world = ecsWorlds[id];
+    if (!world) {
+        throw new RangeError("Invalid ecs world");
+    }
+    return world;
+}
+/**
+ * 
+ * @param {number} capacity 
+ * @param {number} columns 
+ * @returns {{ id: number, buffer: ArrayBuffer }}
+ */
+export function createECSWorld(capacity, columns) {
+    const buffer = new ArrayBuffer((ECS_HEADER_SIZE + capacity * (5 + columns)) * 4);
+    const view = (/** @type {number} */ offset, /** @type {number} */ length) => new Uint32Array(buffer, offset * 4, length);
+    const masks = ECS_HEADER_SIZE;
+    const world = {
+        capacity,
+        columns,
+        header: view(0, ECS_HEADER_SIZE),
+        masks: view(masks, capacity),
+        entities: view(masks + capacity, capacity),
+        rows: view(masks + 2 * capacity, capacity).fill(ECS_NO_ROW),
+        ranges: view(masks + 3 * capacity, 2 * capacity),
+        cells: view(masks + 5 * capacity, columns * capacity),
+        buffer,
+        freeIds: [],
+        nextId: 0,
+    };
+    ecsWorlds.push(world);
+    return { id: ecsWorlds.length - 1, buffer };
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {number} mask 
+ * @returns {number} entity
+ */
+export function createEntity(id, mask) {
+    const world = getECSWorld(id);
+    const row = world.header[0];
+    if (row === world.capacity) {
+        throw new RangeError(`ecs world is full: ${world.capacity} entities`);
+    }
+    const entity = world.freeIds.length ? /** @type {number} */ (world.freeIds.pop()) : world.nextId++;
+    for (let c = 0; c < world.columns; c++) {
+        world.cells[c * world.capacity + row] = 0;
+    }
+    world.masks[row] = mask;
+    world.entities[row] = entity;
+    world.rows[entity] = row;
+    world.header[0] = row + 1;
+    return entity;
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {number} entity 
+ */
+export function destroyEntity(id, entity) {
+    const world = getECSWorld(id);
+    if (entity >= world.nextId || world.rows[entity] === ECS_NO_ROW) {
+        throw new RangeError(`Invalid entity ${entity}`);
+    }
+    const row = world.rows[entity];
+    const last = --world.header[0];
+    if (row !== last) {
+        for (let c = 0; c < world.columns; c++) {
+            world.cells[c * world.capacity + row] = world.cells[c * world.capacity + last];
+        }
+        world.masks[row] = world.masks[last];
+        world.entities[row] = world.entities[last];
+        world.rows[world.entities[row]] = row;
+    }
+    world.rows[entity] = ECS_NO_ROW;
+    world.freeIds.push(entity);
+}
+/**
+ * @param {typeof ecsWorlds[number]} world
+ * @param {number} mask
+ */
+function findEntityRanges(world, mask) {
+    const { masks, ranges } = world;
+    const count = world.header[0];
+    let found = 0;
+    let row = 0;
+    while (row < count) {
+        while (row < count && (masks[row] & mask) >>> 0 !== mask >>> 0) {
+            row++;
+        }
+        if (row === count) {
+            break;
+        }
+        ranges[found * 2] = row;
+        while (row < count && (masks[row] & mask) >>> 0 === mask >>> 0) {
+            row++;
+        }
+        ranges[found * 2 + 1] = row;
+        found++;
+    }
+    return found;
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {number} mask 
+ * @returns {number} ranges written
+ */
+export function queryEntities(id, mask) {
+    return findEntityRanges(getECSWorld(id), mask);
+}
+/**
+ * 
+ * @param {number} id 
+ * @param {number} physicsId 
+ * @param {number} mask 
+ * @param {number} firstColumn 
+ * @param {number} dt 
+ * @param {number} [gravity] 
+ * @param {number} [maxFallingSpeed] 
+ * @returns {number} ranges written
+ */
+export function stepEntityPhysics(id, physicsId, mask, firstColumn, dt, gravity = 0, maxFallingSpeed = -Infinity) {
+    const world = getECSWorld(id);
+    const physics = physicsWorlds[physicsId];
+    if (!physics) {
+        throw new RangeError("Invalid physics world");
+    }
+    if (firstColumn + PHYSICS_COLUMNS > world.columns) {
+        throw new RangeError(`body columns ${firstColumn}..${firstColumn + PHYSICS_COLUMNS} out of range`);
+    }
+    const { buffer, capacity } = world;
+    const column = (/** @type {number} */ index) => new Float32Array(buffer, world.cells.byteOffset + (firstColumn + index) * capacity * 4, capacity);
+    const view = {
+        ...physics,
+        x: column(0), y: column(1), oldX: column(2), oldY: column(3),
+        speedX: column(4), speedY: column(5), halfX: column(6), halfY: column(7),
+        flags: new Uint32Array(buffer, world.cells.byteOffset + (firstColumn + 8) * capacity * 4, capacity),
+    };
+    const ranges = findEntityRanges(world, mask);
+    for (let r = 0; r < ranges; r++) {
+        for (let row = world.ranges[r * 2]; row < world.ranges[r * 2 + 1]; row++) {
+            integratePhysicsBody(view, row, dt, gravity, maxFallingSpeed);
+        }
+    }
+    return ranges;
+}
+const FONT_MAX_STALLS = 100;
+/**
+ * Same tables and layout as the native text module in libs/context.c.
+ * @type {{
+ *   glyphs: Map<number, { codepoint: number, advance: number, left: number, bottom: number, right: number, top: number, u: number, v: number, uw: number, vh: number, space: boolean }>,
+ *   kerning: Map<string, number>
+ * }[]}
+ */
+const fonts = [];
+const fontSpace = /\s/;
+/**
+ * 
+ * @param {TextOptions["font"]} font parsed msdf-atlas-gen JSON
+ * @returns {number}
+ */
+export function createFont(font) {
+    const { width: texW, height: texH } = font.atlas;
+    const glyphs = new Map();
+    const kerning = new Map();
+    for (const variant of font.variants) {
+        for (const glyph of variant.glyphs) {
+            const plane = glyph.planeBounds ?? { left: 0, bottom: 0, right: 0, top: 0 };
+            const bounds = glyph.atlasBounds ?? { left: 0, bottom: 0, right: 0, top: 0 };
+            glyphs.set(glyph.unicode, {
+                codepoint: glyph.unicode,
+                advance: glyph.advance,
+                left: plane.left, bottom: plane.bottom, right: plane.right, top: plane.top,
+                u: bounds.left / texW,
+                uw: (bounds.right - bounds.left) / texW,
+                v: 1.0 - bounds.top / texH,
+                vh: (bounds.bottom - bounds.top) / texH,
+                space: fontSpace.test(String.fromCodePoint(glyph.unicode)),
+            });
+        }
+        for (const pair of variant.kerning) {
+            kerning.set(`${pair.first}_${pair.second}`, pair.amount);
+        }
+    }
+    fonts.push({ glyphs, kerning });
+    return fonts.length - 1;
+}
+/**
+ * 
+ * @param {number} fontId 
+ * @param {string} text 
+ * @param {number} size 
+ * @param {number} width 
+ * @param {"left" | "right" | "center"} align 
+ * @param {number} letterSpacing 
+ * @param {number} lineHeight 
+ * @param {number} wordSpacing 
+ * @param {boolean} wordBreak 
+ * @param {Buffers} buffers 
+ * @returns {{ lines: number, width: number }}
+ */
+export function layoutText(fontId, text, size, width, align, letterSpacing, lineHeight, wordSpacing, wordBreak, buffers) {
+    const font = fonts[fontId];
+    const chars = Array.from(text, (char) => /** @type {number} */ (char.codePointAt(0)));
+    const space = font.glyphs.get(32);
+    const scale = size;
+    /** @type {{ glyph: NonNullable<typeof space>, x: number }[]} */
+    const glyphs = [];
+    /** @type {{ first: number, width: number }[]} */
+    const lines = [];
+    let line = { first: 0, width: 0 };
+    lines.push(line);
+    let cursor = 0;
+    let wordCursor = 0;
+    let wordWidth = 0;
+    let stalls = 0;
+    const newLine = () => {
+        line = { first: glyphs.length, width: 0 };
+        lines.push(line);
+        wordCursor = cursor;
+        wordWidth = 0;
+    };
+    while (cursor < chars.length && stalls < FONT_MAX_STALLS) {
+        stalls++;
+        const c = chars[cursor];
+        if (c === 10) {
+            cursor++;
+            newLine();
+            continue;
+        }
+        const glyph = font.glyphs.get(c) ?? space;
+        if (!glyph) {
+            cursor++;
+            stalls = 0;
+            continue;
+        }
+        if (glyphs.length > line.first) {
+            const kern = (font.kerning.get(`${glyphs[glyphs.length - 1].glyph.codepoint}_${glyph.codepoint}`) ?? 0) * scale;
+            line.width += kern;
+            wordWidth += kern;
+        }
+        glyphs.push({ glyph, x: line.width });
+        let advance = 0;
+        if (fontSpace.test(String.fromCodePoint(c))) {
+            wordCursor = cursor;
+            wordWidth = 0;
+            advance += wordSpacing * size;
+        } else {
+            advance += letterSpacing * size;
+        }
+        advance += glyph.advance * scale;
+        line.width += advance;
+        wordWidth += advance;
+        if (line.width > width) {
+            if (wordBreak && glyphs.length - line.first > 1) {
+                line.width -= advance;
+                glyphs.pop();
+                newLine();
+                continue;
+            } else if (!wordBreak && wordWidth !== line.width) {
+                const wordGlyphs = Math.min(cursor - wordCursor + 1, glyphs.length - line.first);
+                glyphs.length -= wordGlyphs;
+                cursor = wordCursor;
+                line.width -= wordWidth;
+                newLine();
+                continue;
+            }
+        }
+        cursor++;
+        stalls = 0;
+    }
+    if (!line.width) {
+        lines.pop();
+    }
+    const { position, uv, index, id } = buffers;
+    const quads = Math.min(position.length / 12, uv.length / 8);
+    let j = 0;
+    let y = size;
+    let maxWidth = 0;
+    for (let l = 0; l < lines.length; l++) {
+        const end = l + 1 < lines.length ? lines[l + 1].first : glyphs.length;
+        const lineWidth = lines[l].width;
+        maxWidth = Math.max(maxWidth, lineWidth);
+        for (let i = lines[l].first; i < end && j < quads; i++) {
+            const { glyph } = glyphs[i];
+            if (glyph.space) {
+                continue;
+            }
+            let x = glyphs[i].x;
+            if (align === "center") {
+                x -= lineWidth * 0.5;
+            } else if (align === "right") {
+                x -= lineWidth;
+            }
+            x += glyph.left * scale;
+            const top = y - glyph.top * scale;
+            const w = (glyph.right - glyph.left) * scale;
+            const h = (glyph.bottom - glyph.top) * scale;
+            position.set([x, top - h, 0, x, top, 0, x + w, top - h, 0, x + w, top, 0], j * 12);
+            uv.set([glyph.u, glyph.v - glyph.vh, glyph.u, glyph.v, glyph.u + glyph.uw, glyph.v - glyph.vh, glyph.u + glyph.uw, glyph.v], j * 8);
+            j++;
+        }
+        y += size * lineHeight;
+    }
+    position.fill(0, j * 12);
+    uv.fill(0, j * 8);
+    for (let i = 0; i < index.length / 6; i++) {
+        index.set([i * 4, i * 4 + 2, i * 4 + 1, i * 4 + 1, i * 4 + 2, i * 4 + 3], i * 6);
+    }
+    for (let i = 0; i < id.length; i++) {
+        id[i] = Math.floor(i / 4);
+    }
+    return { lines: lines.length, width: maxWidth };
+}
+
+const PROFILE_FRAMES = 256;
+const PROFILE_MAX_ZONES = 16;
+const PROFILE_COUNTERS = 9;
+const PROFILE_FRAME_SIZE = PROFILE_COUNTERS + 3 * PROFILE_MAX_ZONES;
+const PROFILE_GPU_LATENCY = 4;
+const PROFILE_MAX_EVENTS = 65536;
+/**
+ * Same buffer layout as the native profiler in libs/context.c. GPU zones need
+ * EXT_disjoint_timer_query_webgl2, the browser does not expose JS to C calls, GC runs or allocation counts.
+ */
+const profiler = {
+    /** @type {string[]} */
+    names: [],
+    buffer: new Float64Array(1 + PROFILE_FRAMES * PROFILE_FRAME_SIZE),
+    frame: 0,
+    frameStart: 0,
+    drawCalls: 0,
+    /** @type {{ zone: number, begin: number }[]} */
+    stack: [],
+    /** @type {{ zone: number, gpu: boolean, begin: number, duration: number }[]} */
+    events: [],
+    /** @type {{ query: WebGLQuery, zone: number, event: { duration: number } }[][]} */
+    queries: Array.from({ length: PROFILE_GPU_LATENCY }, () => []),
+    /** @type {any} */
+    timerQuery: undefined,
+    gpuZone: -1,
+};
+/**
+ * @param {number} frame
+ */
+function getProfileFrame(frame) {
+    const start = 1 + (frame % PROFILE_FRAMES) * PROFILE_FRAME_SIZE;
+    return profiler.buffer.subarray(start, start + PROFILE_FRAME_SIZE);
+}
+/**
+ * @param {number} zone
+ * @param {boolean} gpu
+ * @param {number} begin
+ * @param {number} duration
+ */
+function addProfileEvent(zone, gpu, begin, duration) {
+    const event = { zone, gpu, begin, duration };
+    profiler.events.push(event);
+    if (profiler.events.length > PROFILE_MAX_EVENTS) {
+        profiler.events.shift();
+    }
+    return event;
+}
+/**
+ * @param {string} name
+ * @returns {number}
+ */
+export function createProfileZone(name) {
+    if (profiler.names.length === PROFILE_MAX_ZONES) {
+        throw new RangeError("too many profile zones");
+    }
+    profiler.names.push(name);
+    return profiler.names.length - 1;
+}
+/**
+ * @param {number} zone
+ */
+export function beginProfileZone(zone) {
+    profiler.stack.push({ zone, begin: performance.now() / 1000 });
+}
+export function endProfileZone() {
+    const open = profiler.stack.pop();
+    if (!open) {
+        throw new RangeError("no open profile zone");
+    }
+    const duration = performance.now() / 1000 - open.begin;
+    getProfileFrame(profiler.frame)[PROFILE_COUNTERS + open.zone] += duration * 1000;
+    addProfileEvent(open.zone, false, open.begin, duration);
+}
+/**
+ * @param {number} zone
+ */
+export function beginGPUZone(zone) {
+    const gl = context.gl;
+    if (profiler.timerQuery === undefined) {
+        profiler.timerQuery = gl.getExtension("EXT_disjoint_timer_query_webgl2");
+    }
+    const queries = profiler.queries[profiler.frame % PROFILE_GPU_LATENCY];
+    if (!profiler.timerQuery || profiler.gpuZone >= 0) {
+        return;
+    }
+    const query = gl.createQuery();
+    if (!query) {
+        return;
+    }
+    queries.push({ query, zone, event: addProfileEvent(zone, true, performance.now() / 1000, 0) });
+    gl.beginQuery(profiler.timerQuery.TIME_ELAPSED_EXT, query);
+    profiler.gpuZone = zone;
+}
+export function endGPUZone() {
+    if (profiler.gpuZone >= 0) {
+        context.gl.endQuery(profiler.timerQuery.TIME_ELAPSED_EXT);
+        profiler.gpuZone = -1;
+    }
+}
+/**
+ * @param {number} frame
+ */
+function collectGPUZones(frame) {
+    const gl = context.gl;
+    const queries = profiler.queries[frame % PROFILE_GPU_LATENCY];
+    const record = getProfileFrame(frame);
+    // a disjoint event makes every pending result meaningless
+    const disjoint = gl.getParameter(profiler.timerQuery.GPU_DISJOINT_EXT);
+    for (const { query, zone, event } of queries) {
+        if (!disjoint && gl.getQueryParameter(query, gl.QUERY_RESULT_AVAILABLE)) {
+            const elapsed = gl.getQueryParameter(query, gl.QUERY_RESULT);
+            record[PROFILE_COUNTERS + PROFILE_MAX_ZONES + zone] += elapsed / 1e6;
+            event.duration = elapsed / 1e9;
+        }
+        gl.deleteQuery(query);
+    }
+    queries.length = 0;
+}
+export function endProfileFrame() {
+    const now = performance.now() / 1000;
+    const record = getProfileFrame(profiler.frame);
+    record[0] = profiler.frame;
+    record[1] = profiler.frameStart;
+    record[2] = profiler.frame ? (now - profiler.frameStart) * 1000 : 0;
+    record[3] = profiler.drawCalls;
+    record[4] = 0;
+    // @ts-ignore non-standard, Chromium only
+    record[5] = performance.memory?.usedJSHeapSize ?? 0;
+    record[6] = 0;
+    record[7] = 0;
+    record[8] = 0;
+    if (profiler.timerQuery && profiler.frame + 1 >= PROFILE_GPU_LATENCY) {
+        collectGPUZones(profiler.frame + 1 - PROFILE_GPU_LATENCY);
+    }
+    profiler.frame++;
+    profiler.buffer[0] = profiler.frame;
+    profiler.frameStart = now;
+    profiler.drawCalls = 0;
+    getProfileFrame(profiler.frame).fill(0);
+}
+/**
+ * @returns {{ buffer: ArrayBuffer, frames: number, frameSize: number, zones: number, counters: number, gpuLatency: number }}
+ */
+export function getProfileBuffer() {
+    return {
+        buffer: profiler.buffer.buffer,
+        frames: PROFILE_FRAMES,
+        frameSize: PROFILE_FRAME_SIZE,
+        zones: PROFILE_MAX_ZONES,
+        counters: PROFILE_COUNTERS,
+        gpuLatency: PROFILE_GPU_LATENCY,
+    };
+}
+/**
+ * There is no file system in the browser, the trace is offered as a download instead.
+ * @param {string} path
+ * @returns {boolean}
+ */
+export function writeProfileTrace(path) {
+    /** @type {object[]} */
+    const traceEvents = [
+        { name: "thread_name", ph: "M", pid: 1, tid: 1, args: { name: "CPU" } },
+        { name: "thread_name", ph: "M", pid: 1, tid: 2, args: { name: "GPU" } },
+    ];
+    for (const event of profiler.events) {
+        traceEvents.push({ name: profiler.names[event.zone], ph: "X", pid: 1, tid: event.gpu ? 2 : 1, ts: event.begin * 1e6, dur: event.duration * 1e6 });
+    }
+    for (let frame = Math.max(0, profiler.frame - PROFILE_FRAMES); frame < profiler.frame; frame++) {
+        const record = getProfileFrame(frame);
+        traceEvents.push({ name: "frame", ph: "C", pid: 1, ts: record[1] * 1e6, args: { drawCalls: record[3], nativeCalls: record[4], heapSize: record[5], gcRuns: record[6], allocations: record[7], gcPause: record[8] } });
+    }
+    const link = document.createElement("a");
+    link.href = URL.createObjectURL(new Blob([JSON.stringify({ displayTimeUnit: "ms", traceEvents })], { type: "application/json" }));
+    link.download = path.split("/").pop() ?? path;
+    link.click();
+    URL.revokeObjectURL(link.href);
+    return true;
+}
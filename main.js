@@ -1,3 +1,3 @@
 import { mainQuickjs } from "./scripts/engine.js";
 
-mainQuickjs();
+mainQuickjs({ renderThread: scriptArgs.includes("--render-thread") });
@@ -82,6 +82,20 @@ static inline int list_empty(struct list_head *el)
     return el->next == el;
 }
 
+/* move all the elements of 'list' to the end of 'head' and leave
+   'list' empty */
+static inline void list_splice_tail_init(struct list_head *list,
+                                         struct list_head *head)
+{
+    if (!list_empty(list)) {
+        list->next->prev = head->prev;
+        head->prev->next = list->next;
+        list->prev->next = head;
+        head->prev = list->prev;
+        init_list_head(list);
+    }
+}
+
 #define list_for_each(el, head) \
   for(el = (head)->next; el != (head); el = el->next)
 
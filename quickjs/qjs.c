@@ -214,6 +214,7 @@ static void *js_trace_malloc(JSMallocState *s, size_t size)
     js_trace_malloc_printf(s, "A %zd -> %p\n", size, ptr);
     if (ptr) {
         s->malloc_count++;
+        s->malloc_total++;
         s->malloc_size += js_trace_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
     }
     return ptr;
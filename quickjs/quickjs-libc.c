@@ -721,6 +721,56 @@ static JSValue js_std_gc(JSContext *ctx, JSValueConst this_val,
     return JS_UNDEFINED;
 }
 
+static JSValue js_std_gcStep(JSContext *ctx, JSValueConst this_val,
+                             int argc, JSValueConst *argv)
+{
+    int64_t budget;
+
+    if (JS_ToInt64(ctx, &budget, argv[0]))
+        return JS_EXCEPTION;
+    return JS_NewBool(ctx, JS_RunGCStep(JS_GetRuntime(ctx), budget));
+}
+
+static JSValue js_std_setGCMode(JSContext *ctx, JSValueConst this_val,
+                                int argc, JSValueConst *argv)
+{
+    int mode;
+
+    if (JS_ToInt32(ctx, &mode, argv[0]))
+        return JS_EXCEPTION;
+    if (mode != JS_GC_MODE_AUTO && mode != JS_GC_MODE_MANUAL)
+        return JS_ThrowRangeError(ctx, "invalid GC mode");
+    JS_SetGCMode(JS_GetRuntime(ctx), mode);
+    return JS_UNDEFINED;
+}
+
+static JSValue js_std_getGCStats(JSContext *ctx, JSValueConst this_val,
+                                 int argc, JSValueConst *argv)
+{
+    JSGCStats s;
+    JSValue obj;
+
+    JS_GetGCStats(JS_GetRuntime(ctx), &s);
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        return obj;
+    JS_DefinePropertyValueStr(ctx, obj, "youngCount",
+                              JS_NewInt64(ctx, s.young_count), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "fullCount",
+                              JS_NewInt64(ctx, s.full_count), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "lastPause",
+                              JS_NewInt64(ctx, s.last_pause_us), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "maxPause",
+                              JS_NewInt64(ctx, s.max_pause_us), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "totalPause",
+                              JS_NewInt64(ctx, s.total_pause_us), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "lastScanned",
+                              JS_NewInt64(ctx, s.last_scanned), JS_PROP_C_W_E);
+    JS_DefinePropertyValueStr(ctx, obj, "lastFreed",
+                              JS_NewInt64(ctx, s.last_freed), JS_PROP_C_W_E);
+    return obj;
+}
+
 static int interrupt_handler(JSRuntime *rt, void *opaque)
 {
     return (os_pending_signals >> SIGINT) & 1;
@@ -1489,6 +1539,9 @@ static const JSCFunctionListEntry js_std_error_props[] = {
 static const JSCFunctionListEntry js_std_funcs[] = {
     JS_CFUNC_DEF("exit", 1, js_std_exit ),
     JS_CFUNC_DEF("gc", 0, js_std_gc ),
+    JS_CFUNC_DEF("gcStep", 1, js_std_gcStep ),
+    JS_CFUNC_DEF("setGCMode", 1, js_std_setGCMode ),
+    JS_CFUNC_DEF("getGCStats", 0, js_std_getGCStats ),
     JS_CFUNC_DEF("evalScript", 1, js_evalScript ),
     JS_CFUNC_DEF("loadScript", 1, js_loadScript ),
     JS_CFUNC_DEF("getenv", 1, js_std_getenv ),
@@ -1511,6 +1564,8 @@ static const JSCFunctionListEntry js_std_funcs[] = {
     JS_PROP_INT32_DEF("SEEK_SET", SEEK_SET, JS_PROP_CONFIGURABLE ),
     JS_PROP_INT32_DEF("SEEK_CUR", SEEK_CUR, JS_PROP_CONFIGURABLE ),
     JS_PROP_INT32_DEF("SEEK_END", SEEK_END, JS_PROP_CONFIGURABLE ),
+    JS_PROP_INT32_DEF("GC_MODE_AUTO", JS_GC_MODE_AUTO, JS_PROP_CONFIGURABLE ),
+    JS_PROP_INT32_DEF("GC_MODE_MANUAL", JS_GC_MODE_MANUAL, JS_PROP_CONFIGURABLE ),
     JS_OBJECT_DEF("Error", js_std_error_props, countof(js_std_error_props), JS_PROP_CONFIGURABLE),
 };
     
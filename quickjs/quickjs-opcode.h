@@ -367,6 +367,13 @@ DEF(typeof_is_undefined, 1, 1, 1, none)
 DEF( typeof_is_function, 1, 1, 1, none)
 #endif
 
+/* get_field, get_field2 and put_field with an inline cache: the u16
+   is the index of the cache slot in JSFunctionBytecode.ic. Emitted in
+   phase 3, must be in the same order as the uncached opcodes. */
+DEF(   get_field_ic, 7, 1, 1, atom_u16)
+DEF(  get_field2_ic, 7, 1, 2, atom_u16)
+DEF(   put_field_ic, 7, 2, 0, atom_u16)
+
 #undef DEF
 #undef def
 #endif  /* DEF */
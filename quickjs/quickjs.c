@@ -76,6 +76,20 @@
 #define CONFIG_STACK_CHECK
 #endif
 
+#if defined(__SANITIZE_ADDRESS__)
+#define JS_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define JS_ASAN
+#endif
+#endif
+
+/* allocate the small blocks from per-runtime slabs. Disabled with the
+   address sanitizer, which cannot see the errors inside a slab. */
+#if !defined(JS_ASAN)
+#define CONFIG_SLAB
+#endif
+
 
 /* dump object free */
 //#define DUMP_FREE
@@ -213,6 +227,34 @@ typedef enum {
     JS_GC_PHASE_REMOVE_CYCLES,
 } JSGCPhaseEnum;
 
+#define JS_SLAB_PAGE_BITS 12
+#define JS_SLAB_PAGE_SIZE (1 << JS_SLAB_PAGE_BITS)
+#define JS_SLAB_ARENA_PAGES 16
+#define JS_SLAB_MAX_SIZE 256
+#define JS_SLAB_ALIGN 16
+#define JS_SLAB_CLASS_COUNT (JS_SLAB_MAX_SIZE / JS_SLAB_ALIGN)
+
+typedef struct JSSlabClass {
+    void *free_list; /* freed blocks, linked through their first word */
+    uint8_t *ptr, *end; /* never allocated part of the current page */
+} JSSlabClass;
+
+/* Blocks of at most JS_SLAB_MAX_SIZE bytes are carved from pages that
+   only hold blocks of one size class, so the blocks have no header.
+   JSMallocState counts the blocks, not the arenas holding the pages.
+   The arenas are kept until JS_FreeRuntime(): a page stays assigned to
+   its class and its freed blocks are reused, so the slab memory is
+   bounded by the peak of the small block usage. */
+typedef struct JSSlab {
+    JSSlabClass classes[JS_SLAB_CLASS_COUNT];
+    uint8_t *page_ptr, *page_end; /* unused pages of the last arena */
+    void *arena_list; /* arenas, linked through their first word */
+    /* page address | (class index + 1) of every page, 0 if free slot */
+    uintptr_t *page_hash;
+    int page_hash_bits;
+    uint32_t page_count;
+} JSSlab;
+
 typedef enum OPCodeEnum OPCodeEnum;
 
 /* function pointers are used for numeric operations so that it is
@@ -236,6 +278,7 @@ typedef struct {
 struct JSRuntime {
     JSMallocFunctions mf;
     JSMallocState malloc_state;
+    JSSlab slab;
     const char *rt_info;
 
     int atom_hash_size; /* power of two */
@@ -253,11 +296,29 @@ struct JSRuntime {
     /* list of JSGCObjectHeader.link. List of allocated GC objects (used
        by the garbage collector) */
     struct list_head gc_obj_list;
+    /* list of JSGCObjectHeader.link. GC objects allocated or mutated
+       since the last collection. A young collection only looks for
+       cycles among them. */
+    struct list_head gc_young_obj_list;
     /* list of JSGCObjectHeader.link. Used during JS_FreeValueRT() */
     struct list_head gc_zero_ref_count_list; 
     struct list_head tmp_obj_list; /* used during GC */
     JSGCPhaseEnum gc_phase : 8;
+    JSGCModeEnum gc_mode : 8;
     size_t malloc_gc_threshold;
+    /* a full collection is done instead of a young one above it */
+    size_t malloc_gc_full_threshold;
+    /* allocation between two collections of the young objects. It
+       bounds their pause independently of the heap size. */
+    size_t malloc_gc_young_threshold;
+    int64_t gc_count; /* number of collections */
+    JSGCStats gc_stats;
+    /* pause and heap size of the last full collection, used to guess
+       the cost of the next one */
+    int64_t gc_full_pause_us;
+    size_t gc_full_malloc_size;
+    /* JS_RunGCStep() calls since the full collection became due */
+    int gc_step_deferred;
 #ifdef DUMP_LEAKS
     struct list_head string_list; /* list of JSString.link */
 #endif
@@ -295,6 +356,7 @@ struct JSRuntime {
     int shape_hash_size;
     int shape_hash_count; /* number of hashed shapes */
     JSShape **shape_hash;
+    uint64_t shape_id_counter; /* last JSShape.id given out */
     bf_context_t bf_ctx;
     JSNumericOperations bigint_ops;
 #ifdef CONFIG_BIGNUM
@@ -350,7 +412,8 @@ typedef enum {
 struct JSGCObjectHeader {
     int ref_count; /* must come first, 32-bit */
     JSGCObjectTypeEnum gc_obj_type : 4;
-    uint8_t mark : 4; /* used by the GC */
+    uint8_t mark : 3; /* used by the GC */
+    uint8_t young : 1; /* in rt->gc_young_obj_list */
     uint8_t dummy1; /* not used by the GC */
     uint16_t dummy2; /* not used by the GC */
     struct list_head link;
@@ -502,6 +565,37 @@ struct JSString {
     } u;
 };
 
+/* JS_TAG_STRING_ROPE: the concatenation of 'left' and 'right', each a
+   JS_TAG_STRING or JS_TAG_STRING_ROPE value. Ropes are only created by
+   string concatenation and are flattened on first character access.
+   The tag is private to this file: ropes are flattened before a value
+   reaches a native function, a class hook or the caller of an API
+   function, so that code outside only sees JS_TAG_STRING. */
+#define JS_TAG_STRING_ROPE (-6)
+
+typedef struct JSStringRope {
+    JSRefCountHeader header; /* must come first, 32-bit */
+    uint32_t len : 31;
+    uint8_t is_wide_char : 1; /* 1 if a leaf has 16 bit characters */
+    /* once flattened, 'left' is the flat string and 'right' is undefined */
+    JSValue left;
+    JSValue right;
+} JSStringRope;
+
+static inline BOOL tag_is_string(uint32_t tag)
+{
+    return tag == JS_TAG_STRING || tag == JS_TAG_STRING_ROPE;
+}
+
+/* 'v' must be a string or a rope */
+static inline uint32_t js_string_value_len(JSValueConst v)
+{
+    if (JS_VALUE_GET_TAG(v) == JS_TAG_STRING_ROPE)
+        return ((JSStringRope *)JS_VALUE_GET_PTR(v))->len;
+    else
+        return JS_VALUE_GET_STRING(v)->len;
+}
+
 typedef struct JSClosureVar {
     uint8_t is_local : 1;
     uint8_t is_arg : 1;
@@ -581,6 +675,22 @@ typedef enum JSFunctionKindEnum {
     JS_FUNC_ASYNC_GENERATOR = (JS_FUNC_GENERATOR | JS_FUNC_ASYNC),
 } JSFunctionKindEnum;
 
+/* Inline cache of one get_field, get_field2 or put_field site. The
+   property is at 'prop_index' in the shape of the object found by
+   following 'depth' prototypes from the receiver. The entry is valid
+   while the receiver and the prototypes walked have the recorded
+   shapes. */
+#define JS_IC_MAX_DEPTH 2
+#define JS_IC_MAX_COUNT 65536 /* cache slots per function */
+
+typedef struct JSInlineCache {
+    uint64_t shape_id; /* receiver shape, 0 if the slot is empty */
+    uint64_t proto_shape_id[JS_IC_MAX_DEPTH];
+    uint32_t prop_index;
+    uint8_t depth;
+    uint8_t is_getter; /* the property is an accessor with a getter */
+} JSInlineCache;
+
 typedef struct JSFunctionBytecode {
     JSGCObjectHeader header; /* must come first */
     uint8_t js_mode;
@@ -612,6 +722,8 @@ typedef struct JSFunctionBytecode {
     JSValue *cpool; /* constant pool (self pointer) */
     int cpool_count;
     int closure_var_count;
+    JSInlineCache *ic; /* indexed by the u16 of the *_ic opcodes */
+    int ic_count;
     struct {
         /* debug info, move to separate structure to save memory? */
         JSAtom filename;
@@ -879,6 +991,10 @@ struct JSShape {
     int deleted_prop_count;
     JSShape *shape_hash_next; /* in JSRuntime.shape_hash[h] list */
     JSObject *proto;
+    /* unique for the life of the runtime, renewed each time the
+       properties or the prototype change. The inline caches are keyed
+       on it instead of the shape address, which can be reused. */
+    uint64_t id;
     JSShapeProperty prop[0]; /* prop_size elements */
 };
 
@@ -1032,6 +1148,8 @@ static JSValue JS_CallConstructorInternal(JSContext *ctx,
                                           JSValueConst func_obj,
                                           JSValueConst new_target,
                                           int argc, JSValue *argv, int flags);
+static JSValue __JS_Call(JSContext *ctx, JSValueConst func_obj,
+                         JSValueConst this_obj, int argc, JSValueConst *argv);
 static JSValue JS_CallFree(JSContext *ctx, JSValue func_obj, JSValueConst this_obj,
                            int argc, JSValueConst *argv);
 static JSValue JS_InvokeFree(JSContext *ctx, JSValue this_val, JSAtom atom,
@@ -1118,6 +1236,8 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
 static JSValue js_regexp_constructor_internal(JSContext *ctx, JSValueConst ctor,
                                               JSValue pattern, JSValue bc);
 static void gc_decref(JSRuntime *rt);
+static void gc_run_young(JSRuntime *rt);
+static void gc_promote_young(JSRuntime *rt);
 static int JS_NewClass1(JSRuntime *rt, JSClassID class_id,
                         const JSClassDef *class_def, JSAtom name);
 
@@ -1233,6 +1353,8 @@ static JSValue js_promise_then(JSContext *ctx, JSValueConst this_val,
 static int js_string_compare(JSContext *ctx,
                              const JSString *p1, const JSString *p2);
 static JSValue JS_ToNumber(JSContext *ctx, JSValueConst val);
+static JSValue JS_GetPropertyValue(JSContext *ctx, JSValueConst this_obj,
+                                   JSValue prop);
 static int JS_SetPropertyValue(JSContext *ctx, JSValueConst this_obj,
                                JSValue prop, JSValue val, int flags);
 static int JS_NumberIsInteger(JSContext *ctx, JSValueConst val);
@@ -1283,9 +1405,24 @@ static const JSClassExoticMethods js_proxy_exotic_methods;
 static const JSClassExoticMethods js_module_ns_exotic_methods;
 static JSClassID js_class_id_alloc = JS_CLASS_INIT_COUNT;
 
+/* the next automatic collection is a young one after
+   malloc_gc_young_threshold more bytes, or the full one if the young
+   collections are disabled */
+static void gc_update_threshold(JSRuntime *rt)
+{
+    if (rt->malloc_gc_young_threshold == 0) {
+        rt->malloc_gc_threshold = rt->malloc_gc_full_threshold;
+    } else {
+        rt->malloc_gc_threshold = rt->malloc_state.malloc_size +
+            rt->malloc_gc_young_threshold;
+    }
+}
+
 static void js_trigger_gc(JSRuntime *rt, size_t size)
 {
     BOOL force_gc;
+    if (rt->gc_mode == JS_GC_MODE_MANUAL)
+        return;
 #ifdef FORCE_GC_AT_MALLOC
     force_gc = TRUE;
 #else
@@ -1297,9 +1434,17 @@ static void js_trigger_gc(JSRuntime *rt, size_t size)
         printf("GC: size=%" PRIu64 "\n",
                (uint64_t)rt->malloc_state.malloc_size);
 #endif
-        JS_RunGC(rt);
-        rt->malloc_gc_threshold = rt->malloc_state.malloc_size +
-            (rt->malloc_state.malloc_size >> 1);
+        /* most collections only look at the objects allocated or
+           mutated since the previous one. The whole heap is only
+           scanned once it has grown by half. */
+        if ((rt->malloc_state.malloc_size + size) >
+            rt->malloc_gc_full_threshold ||
+            rt->malloc_gc_young_threshold == 0) {
+            JS_RunGC(rt);
+        } else {
+            gc_run_young(rt);
+        }
+        gc_update_threshold(rt);
     }
 }
 
@@ -1308,23 +1453,249 @@ static size_t js_malloc_usable_size_unknown(const void *ptr)
     return 0;
 }
 
+/* Slab allocator. There is one class per multiple of JS_SLAB_ALIGN
+   bytes, so the blocks keep the alignment of malloc(). */
+
+static inline int js_slab_size_class(size_t size)
+{
+    return (size - 1) / JS_SLAB_ALIGN;
+}
+
+static inline int js_slab_class_size(int class_index)
+{
+    return (class_index + 1) * JS_SLAB_ALIGN;
+}
+
+static inline uint32_t js_slab_hash(uintptr_t page, int bits)
+{
+    return ((uint64_t)(page >> JS_SLAB_PAGE_BITS) * 0x9E3779B97F4A7C15) >>
+        (64 - bits);
+}
+
+/* return the class index of the slab block 'ptr' or -1 if it was
+   not allocated by the slab */
+static inline int js_slab_find(JSSlab *sl, const void *ptr)
+{
+    uintptr_t page, e;
+    uint32_t h, mask;
+
+    if (sl->page_count == 0)
+        return -1;
+    page = (uintptr_t)ptr & ~(uintptr_t)(JS_SLAB_PAGE_SIZE - 1);
+    mask = ((uint32_t)1 << sl->page_hash_bits) - 1;
+    h = js_slab_hash(page, sl->page_hash_bits);
+    for(;;) {
+        e = sl->page_hash[h];
+        if (e == 0)
+            return -1;
+        if ((e & ~(uintptr_t)(JS_SLAB_PAGE_SIZE - 1)) == page)
+            return (int)(e & (JS_SLAB_PAGE_SIZE - 1)) - 1;
+        h = (h + 1) & mask;
+    }
+}
+
+static void js_slab_hash_insert(uintptr_t *tab, int bits, uintptr_t e)
+{
+    uint32_t h, mask;
+
+    mask = ((uint32_t)1 << bits) - 1;
+    h = js_slab_hash(e, bits);
+    while (tab[h] != 0)
+        h = (h + 1) & mask;
+    tab[h] = e;
+}
+
+static int js_slab_add_page(JSRuntime *rt, uint8_t *page, int class_index)
+{
+    JSSlab *sl = &rt->slab;
+    uintptr_t *new_tab;
+    int new_bits;
+    uint32_t i;
+
+    /* keep the load factor below 1/2 */
+    if (2 * (sl->page_count + 1) > ((uint32_t)1 << sl->page_hash_bits)) {
+        new_bits = max_int(sl->page_hash_bits + 1, 8);
+        new_tab = rt->mf.js_malloc(&rt->malloc_state,
+                                   sizeof(new_tab[0]) << new_bits);
+        if (!new_tab)
+            return -1;
+        memset(new_tab, 0, sizeof(new_tab[0]) << new_bits);
+        if (sl->page_hash) {
+            for(i = 0; i < ((uint32_t)1 << sl->page_hash_bits); i++) {
+                if (sl->page_hash[i] != 0)
+                    js_slab_hash_insert(new_tab, new_bits, sl->page_hash[i]);
+            }
+            rt->mf.js_free(&rt->malloc_state, sl->page_hash);
+        }
+        sl->page_hash = new_tab;
+        sl->page_hash_bits = new_bits;
+    }
+    js_slab_hash_insert(sl->page_hash, sl->page_hash_bits,
+                        (uintptr_t)page | (class_index + 1));
+    sl->page_count++;
+    return 0;
+}
+
+/* the arenas are allocated and freed without changing JSMallocState,
+   which counts the blocks */
+static void *js_slab_arena_malloc(JSRuntime *rt, size_t size)
+{
+    JSMallocState *s = &rt->malloc_state;
+    JSMallocState s1 = *s;
+    void *ptr;
+
+    ptr = rt->mf.js_malloc(s, size);
+    *s = s1;
+    return ptr;
+}
+
+static void js_slab_arena_free(JSRuntime *rt, void *ptr)
+{
+    JSMallocState *s = &rt->malloc_state;
+    JSMallocState s1 = *s;
+
+    rt->mf.js_free(s, ptr);
+    *s = s1;
+}
+
+static no_inline void *js_slab_malloc_slow(JSRuntime *rt, int class_index)
+{
+    JSSlab *sl = &rt->slab;
+    JSSlabClass *sc = &sl->classes[class_index];
+    int size = js_slab_class_size(class_index);
+    uint8_t *page;
+    void **arena;
+
+    if (sl->page_ptr == sl->page_end) {
+        /* the slack aligns the pages and holds the arena link */
+        arena = js_slab_arena_malloc(rt, sizeof(void *) +
+                                     (JS_SLAB_ARENA_PAGES + 1) * JS_SLAB_PAGE_SIZE);
+        if (!arena)
+            return NULL;
+        *arena = sl->arena_list;
+        sl->arena_list = arena;
+        sl->page_ptr = (uint8_t *)(((uintptr_t)(arena + 1) +
+                                    JS_SLAB_PAGE_SIZE - 1) &
+                                   ~(uintptr_t)(JS_SLAB_PAGE_SIZE - 1));
+        sl->page_end = sl->page_ptr + JS_SLAB_ARENA_PAGES * JS_SLAB_PAGE_SIZE;
+    }
+    page = sl->page_ptr;
+    if (js_slab_add_page(rt, page, class_index))
+        return NULL;
+    sl->page_ptr += JS_SLAB_PAGE_SIZE;
+    sc->ptr = page + size;
+    sc->end = page + (JS_SLAB_PAGE_SIZE / size) * size;
+    return page;
+}
+
+static inline void *js_slab_malloc(JSRuntime *rt, size_t size)
+{
+    JSSlab *sl = &rt->slab;
+    JSMallocState *s = &rt->malloc_state;
+    int class_index = js_slab_size_class(size);
+    JSSlabClass *sc = &sl->classes[class_index];
+    void *ptr;
+
+    if (unlikely(s->malloc_size + js_slab_class_size(class_index) >
+                 s->malloc_limit))
+        return NULL;
+    ptr = sc->free_list;
+    if (ptr) {
+        sc->free_list = *(void **)ptr;
+    } else if (sc->ptr != sc->end) {
+        ptr = sc->ptr;
+        sc->ptr += js_slab_class_size(class_index);
+    } else {
+        ptr = js_slab_malloc_slow(rt, class_index);
+        if (!ptr)
+            return NULL;
+    }
+    s->malloc_count++;
+    s->malloc_total++;
+    s->malloc_size += js_slab_class_size(class_index);
+    return ptr;
+}
+
+static inline void js_slab_free(JSRuntime *rt, void *ptr, int class_index)
+{
+    JSSlabClass *sc = &rt->slab.classes[class_index];
+
+    *(void **)ptr = sc->free_list;
+    sc->free_list = ptr;
+    rt->malloc_state.malloc_count--;
+    rt->malloc_state.malloc_size -= js_slab_class_size(class_index);
+}
+
+/* give all the arenas back to the system allocator */
+static void js_slab_release(JSRuntime *rt)
+{
+    JSSlab *sl = &rt->slab;
+    void *arena, *next;
+
+    for(arena = sl->arena_list; arena != NULL; arena = next) {
+        next = *(void **)arena;
+        js_slab_arena_free(rt, arena);
+    }
+    rt->mf.js_free(&rt->malloc_state, sl->page_hash);
+    memset(sl, 0, sizeof(*sl));
+}
+
 void *js_malloc_rt(JSRuntime *rt, size_t size)
 {
+#ifdef CONFIG_SLAB
+    if (size - 1 < JS_SLAB_MAX_SIZE)
+        return js_slab_malloc(rt, size);
+#endif
     return rt->mf.js_malloc(&rt->malloc_state, size);
 }
 
 void js_free_rt(JSRuntime *rt, void *ptr)
 {
+    int class_index;
+
+    class_index = js_slab_find(&rt->slab, ptr);
+    if (class_index >= 0) {
+        js_slab_free(rt, ptr, class_index);
+        return;
+    }
     rt->mf.js_free(&rt->malloc_state, ptr);
 }
 
 void *js_realloc_rt(JSRuntime *rt, void *ptr, size_t size)
 {
-    return rt->mf.js_realloc(&rt->malloc_state, ptr, size);
+    int class_index;
+    size_t old_size;
+    void *new_ptr;
+
+    class_index = js_slab_find(&rt->slab, ptr);
+    if (class_index < 0) {
+        if (!ptr && size != 0)
+            return js_malloc_rt(rt, size);
+        return rt->mf.js_realloc(&rt->malloc_state, ptr, size);
+    }
+    if (size == 0) {
+        js_slab_free(rt, ptr, class_index);
+        return NULL;
+    }
+    old_size = js_slab_class_size(class_index);
+    /* a shrinking block stays in place */
+    if (size <= old_size)
+        return ptr;
+    new_ptr = js_malloc_rt(rt, size);
+    if (!new_ptr)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    js_slab_free(rt, ptr, class_index);
+    return new_ptr;
 }
 
 size_t js_malloc_usable_size_rt(JSRuntime *rt, const void *ptr)
 {
+    int class_index;
+
+    class_index = js_slab_find(&rt->slab, ptr);
+    if (class_index >= 0)
+        return js_slab_class_size(class_index);
     return rt->mf.js_malloc_usable_size(ptr);
 }
 
@@ -1635,6 +2006,8 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque)
     }
     rt->malloc_state = ms;
     rt->malloc_gc_threshold = 256 * 1024;
+    rt->malloc_gc_full_threshold = 256 * 1024;
+    rt->malloc_gc_young_threshold = 256 * 1024;
 
     bf_context_init(&rt->bf_ctx, js_bf_realloc, rt);
     set_dummy_numeric_ops(&rt->bigint_ops);
@@ -1645,8 +2018,10 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque)
 
     init_list_head(&rt->context_list);
     init_list_head(&rt->gc_obj_list);
+    init_list_head(&rt->gc_young_obj_list);
     init_list_head(&rt->gc_zero_ref_count_list);
     rt->gc_phase = JS_GC_PHASE_NONE;
+    rt->gc_mode = JS_GC_MODE_AUTO;
     
 #ifdef DUMP_LEAKS
     init_list_head(&rt->string_list);
@@ -1724,6 +2099,7 @@ static void *js_def_malloc(JSMallocState *s, size_t size)
         return NULL;
 
     s->malloc_count++;
+    s->malloc_total++;
     s->malloc_size += js_def_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
     return ptr;
 }
@@ -1788,6 +2164,12 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold)
     rt->malloc_gc_threshold = gc_threshold;
 }
 
+/* use 0 to only do full collections */
+void JS_SetGCYoungThreshold(JSRuntime *rt, size_t gc_young_threshold)
+{
+    rt->malloc_gc_young_threshold = gc_young_threshold;
+}
+
 #define malloc(s) malloc_is_forbidden(s)
 #define free(p) free_is_forbidden(p)
 #define realloc(p,s) realloc_is_forbidden(p,s)
@@ -1989,6 +2371,7 @@ void JS_FreeRuntime(JSRuntime *rt)
     }
 #endif
     assert(list_empty(&rt->gc_obj_list));
+    assert(list_empty(&rt->gc_young_obj_list));
 
     /* free the classes */
     for(i = 0; i < rt->class_count; i++) {
@@ -2100,6 +2483,9 @@ void JS_FreeRuntime(JSRuntime *rt)
         if (rt->rt_info)
             printf("\n");
     }
+#endif
+    js_slab_release(rt);
+#ifdef DUMP_LEAKS
     {
         JSMallocState *s = &rt->malloc_state;
         if (s->malloc_count > 1) {
@@ -2293,6 +2679,7 @@ void JS_FreeContext(JSContext *ctx)
         JSGCObjectHeader *p;
         printf("JSObjects: {\n");
         JS_DumpObjectHeader(ctx->rt);
+        gc_promote_young(rt);
         list_for_each(el, &rt->gc_obj_list) {
             p = list_entry(el, JSGCObjectHeader, link);
             JS_DumpGCObject(rt, p);
@@ -4190,34 +4577,269 @@ static JSValue JS_ConcatString1(JSContext *ctx,
     return JS_MKPTR(JS_TAG_STRING, p);
 }
 
+/* Rope strings */
+
+/* concatenations shorter than this are copied. Short right leaves of a
+   rope are also merged up to this length, so that appending one
+   character at a time does not allocate one node per character. */
+#define JS_STRING_ROPE_MIN_LEN 256
+
+static inline BOOL js_string_value_is_wide_char(JSValueConst v)
+{
+    if (JS_VALUE_GET_TAG(v) == JS_TAG_STRING_ROPE)
+        return ((JSStringRope *)JS_VALUE_GET_PTR(v))->is_wide_char;
+    else
+        return JS_VALUE_GET_STRING(v)->is_wide_char;
+}
+
+/* op1 and op2 are non empty strings or ropes and are freed */
+static JSValue js_new_string_rope(JSContext *ctx, JSValue op1, JSValue op2)
+{
+    JSStringRope *r;
+    uint32_t len;
+
+    len = js_string_value_len(op1) + js_string_value_len(op2);
+    if (len > JS_STRING_LEN_MAX) {
+        JS_ThrowInternalError(ctx, "string too long");
+        goto fail;
+    }
+    r = js_malloc(ctx, sizeof(*r));
+    if (!r)
+        goto fail;
+    r->header.ref_count = 1;
+    r->len = len;
+    r->is_wide_char = js_string_value_is_wide_char(op1) |
+        js_string_value_is_wide_char(op2);
+    r->left = op1;
+    r->right = op2;
+    return JS_MKPTR(JS_TAG_STRING_ROPE, r);
+ fail:
+    JS_FreeValue(ctx, op1);
+    JS_FreeValue(ctx, op2);
+    return JS_EXCEPTION;
+}
+
+/* The rope walks below only recurse into the shorter child and loop on
+   the longer one, so their stack depth is at most log2(len) whatever
+   the shape of the tree. */
+
+static void js_free_string_rope(JSRuntime *rt, JSStringRope *r)
+{
+    JSValue left, right, tmp;
+
+    for(;;) {
+        left = r->left;
+        right = r->right;
+        js_free_rt(rt, r);
+        if (!JS_IsUndefined(right)) {
+            if (js_string_value_len(left) > js_string_value_len(right)) {
+                tmp = left;
+                left = right;
+                right = tmp;
+            }
+            JS_FreeValueRT(rt, left);
+            left = right;
+        }
+        if (JS_VALUE_GET_TAG(left) != JS_TAG_STRING_ROPE) {
+            JS_FreeValueRT(rt, left);
+            break;
+        }
+        r = JS_VALUE_GET_PTR(left);
+        if (--r->header.ref_count > 0)
+            break;
+    }
+}
+
+/* copy the characters of the string or rope 'v' to 'dst' at 'offset' */
+static void js_string_rope_copy(JSString *dst, uint32_t offset,
+                                JSValueConst v)
+{
+    JSStringRope *r;
+    JSString *p;
+    uint32_t left_len;
+
+    while (JS_VALUE_GET_TAG(v) == JS_TAG_STRING_ROPE) {
+        r = JS_VALUE_GET_PTR(v);
+        if (JS_IsUndefined(r->right)) {
+            v = r->left;
+            break;
+        }
+        left_len = js_string_value_len(r->left);
+        if (left_len <= r->len - left_len) {
+            js_string_rope_copy(dst, offset, r->left);
+            offset += left_len;
+            v = r->right;
+        } else {
+            js_string_rope_copy(dst, offset + left_len, r->right);
+            v = r->left;
+        }
+    }
+    p = JS_VALUE_GET_STRING(v);
+    if (dst->is_wide_char)
+        copy_str16(dst->u.str16 + offset, p, 0, p->len);
+    else
+        memcpy(dst->u.str8 + offset, p->u.str8, p->len);
+}
+
+/* Return the flat string of the rope, built on first use and kept by
+   the rope. The subtrees are released. Return NULL if exception. */
+static JSString *js_string_rope_flatten(JSContext *ctx, JSStringRope *r)
+{
+    JSStringRope *r1;
+    JSString *p;
+    uint32_t max_len;
+
+    if (JS_IsUndefined(r->right))
+        return JS_VALUE_GET_STRING(r->left);
+    if (JS_VALUE_GET_TAG(r->left) == JS_TAG_STRING_ROPE) {
+        r1 = JS_VALUE_GET_PTR(r->left);
+        if (r1->header.ref_count == 1 && JS_IsUndefined(r1->right)) {
+            /* the left child is an unshared flattened rope */
+            r->left = JS_DupValue(ctx, r1->left);
+            JS_FreeValue(ctx, JS_MKPTR(JS_TAG_STRING_ROPE, r1));
+        }
+    }
+    max_len = r->len;
+    if (JS_VALUE_GET_TAG(r->left) == JS_TAG_STRING) {
+        /* The string is being built by appending to a flat string which
+           is read in between: extend it in place when it is unshared,
+           otherwise leave some slack for the next appends so that such
+           loops stay linear. */
+        p = JS_VALUE_GET_STRING(r->left);
+        if (p->header.ref_count == 1 && p->is_wide_char == r->is_wide_char
+        &&  js_malloc_usable_size(ctx, p) >= sizeof(*p) + (r->len << r->is_wide_char) + 1 - r->is_wide_char) {
+            js_string_rope_copy(p, p->len, r->right);
+            p->len = r->len;
+            if (!p->is_wide_char)
+                p->u.str8[r->len] = '\0';
+            JS_FreeValue(ctx, r->right);
+            r->right = JS_UNDEFINED;
+            return p;
+        }
+        max_len = min_uint32(r->len + r->len / 2, JS_STRING_LEN_MAX);
+    }
+    p = js_alloc_string(ctx, max_len, r->is_wide_char);
+    if (!p)
+        return NULL;
+    p->len = r->len;
+    js_string_rope_copy(p, 0, JS_MKPTR(JS_TAG_STRING_ROPE, r));
+    if (!p->is_wide_char)
+        p->u.str8[r->len] = '\0';
+    JS_FreeValue(ctx, r->left);
+    JS_FreeValue(ctx, r->right);
+    r->left = JS_MKPTR(JS_TAG_STRING, p);
+    r->right = JS_UNDEFINED;
+    return p;
+}
+
+/* Return 'v' with a rope replaced by its flat string. */
+static JSValue js_flatten_string(JSContext *ctx, JSValueConst v)
+{
+    JSString *p;
+
+    if (JS_VALUE_GET_TAG(v) != JS_TAG_STRING_ROPE)
+        return JS_DupValue(ctx, v);
+    p = js_string_rope_flatten(ctx, JS_VALUE_GET_PTR(v));
+    if (!p)
+        return JS_EXCEPTION;
+    return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, p));
+}
+
+static JSValue js_flatten_string_free(JSContext *ctx, JSValue v)
+{
+    JSValue ret;
+
+    if (JS_VALUE_GET_TAG(v) != JS_TAG_STRING_ROPE)
+        return v;
+    ret = js_flatten_string(ctx, v);
+    JS_FreeValue(ctx, v);
+    return ret;
+}
+
+static inline JSValue js_string_rope_unwrap(JSContext *ctx, JSValue v)
+{
+    JSStringRope *r;
+    JSValue ret;
+
+    if (JS_VALUE_GET_TAG(v) != JS_TAG_STRING_ROPE)
+        return v;
+    r = JS_VALUE_GET_PTR(v);
+    if (!JS_IsUndefined(r->right))
+        return v;
+    ret = JS_DupValue(ctx, r->left);
+    JS_FreeValue(ctx, v);
+    return ret;
+}
+
+/* op1 and op2 are non empty strings or ropes and are freed */
+static JSValue js_concat_string_rope(JSContext *ctx, JSValue op1, JSValue op2)
+{
+    JSStringRope *r1;
+    JSValue left, right;
+
+    if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE &&
+        JS_VALUE_GET_TAG(op2) == JS_TAG_STRING) {
+        r1 = JS_VALUE_GET_PTR(op1);
+        if (JS_VALUE_GET_TAG(r1->right) == JS_TAG_STRING &&
+            JS_VALUE_GET_STRING(r1->right)->len +
+            JS_VALUE_GET_STRING(op2)->len < JS_STRING_ROPE_MIN_LEN) {
+            /* merge op2 into the short right leaf */
+            right = JS_ConcatString1(ctx, JS_VALUE_GET_STRING(r1->right),
+                                     JS_VALUE_GET_STRING(op2));
+            JS_FreeValue(ctx, op2);
+            if (JS_IsException(right)) {
+                JS_FreeValue(ctx, op1);
+                return JS_EXCEPTION;
+            }
+            left = JS_DupValue(ctx, r1->left);
+            JS_FreeValue(ctx, op1);
+            return js_new_string_rope(ctx, left, right);
+        }
+    }
+    return js_new_string_rope(ctx, op1, op2);
+}
+
 /* op1 and op2 are converted to strings. For convience, op1 or op2 =
    JS_EXCEPTION are accepted and return JS_EXCEPTION.  */
 static JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2)
 {
     JSValue ret;
     JSString *p1, *p2;
+    uint32_t len1, len2;
 
-    if (unlikely(JS_VALUE_GET_TAG(op1) != JS_TAG_STRING)) {
+    if (unlikely(!tag_is_string(JS_VALUE_GET_TAG(op1)))) {
         op1 = JS_ToStringFree(ctx, op1);
         if (JS_IsException(op1)) {
             JS_FreeValue(ctx, op2);
             return JS_EXCEPTION;
         }
     }
-    if (unlikely(JS_VALUE_GET_TAG(op2) != JS_TAG_STRING)) {
+    if (unlikely(!tag_is_string(JS_VALUE_GET_TAG(op2)))) {
         op2 = JS_ToStringFree(ctx, op2);
         if (JS_IsException(op2)) {
             JS_FreeValue(ctx, op1);
             return JS_EXCEPTION;
         }
     }
+    /* a flattened rope is replaced by its flat string so that the in
+       place concatenation below can apply */
+    op1 = js_string_rope_unwrap(ctx, op1);
+    op2 = js_string_rope_unwrap(ctx, op2);
+    len1 = js_string_value_len(op1);
+    len2 = js_string_value_len(op2);
+    if (len2 == 0) {
+        goto ret_op1;
+    }
+    if (len1 == 0) {
+        JS_FreeValue(ctx, op1);
+        return op2;
+    }
+    if (JS_VALUE_GET_TAG(op1) == JS_TAG_STRING_ROPE ||
+        JS_VALUE_GET_TAG(op2) == JS_TAG_STRING_ROPE)
+        return js_concat_string_rope(ctx, op1, op2);
     p1 = JS_VALUE_GET_STRING(op1);
     p2 = JS_VALUE_GET_STRING(op2);
 
-    /* XXX: could also check if p1 is empty */
-    if (p2->len == 0) {
-        goto ret_op1;
-    }
     if (p1->header.ref_count == 1 && p1->is_wide_char == p2->is_wide_char
     &&  js_malloc_usable_size(ctx, p1) >= sizeof(*p1) + ((p1->len + p2->len) << p2->is_wide_char) + 1 - p1->is_wide_char) {
         /* Concatenate in place in available space at the end of p1 */
@@ -4233,6 +4855,8 @@ static JSValue JS_ConcatString(JSContext *ctx, JSValue op1, JSValue op2)
         JS_FreeValue(ctx, op2);
         return op1;
     }
+    if (len1 + len2 >= JS_STRING_ROPE_MIN_LEN)
+        return js_concat_string_rope(ctx, op1, op2);
     ret = JS_ConcatString1(ctx, p1, p2);
     JS_FreeValue(ctx, op1);
     JS_FreeValue(ctx, op2);
@@ -4348,6 +4972,12 @@ static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
     rt->shape_hash_count--;
 }
 
+/* invalidate the inline caches keyed on the previous id of 'sh' */
+static inline void js_shape_renew_id(JSRuntime *rt, JSShape *sh)
+{
+    sh->id = ++rt->shape_id_counter;
+}
+
 /* create a new empty shape with prototype 'proto' */
 static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
                                         int hash_size, int prop_size)
@@ -4376,6 +5006,7 @@ static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
     sh->prop_size = prop_size;
     sh->prop_count = 0;
     sh->deleted_prop_count = 0;
+    js_shape_renew_id(rt, sh);
     
     /* insert in the hash table */
     sh->hash = shape_initial_hash(proto);
@@ -4412,6 +5043,7 @@ static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
     sh->header.ref_count = 1;
     add_gc_object(ctx->rt, &sh->header, JS_GC_OBJ_TYPE_SHAPE);
     sh->is_hashed = FALSE;
+    js_shape_renew_id(ctx->rt, sh);
     if (sh->proto) {
         JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, sh->proto));
     }
@@ -4492,11 +5124,12 @@ static no_inline int resize_properties(JSContext *ctx, JSShape **psh,
     if (!sh_alloc)
         return -1;
     sh = get_shape_from_alloc(sh_alloc, new_hash_size);
-    list_del(&old_sh->header.link);
     /* copy all the shape properties */
     memcpy(sh, old_sh,
            sizeof(JSShape) + sizeof(sh->prop[0]) * old_sh->prop_count);
-    list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+    /* take the place of the old shape in its GC list */
+    list_add_tail(&sh->header.link, &old_sh->header.link);
+    list_del(&old_sh->header.link);
     
     if (new_hash_size != (sh->prop_hash_mask + 1)) {
         /* resize the hash table and the properties */
@@ -4550,9 +5183,9 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     if (!sh_alloc)
         return -1;
     sh = get_shape_from_alloc(sh_alloc, new_hash_size);
-    list_del(&old_sh->header.link);
     memcpy(sh, old_sh, sizeof(JSShape));
-    list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+    list_add_tail(&sh->header.link, &old_sh->header.link);
+    list_del(&old_sh->header.link);
     
     memset(prop_hash_end(sh) - new_hash_size, 0,
            sizeof(prop_hash_end(sh)[0]) * new_hash_size);
@@ -4579,6 +5212,7 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     sh->prop_size = new_size;
     sh->deleted_prop_count = 0;
     sh->prop_count = j;
+    js_shape_renew_id(ctx->rt, sh);
 
     p->shape = sh;
     js_free(ctx, get_alloc_from_shape(old_sh));
@@ -4626,6 +5260,7 @@ static int add_shape_property(JSContext *ctx, JSShape **psh,
     pr->atom = JS_DupAtom(ctx, atom);
     pr->flags = prop_flags;
     sh->has_small_array_index |= __JS_AtomIsTaggedInt(atom);
+    js_shape_renew_id(rt, sh);
     /* add in hash table */
     hash_mask = sh->prop_hash_mask;
     h = atom & hash_mask;
@@ -4719,6 +5354,7 @@ static __maybe_unused void JS_DumpShapes(JSRuntime *rt)
         }
     }
     /* dump non-hashed shapes */
+    gc_promote_young(rt);
     list_for_each(el, &rt->gc_obj_list) {
         gp = list_entry(el, JSGCObjectHeader, link);
         if (gp->gc_obj_type == JS_GC_OBJ_TYPE_JS_OBJECT) {
@@ -5475,6 +6111,19 @@ static void free_gc_object(JSRuntime *rt, JSGCObjectHeader *gp)
     }
 }
 
+/* 'p' dropped to zero references while cycles are being removed. The
+   GC objects of the cycles have mark = 1. The others (kept alive by
+   the scan or not scanned at all by a young collection) are freed in
+   the same pass. */
+static void gc_free_with_cycles(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (p->mark == 0) {
+        list_del(&p->link);
+        list_add_tail(&p->link, &rt->tmp_obj_list);
+        p->mark = 1;
+    }
+}
+
 static void free_zero_refcount(JSRuntime *rt)
 {
     struct list_head *el;
@@ -5523,6 +6172,9 @@ void __JS_FreeValueRT(JSRuntime *rt, JSValue v)
             }
         }
         break;
+    case JS_TAG_STRING_ROPE:
+        js_free_string_rope(rt, JS_VALUE_GET_PTR(v));
+        break;
     case JS_TAG_OBJECT:
     case JS_TAG_FUNCTION_BYTECODE:
         {
@@ -5533,6 +6185,8 @@ void __JS_FreeValueRT(JSRuntime *rt, JSValue v)
                 if (rt->gc_phase == JS_GC_PHASE_NONE) {
                     free_zero_refcount(rt);
                 }
+            } else {
+                gc_free_with_cycles(rt, p);
             }
         }
         break;
@@ -5581,8 +6235,46 @@ static void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h,
                           JSGCObjectTypeEnum type)
 {
     h->mark = 0;
+    h->young = 1;
     h->gc_obj_type = type;
-    list_add_tail(&h->link, &rt->gc_obj_list);
+    list_add_tail(&h->link, &rt->gc_young_obj_list);
+}
+
+/* move an old GC object back to the young ones so that the next young
+   collection sees the cycles it may now be part of */
+static no_inline void gc_make_young(JSRuntime *rt, JSGCObjectHeader *h)
+{
+    if (rt->gc_phase == JS_GC_PHASE_NONE) {
+        list_del(&h->link);
+        list_add_tail(&h->link, &rt->gc_young_obj_list);
+        h->young = 1;
+    }
+}
+
+/* called when an object reference is stored in a property of 'p'.
+   Missing a store only delays the collection of its cycles to the
+   next full GC. The array elements are not tracked: rescanning a large
+   array at every young collection costs more than it finds. */
+static inline void gc_write_barrier(JSRuntime *rt, JSObject *p,
+                                    JSValueConst val)
+{
+    if (unlikely(!p->header.young) &&
+        JS_VALUE_GET_TAG(val) == JS_TAG_OBJECT) {
+        gc_make_young(rt, &p->header);
+    }
+}
+
+/* the survivors of a collection become old */
+static void gc_promote_young(JSRuntime *rt)
+{
+    struct list_head *el;
+    JSGCObjectHeader *p;
+
+    list_for_each(el, &rt->gc_young_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        p->young = 0;
+    }
+    list_splice_tail_init(&rt->gc_young_obj_list, &rt->gc_obj_list);
 }
 
 static void remove_gc_object(JSGCObjectHeader *h)
@@ -5727,6 +6419,7 @@ static void gc_decref(JSRuntime *rt)
 {
     struct list_head *el, *el1;
     JSGCObjectHeader *p;
+    int64_t count = 0;
     
     init_list_head(&rt->tmp_obj_list);
 
@@ -5742,7 +6435,9 @@ static void gc_decref(JSRuntime *rt)
             list_del(&p->link);
             list_add_tail(&p->link, &rt->tmp_obj_list);
         }
+        count++;
     }
+    rt->gc_stats.last_scanned = count;
 }
 
 static void gc_scan_incref_child(JSRuntime *rt, JSGCObjectHeader *p)
@@ -5782,10 +6477,79 @@ static void gc_scan(JSRuntime *rt)
     }
 }
 
+/* Young collection: the references from the old objects are not
+   subtracted, so only the cycles made of young objects are found. An
+   old object holding a young one keeps it alive. */
+
+static void gc_decref_child_young(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (p->young)
+        gc_decref_child(rt, p);
+}
+
+static void gc_decref_young(JSRuntime *rt)
+{
+    struct list_head *el, *el1;
+    JSGCObjectHeader *p;
+    int64_t count = 0;
+
+    init_list_head(&rt->tmp_obj_list);
+
+    list_for_each_safe(el, el1, &rt->gc_young_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        assert(p->mark == 0);
+        mark_children(rt, p, gc_decref_child_young);
+        p->mark = 1;
+        if (p->ref_count == 0) {
+            list_del(&p->link);
+            list_add_tail(&p->link, &rt->tmp_obj_list);
+        }
+        count++;
+    }
+    rt->gc_stats.last_scanned = count;
+}
+
+static void gc_scan_incref_child_young(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (p->young) {
+        p->ref_count++;
+        if (p->ref_count == 1) {
+            list_del(&p->link);
+            list_add_tail(&p->link, &rt->gc_young_obj_list);
+            p->mark = 0;
+        }
+    }
+}
+
+static void gc_scan_incref_child2_young(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (p->young)
+        p->ref_count++;
+}
+
+static void gc_scan_young(JSRuntime *rt)
+{
+    struct list_head *el;
+    JSGCObjectHeader *p;
+
+    list_for_each(el, &rt->gc_young_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        assert(p->ref_count > 0);
+        p->mark = 0;
+        mark_children(rt, p, gc_scan_incref_child_young);
+    }
+    
+    list_for_each(el, &rt->tmp_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        mark_children(rt, p, gc_scan_incref_child2_young);
+    }
+}
+
 static void gc_free_cycles(JSRuntime *rt)
 {
     struct list_head *el, *el1;
     JSGCObjectHeader *p;
+    int64_t count = 0;
 #ifdef DUMP_GC_FREE
     BOOL header_done = FALSE;
 #endif
@@ -5797,6 +6561,7 @@ static void gc_free_cycles(JSRuntime *rt)
         if (el == &rt->tmp_obj_list)
             break;
         p = list_entry(el, JSGCObjectHeader, link);
+        count++;
         /* Only need to free the GC object associated with JS values
            or async functions. The rest will be automatically removed
            because they must be referenced by them. */
@@ -5831,10 +6596,52 @@ static void gc_free_cycles(JSRuntime *rt)
     }
 
     init_list_head(&rt->gc_zero_ref_count_list);
+    rt->gc_stats.last_freed = count;
+}
+
+static int64_t gc_get_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void gc_update_stats(JSRuntime *rt, int64_t start_time)
+{
+    JSGCStats *s = &rt->gc_stats;
+    int64_t pause;
+
+    rt->gc_count++;
+    pause = gc_get_time_us() - start_time;
+    s->last_pause_us = pause;
+    s->total_pause_us += pause;
+    if (pause > s->max_pause_us)
+        s->max_pause_us = pause;
+}
+
+/* collect the cycles among the objects allocated or mutated since the
+   previous collection, then make the survivors old */
+static void gc_run_young(JSRuntime *rt)
+{
+    int64_t start_time = gc_get_time_us();
+
+    gc_decref_young(rt);
+    gc_scan_young(rt);
+    gc_free_cycles(rt);
+    gc_promote_young(rt);
+
+    rt->gc_stats.young_count++;
+    gc_update_stats(rt, start_time);
 }
 
 void JS_RunGC(JSRuntime *rt)
 {
+    int64_t start_time = gc_get_time_us();
+    size_t malloc_size;
+
+    rt->gc_full_malloc_size = rt->malloc_state.malloc_size;
+    gc_promote_young(rt);
+
     /* decrement the reference of the children of each object. mark =
        1 after this pass. */
     gc_decref(rt);
@@ -5844,6 +6651,55 @@ void JS_RunGC(JSRuntime *rt)
 
     /* free the GC objects in a cycle */
     gc_free_cycles(rt);
+
+    malloc_size = rt->malloc_state.malloc_size;
+    rt->malloc_gc_full_threshold = malloc_size + (malloc_size >> 1);
+    rt->gc_step_deferred = 0;
+    rt->gc_stats.full_count++;
+    gc_update_stats(rt, start_time);
+    rt->gc_full_pause_us = rt->gc_stats.last_pause_us;
+}
+
+void JS_SetGCMode(JSRuntime *rt, JSGCModeEnum mode)
+{
+    rt->gc_mode = mode;
+}
+
+/* the full collection walks every GC object, so its pause grows with
+   the heap */
+static int64_t gc_full_cost_us(JSRuntime *rt)
+{
+    if (rt->gc_full_malloc_size == 0)
+        return 0;
+    return (double)rt->gc_full_pause_us * rt->malloc_state.malloc_size /
+        rt->gc_full_malloc_size;
+}
+
+/* a due full collection is no longer deferred once the heap has
+   reached twice its threshold or after this number of steps */
+#define JS_GC_STEP_MAX_DEFERRED 120
+
+/* The young collection runs when objects were allocated or mutated:
+   its pause only depends on them. */
+BOOL JS_RunGCStep(JSRuntime *rt, int64_t budget_us)
+{
+    int64_t start_time = gc_get_time_us();
+    size_t malloc_size;
+
+    if (!list_empty(&rt->gc_young_obj_list))
+        gc_run_young(rt);
+    malloc_size = rt->malloc_state.malloc_size;
+    if (malloc_size > rt->malloc_gc_full_threshold) {
+        budget_us -= gc_get_time_us() - start_time;
+        if (gc_full_cost_us(rt) > budget_us &&
+            malloc_size / 2 <= rt->malloc_gc_full_threshold &&
+            rt->gc_step_deferred < JS_GC_STEP_MAX_DEFERRED) {
+            rt->gc_step_deferred++;
+            return FALSE;
+        }
+        JS_RunGC(rt);
+    }
+    return TRUE;
 }
 
 /* Return false if not an object or if the object has already been
@@ -5928,6 +6784,17 @@ static void compute_value_size(JSValueConst val, JSMemoryUsage_helper *hp)
     case JS_TAG_STRING:
         compute_jsstring_size(JS_VALUE_GET_STRING(val), hp);
         break;
+    case JS_TAG_STRING_ROPE:
+        {
+            /* the leaves of a rope which is not flattened are not counted */
+            JSStringRope *r = JS_VALUE_GET_PTR(val);
+            double s_ref_count = r->header.ref_count;
+            hp->str_count += 1 / s_ref_count;
+            hp->str_size += sizeof(*r) / s_ref_count;
+            if (JS_IsUndefined(r->right))
+                compute_value_size(r->left, hp);
+        }
+        break;
     case JS_TAG_BIG_INT:
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_FLOAT:
@@ -5938,6 +6805,22 @@ static void compute_value_size(JSValueConst val, JSMemoryUsage_helper *hp)
     }
 }
 
+/* constant time, unlike JS_ComputeMemoryUsage() */
+void JS_GetMallocState(JSRuntime *rt, JSMallocState *s)
+{
+    *s = rt->malloc_state;
+}
+
+int64_t JS_GetGCCount(JSRuntime *rt)
+{
+    return rt->gc_count;
+}
+
+void JS_GetGCStats(JSRuntime *rt, JSGCStats *s)
+{
+    *s = rt->gc_stats;
+}
+
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
 {
     struct list_head *el, *el1;
@@ -6000,6 +6883,8 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
         }
     }
 
+    /* only the old list is walked */
+    gc_promote_young(rt);
     list_for_each(el, &rt->gc_obj_list) {
         JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
         JSObject *p;
@@ -6267,6 +7152,7 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
             int obj_classes[JS_CLASS_INIT_COUNT + 1] = { 0 };
             int class_id;
             struct list_head *el;
+            gc_promote_young(rt);
             list_for_each(el, &rt->gc_obj_list) {
                 JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
                 JSObject *p;
@@ -6364,6 +7250,10 @@ JSValue JS_GetGlobalObject(JSContext *ctx)
 JSValue JS_Throw(JSContext *ctx, JSValue obj)
 {
     JSRuntime *rt = ctx->rt;
+    /* JS_GetException() must not return a rope */
+    obj = js_flatten_string_free(ctx, obj);
+    if (JS_IsException(obj))
+        return obj;
     JS_FreeValue(ctx, rt->current_exception);
     rt->current_exception = obj;
     return JS_EXCEPTION;
@@ -6496,7 +7386,7 @@ static const char *get_func_name(JSContext *ctx, JSValueConst func)
     if ((prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL)
         return NULL;
     val = pr->u.value;
-    if (JS_VALUE_GET_TAG(val) != JS_TAG_STRING)
+    if (!tag_is_string(JS_VALUE_GET_TAG(val)))
         return NULL;
     return JS_ToCString(ctx, val);
 }
@@ -6932,6 +7822,7 @@ static JSValueConst JS_GetPrototypePrimitive(JSContext *ctx, JSValueConst val)
         val = ctx->class_proto[JS_CLASS_BOOLEAN];
         break;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         val = ctx->class_proto[JS_CLASS_STRING];
         break;
     case JS_TAG_SYMBOL:
@@ -7109,9 +8000,10 @@ static int JS_AutoInitProperty(JSContext *ctx, JSObject *p, JSAtom prop,
     return 0;
 }
 
-JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
-                               JSAtom prop, JSValueConst this_obj,
-                               BOOL throw_ref_error)
+/* the result can be a rope */
+static JSValue __JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
+                                        JSAtom prop, JSValueConst this_obj,
+                                        BOOL throw_ref_error)
 {
     JSObject *p;
     JSProperty *pr;
@@ -7145,6 +8037,22 @@ JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
                 }
             }
             break;
+        case JS_TAG_STRING_ROPE:
+            {
+                JSStringRope *r = JS_VALUE_GET_PTR(obj);
+                if (__JS_AtomIsTaggedInt(prop)) {
+                    uint32_t idx = __JS_AtomToUInt32(prop);
+                    if (idx < r->len) {
+                        JSString *p1 = js_string_rope_flatten(ctx, r);
+                        if (!p1)
+                            return JS_EXCEPTION;
+                        return js_new_string_char(ctx, string_get(p1, idx));
+                    }
+                } else if (prop == JS_ATOM_length) {
+                    return JS_NewInt32(ctx, r->len);
+                }
+            }
+            break;
         default:
             break;
         }
@@ -7192,7 +8100,8 @@ JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
                     uint32_t idx = __JS_AtomToUInt32(prop);
                     if (idx < p->u.array.count) {
                         /* we avoid duplicating the code */
-                        return JS_GetPropertyUint32(ctx, JS_MKPTR(JS_TAG_OBJECT, p), idx);
+                        return JS_GetPropertyValue(ctx, JS_MKPTR(JS_TAG_OBJECT, p),
+                                                   JS_NewUint32(ctx, idx));
                     } else if (p->class_id >= JS_CLASS_UINT8C_ARRAY &&
                                p->class_id <= JS_CLASS_FLOAT64_ARRAY) {
                         return JS_UNDEFINED;
@@ -7255,6 +8164,14 @@ JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
     }
 }
 
+JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
+                               JSAtom prop, JSValueConst this_obj,
+                               BOOL throw_ref_error)
+{
+    return js_flatten_string_free(ctx, __JS_GetPropertyInternal(ctx, obj, prop, this_obj,
+                                                                throw_ref_error));
+}
+
 static JSValue JS_ThrowTypeErrorPrivateNotFound(JSContext *ctx, JSAtom atom)
 {
     return JS_ThrowTypeErrorAtom(ctx, "private class field '%s' does not exist",
@@ -7774,11 +8691,23 @@ retry:
 int JS_GetOwnProperty(JSContext *ctx, JSPropertyDescriptor *desc,
                       JSValueConst obj, JSAtom prop)
 {
+    int ret;
+
     if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT) {
         JS_ThrowTypeErrorNotAnObject(ctx);
         return -1;
     }
-    return JS_GetOwnPropertyInternal(ctx, desc, JS_VALUE_GET_OBJ(obj), prop);
+    ret = JS_GetOwnPropertyInternal(ctx, desc, JS_VALUE_GET_OBJ(obj), prop);
+    if (ret > 0 && desc &&
+        JS_VALUE_GET_TAG(desc->value) == JS_TAG_STRING_ROPE) {
+        desc->value = js_flatten_string_free(ctx, desc->value);
+        if (JS_IsException(desc->value)) {
+            desc->value = JS_UNDEFINED;
+            js_free_desc(ctx, desc);
+            return -1;
+        }
+    }
+    return ret;
 }
 
 /* return -1 if exception (Proxy object only) or TRUE/FALSE */
@@ -7944,7 +8873,7 @@ static JSValue JS_GetPropertyValue(JSContext *ctx, JSValueConst this_obj,
         JS_FreeValue(ctx, prop);
         if (unlikely(atom == JS_ATOM_NULL))
             return JS_EXCEPTION;
-        ret = JS_GetProperty(ctx, this_obj, atom);
+        ret = __JS_GetPropertyInternal(ctx, this_obj, atom, this_obj, FALSE);
         JS_FreeAtom(ctx, atom);
         return ret;
     }
@@ -7953,7 +8882,8 @@ static JSValue JS_GetPropertyValue(JSContext *ctx, JSValueConst this_obj,
 JSValue JS_GetPropertyUint32(JSContext *ctx, JSValueConst this_obj,
                              uint32_t idx)
 {
-    return JS_GetPropertyValue(ctx, this_obj, JS_NewUint32(ctx, idx));
+    return js_flatten_string_free(ctx, JS_GetPropertyValue(ctx, this_obj,
+                                                           JS_NewUint32(ctx, idx)));
 }
 
 /* Check if an object has a generalized numeric property. Return value:
@@ -8437,6 +9367,7 @@ int JS_SetPropertyInternal(JSContext *ctx, JSValueConst obj,
         if (likely((prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
                                   JS_PROP_LENGTH)) == JS_PROP_WRITABLE)) {
             /* fast case */
+            gc_write_barrier(ctx->rt, p1, val);
             set_value(ctx, &pr->u.value, val);
             return TRUE;
         } else if (prs->flags & JS_PROP_LENGTH) {
@@ -8508,6 +9439,9 @@ int JS_SetPropertyInternal(JSContext *ctx, JSValueConst obj,
                 if (em) {
                     JSValue obj1;
                     if (em->set_property) {
+                        val = js_flatten_string_free(ctx, val);
+                        if (JS_IsException(val))
+                            return -1;
                         /* set_property can free the prototype */
                         obj1 = JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, p1));
                         ret = em->set_property(ctx, obj1, prop,
@@ -8903,8 +9837,13 @@ static int JS_CreateProperty(JSContext *ctx, JSObject *p,
             const JSClassExoticMethods *em = ctx->rt->class_array[p->class_id].exotic;
             if (em) {
                 if (em->define_own_property) {
-                    return em->define_own_property(ctx, JS_MKPTR(JS_TAG_OBJECT, p),
-                                                   prop, val, getter, setter, flags);
+                    JSValue val1 = js_flatten_string(ctx, val);
+                    if (JS_IsException(val1))
+                        return -1;
+                    ret = em->define_own_property(ctx, JS_MKPTR(JS_TAG_OBJECT, p),
+                                                  prop, val1, getter, setter, flags);
+                    JS_FreeValue(ctx, val1);
+                    return ret;
                 }
                 ret = JS_IsExtensible(ctx, JS_MKPTR(JS_TAG_OBJECT, p));
                 if (ret < 0)
@@ -8942,6 +9881,7 @@ static int JS_CreateProperty(JSContext *ctx, JSObject *p,
         }
     } else {
         if (flags & JS_PROP_HAS_VALUE) {
+            gc_write_barrier(ctx->rt, p, val);
             pr->u.value = JS_DupValue(ctx, val);
         } else {
             pr->u.value = JS_UNDEFINED;
@@ -9007,6 +9947,8 @@ static int js_shape_prepare_update(JSContext *ctx, JSObject *p,
             sh->is_hashed = FALSE;
         }
     }
+    /* the caller modifies the shape in place */
+    js_shape_renew_id(ctx->rt, sh);
     return 0;
 }
 
@@ -9582,7 +10524,7 @@ static JSValue JS_GetGlobalVar(JSContext *ctx, JSAtom prop,
             return JS_ThrowReferenceErrorUninitialized(ctx, prs->atom);
         return JS_DupValue(ctx, pr->u.value);
     }
-    return JS_GetPropertyInternal(ctx, ctx->global_obj, prop,
+    return __JS_GetPropertyInternal(ctx, ctx->global_obj, prop,
                                  ctx->global_obj, throw_ref_error);
 }
 
@@ -9954,6 +10896,10 @@ static int JS_ToBoolFree(JSContext *ctx, JSValue val)
             JS_FreeValue(ctx, val);
             return ret;
         }
+    case JS_TAG_STRING_ROPE:
+        /* a rope is never empty */
+        JS_FreeValue(ctx, val);
+        return TRUE;
     case JS_TAG_BIG_INT:
 #ifdef CONFIG_BIGNUM
     case JS_TAG_BIG_FLOAT:
@@ -10485,6 +11431,7 @@ static JSValue JS_ToNumberHintFree(JSContext *ctx, JSValue val,
             return JS_EXCEPTION;
         goto redo;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         {
             const char *str;
             const char *p;
@@ -11588,6 +12535,8 @@ JSValue JS_ToStringInternal(JSContext *ctx, JSValueConst val, BOOL is_ToProperty
     switch(tag) {
     case JS_TAG_STRING:
         return JS_DupValue(ctx, val);
+    case JS_TAG_STRING_ROPE:
+        return js_flatten_string(ctx, val);
     case JS_TAG_INT:
         snprintf(buf, sizeof(buf), "%d", JS_VALUE_GET_INT(val));
         str = buf;
@@ -11978,6 +12927,15 @@ static __maybe_unused void JS_DumpValueShort(JSRuntime *rt,
                    JS_AtomGetStrRT(rt, atom_buf, sizeof(atom_buf), js_get_atom_index(rt, p)));
         }
         break;
+    case JS_TAG_STRING_ROPE:
+        {
+            JSStringRope *r = JS_VALUE_GET_PTR(val);
+            if (JS_IsUndefined(r->right))
+                JS_DumpValueShort(rt, r->left);
+            else
+                printf("[rope %u]", r->len);
+        }
+        break;
     case JS_TAG_MODULE:
         printf("[module]");
         break;
@@ -12167,6 +13125,7 @@ static bf_t *JS_ToBigIntFree(JSContext *ctx, bf_t *buf, JSValue val)
         break;
 #endif        
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         val = JS_StringToBigIntErr(ctx, val);
         if (JS_IsException(val))
             return NULL;
@@ -13569,10 +14528,10 @@ static no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp)
         /* try to call an overloaded operator */
         if ((tag1 == JS_TAG_OBJECT &&
              (tag2 != JS_TAG_NULL && tag2 != JS_TAG_UNDEFINED &&
-              tag2 != JS_TAG_STRING)) ||
+              !tag_is_string(tag2))) ||
             (tag2 == JS_TAG_OBJECT &&
              (tag1 != JS_TAG_NULL && tag1 != JS_TAG_UNDEFINED &&
-              tag1 != JS_TAG_STRING))) {
+              !tag_is_string(tag1)))) {
             JSValue res;
             int ret = js_call_binary_op_fallback(ctx, &res, op1, op2, OP_add,
                                                  FALSE, HINT_NONE);
@@ -13603,7 +14562,7 @@ static no_inline __exception int js_add_slow(JSContext *ctx, JSValue *sp)
         tag2 = JS_VALUE_GET_NORM_TAG(op2);
     }
 
-    if (tag1 == JS_TAG_STRING || tag2 == JS_TAG_STRING) {
+    if (tag_is_string(tag1) || tag_is_string(tag2)) {
         sp[-2] = JS_ConcatString(ctx, op1, op2);
         if (JS_IsException(sp[-2]))
             goto exception;
@@ -13900,8 +14859,15 @@ static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
     tag1 = JS_VALUE_GET_NORM_TAG(op1);
     tag2 = JS_VALUE_GET_NORM_TAG(op2);
 
-    if (tag1 == JS_TAG_STRING && tag2 == JS_TAG_STRING) {
+    if (tag_is_string(tag1) && tag_is_string(tag2)) {
         JSString *p1, *p2;
+        op1 = js_flatten_string_free(ctx, op1);
+        op2 = js_flatten_string_free(ctx, op2);
+        if (JS_IsException(op1) || JS_IsException(op2)) {
+            JS_FreeValue(ctx, op1);
+            JS_FreeValue(ctx, op2);
+            goto exception;
+        }
         p1 = JS_VALUE_GET_STRING(op1);
         p2 = JS_VALUE_GET_STRING(op2);
         res = js_string_compare(ctx, p1, p2);
@@ -13927,15 +14893,15 @@ static no_inline int js_relational_slow(JSContext *ctx, JSValue *sp,
         /* fast path for float64/int */
         goto float64_compare;
     } else {
-        if (((tag1 == JS_TAG_BIG_INT && tag2 == JS_TAG_STRING) ||
-             (tag2 == JS_TAG_BIG_INT && tag1 == JS_TAG_STRING)) &&
+        if (((tag1 == JS_TAG_BIG_INT && tag_is_string(tag2)) ||
+             (tag2 == JS_TAG_BIG_INT && tag_is_string(tag1))) &&
             !is_math_mode(ctx)) {
-            if (tag1 == JS_TAG_STRING) {
+            if (tag_is_string(tag1)) {
                 op1 = JS_StringToBigInt(ctx, op1);
                 if (JS_VALUE_GET_TAG(op1) != JS_TAG_BIG_INT)
                     goto invalid_bigint_string;
             }
-            if (tag2 == JS_TAG_STRING) {
+            if (tag_is_string(tag2)) {
                 op2 = JS_StringToBigInt(ctx, op2);
                 if (JS_VALUE_GET_TAG(op2) != JS_TAG_BIG_INT) {
                 invalid_bigint_string:
@@ -14101,17 +15067,20 @@ static no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp,
     } else if ((tag1 == JS_TAG_NULL && tag2 == JS_TAG_UNDEFINED) ||
                (tag2 == JS_TAG_NULL && tag1 == JS_TAG_UNDEFINED)) {
         res = TRUE;
-    } else if ((tag1 == JS_TAG_STRING && tag_is_number(tag2)) ||
-               (tag2 == JS_TAG_STRING && tag_is_number(tag1))) {
+    } else if (tag_is_string(tag1) && tag_is_string(tag2)) {
+        /* a rope and a flat string */
+        res = js_strict_eq2(ctx, op1, op2, JS_EQ_STRICT);
+    } else if ((tag_is_string(tag1) && tag_is_number(tag2)) ||
+               (tag_is_string(tag2) && tag_is_number(tag1))) {
 
         if ((tag1 == JS_TAG_BIG_INT || tag2 == JS_TAG_BIG_INT) &&
             !is_math_mode(ctx)) {
-            if (tag1 == JS_TAG_STRING) {
+            if (tag_is_string(tag1)) {
                 op1 = JS_StringToBigInt(ctx, op1);
                 if (JS_VALUE_GET_TAG(op1) != JS_TAG_BIG_INT)
                     goto invalid_bigint_string;
             }
-            if (tag2 == JS_TAG_STRING) {
+            if (tag_is_string(tag2)) {
                 op2 = JS_StringToBigInt(ctx, op2);
                 if (JS_VALUE_GET_TAG(op2) != JS_TAG_BIG_INT) {
                 invalid_bigint_string:
@@ -14141,9 +15110,9 @@ static no_inline __exception int js_eq_slow(JSContext *ctx, JSValue *sp,
         op2 = JS_NewInt32(ctx, JS_VALUE_GET_INT(op2));
         goto redo;
     } else if ((tag1 == JS_TAG_OBJECT &&
-                (tag_is_number(tag2) || tag2 == JS_TAG_STRING || tag2 == JS_TAG_SYMBOL)) ||
+                (tag_is_number(tag2) || tag_is_string(tag2) || tag2 == JS_TAG_SYMBOL)) ||
                (tag2 == JS_TAG_OBJECT &&
-                (tag_is_number(tag1) || tag1 == JS_TAG_STRING || tag1 == JS_TAG_SYMBOL))) {
+                (tag_is_number(tag1) || tag_is_string(tag1) || tag1 == JS_TAG_SYMBOL))) {
 #ifdef CONFIG_BIGNUM
         /* try the fallback operator */
         res = js_call_binary_op_fallback(ctx, &ret, op1, op2,
@@ -14316,14 +15285,23 @@ static BOOL js_strict_eq2(JSContext *ctx, JSValue op1, JSValue op2,
         res = (tag1 == tag2);
         break;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         {
             JSString *p1, *p2;
-            if (tag1 != tag2) {
+            if (!tag_is_string(tag2) ||
+                js_string_value_len(op1) != js_string_value_len(op2)) {
                 res = FALSE;
             } else {
-                p1 = JS_VALUE_GET_STRING(op1);
-                p2 = JS_VALUE_GET_STRING(op2);
-                res = (js_string_compare(ctx, p1, p2) == 0);
+                op1 = js_flatten_string_free(ctx, op1);
+                op2 = js_flatten_string_free(ctx, op2);
+                if (JS_IsException(op1) || JS_IsException(op2)) {
+                    /* out of memory: the exception is left pending */
+                    res = FALSE;
+                } else {
+                    p1 = JS_VALUE_GET_STRING(op1);
+                    p2 = JS_VALUE_GET_STRING(op2);
+                    res = (js_string_compare(ctx, p1, p2) == 0);
+                }
             }
         }
         break;
@@ -14605,6 +15583,7 @@ static __exception int js_operator_typeof(JSContext *ctx, JSValueConst op1)
         atom = JS_ATOM_boolean;
         break;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         atom = JS_ATOM_string;
         break;
     case JS_TAG_OBJECT:
@@ -15073,7 +16052,7 @@ static JSValue JS_GetIterator2(JSContext *ctx, JSValueConst obj,
 {
     JSValue enum_obj;
 
-    enum_obj = JS_Call(ctx, method, obj, 0, NULL);
+    enum_obj = __JS_Call(ctx, method, obj, 0, NULL);
     if (JS_IsException(enum_obj))
         return enum_obj;
     if (!JS_IsObject(enum_obj)) {
@@ -15143,7 +16122,7 @@ static JSValue JS_IteratorNext2(JSContext *ctx, JSValueConst enum_obj,
                                       pdone, p->u.cfunc.magic);
         }
     }
-    obj = JS_Call(ctx, method, enum_obj, argc, argv);
+    obj = __JS_Call(ctx, method, enum_obj, argc, argv);
     if (JS_IsException(obj))
         goto fail;
     if (!JS_IsObject(obj)) {
@@ -16010,11 +16989,138 @@ static JSValue js_call_bound_function(JSContext *ctx, JSValueConst func_obj,
         return JS_CallConstructor2(ctx, bf->func_obj, new_target,
                                    arg_count, arg_buf);
     } else {
-        return JS_Call(ctx, bf->func_obj, bf->this_val,
+        return __JS_Call(ctx, bf->func_obj, bf->this_val,
                        arg_count, arg_buf);
     }
 }
 
+/* inline caches for get_field, get_field2 and put_field */
+
+/* TRUE if a lookup that did not find a non index property in the shape
+   of 'p' goes on with its prototype */
+static inline BOOL js_ic_is_transparent(JSObject *p)
+{
+    return !p->is_exotic || p->fast_array || p->class_id == JS_CLASS_ARRAY;
+}
+
+/* return the object holding the property cached in 'ic' for the
+   receiver 'p' or NULL if a shape on the way has changed */
+static inline JSObject *js_ic_get_holder(const JSInlineCache *ic,
+                                         JSObject *p)
+{
+    int i;
+
+    if (p->shape->id != ic->shape_id)
+        return NULL;
+    for(i = 0; i < ic->depth; i++) {
+        if (unlikely(!js_ic_is_transparent(p)))
+            return NULL;
+        p = p->shape->proto;
+        if (p->shape->id != ic->proto_shape_id[i])
+            return NULL;
+    }
+    return p;
+}
+
+/* look up 'atom' from 'p' as __JS_GetPropertyInternal() does and store
+   where it was found in 'ic'. Only plain data properties, and getters
+   for a read, are cached. 'is_put' limits the lookup to writable own
+   properties. Return the holder or NULL if the lookup cannot be
+   cached. */
+static no_inline JSObject *js_ic_update(JSContext *ctx, JSInlineCache *ic,
+                                       JSObject *p, JSAtom atom,
+                                       BOOL is_put)
+{
+    uint64_t proto_shape_id[JS_IC_MAX_DEPTH];
+    JSShapeProperty *prs;
+    JSProperty *pr;
+    JSObject *p1;
+    int depth, flags;
+
+    if (__JS_AtomIsTaggedInt(atom))
+        return NULL;
+    p1 = p;
+    for(depth = 0;; depth++) {
+        prs = find_own_property(&pr, p1, atom);
+        if (prs)
+            break;
+        if (is_put || depth == JS_IC_MAX_DEPTH || !js_ic_is_transparent(p1))
+            return NULL;
+        p1 = p1->shape->proto;
+        if (!p1)
+            return NULL;
+        proto_shape_id[depth] = p1->shape->id;
+    }
+    flags = prs->flags;
+    if (is_put) {
+        if ((flags & (JS_PROP_TMASK | JS_PROP_WRITABLE | JS_PROP_LENGTH)) !=
+            JS_PROP_WRITABLE)
+            return NULL;
+    } else if ((flags & JS_PROP_TMASK) == JS_PROP_GETSET) {
+        if (!pr->u.getset.getter)
+            return NULL;
+    } else if (flags & JS_PROP_TMASK) {
+        return NULL;
+    }
+    /* a typed array met on the way would answer a numeric index itself */
+    if (depth > 0 && JS_AtomIsNumericIndex(ctx, atom) != 0)
+        return NULL;
+    ic->shape_id = p->shape->id;
+    memcpy(ic->proto_shape_id, proto_shape_id,
+           sizeof(proto_shape_id[0]) * depth);
+    ic->prop_index = prs - get_shape_prop(p1->shape);
+    ic->depth = depth;
+    ic->is_getter = (flags & JS_PROP_TMASK) == JS_PROP_GETSET;
+    return p1;
+}
+
+static inline JSValue js_get_field_ic(JSContext *ctx, JSInlineCache *ic,
+                                      JSValueConst obj, JSAtom atom)
+{
+    JSObject *p, *holder;
+    JSProperty *pr;
+
+    if (unlikely(JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT))
+        return __JS_GetPropertyInternal(ctx, obj, atom, obj, FALSE);
+    p = JS_VALUE_GET_OBJ(obj);
+    holder = js_ic_get_holder(ic, p);
+    if (unlikely(!holder)) {
+        holder = js_ic_update(ctx, ic, p, atom, FALSE);
+        if (!holder)
+            return __JS_GetPropertyInternal(ctx, obj, atom, obj, FALSE);
+    }
+    pr = &holder->prop[ic->prop_index];
+    if (unlikely(ic->is_getter)) {
+        JSValue func;
+        /* the getter can be removed without changing the shape */
+        if (!pr->u.getset.getter)
+            return JS_UNDEFINED;
+        func = JS_MKPTR(JS_TAG_OBJECT, pr->u.getset.getter);
+        /* Note: the field could be removed in the getter */
+        return JS_CallFree(ctx, JS_DupValue(ctx, func), obj, 0, NULL);
+    }
+    return JS_DupValue(ctx, pr->u.value);
+}
+
+/* 'val' is freed. return -1 if exception */
+static inline int js_put_field_ic(JSContext *ctx, JSInlineCache *ic,
+                                  JSValueConst obj, JSAtom atom, JSValue val)
+{
+    JSObject *p;
+
+    if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+        p = JS_VALUE_GET_OBJ(obj);
+        if (likely(p->shape->id == ic->shape_id) ||
+            js_ic_update(ctx, ic, p, atom, TRUE)) {
+            gc_write_barrier(ctx->rt, p, val);
+            set_value(ctx, &p->prop[ic->prop_index].u.value, val);
+            return TRUE;
+        }
+    }
+    return JS_SetPropertyInternal(ctx, obj, atom, val, obj,
+                                  JS_PROP_THROW_STRICT);
+}
+
 /* argument of OP_special_object */
 typedef enum {
     OP_SPECIAL_OBJECT_ARGUMENTS,
@@ -16032,6 +17138,53 @@ typedef enum {
 #define FUNC_RET_INITIAL_YIELD 3
 
 /* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0. */
+static inline BOOL js_call_has_rope(JSValueConst this_obj, int argc,
+                                    JSValueConst *argv)
+{
+    int i;
+
+    if (JS_VALUE_GET_TAG(this_obj) == JS_TAG_STRING_ROPE)
+        return TRUE;
+    for(i = 0; i < argc; i++) {
+        if (JS_VALUE_GET_TAG(argv[i]) == JS_TAG_STRING_ROPE)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Native functions and class call hooks never see ropes: call
+   'call_func' with the ropes of 'this_obj' and 'argv' flattened. */
+static no_inline JSValue js_call_flat(JSContext *ctx, JSClassCall *call_func,
+                                      JSValueConst func_obj,
+                                      JSValueConst this_obj,
+                                      int argc, JSValueConst *argv, int flags)
+{
+    JSValue this_flat, *arg_buf, ret;
+    int i;
+
+    if (js_check_stack_overflow(ctx->rt, sizeof(arg_buf[0]) * argc))
+        return JS_ThrowStackOverflow(ctx);
+    arg_buf = alloca(sizeof(arg_buf[0]) * argc);
+    this_flat = js_flatten_string(ctx, this_obj);
+    if (JS_IsException(this_flat))
+        return JS_EXCEPTION;
+    for(i = 0; i < argc; i++) {
+        arg_buf[i] = js_flatten_string(ctx, argv[i]);
+        if (JS_IsException(arg_buf[i])) {
+            argc = i;
+            ret = JS_EXCEPTION;
+            goto done;
+        }
+    }
+    ret = call_func(ctx, func_obj, this_flat, argc, (JSValueConst *)arg_buf,
+                    flags);
+ done:
+    for(i = 0; i < argc; i++)
+        JS_FreeValue(ctx, arg_buf[i]);
+    JS_FreeValue(ctx, this_flat);
+    return ret;
+}
+
 static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                                JSValueConst this_obj, JSValueConst new_target,
                                int argc, JSValue *argv, int flags)
@@ -16105,6 +17258,9 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         not_a_function:
             return JS_ThrowTypeError(caller_ctx, "not a function");
         }
+        if (unlikely(js_call_has_rope(this_obj, argc, (JSValueConst *)argv)))
+            return js_call_flat(caller_ctx, call_func, func_obj, this_obj,
+                                argc, (JSValueConst *)argv, flags);
         return call_func(caller_ctx, func_obj, this_obj, argc,
                          (JSValueConst *)argv, flags);
     }
@@ -16693,7 +17849,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     ret_val = JS_EvalObject(ctx, JS_UNDEFINED, obj,
                                             JS_EVAL_TYPE_DIRECT, scope_idx);
                 } else {
-                    ret_val = JS_Call(ctx, sp[-2], JS_UNDEFINED, len,
+                    ret_val = __JS_Call(ctx, sp[-2], JS_UNDEFINED, len,
                                       (JSValueConst *)tab);
                 }
                 free_arg_list(ctx, tab, len);
@@ -17325,7 +18481,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             /* stack: iter_obj next catch_offset val */
             {
                 JSValue ret;
-                ret = JS_Call(ctx, sp[-3], sp[-4],
+                ret = __JS_Call(ctx, sp[-3], sp[-4],
                               1, (JSValueConst *)(sp - 1));
                 if (JS_IsException(ret))
                     goto exception;
@@ -17389,7 +18545,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 atom = get_u32(pc);
                 pc += 4;
 
-                val = JS_GetProperty(ctx, sp[-1], atom);
+                val = __JS_GetPropertyInternal(ctx, sp[-1], atom, sp[-1], FALSE);
                 if (unlikely(JS_IsException(val)))
                     goto exception;
                 JS_FreeValue(ctx, sp[-1]);
@@ -17404,7 +18560,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 atom = get_u32(pc);
                 pc += 4;
 
-                val = JS_GetProperty(ctx, sp[-1], atom);
+                val = __JS_GetPropertyInternal(ctx, sp[-1], atom, sp[-1], FALSE);
                 if (unlikely(JS_IsException(val)))
                     goto exception;
                 *sp++ = val;
@@ -17427,6 +18583,56 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
 
+        CASE(OP_get_field_ic):
+            {
+                JSValue val;
+                JSAtom atom;
+                JSInlineCache *ic;
+                atom = get_u32(pc);
+                ic = &b->ic[get_u16(pc + 4)];
+                pc += 6;
+
+                val = js_get_field_ic(ctx, ic, sp[-1], atom);
+                if (unlikely(JS_IsException(val)))
+                    goto exception;
+                JS_FreeValue(ctx, sp[-1]);
+                sp[-1] = val;
+            }
+            BREAK;
+
+        CASE(OP_get_field2_ic):
+            {
+                JSValue val;
+                JSAtom atom;
+                JSInlineCache *ic;
+                atom = get_u32(pc);
+                ic = &b->ic[get_u16(pc + 4)];
+                pc += 6;
+
+                val = js_get_field_ic(ctx, ic, sp[-1], atom);
+                if (unlikely(JS_IsException(val)))
+                    goto exception;
+                *sp++ = val;
+            }
+            BREAK;
+
+        CASE(OP_put_field_ic):
+            {
+                int ret;
+                JSAtom atom;
+                JSInlineCache *ic;
+                atom = get_u32(pc);
+                ic = &b->ic[get_u16(pc + 4)];
+                pc += 6;
+
+                ret = js_put_field_ic(ctx, ic, sp[-2], atom, sp[-1]);
+                JS_FreeValue(ctx, sp[-2]);
+                sp -= 2;
+                if (unlikely(ret < 0))
+                    goto exception;
+            }
+            BREAK;
+
         CASE(OP_private_symbol):
             {
                 JSAtom atom;
@@ -17655,7 +18861,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 atom = JS_ValueToAtom(ctx, sp[-1]);
                 if (unlikely(atom == JS_ATOM_NULL))
                     goto exception;
-                val = JS_GetPropertyInternal(ctx, sp[-2], atom, sp[-3], FALSE);
+                val = __JS_GetPropertyInternal(ctx, sp[-2], atom, sp[-3], FALSE);
                 JS_FreeAtom(ctx, atom);
                 if (unlikely(JS_IsException(val)))
                     goto exception;
@@ -17804,7 +19010,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                         goto add_loc_slow;
                     *pv = JS_NewInt32(ctx, r);
                     sp--;
-                } else if (JS_VALUE_GET_TAG(*pv) == JS_TAG_STRING) {
+                } else if (tag_is_string(JS_VALUE_GET_TAG(*pv))) {
                     JSValue op1;
                     op1 = sp[-1];
                     sp--;
@@ -18395,7 +19601,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     }
                     switch (opcode) {
                     case OP_with_get_var:
-                        val = JS_GetProperty(ctx, obj, atom);
+                        val = __JS_GetPropertyInternal(ctx, obj, atom, obj, FALSE);
                         if (unlikely(JS_IsException(val)))
                             goto exception;
                         set_value(ctx, &sp[-1], val);
@@ -18568,13 +19774,21 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
     return ret_val;
 }
 
-JSValue JS_Call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_obj,
-                int argc, JSValueConst *argv)
+/* the result can be a rope */
+static JSValue __JS_Call(JSContext *ctx, JSValueConst func_obj,
+                         JSValueConst this_obj, int argc, JSValueConst *argv)
 {
     return JS_CallInternal(ctx, func_obj, this_obj, JS_UNDEFINED,
                            argc, (JSValue *)argv, JS_CALL_FLAG_COPY_ARGV);
 }
 
+JSValue JS_Call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_obj,
+                int argc, JSValueConst *argv)
+{
+    return js_flatten_string_free(ctx, __JS_Call(ctx, func_obj, this_obj,
+                                                 argc, argv));
+}
+
 static JSValue JS_CallFree(JSContext *ctx, JSValue func_obj, JSValueConst this_obj,
                            int argc, JSValueConst *argv)
 {
@@ -18683,6 +19897,9 @@ static JSValue JS_CallConstructorInternal(JSContext *ctx,
         not_a_function:
             return JS_ThrowTypeError(ctx, "not a function");
         }
+        if (unlikely(js_call_has_rope(new_target, argc, (JSValueConst *)argv)))
+            return js_call_flat(ctx, call_func, func_obj, new_target,
+                                argc, (JSValueConst *)argv, flags);
         return call_func(ctx, func_obj, new_target, argc,
                          (JSValueConst *)argv, flags);
     }
@@ -18732,7 +19949,8 @@ JSValue JS_Invoke(JSContext *ctx, JSValueConst this_val, JSAtom atom,
     func_obj = JS_GetProperty(ctx, this_val, atom);
     if (JS_IsException(func_obj))
         return func_obj;
-    return JS_CallFree(ctx, func_obj, this_val, argc, argv);
+    return js_flatten_string_free(ctx, JS_CallFree(ctx, func_obj, this_val,
+                                                   argc, argv));
 }
 
 static JSValue JS_InvokeFree(JSContext *ctx, JSValue this_val, JSAtom atom,
@@ -18867,6 +20085,8 @@ static void async_func_free(JSRuntime *rt, JSAsyncFunctionState *s)
             if (rt->gc_phase == JS_GC_PHASE_NONE) {
                 free_zero_refcount(rt);
             }
+        } else {
+            gc_free_with_cycles(rt, &s->header);
         }
     }
 }
@@ -19098,13 +20318,13 @@ static void js_async_function_resume(JSContext *ctx, JSAsyncFunctionState *s)
             JSValue error;
         fail:
             error = JS_GetException(ctx);
-            ret2 = JS_Call(ctx, s->resolving_funcs[1], JS_UNDEFINED,
+            ret2 = __JS_Call(ctx, s->resolving_funcs[1], JS_UNDEFINED,
                            1, (JSValueConst *)&error);
             JS_FreeValue(ctx, error);
             JS_FreeValue(ctx, ret2); /* XXX: what to do if exception ? */
         } else {
             /* normal return */
-            ret2 = JS_Call(ctx, s->resolving_funcs[0], JS_UNDEFINED,
+            ret2 = __JS_Call(ctx, s->resolving_funcs[0], JS_UNDEFINED,
                            1, (JSValueConst *)&func_ret);
             JS_FreeValue(ctx, func_ret);
             JS_FreeValue(ctx, ret2); /* XXX: what to do if exception ? */
@@ -19341,7 +20561,7 @@ static void js_async_generator_resolve_or_reject(JSContext *ctx,
 
     next = list_entry(s->queue.next, JSAsyncGeneratorRequest, link);
     list_del(&next->link);
-    ret = JS_Call(ctx, next->resolving_funcs[is_reject], JS_UNDEFINED, 1,
+    ret = __JS_Call(ctx, next->resolving_funcs[is_reject], JS_UNDEFINED, 1,
                   &result);
     JS_FreeValue(ctx, ret);
     JS_FreeValue(ctx, next->result);
@@ -19572,7 +20792,7 @@ static JSValue js_async_generator_next(JSContext *ctx, JSValueConst this_val,
         JSValue err, res2;
         JS_ThrowTypeError(ctx, "not an AsyncGenerator object");
         err = JS_GetException(ctx);
-        res2 = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
+        res2 = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
                        1, (JSValueConst *)&err);
         JS_FreeValue(ctx, err);
         JS_FreeValue(ctx, res2);
@@ -19886,6 +21106,7 @@ typedef struct JSFunctionDef {
     JSGlobalVar *global_vars;
 
     DynBuf byte_code;
+    int ic_count; /* inline cache slots used by the final byte code */
     int last_opcode_pos; /* -1 if no last opcode */
     int last_opcode_line_num;
     BOOL use_short_opcodes; /* true if short opcodes are used in byte_code */
@@ -28219,7 +29440,7 @@ static int js_inner_module_linking(JSContext *ctx, JSModuleDef *m,
         }
 
         /* initialize the global variables */
-        ret_val = JS_Call(ctx, m->func_obj, JS_TRUE, 0, NULL);
+        ret_val = __JS_Call(ctx, m->func_obj, JS_TRUE, 0, NULL);
         if (JS_IsException(ret_val))
             goto fail;
         JS_FreeValue(ctx, ret_val);
@@ -28372,7 +29593,7 @@ static JSValue js_load_module_rejected(JSContext *ctx, JSValueConst this_val,
         error = argv[0];
     else
         error = JS_UNDEFINED;
-    ret = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
+    ret = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
                   1, &error);
     JS_FreeValue(ctx, ret);
     return JS_UNDEFINED;
@@ -28392,7 +29613,7 @@ static JSValue js_load_module_fulfilled(JSContext *ctx, JSValueConst this_val,
         js_load_module_rejected(ctx, JS_UNDEFINED, 1, (JSValueConst *)&err, 0, func_data);
         return JS_UNDEFINED;
     }
-    ret = JS_Call(ctx, resolving_funcs[0], JS_UNDEFINED,
+    ret = __JS_Call(ctx, resolving_funcs[0], JS_UNDEFINED,
                    1, (JSValueConst *)&ns);
     JS_FreeValue(ctx, ret);
     JS_FreeValue(ctx, ns);
@@ -28423,7 +29644,7 @@ static void JS_LoadModuleInternal(JSContext *ctx, const char *basename,
     if (JS_IsException(evaluate_promise)) {
     fail:
         err = JS_GetException(ctx);
-        ret = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
+        ret = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
                       1, (JSValueConst *)&err);
         JS_FreeValue(ctx, ret); /* XXX: what to do if exception ? */
         JS_FreeValue(ctx, err);
@@ -28470,7 +29691,7 @@ static JSValue js_dynamic_import_job(JSContext *ctx,
     const char *basename = NULL, *filename;
     JSValue ret, err;
 
-    if (!JS_IsString(basename_val)) {
+    if (!tag_is_string(JS_VALUE_GET_TAG(basename_val))) {
         JS_ThrowTypeError(ctx, "no function filename for import()");
         goto exception;
     }
@@ -28489,7 +29710,7 @@ static JSValue js_dynamic_import_job(JSContext *ctx,
     return JS_UNDEFINED;
  exception:
     err = JS_GetException(ctx);
-    ret = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
+    ret = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED,
                    1, (JSValueConst *)&err);
     JS_FreeValue(ctx, ret); /* XXX: what to do if exception ? */
     JS_FreeValue(ctx, err);
@@ -28540,7 +29761,7 @@ static void js_set_module_evaluated(JSContext *ctx, JSModuleDef *m)
         JSValue value, ret_val;
         assert(m->cycle_root == m);
         value = JS_UNDEFINED;
-        ret_val = JS_Call(ctx, m->resolving_funcs[0], JS_UNDEFINED,
+        ret_val = __JS_Call(ctx, m->resolving_funcs[0], JS_UNDEFINED,
                           1, (JSValueConst *)&value);
         JS_FreeValue(ctx, ret_val);
     }
@@ -28642,7 +29863,7 @@ static JSValue js_async_module_execution_rejected(JSContext *ctx, JSValueConst t
     if (!JS_IsUndefined(module->promise)) {
         JSValue ret_val;
         assert(module->cycle_root == module);
-        ret_val = JS_Call(ctx, module->resolving_funcs[1], JS_UNDEFINED,
+        ret_val = __JS_Call(ctx, module->resolving_funcs[1], JS_UNDEFINED,
                           1, &error);
         JS_FreeValue(ctx, ret_val);
     }
@@ -28906,7 +30127,7 @@ static JSValue js_evaluate_module(JSContext *ctx, JSModuleDef *m)
         JS_FreeValue(ctx, result);
         assert(m->status == JS_MODULE_STATUS_EVALUATED);
         assert(m->eval_has_exception);
-        ret_val = JS_Call(ctx, m->resolving_funcs[1], JS_UNDEFINED,
+        ret_val = __JS_Call(ctx, m->resolving_funcs[1], JS_UNDEFINED,
                           1, (JSValueConst *)&m->eval_exception);
         JS_FreeValue(ctx, ret_val);
     } else {
@@ -28917,7 +30138,7 @@ static JSValue js_evaluate_module(JSContext *ctx, JSModuleDef *m)
             JSValue value;
             assert(m->status == JS_MODULE_STATUS_EVALUATED);
             value = JS_UNDEFINED;
-            ret_val = JS_Call(ctx, m->resolving_funcs[0], JS_UNDEFINED,
+            ret_val = __JS_Call(ctx, m->resolving_funcs[0], JS_UNDEFINED,
                               1, (JSValueConst *)&value);
             JS_FreeValue(ctx, ret_val);
         }
@@ -31950,6 +33171,21 @@ static void put_short_code(DynBuf *bc_out, int op, int idx)
     dbuf_put_u16(bc_out, idx);
 }
 
+/* emit get_field, get_field2 or put_field with its own inline cache
+   slot, or uncached once the function has used all the slots */
+static void put_field_code(JSFunctionDef *s, DynBuf *bc_out, int op,
+                           JSAtom atom)
+{
+    if (s->ic_count < JS_IC_MAX_COUNT) {
+        dbuf_putc(bc_out, op - OP_get_field + OP_get_field_ic);
+        dbuf_put_u32(bc_out, atom);
+        dbuf_put_u16(bc_out, s->ic_count++);
+    } else {
+        dbuf_putc(bc_out, op);
+        dbuf_put_u32(bc_out, atom);
+    }
+}
+
 /* peephole optimizations and resolve goto/labels */
 static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
 {
@@ -32205,6 +33441,11 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
 
             if (ls->addr == -1) {
                 int diff = ls->pos2 - pos - 1;
+                /* the inline cache opcodes are 2 bytes longer than the 5
+                   byte field opcodes they replace, so the code up to the
+                   label can grow by 2/5. The jumps are shrunk again
+                   below once the addresses are known. */
+                diff += (diff * 2 + 4) / 5;
                 if (diff < 128 && (op == OP_if_false || op == OP_if_true || op == OP_goto)) {
                     jp->size = 1;
                     jp->op = OP_if_false8 + (op - OP_if_false);
@@ -32405,7 +33646,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     break;
                 }
             }
-            goto no_change;
+            goto field_code;
 #endif
         case OP_push_atom_value:
             if (OPTIMIZE) {
@@ -32493,8 +33734,12 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                 if (code_match(&cc, pos_next, M2(OP_put_field, OP_put_var_strict), OP_drop, -1)) {
                     if (cc.line_num >= 0) line_num = cc.line_num;
                     add_pc2line_info(s, bc_out.size, line_num);
-                    dbuf_putc(&bc_out, cc.op);
-                    dbuf_put_u32(&bc_out, cc.atom);
+                    if (cc.op == OP_put_field) {
+                        put_field_code(s, &bc_out, cc.op, cc.atom);
+                    } else {
+                        dbuf_putc(&bc_out, cc.op);
+                        dbuf_put_u32(&bc_out, cc.atom);
+                    }
                     pos_next = cc.pos;
                     break;
                 }
@@ -32662,8 +33907,12 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     if (cc.line_num >= 0) line_num = cc.line_num;
                     add_pc2line_info(s, bc_out.size, line_num);
                     dbuf_putc(&bc_out, OP_dec + (op - OP_post_dec));
-                    dbuf_putc(&bc_out, cc.op);
-                    dbuf_put_u32(&bc_out, cc.atom);
+                    if (cc.op == OP_put_field) {
+                        put_field_code(s, &bc_out, cc.op, cc.atom);
+                    } else {
+                        dbuf_putc(&bc_out, cc.op);
+                        dbuf_put_u32(&bc_out, cc.atom);
+                    }
                     pos_next = cc.pos;
                     break;
                 }
@@ -32720,6 +33969,16 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
             goto no_change;
 #endif
 
+#if !SHORT_OPCODES
+        case OP_get_field:
+#endif
+        case OP_get_field2:
+        case OP_put_field:
+        field_code:
+            add_pc2line_info(s, bc_out.size, line_num);
+            put_field_code(s, &bc_out, op, get_u32(bc_buf + pos + 1));
+            break;
+
         default:
         no_change:
             add_pc2line_info(s, bc_out.size, line_num);
@@ -33129,6 +34388,7 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
 {
     JSValue func_obj;
     JSFunctionBytecode *b;
+    JSInlineCache *ic;
     struct list_head *el, *el1;
     int stack_size, scope, idx;
     int function_size, byte_code_offset, cpool_offset;
@@ -33237,10 +34497,20 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
     byte_code_offset = function_size;
     function_size += fd->byte_code.size;
 
+    ic = NULL;
+    if (fd->ic_count) {
+        ic = js_mallocz(ctx, sizeof(*ic) * fd->ic_count);
+        if (!ic)
+            goto fail;
+    }
     b = js_mallocz(ctx, function_size);
-    if (!b)
+    if (!b) {
+        js_free(ctx, ic);
         goto fail;
+    }
     b->header.ref_count = 1;
+    b->ic = ic;
+    b->ic_count = fd->ic_count;
 
     b->byte_code_buf = (void *)((uint8_t*)b + byte_code_offset);
     b->byte_code_len = fd->byte_code.size;
@@ -33379,6 +34649,7 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
     }
     if (b->realm)
         JS_FreeContext(b->realm);
+    js_free_rt(rt, b->ic);
 
     JS_FreeAtomRT(rt, b->func_name);
     if (b->has_debug) {
@@ -34232,7 +35503,8 @@ static JSValue JS_EvalFunctionInternal(JSContext *ctx, JSValue fun_obj,
 
 JSValue JS_EvalFunction(JSContext *ctx, JSValue fun_obj)
 {
-    return JS_EvalFunctionInternal(ctx, fun_obj, ctx->global_obj, NULL, NULL);
+    return js_flatten_string_free(ctx, JS_EvalFunctionInternal(ctx, fun_obj, ctx->global_obj,
+                                                               NULL, NULL));
 }
 
 /* 'input' must be zero terminated i.e. input[input_len] = '\0'. */
@@ -34372,7 +35644,7 @@ static JSValue JS_EvalObject(JSContext *ctx, JSValueConst this_obj,
     const char *str;
     size_t len;
 
-    if (!JS_IsString(val))
+    if (!tag_is_string(JS_VALUE_GET_TAG(val)))
         return JS_DupValue(ctx, val);
     str = JS_ToCStringLen(ctx, &len, val);
     if (!str)
@@ -34394,7 +35666,7 @@ JSValue JS_EvalThis(JSContext *ctx, JSValueConst this_obj,
            eval_type == JS_EVAL_TYPE_MODULE);
     ret = JS_EvalInternal(ctx, this_obj, input, input_len, filename,
                           eval_flags, -1);
-    return ret;
+    return js_flatten_string_free(ctx, ret);
 }
 
 JSValue JS_Eval(JSContext *ctx, const char *input, size_t input_len,
@@ -35260,6 +36532,15 @@ static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj)
             JS_WriteString(s, p);
         }
         break;
+    case JS_TAG_STRING_ROPE:
+        {
+            JSString *p = js_string_rope_flatten(s->ctx, JS_VALUE_GET_PTR(obj));
+            if (!p)
+                goto fail;
+            bc_put_u8(s, BC_TAG_STRING);
+            JS_WriteString(s, p);
+        }
+        break;
     case JS_TAG_FUNCTION_BYTECODE:
         if (!s->allow_bytecode)
             goto invalid_tag;
@@ -35733,6 +37014,9 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
         default:
             break;
         }
+        if (op >= OP_get_field_ic && op <= OP_put_field_ic) {
+            b->ic_count = max_int(b->ic_count, get_u16(bc_buf + pos + 5) + 1);
+        }
         pos += len;
     }
     return 0;
@@ -36043,6 +37327,11 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s)
             goto fail;
         bc_read_trace(s, "}\n");
     }
+    if (b->ic_count) {
+        b->ic = js_mallocz(ctx, sizeof(*b->ic) * b->ic_count);
+        if (!b->ic)
+            goto fail;
+    }
     if (b->has_debug) {
         /* read optional debug information */
         bc_read_trace(s, "debug {\n");
@@ -36953,6 +38242,13 @@ static JSValue JS_ToObject(JSContext *ctx, JSValueConst val)
     case JS_TAG_FLOAT64:
         obj = JS_NewObjectClass(ctx, JS_CLASS_NUMBER);
         goto set_value;
+    case JS_TAG_STRING_ROPE:
+        val = js_flatten_string(ctx, val);
+        if (JS_IsException(val))
+            return val;
+        obj = JS_ToObject(ctx, val);
+        JS_FreeValue(ctx, val);
+        return obj;
     case JS_TAG_STRING:
         /* XXX: should call the string constructor */
         {
@@ -37639,7 +38935,7 @@ static JSValue js_object_toString(JSContext *ctx, JSValueConst this_val,
         JS_FreeValue(ctx, obj);
         if (JS_IsException(tag))
             return JS_EXCEPTION;
-        if (!JS_IsString(tag)) {
+        if (!tag_is_string(JS_VALUE_GET_TAG(tag))) {
             JS_FreeValue(ctx, tag);
             tag = JS_AtomToString(ctx, atom);
         }
@@ -38346,7 +39642,7 @@ static JSValue js_function_apply(JSContext *ctx, JSValueConst this_val,
     array_arg = argv[1];
     if ((JS_VALUE_GET_TAG(array_arg) == JS_TAG_UNDEFINED ||
          JS_VALUE_GET_TAG(array_arg) == JS_TAG_NULL) && magic != 2) {
-        return JS_Call(ctx, this_val, this_arg, 0, NULL);
+        return __JS_Call(ctx, this_val, this_arg, 0, NULL);
     }
     tab = build_arg_list(ctx, &len, array_arg);
     if (!tab)
@@ -38354,7 +39650,7 @@ static JSValue js_function_apply(JSContext *ctx, JSValueConst this_val,
     if (magic & 1) {
         ret = JS_CallConstructor2(ctx, this_val, this_arg, len, (JSValueConst *)tab);
     } else {
-        ret = JS_Call(ctx, this_val, this_arg, len, (JSValueConst *)tab);
+        ret = __JS_Call(ctx, this_val, this_arg, len, (JSValueConst *)tab);
     }
     free_arg_list(ctx, tab, len);
     return ret;
@@ -38364,9 +39660,9 @@ static JSValue js_function_call(JSContext *ctx, JSValueConst this_val,
                                 int argc, JSValueConst *argv)
 {
     if (argc <= 0) {
-        return JS_Call(ctx, this_val, JS_UNDEFINED, 0, NULL);
+        return __JS_Call(ctx, this_val, JS_UNDEFINED, 0, NULL);
     } else {
-        return JS_Call(ctx, this_val, argv[0], argc - 1, argv + 1);
+        return __JS_Call(ctx, this_val, argv[0], argc - 1, argv + 1);
     }
 }
 
@@ -38440,7 +39736,7 @@ static JSValue js_function_bind(JSContext *ctx, JSValueConst this_val,
     name1 = JS_GetProperty(ctx, this_val, JS_ATOM_name);
     if (JS_IsException(name1))
         goto exception;
-    if (!JS_IsString(name1)) {
+    if (!tag_is_string(JS_VALUE_GET_TAG(name1))) {
         JS_FreeValue(ctx, name1);
         name1 = JS_AtomToString(ctx, JS_ATOM_empty_string);
     }
@@ -38838,7 +40134,7 @@ static JSValue js_array_from(JSContext *ctx, JSValueConst this_val,
             if (mapping) {
                 args[0] = v;
                 args[1] = JS_NewInt32(ctx, k);
-                v2 = JS_Call(ctx, mapfn, this_arg, 2, args);
+                v2 = __JS_Call(ctx, mapfn, this_arg, 2, args);
                 JS_FreeValue(ctx, v);
                 v = v2;
                 if (JS_IsException(v))
@@ -38871,7 +40167,7 @@ static JSValue js_array_from(JSContext *ctx, JSValueConst this_val,
             if (mapping) {
                 args[0] = v;
                 args[1] = JS_NewInt32(ctx, k);
-                v2 = JS_Call(ctx, mapfn, this_arg, 2, args);
+                v2 = __JS_Call(ctx, mapfn, this_arg, 2, args);
                 JS_FreeValue(ctx, v);
                 v = v2;
                 if (JS_IsException(v))
@@ -39272,7 +40568,7 @@ static JSValue js_array_every(JSContext *ctx, JSValueConst this_val,
             args[0] = val;
             args[1] = index_val;
             args[2] = obj;
-            res = JS_Call(ctx, func, this_arg, 3, args);
+            res = __JS_Call(ctx, func, this_arg, 3, args);
             JS_FreeValue(ctx, index_val);
             if (JS_IsException(res))
                 goto exception;
@@ -39416,7 +40712,7 @@ static JSValue js_array_reduce(JSContext *ctx, JSValueConst this_val,
             args[1] = val;
             args[2] = index_val;
             args[3] = obj;
-            acc1 = JS_Call(ctx, func, JS_UNDEFINED, 4, args);
+            acc1 = __JS_Call(ctx, func, JS_UNDEFINED, 4, args);
             JS_FreeValue(ctx, index_val);
             JS_FreeValue(ctx, val);
             val = JS_UNDEFINED;
@@ -39660,7 +40956,7 @@ static JSValue js_array_find(JSContext *ctx, JSValueConst this_val,
         args[0] = val;
         args[1] = index_val;
         args[2] = this_val;
-        res = JS_Call(ctx, func, this_arg, 3, args);
+        res = __JS_Call(ctx, func, this_arg, 3, args);
         if (JS_IsException(res))
             goto exception;
         if (JS_ToBoolFree(ctx, res)) {
@@ -40235,7 +41531,7 @@ static int64_t JS_FlattenIntoArray(JSContext *ctx, JSValueConst target,
             continue;
         if (!JS_IsUndefined(mapperFunction)) {
             JSValueConst args[3] = { element, JS_NewInt64(ctx, sourceIndex), source };
-            element = JS_Call(ctx, mapperFunction, thisArg, 3, args);
+            element = __JS_Call(ctx, mapperFunction, thisArg, 3, args);
             JS_FreeValue(ctx, (JSValue)args[0]);
             JS_FreeValue(ctx, (JSValue)args[1]);
             if (JS_IsException(element))
@@ -40353,7 +41649,7 @@ static int js_array_cmp_generic(const void *a, const void *b, void *opaque) {
             goto cmp_same;
         argv[0] = ap->val;
         argv[1] = bp->val;
-        res = JS_Call(ctx, psc->method, JS_UNDEFINED, 2, argv);
+        res = __JS_Call(ctx, psc->method, JS_UNDEFINED, 2, argv);
         if (JS_IsException(res))
             goto exception;
         if (JS_VALUE_GET_TAG(res) == JS_TAG_INT) {
@@ -41230,6 +42526,8 @@ static JSValue js_thisStringValue(JSContext *ctx, JSValueConst this_val)
 {
     if (JS_VALUE_GET_TAG(this_val) == JS_TAG_STRING)
         return JS_DupValue(ctx, this_val);
+    if (JS_VALUE_GET_TAG(this_val) == JS_TAG_STRING_ROPE)
+        return js_flatten_string(ctx, this_val);
 
     if (JS_VALUE_GET_TAG(this_val) == JS_TAG_OBJECT) {
         JSObject *p = JS_VALUE_GET_OBJ(this_val);
@@ -41840,7 +43138,9 @@ static JSValue js_string___GetSubstitution(JSContext *ctx, JSValueConst this_val
     namedCaptures = argv[4];
     rep = argv[5];
 
-    if (!JS_IsString(rep) || !JS_IsString(str))
+    /* flat strings from JS_ToString() */
+    if (JS_VALUE_GET_TAG(rep) != JS_TAG_STRING ||
+        JS_VALUE_GET_TAG(str) != JS_TAG_STRING)
         return JS_ThrowTypeError(ctx, "not a string");
 
     sp = JS_VALUE_GET_STRING(str);
@@ -42009,7 +43309,7 @@ static JSValue js_string_replace(JSContext *ctx, JSValueConst this_val,
             args[0] = search_str;
             args[1] = JS_NewInt32(ctx, pos);
             args[2] = str;
-            repl_str = JS_ToStringFree(ctx, JS_Call(ctx, replaceValue, JS_UNDEFINED, 3, args));
+            repl_str = JS_ToStringFree(ctx, __JS_Call(ctx, replaceValue, JS_UNDEFINED, 3, args));
         } else {
             args[0] = search_str;
             args[1] = str;
@@ -45041,7 +46341,7 @@ static JSValue internalize_json_property(JSContext *ctx, JSValueConst holder,
         goto fail;
     args[0] = name_val;
     args[1] = val;
-    res = JS_Call(ctx, reviver, holder, 2, args);
+    res = __JS_Call(ctx, reviver, holder, 2, args);
     JS_FreeValue(ctx, name_val);
     JS_FreeValue(ctx, val);
     return res;
@@ -45126,7 +46426,7 @@ static JSValue js_json_check(JSContext *ctx, JSONStringifyContext *jsc,
     if (!JS_IsUndefined(jsc->replacer_func)) {
         args[0] = key;
         args[1] = val;
-        v = JS_Call(ctx, jsc->replacer_func, holder, 2, args);
+        v = __JS_Call(ctx, jsc->replacer_func, holder, 2, args);
         JS_FreeValue(ctx, val);
         val = v;
         if (JS_IsException(val))
@@ -45138,6 +46438,7 @@ static JSValue js_json_check(JSContext *ctx, JSONStringifyContext *jsc,
         if (JS_IsFunction(ctx, val))
             break;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
     case JS_TAG_INT:
     case JS_TAG_FLOAT64:
 #ifdef CONFIG_BIGNUM
@@ -45318,6 +46619,7 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
         JS_FreeValue(ctx, prop);
         return 0;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         val = JS_ToQuotedStringFree(ctx, val);
         if (JS_IsException(val))
             goto exception;
@@ -45408,7 +46710,7 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
                     v = JS_ToStringFree(ctx, v);
                     if (JS_IsException(v))
                         goto exception;
-                } else if (!JS_IsString(v)) {
+                } else if (!tag_is_string(JS_VALUE_GET_TAG(v))) {
                     JS_FreeValue(ctx, v);
                     continue;
                 }
@@ -45426,7 +46728,9 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
             }
         }
     }
-    space = JS_DupValue(ctx, space0);
+    space = js_flatten_string_free(ctx, JS_DupValue(ctx, space0));
+    if (JS_IsException(space))
+        goto exception;
     if (JS_IsObject(space)) {
         JSObject *p = JS_VALUE_GET_OBJ(space);
         if (p->class_id == JS_CLASS_NUMBER) {
@@ -45581,7 +46885,7 @@ static JSValue js_reflect_get(JSContext *ctx, JSValueConst this_val,
     atom = JS_ValueToAtom(ctx, prop);
     if (unlikely(atom == JS_ATOM_NULL))
         return JS_EXCEPTION;
-    ret = JS_GetPropertyInternal(ctx, obj, atom, receiver, FALSE);
+    ret = __JS_GetPropertyInternal(ctx, obj, atom, receiver, FALSE);
     JS_FreeAtom(ctx, atom);
     return ret;
 }
@@ -45929,7 +47233,7 @@ static JSValue js_proxy_get(JSContext *ctx, JSValueConst obj, JSAtom atom,
         return JS_EXCEPTION;
     /* Note: recursion is possible thru the prototype of s->target */
     if (JS_IsUndefined(method))
-        return JS_GetPropertyInternal(ctx, s->target, atom, receiver, FALSE);
+        return __JS_GetPropertyInternal(ctx, s->target, atom, receiver, FALSE);
     atom_val = JS_AtomToValue(ctx, atom);
     if (JS_IsException(atom_val)) {
         JS_FreeValue(ctx, method);
@@ -46357,7 +47661,7 @@ static int js_proxy_get_own_property_names(JSContext *ctx,
         val = JS_GetPropertyUint32(ctx, prop_array, i);
         if (JS_IsException(val))
             goto fail;
-        if (!JS_IsString(val) && !JS_IsSymbol(val)) {
+        if (!tag_is_string(JS_VALUE_GET_TAG(val)) && !JS_IsSymbol(val)) {
             JS_FreeValue(ctx, val);
             JS_ThrowTypeError(ctx, "proxy: properties must be strings or symbols");
             goto fail;
@@ -46459,7 +47763,7 @@ static JSValue js_proxy_call_constructor(JSContext *ctx, JSValueConst func_obj,
     args[0] = s->target;
     args[1] = arg_array;
     args[2] = new_target;
-    ret = JS_Call(ctx, method, s->handler, 3, args);
+    ret = __JS_Call(ctx, method, s->handler, 3, args);
     if (!JS_IsException(ret) && JS_VALUE_GET_TAG(ret) != JS_TAG_OBJECT) {
         JS_FreeValue(ctx, ret);
         ret = JS_ThrowTypeErrorNotAnObject(ctx);
@@ -46489,7 +47793,7 @@ static JSValue js_proxy_call(JSContext *ctx, JSValueConst func_obj,
         return JS_ThrowTypeError(ctx, "not a function");
     }
     if (JS_IsUndefined(method))
-        return JS_Call(ctx, s->target, this_obj, argc, argv);
+        return __JS_Call(ctx, s->target, this_obj, argc, argv);
     arg_array = js_create_array(ctx, argc, argv);
     if (JS_IsException(arg_array)) {
         ret = JS_EXCEPTION;
@@ -46498,7 +47802,7 @@ static JSValue js_proxy_call(JSContext *ctx, JSValueConst func_obj,
     args[0] = s->target;
     args[1] = this_obj;
     args[2] = arg_array;
-    ret = JS_Call(ctx, method, s->handler, 3, args);
+    ret = __JS_Call(ctx, method, s->handler, 3, args);
  fail:
     JS_FreeValue(ctx, method);
     JS_FreeValue(ctx, arg_array);
@@ -46829,7 +48133,7 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
                 break;
             }
             if (is_set) {
-                ret = JS_Call(ctx, adder, obj, 1, (JSValueConst *)&item);
+                ret = __JS_Call(ctx, adder, obj, 1, (JSValueConst *)&item);
                 if (JS_IsException(ret)) {
                     JS_FreeValue(ctx, item);
                     goto fail;
@@ -46851,7 +48155,7 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
                     goto fail1;
                 args[0] = key;
                 args[1] = value;
-                ret = JS_Call(ctx, adder, obj, 2, args);
+                ret = __JS_Call(ctx, adder, obj, 2, args);
                 if (JS_IsException(ret)) {
                 fail1:
                     JS_FreeValue(ctx, item);
@@ -46883,12 +48187,19 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
 }
 
 /* XXX: could normalize strings to speed up comparison */
+/* return JS_EXCEPTION if a rope cannot be flattened */
 static JSValueConst map_normalize_key(JSContext *ctx, JSValueConst key)
 {
     uint32_t tag = JS_VALUE_GET_TAG(key);
     /* convert -0.0 to +0.0 */
     if (JS_TAG_IS_FLOAT64(tag) && JS_VALUE_GET_FLOAT64(key) == 0.0) {
         key = JS_NewInt32(ctx, 0);
+    } else if (tag == JS_TAG_STRING_ROPE) {
+        /* the flat string is kept alive by the rope */
+        JSString *p = js_string_rope_flatten(ctx, JS_VALUE_GET_PTR(key));
+        if (!p)
+            return JS_EXCEPTION;
+        key = JS_MKPTR(JS_TAG_STRING, p);
     }
     return key;
 }
@@ -47101,6 +48412,8 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
+    if (JS_IsException(key))
+        return JS_EXCEPTION;
     if (s->is_weak && !JS_IsObject(key))
         return JS_ThrowTypeErrorNotAnObject(ctx);
     if (magic & MAGIC_SET)
@@ -47129,6 +48442,8 @@ static JSValue js_map_get(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
+    if (JS_IsException(key))
+        return JS_EXCEPTION;
     mr = map_find_record(ctx, s, key);
     if (!mr)
         return JS_UNDEFINED;
@@ -47146,6 +48461,8 @@ static JSValue js_map_has(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
+    if (JS_IsException(key))
+        return JS_EXCEPTION;
     mr = map_find_record(ctx, s, key);
     return JS_NewBool(ctx, (mr != NULL));
 }
@@ -47160,6 +48477,8 @@ static JSValue js_map_delete(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
+    if (JS_IsException(key))
+        return JS_EXCEPTION;
     mr = map_find_record(ctx, s, key);
     if (!mr)
         return JS_FALSE;
@@ -47223,7 +48542,7 @@ static JSValue js_map_forEach(JSContext *ctx, JSValueConst this_val,
             else
                 args[0] = JS_DupValue(ctx, mr->value);
             args[2] = (JSValue)this_val;
-            ret = JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
+            ret = __JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
             JS_FreeValue(ctx, args[0]);
             if (!magic)
                 JS_FreeValue(ctx, args[1]);
@@ -47288,7 +48607,7 @@ static JSValue js_object_groupBy(JSContext *ctx, JSValueConst this_val,
 
         args[0] = v;
         args[1] = JS_NewInt64(ctx, idx);
-        key = JS_Call(ctx, cb, ctx->global_obj, 2, args);
+        key = __JS_Call(ctx, cb, ctx->global_obj, 2, args);
         if (JS_IsException(key))
             goto iterator_close_exception;
 
@@ -47731,7 +49050,7 @@ static JSValue promise_reaction_job(JSContext *ctx, int argc,
             res = JS_DupValue(ctx, arg);
         }
     } else {
-        res = JS_Call(ctx, handler, JS_UNDEFINED, 1, &arg);
+        res = __JS_Call(ctx, handler, JS_UNDEFINED, 1, &arg);
     }
     is_reject = JS_IsException(res);
     if (is_reject)
@@ -47741,7 +49060,7 @@ static JSValue promise_reaction_job(JSContext *ctx, int argc,
        creating a dummy promise in the 'await' implementation of async
        functions */
     if (!JS_IsUndefined(func)) {
-        res2 = JS_Call(ctx, func, JS_UNDEFINED,
+        res2 = __JS_Call(ctx, func, JS_UNDEFINED,
                        1, (JSValueConst *)&res);
     } else {
         res2 = JS_UNDEFINED;
@@ -47822,10 +49141,10 @@ static JSValue js_promise_resolve_thenable_job(JSContext *ctx,
     then = argv[2];
     if (js_create_resolving_functions(ctx, args, promise) < 0)
         return JS_EXCEPTION;
-    res = JS_Call(ctx, then, thenable, 2, (JSValueConst *)args);
+    res = __JS_Call(ctx, then, thenable, 2, (JSValueConst *)args);
     if (JS_IsException(res)) {
         JSValue error = JS_GetException(ctx);
-        res = JS_Call(ctx, args[1], JS_UNDEFINED, 1, (JSValueConst *)&error);
+        res = __JS_Call(ctx, args[1], JS_UNDEFINED, 1, (JSValueConst *)&error);
         JS_FreeValue(ctx, error);
     }
     JS_FreeValue(ctx, args[0]);
@@ -48021,11 +49340,11 @@ static JSValue js_promise_constructor(JSContext *ctx, JSValueConst new_target,
     JS_SetOpaque(obj, s);
     if (js_create_resolving_functions(ctx, args, obj))
         goto fail;
-    ret = JS_Call(ctx, executor, JS_UNDEFINED, 2, (JSValueConst *)args);
+    ret = __JS_Call(ctx, executor, JS_UNDEFINED, 2, (JSValueConst *)args);
     if (JS_IsException(ret)) {
         JSValue ret2, error;
         error = JS_GetException(ctx);
-        ret2 = JS_Call(ctx, args[1], JS_UNDEFINED, 1, (JSValueConst *)&error);
+        ret2 = __JS_Call(ctx, args[1], JS_UNDEFINED, 1, (JSValueConst *)&error);
         JS_FreeValue(ctx, error);
         if (JS_IsException(ret2))
             goto fail1;
@@ -48131,7 +49450,7 @@ static JSValue js_promise_resolve(JSContext *ctx, JSValueConst this_val,
     result_promise = js_new_promise_capability(ctx, resolving_funcs, this_val);
     if (JS_IsException(result_promise))
         return result_promise;
-    ret = JS_Call(ctx, resolving_funcs[is_reject], JS_UNDEFINED, 1, argv);
+    ret = __JS_Call(ctx, resolving_funcs[is_reject], JS_UNDEFINED, 1, argv);
     JS_FreeValue(ctx, resolving_funcs[0]);
     JS_FreeValue(ctx, resolving_funcs[1]);
     if (JS_IsException(ret)) {
@@ -48246,10 +49565,10 @@ static JSValue js_promise_all_resolve_element(JSContext *ctx,
             error = js_aggregate_error_constructor(ctx, values);
             if (JS_IsException(error))
                 return JS_EXCEPTION;
-            ret = JS_Call(ctx, resolve, JS_UNDEFINED, 1, (JSValueConst *)&error);
+            ret = __JS_Call(ctx, resolve, JS_UNDEFINED, 1, (JSValueConst *)&error);
             JS_FreeValue(ctx, error);
         } else {
-            ret = JS_Call(ctx, resolve, JS_UNDEFINED, 1, (JSValueConst *)&values);
+            ret = __JS_Call(ctx, resolve, JS_UNDEFINED, 1, (JSValueConst *)&values);
         }
         if (JS_IsException(ret))
             return ret;
@@ -48284,7 +49603,7 @@ static JSValue js_promise_all(JSContext *ctx, JSValueConst this_val,
         JSValue error;
     fail_reject:
         error = JS_GetException(ctx);
-        ret = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED, 1,
+        ret = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED, 1,
                        (JSValueConst *)&error);
         JS_FreeValue(ctx, error);
         if (JS_IsException(ret))
@@ -48315,7 +49634,7 @@ static JSValue js_promise_all(JSContext *ctx, JSValueConst this_val,
                 goto fail_reject;
             if (done)
                 break;
-            next_promise = JS_Call(ctx, promise_resolve, 
+            next_promise = __JS_Call(ctx, promise_resolve, 
                                    this_val, 1, (JSValueConst *)&item);
             JS_FreeValue(ctx, item);
             if (JS_IsException(next_promise)) {
@@ -48383,7 +49702,7 @@ static JSValue js_promise_all(JSContext *ctx, JSValueConst this_val,
                 JS_FreeValue(ctx, values);
                 values = error;
             }
-            ret = JS_Call(ctx, resolving_funcs[is_promise_any], JS_UNDEFINED,
+            ret = __JS_Call(ctx, resolving_funcs[is_promise_any], JS_UNDEFINED,
                           1, (JSValueConst *)&values);
             if (check_exception_free(ctx, ret))
                 goto fail_reject;
@@ -48426,7 +49745,7 @@ static JSValue js_promise_race(JSContext *ctx, JSValueConst this_val,
         JSValue error;
     fail_reject:
         error = JS_GetException(ctx);
-        ret = JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED, 1,
+        ret = __JS_Call(ctx, resolving_funcs[1], JS_UNDEFINED, 1,
                        (JSValueConst *)&error);
         JS_FreeValue(ctx, error);
         if (JS_IsException(ret))
@@ -48445,7 +49764,7 @@ static JSValue js_promise_race(JSContext *ctx, JSValueConst this_val,
                 goto fail_reject;
             if (done)
                 break;
-            next_promise = JS_Call(ctx, promise_resolve,
+            next_promise = __JS_Call(ctx, promise_resolve,
                                    this_val, 1, (JSValueConst *)&item);
             JS_FreeValue(ctx, item);
             if (JS_IsException(next_promise)) {
@@ -48588,7 +49907,7 @@ static JSValue js_promise_then_finally_func(JSContext *ctx, JSValueConst this_va
     JSValueConst onFinally = func_data[1];
     JSValue res, promise, ret, then_func;
 
-    res = JS_Call(ctx, onFinally, JS_UNDEFINED, 0, NULL);
+    res = __JS_Call(ctx, onFinally, JS_UNDEFINED, 0, NULL);
     if (JS_IsException(res))
         return res;
     promise = js_promise_resolve(ctx, ctor, 1, (JSValueConst *)&res, 0);
@@ -48805,7 +50124,7 @@ static JSValue js_async_from_sync_iterator_next(JSContext *ctx, JSValueConst thi
         err = JS_GetException(ctx);
         is_reject = 1;
     done_resolve:
-        res2 = JS_Call(ctx, resolving_funcs[is_reject], JS_UNDEFINED,
+        res2 = __JS_Call(ctx, resolving_funcs[is_reject], JS_UNDEFINED,
                        1, (JSValueConst *)&err);
         JS_FreeValue(ctx, err);
         JS_FreeValue(ctx, res2);
@@ -49633,7 +50952,7 @@ static JSValue js_date_constructor(JSContext *ctx, JSValueConst new_target,
             }
         }
         v = JS_ToPrimitive(ctx, argv[0], HINT_NONE);
-        if (JS_IsString(v)) {
+        if (tag_is_string(JS_VALUE_GET_TAG(v))) {
             dv = js_Date_parse(ctx, JS_UNDEFINED, 1, (JSValueConst *)&v);
             JS_FreeValue(ctx, v);
             if (JS_IsException(dv))
@@ -50016,7 +51335,7 @@ static JSValue js_date_Symbol_toPrimitive(JSContext *ctx, JSValueConst this_val,
     if (!JS_IsObject(obj))
         return JS_ThrowTypeErrorNotAnObject(ctx);
 
-    if (JS_IsString(argv[0])) {
+    if (tag_is_string(JS_VALUE_GET_TAG(argv[0]))) {
         hint = JS_ValueToAtom(ctx, argv[0]);
         if (hint == JS_ATOM_NULL)
             return JS_EXCEPTION;
@@ -50573,6 +51892,7 @@ static JSValue JS_ToBigIntCtorFree(JSContext *ctx, JSValue val)
         goto redo;
 #endif        
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         val = JS_StringToBigIntErr(ctx, val);
         break;
     case JS_TAG_OBJECT:
@@ -51133,6 +52453,7 @@ static JSValue js_bigfloat_constructor(JSContext *ctx,
                 break;
             goto redo;
         case JS_TAG_STRING:
+        case JS_TAG_STRING_ROPE:
             {
                 const char *str, *p;
                 size_t len;
@@ -51625,7 +52946,7 @@ static JSValue js_float_env_setPrec(JSContext *ctx,
     ctx->fp_env.prec = prec;
     ctx->fp_env.flags = flags;
 
-    ret = JS_Call(ctx, func, JS_UNDEFINED, 0, NULL);
+    ret = __JS_Call(ctx, func, JS_UNDEFINED, 0, NULL);
     /* always restore the floating point precision */
     ctx->fp_env.prec = saved_prec;
     ctx->fp_env.flags = saved_flags;
@@ -51821,6 +53142,7 @@ static JSValue JS_ToBigDecimalFree(JSContext *ctx, JSValue val,
             break;
         goto redo;
     case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
         {
             const char *str, *p;
             size_t len;
@@ -52787,6 +54109,16 @@ static JSArrayBuffer *js_get_array_buffer(JSContext *ctx, JSValueConst obj)
     return p->u.array_buffer;
 }
 
+JS_BOOL JS_IsArrayBuffer(JSValueConst obj)
+{
+    JSObject *p;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return FALSE;
+    p = JS_VALUE_GET_OBJ(obj);
+    return p->class_id == JS_CLASS_ARRAY_BUFFER ||
+        p->class_id == JS_CLASS_SHARED_ARRAY_BUFFER;
+}
+
 /* return NULL if exception. WARNING: any JS call can detach the
    buffer and render the returned pointer invalid */
 uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj)
@@ -53005,6 +54337,16 @@ static JSValue js_typed_array_get_byteOffset(JSContext *ctx,
     return JS_NewInt32(ctx, ta->offset);
 }
 
+JS_BOOL JS_IsTypedArray(JSValueConst obj)
+{
+    JSObject *p;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return FALSE;
+    p = JS_VALUE_GET_OBJ(obj);
+    return p->class_id >= JS_CLASS_UINT8C_ARRAY &&
+        p->class_id <= JS_CLASS_FLOAT64_ARRAY;
+}
+
 /* Return the buffer associated to the typed array or an exception if
    it is not a typed array or if the buffer is detached. pbyte_offset,
    pbyte_length or pbytes_per_element can be NULL. */
@@ -53372,7 +54714,7 @@ static JSValue js_typed_array_from(JSContext *ctx, JSValueConst this_val,
         if (mapping) {
             args[0] = v;
             args[1] = JS_NewInt32(ctx, k);
-            v2 = JS_Call(ctx, mapfn, this_arg, 2, args);
+            v2 = __JS_Call(ctx, mapfn, this_arg, 2, args);
             JS_FreeValue(ctx, v);
             v = v2;
             if (JS_IsException(v))
@@ -53578,7 +54920,7 @@ static JSValue js_typed_array_find(JSContext *ctx, JSValueConst this_val,
         args[0] = val;
         args[1] = index_val;
         args[2] = this_val;
-        res = JS_Call(ctx, func, this_arg, 3, args);
+        res = __JS_Call(ctx, func, this_arg, 3, args);
         if (JS_IsException(res))
             goto exception;
         if (JS_ToBoolFree(ctx, res)) {
@@ -54215,7 +55557,7 @@ static int js_TA_cmp_generic(const void *a, const void *b, void *opaque) {
                               a_idx * (size_t)psc->elt_size);
         argv[1] = psc->getfun(ctx, psc->array_ptr +
                               b_idx * (size_t)(psc->elt_size));
-        res = JS_Call(ctx, psc->cmp, JS_UNDEFINED, 2, argv);
+        res = __JS_Call(ctx, psc->cmp, JS_UNDEFINED, 2, argv);
         if (JS_IsException(res)) {
             psc->exception = 1;
             goto done;
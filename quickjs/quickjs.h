@@ -319,6 +319,7 @@ typedef struct JSMallocState {
     size_t malloc_count;
     size_t malloc_size;
     size_t malloc_limit;
+    size_t malloc_total; /* blocks allocated so far, frees do not subtract */
     void *opaque; /* user opaque */
 } JSMallocState;
 
@@ -336,6 +337,7 @@ JSRuntime *JS_NewRuntime(void);
 void JS_SetRuntimeInfo(JSRuntime *rt, const char *info);
 void JS_SetMemoryLimit(JSRuntime *rt, size_t limit);
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold);
+void JS_SetGCYoungThreshold(JSRuntime *rt, size_t gc_young_threshold);
 /* use 0 to disable maximum stack size check */
 void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
 /* should be called when changing thread to update the stack top value
@@ -348,6 +350,19 @@ void JS_SetRuntimeOpaque(JSRuntime *rt, void *opaque);
 typedef void JS_MarkFunc(JSRuntime *rt, JSGCObjectHeader *gp);
 void JS_MarkValue(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func);
 void JS_RunGC(JSRuntime *rt);
+
+typedef enum JSGCModeEnum {
+    JS_GC_MODE_AUTO, /* collect when the allocated memory grows (default) */
+    JS_GC_MODE_MANUAL, /* only collect in JS_RunGC() and JS_RunGCStep() */
+} JSGCModeEnum;
+
+void JS_SetGCMode(JSRuntime *rt, JSGCModeEnum mode);
+/* Collect the young objects, then do a full collection if one is due
+   and it is expected to fit in the remaining 'budget_us'
+   microseconds. Return FALSE if a full collection is still due. It is
+   done whatever the budget once the heap has grown to twice the full
+   collection threshold or after 120 deferred steps. */
+JS_BOOL JS_RunGCStep(JSRuntime *rt, int64_t budget_us);
 JS_BOOL JS_IsLiveObject(JSRuntime *rt, JSValueConst obj);
 
 JSContext *JS_NewContext(JSRuntime *rt);
@@ -416,6 +431,21 @@ typedef struct JSMemoryUsage {
 } JSMemoryUsage;
 
 void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s);
+/* cheap enough to call every frame */
+void JS_GetMallocState(JSRuntime *rt, JSMallocState *s);
+int64_t JS_GetGCCount(JSRuntime *rt);
+
+typedef struct JSGCStats {
+    int64_t young_count; /* collections of the young objects only */
+    int64_t full_count;
+    int64_t last_pause_us;
+    int64_t max_pause_us;
+    int64_t total_pause_us;
+    int64_t last_scanned; /* GC objects scanned by the last collection */
+    int64_t last_freed; /* GC objects freed by the last collection */
+} JSGCStats;
+
+void JS_GetGCStats(JSRuntime *rt, JSGCStats *s);
 void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt);
 
 /* atom support */
@@ -821,6 +851,9 @@ JSValue JS_NewArrayBuffer(JSContext *ctx, uint8_t *buf, size_t len,
 JSValue JS_NewArrayBufferCopy(JSContext *ctx, const uint8_t *buf, size_t len);
 void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj);
 uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj);
+/* class tests that never throw, to pick between the two getters */
+JS_BOOL JS_IsArrayBuffer(JSValueConst obj);
+JS_BOOL JS_IsTypedArray(JSValueConst obj);
 JSValue JS_GetTypedArrayBuffer(JSContext *ctx, JSValueConst obj,
                                size_t *pbyte_offset,
                                size_t *pbyte_length,
@@ -304,6 +304,101 @@ function test_string()
     assert("abc".padStart(Infinity, ""), "abc");
 }
 
+/* long concatenations are kept as ropes until their characters are read */
+function test_string_rope()
+{
+    var a, b, c, i, parts, m, o;
+
+    /* appends mixing 8 and 16 bit characters */
+    a = "";
+    parts = [];
+    for(i = 0; i < 1000; i++) {
+        c = (i % 7 == 0) ? "\u20ac" + i : "x" + i;
+        a += c;
+        parts.push(c);
+    }
+    b = parts.join("");
+    assert(a.length, b.length);
+    assert(a === b, true);
+    assert(a == b, true);
+    assert(a < b + "0", true);
+    assert(a.charCodeAt(0), 0x20ac);
+    assert(a[3], "1");
+    assert(a.indexOf("\u20ac7"), b.indexOf("\u20ac7"));
+    assert(typeof a, "string");
+    assert(!!a, true);
+
+    /* prepends build a tree leaning the other way */
+    a = "";
+    for(i = 0; i < 1000; i++)
+        a = i + "," + a;
+    parts = [];
+    for(i = 999; i >= 0; i--)
+        parts.push(i);
+    assert(a, parts.join(",") + ",");
+
+    /* shared subtrees */
+    a = "y".repeat(300);
+    b = a + a;
+    c = b + "z" + b;
+    assert(c.length, 1201);
+    assert(c[600], "z");
+    assert(b, "y".repeat(600));
+
+    /* conversions */
+    a = "1".repeat(200) + "0".repeat(100);
+    assert(a - 0, Number("1".repeat(200) + "0".repeat(100)));
+    assert(a + 1, "1".repeat(200) + "0".repeat(100) + "1");
+    assert(String(a).length, 300);
+    assert(JSON.stringify(a), '"' + a + '"');
+    assert(eval("'" + "e".repeat(300) + "'"), "e".repeat(300));
+
+    /* property and map keys */
+    a = "k".repeat(200) + "k".repeat(100);
+    o = {};
+    o[a] = 1;
+    assert(o["k".repeat(300)], 1);
+    m = new Map();
+    m.set("k".repeat(150) + "k".repeat(150), 2);
+    assert(m.get("k".repeat(300)), 2);
+    assert(m.has(a), true);
+
+    /* reading the string while it is being built */
+    a = "";
+    parts = [];
+    for(i = 0; i < 2000; i++) {
+        a += (i % 100 == 99) ? "\u20ac" : "ab";
+        if (i % 500 == 0)
+            parts.push(a);
+        assert(a.charCodeAt(a.length - 1), (i % 100 == 99) ? 0x20ac : 0x62);
+    }
+    assert(a.length, 3980);
+    assert(a.slice(0, 4), "abab");
+    assert(parts.length, 4);
+    assert(parts[1].length, 997);
+    assert(parts[1] + a.slice(997), a);
+    o = { s: "" };
+    for(i = 0; i < 1000; i++) {
+        o.s += "cd";
+        assert(o.s[2 * i + 1], "d");
+    }
+    assert(o.s, "cd".repeat(1000));
+    /* each read must not copy the whole string: four times more
+       appends should take about four times longer, not sixteen */
+    function append_read(n) {
+        var s = "", sum = 0, i, t = Date.now();
+        for(i = 0; i < n; i++) {
+            s += "x";
+            sum += s.charCodeAt(i);
+        }
+        assert(sum, n * 0x78);
+        return Date.now() - t + 1;
+    }
+    append_read(50000);
+    assert(append_read(200000) < 8 * append_read(50000), true,
+           "append and read is linear");
+}
+
 function test_math()
 {
     var a;
@@ -695,11 +790,46 @@ function test_generator()
     assert(v.value === 6 && v.done === true);
 }
 
+/* cycles between old and young objects must survive the collections
+   of the young objects while referenced */
+function test_gc()
+{
+    var old, i, j, a, b, sum;
+
+    old = [];
+    for(i = 0; i < 1000; i++)
+        old.push({ id: i, next: null });
+    /* allocate enough to trigger several collections */
+    for(j = 0; j < 20; j++) {
+        for(i = 0; i < 1000; i++) {
+            a = { id: i };
+            b = { a: a, pad: [i, i, i, i] };
+            a.b = b;
+            if ((i % 10) == j % 10) {
+                /* young cycle attached to an old object */
+                old[i].next = a;
+                a.owner = old[i];
+            }
+        }
+    }
+    sum = 0;
+    for(i = 0; i < 1000; i++) {
+        a = old[i].next;
+        assert(a.owner, old[i]);
+        assert(a.b.a, a);
+        sum += a.b.pad[0];
+        /* the old objects become garbage cycles */
+        old[i].next = null;
+    }
+    assert(sum, 499500);
+}
+
 test();
 test_function();
 test_enum();
 test_array();
 test_string();
+test_string_rope();
 test_math();
 test_number();
 test_eval();
@@ -711,3 +841,4 @@ test_symbol();
 test_map();
 test_weak_map();
 test_generator();
+test_gc();
@@ -583,6 +583,103 @@ function test_optional_chaining()
     assert((a?.["b"])().c, 42);
 }
 
+function test_inline_cache()
+{
+    var i, a, r, o, proto, objs;
+    function get_x(o) { return o.x; }
+    function set_x(o, v) { "use strict"; o.x = v; }
+    function call_f(o) { return o.f(); }
+
+    /* own property, then the shape changes under the cached site */
+    o = { x: 1, y: 2 };
+    for(i = 0; i < 3; i++)
+        assert(get_x(o), 1);
+    delete o.y;
+    assert(get_x(o), 1);
+    Object.defineProperty(o, "x", { get: function() { return 3; } });
+    assert(get_x(o), 3);
+    delete o.x;
+    assert(get_x(o), undefined);
+
+    /* prototype hits follow changes of the prototype */
+    proto = { f: function() { return 1; } };
+    o = Object.create(proto);
+    for(i = 0; i < 3; i++)
+        assert(call_f(o), 1);
+    proto.f = function() { return 2; };
+    assert(call_f(o), 2);
+    o.f = function() { return 3; };
+    assert(call_f(o), 3);
+    Object.setPrototypeOf(o, { f: function() { return 4; } });
+    assert(call_f(o), 3);
+    delete o.f;
+    assert(call_f(o), 4);
+
+    /* the getter is removed without changing the property flags */
+    o = {};
+    Object.defineProperty(o, "x", { get: function() { return 1; }, configurable: true });
+    for(i = 0; i < 3; i++)
+        assert(get_x(o), 1);
+    Object.defineProperty(o, "x", { get: undefined });
+    assert(get_x(o), undefined);
+
+    /* two levels of prototypes */
+    class A { g() { return "A"; } }
+    class B extends A {}
+    r = "";
+    for(i = 0; i < 3; i++)
+        r += new B().g();
+    assert(r, "AAA");
+    A.prototype.g = function() { return "a"; };
+    assert(new B().g(), "a");
+
+    /* a site that sees several shapes */
+    objs = [ { x: 1 }, { a: 0, x: 2 }, Object.create({ x: 3 }), [] ];
+    objs[3].x = 4;
+    r = 0;
+    for(i = 0; i < 8; i++)
+        r += get_x(objs[i % 4]);
+    assert(r, 20);
+
+    /* stores only hit writable own properties */
+    o = { x: 1 };
+    for(i = 0; i < 3; i++)
+        set_x(o, i);
+    assert(o.x, 2);
+    Object.freeze(o);
+    assert_throws(TypeError, () => set_x(o, 5));
+    assert(o.x, 2);
+    a = [];
+    Object.defineProperty(Object.prototype, "x", { set: function(v) { r = v; }, configurable: true });
+    set_x(a, 7);
+    assert(r, 7);
+    assert(a.hasOwnProperty("x"), false);
+    delete Object.prototype.x;
+
+    /* numeric names on typed arrays are not inherited, even from an
+       object with the same shape */
+    Uint8Array.prototype.Infinity = 1;
+    function get_inf(o) { return o.Infinity; }
+    for(i = 0; i < 3; i++)
+        assert(get_inf(Object.create(Uint8Array.prototype)), 1);
+    assert(get_inf(new Uint8Array(1)), undefined);
+    delete Uint8Array.prototype.Infinity;
+
+    /* the cached opcodes are longer: a forward jump over a chain of
+       field reads must still reach its label */
+    function chain(o, x) {
+        var s = 0;
+        if (x) {
+            s = o.a.a.a.a.a.a.a.a.a.a.a.a.a.a.a.a.a.a;
+        }
+        return s;
+    }
+    o = {};
+    o.a = o;
+    assert(chain(o, true), o);
+    assert(chain(o, false), 0);
+}
+
 test_op1();
 test_cvt();
 test_eq();
@@ -604,3 +701,4 @@ test_argument_scope();
 test_function_expr_name();
 test_parse_semicolon();
 test_optional_chaining();
+test_inline_cache();
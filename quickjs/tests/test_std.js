@@ -291,6 +291,112 @@ function test_async_gc()
     })();
 }
 
+function test_gc_step()
+{
+    var s0, s1, i, j, a, b, deferred;
+
+    std.setGCMode(std.GC_MODE_MANUAL);
+    s0 = std.getGCStats();
+    for(i = 0; i < 100000; i++) {
+        a = {};
+        b = { a: a };
+        a.b = b;
+    }
+    s1 = std.getGCStats();
+    /* no automatic collection in manual mode */
+    assert(s1.youngCount, s0.youngCount);
+    assert(s1.fullCount, s0.fullCount);
+
+    /* enough budget for the due full collection */
+    assert(std.gcStep(1e7), true);
+    s1 = std.getGCStats();
+    assert(s1.youngCount, s0.youngCount + 1);
+    assert(s1.fullCount, s0.fullCount + 1);
+    assert(s1.maxPause >= s1.lastPause, true);
+
+    /* nothing is due any more and nothing was allocated */
+    std.gcStep(0);
+    assert(std.gcStep(0), true);
+    s0 = std.getGCStats();
+    assert(s0.fullCount, s1.fullCount);
+    assert(s0.youngCount, s1.youngCount + 1);
+
+    /* a full collection that never fits in the budget is still done
+       before the garbage cycles grow without bound */
+    deferred = 0;
+    for(j = 0; j < 1000; j++) {
+        for(i = 0; i < 1000; i++) {
+            a = {};
+            b = { a: a };
+            a.b = b;
+        }
+        if (!std.gcStep(-1))
+            deferred++;
+        else if (std.getGCStats().fullCount != s0.fullCount)
+            break;
+    }
+    s1 = std.getGCStats();
+    assert(s1.fullCount, s0.fullCount + 1);
+    assert(deferred > 0 && deferred <= 120, true);
+    std.setGCMode(std.GC_MODE_AUTO);
+}
+
+/* young objects only referenced from old ones must survive the
+   collections of the young objects */
+function test_gc_young()
+{
+    var ballast, arr, map, get, set, s0, s1, i, o, sum;
+
+    std.setGCMode(std.GC_MODE_MANUAL);
+    /* keep the heap large enough so that no full collection is due */
+    ballast = [];
+    for(i = 0; i < 20000; i++)
+        ballast.push({ i: i });
+    arr = [];
+    for(i = 0; i < 100; i++)
+        arr.push(null);
+    map = new Map();
+    (function () {
+        var v = null;
+        get = function () { return v; };
+        set = function (o) { v = o; };
+    })();
+    /* make the containers old */
+    std.gc();
+
+    for(i = 0; i < 100; i++) {
+        /* self cycles, so a young collection would free them if the
+           references from the old containers were missed */
+        o = { id: i };
+        o.self = o;
+        arr[i] = o;
+        o = { id: i };
+        o.self = o;
+        map.set(i, o);
+    }
+    o = { id: 100 };
+    o.self = o;
+    set(o);
+    o = null;
+
+    s0 = std.getGCStats();
+    assert(std.gcStep(0), true);
+    s1 = std.getGCStats();
+    assert(s1.youngCount, s0.youngCount + 1);
+    assert(s1.fullCount, s0.fullCount);
+
+    sum = 0;
+    for(i = 0; i < 100; i++) {
+        assert(arr[i].self, arr[i]);
+        assert(map.get(i).self, map.get(i));
+        sum += arr[i].id + map.get(i).id;
+    }
+    assert(sum, 9900);
+    assert(get().self, get());
+    assert(get().id, 100);
+    std.setGCMode(std.GC_MODE_AUTO);
+}
+
 test_printf();
 test_file1();
 test_file2();
@@ -301,4 +407,6 @@ test_os_exec();
 test_timer();
 test_ext_json();
 test_async_gc();
+test_gc_step();
+test_gc_young();
 
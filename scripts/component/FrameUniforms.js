@@ -0,0 +1,86 @@
+import { bindUniformBuffer, createUniformBuffer, mat4FromTranslationScaleBatch, setUniformBlockBinding, updateUniformBuffer } from "../libs.js";
+
+/** Binding points of the Camera and Transforms blocks in resources/glsl/*.vert.sk */
+export const CAMERA_BINDING = 0;
+export const TRANSFORMS_BINDING = 1;
+/** Matrices in the Transforms block, must match u_models in resources/glsl/*.vert.sk */
+export const MAX_TRANSFORMS = 16;
+
+/**
+ * The uniform blocks every world-space program shares. The camera goes up once per frame and
+ * the model transforms of the frame go up together as one array, draws then only pick a
+ * transform with `u_transform`.
+ */
+export class FrameUniforms {
+    constructor() {
+        /** std140 Camera block: projection, view, world */
+        this.camera = new Float32Array(16 * 3);
+        this.projection = this.camera.subarray(0, 16);
+        this.view = this.camera.subarray(16, 32);
+        this.world = this.camera.subarray(32, 48);
+        /** x, y per transform */
+        this.positions = new Float32Array(MAX_TRANSFORMS * 2);
+        /** scaleX, scaleY per transform */
+        this.scales = new Float32Array(MAX_TRANSFORMS * 2);
+        /** std140 Transforms block */
+        this.transforms = new Float32Array(MAX_TRANSFORMS * 16);
+        this.transformCount = 0;
+        /** @type {WebGLBuffer | undefined} */
+        this.cameraBuffer = undefined;
+        /** @type {WebGLBuffer | undefined} */
+        this.transformBuffer = undefined;
+    }
+    init() {
+        this.cameraBuffer = createUniformBuffer(this.camera.byteLength);
+        this.transformBuffer = createUniformBuffer(this.transforms.byteLength);
+    }
+    /**
+     * Points the program's blocks at the shared binding points, once after linking.
+     * @param {WebGLProgram} program
+     */
+    bindBlocks(program) {
+        setUniformBlockBinding(program, "Camera", CAMERA_BINDING);
+        setUniformBlockBinding(program, "Transforms", TRANSFORMS_BINDING);
+    }
+    /** transforms left this frame */
+    get freeTransforms() {
+        return MAX_TRANSFORMS - this.transformCount;
+    }
+    /** Drops the transforms of the last frame. */
+    reset() {
+        this.transformCount = 0;
+    }
+    /**
+     * Queues translation(x, y, 0) * scaling(scaleX, scaleY, 1) for this frame.
+     * @param {number} x
+     * @param {number} y
+     * @param {number} [scaleX]
+     * @param {number} [scaleY]
+     * @returns {number} the index to set `u_transform` to
+     */
+    pushTransform(x, y, scaleX = 1, scaleY = 1) {
+        if (this.transformCount === MAX_TRANSFORMS) {
+            throw new RangeError(`A frame holds at most ${MAX_TRANSFORMS} transforms`);
+        }
+        const { positions, scales } = this;
+        const index = this.transformCount++;
+        positions[index * 2] = x;
+        positions[index * 2 + 1] = y;
+        scales[index * 2] = scaleX;
+        scales[index * 2 + 1] = scaleY;
+        return index;
+    }
+    /** Uploads the camera and the queued transforms and binds both blocks. */
+    upload() {
+        const { cameraBuffer, transformBuffer, transforms, transformCount } = this;
+        if (cameraBuffer === undefined || transformBuffer === undefined) {
+            throw new Error("Frame uniforms not initialized");
+        }
+        // both blend between frames when the render thread interpolates
+        updateUniformBuffer(cameraBuffer, 0, this.camera, this.camera.length, true);
+        mat4FromTranslationScaleBatch(transforms, this.positions, this.scales, transformCount);
+        updateUniformBuffer(transformBuffer, 0, transforms, transformCount * 16, true);
+        bindUniformBuffer(CAMERA_BINDING, cameraBuffer);
+        bindUniformBuffer(TRANSFORMS_BINDING, transformBuffer);
+    }
+}
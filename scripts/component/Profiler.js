@@ -0,0 +1,127 @@
+import { createProfileZone, getProfileBuffer, writeProfileTrace } from "../libs.js";
+
+/** Counter slots at the start of every frame record, see the profiler in libs/context.c */
+const FRAME_DURATION = 2;
+const DRAW_CALLS = 3;
+const NATIVE_CALLS = 4;
+const HEAP_SIZE = 5;
+const GC_RUNS = 6;
+const ALLOCATIONS = 7;
+const GC_PAUSE = 8;
+
+/**
+ * Names the profile zones and summarizes the native frame ring for the status line.
+ */
+export class Profiler {
+    constructor() {
+        /** @type {Map<string, number>} */
+        this.zones = new Map();
+        /** @type {Set<number>} */
+        this.gpuZones = new Set();
+        const { buffer, frames, frameSize, zones, counters, gpuLatency } = getProfileBuffer();
+        this.records = new Float64Array(buffer);
+        this.frames = frames;
+        this.frameSize = frameSize;
+        this.zoneSlots = zones;
+        this.counters = counters;
+        this.gpuLatency = gpuLatency;
+        /** adds the per-zone allocation counts to the summary */
+        this.trackAllocations = false;
+    }
+    /**
+     * @param {string} name
+     * @returns {number} id for beginProfileZone
+     */
+    zone(name) {
+        let zone = this.zones.get(name);
+        if (zone === undefined) {
+            zone = createProfileZone(name);
+            this.zones.set(name, zone);
+        }
+        return zone;
+    }
+    /**
+     * @param {string} name
+     * @returns {number} id for beginGPUZone
+     */
+    gpuZone(name) {
+        const zone = this.zone(name);
+        this.gpuZones.add(zone);
+        return zone;
+    }
+    /**
+     * @param {string} path
+     * @returns {boolean}
+     */
+    dump(path) {
+        return writeProfileTrace(path);
+    }
+    /**
+     * Averages of the last `count` frames, GPU times lag behind by the query latency.
+     * @param {number} count
+     * @returns {string}
+     */
+    summarize(count) {
+        const { records, frames, frameSize, counters, zoneSlots, gpuLatency } = this;
+        const finished = records[0];
+        const last = Math.min(count, finished, frames - gpuLatency);
+        if (last <= 0) {
+            return "";
+        }
+        const sums = new Float64Array(frameSize);
+        for (let i = 0; i < last; i++) {
+            const start = 1 + ((finished - 1 - i) % frames) * frameSize;
+            for (let j = 0; j < frameSize; j++) {
+                sums[j] += records[start + j];
+            }
+        }
+        let gpuFrames = 0;
+        const gpuSums = new Float64Array(zoneSlots);
+        for (let i = gpuLatency; i < last + gpuLatency && i < finished; i++) {
+            const start = 1 + ((finished - 1 - i) % frames) * frameSize + counters + zoneSlots;
+            for (let j = 0; j < zoneSlots; j++) {
+                gpuSums[j] += records[start + j];
+            }
+            gpuFrames++;
+        }
+        const cpu = [];
+        const gpu = [];
+        for (const [name, zone] of this.zones) {
+            if (this.gpuZones.has(zone)) {
+                gpu.push(`${name} ${(gpuSums[zone] / Math.max(1, gpuFrames)).toFixed(2)}`);
+            } else {
+                cpu.push(`${name} ${(sums[counters + zone] / last).toFixed(2)}`);
+            }
+        }
+        const lines = [
+            `Frame ${(sums[FRAME_DURATION] / last).toFixed(2)}ms CPU ${cpu.join(" ")}`,
+            `GPU ${gpu.join(" ")}`,
+            `Draws ${Math.round(sums[DRAW_CALLS] / last)} Native calls ${Math.round(sums[NATIVE_CALLS] / last)} Heap ${(sums[HEAP_SIZE] / last / 1048576).toFixed(1)}MB GC ${sums[GC_RUNS]} (${(sums[GC_PAUSE] / last).toFixed(2)}ms) Allocs ${(sums[ALLOCATIONS] / last).toFixed(1)}`,
+        ];
+        if (this.trackAllocations) {
+            const allocations = [];
+            for (const [name, zone] of this.zones) {
+                if (!this.gpuZones.has(zone)) {
+                    allocations.push(`${name} ${(sums[counters + 2 * zoneSlots + zone] / last).toFixed(1)}`);
+                }
+            }
+            lines.push(`Allocs ${allocations.join(" ")}`);
+        }
+        return lines.join("\n");
+    }
+    /**
+     * QuickJS allocations per frame over the last `count` frames, 0 once the frame loop is steady.
+     * @param {number} count
+     * @returns {number}
+     */
+    allocationsPerFrame(count) {
+        const { records, frames, frameSize } = this;
+        const finished = records[0];
+        const last = Math.min(count, finished, frames);
+        let sum = 0;
+        for (let i = 0; i < last; i++) {
+            sum += records[1 + ((finished - 1 - i) % frames) * frameSize + ALLOCATIONS];
+        }
+        return last > 0 ? sum / last : 0;
+    }
+}
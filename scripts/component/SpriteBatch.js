@@ -0,0 +1,84 @@
+import { getProgram, getUniformLocationCached } from "../engine.js";
+import { activeTexture, bindTexture, createSpriteBatch, drawSpriteBatch, uniform1f, uniform1i, useProgram } from "../libs.js";
+
+/** Floats per sprite record, must match SPRITE_RECORD_SIZE in libs/context.c */
+export const SPRITE_RECORD_SIZE = 14;
+
+/**
+ * Collects sprites for one atlas and hands them to the native batch in a single call.
+ */
+export class SpriteBatch {
+    /**
+     * @param {number} capacity
+     */
+    constructor(capacity = 1024) {
+        this.program = "sprite";
+        this.capacity = capacity;
+        this.records = new Float32Array(capacity * SPRITE_RECORD_SIZE);
+        this.count = 0;
+        /** @type {number | undefined} */
+        this.batch = undefined;
+        /** @type {AtlasContainer | undefined} */
+        this.atlas = undefined;
+    }
+    /**
+     *
+     * @param {AtlasContainer} atlas
+     */
+    setAtlas(atlas) {
+        this.atlas = atlas;
+    }
+    init() {
+        this.batch = createSpriteBatch(this.capacity);
+    }
+    /**
+     *
+     * @param {number} x
+     * @param {number} y
+     * @param {number} scaleX
+     * @param {number} scaleY
+     * @param {SpriteQuad} quad
+     * @param {number} frame
+     */
+    push(x, y, scaleX, scaleY, quad, frame) {
+        if (this.count === this.capacity) {
+            this.flush();
+        }
+        const { records } = this;
+        const i = this.count * SPRITE_RECORD_SIZE;
+        records[i + 0] = x;
+        records[i + 1] = y;
+        records[i + 2] = scaleX;
+        records[i + 3] = scaleY;
+        records[i + 4] = quad.offsetX;
+        records[i + 5] = quad.offsetY;
+        records[i + 6] = quad.width;
+        records[i + 7] = quad.height;
+        records[i + 8] = quad.rect.x;
+        records[i + 9] = quad.rect.y;
+        records[i + 10] = quad.rect.width;
+        records[i + 11] = quad.rect.height;
+        records[i + 12] = frame;
+        records[i + 13] = quad.rotated ? 1 : 0;
+        this.count++;
+    }
+    flush() {
+        const { batch, atlas, program, records, count } = this;
+        if (batch === undefined) {
+            throw new Error("Sprite batch not initialized");
+        }
+        if (!atlas) {
+            throw new Error("Atlas not initialized");
+        }
+        if (count === 0) {
+            return;
+        }
+        useProgram(getProgram(program));
+        uniform1f(getUniformLocationCached(program, "u_time"), 0);
+        activeTexture(0);
+        bindTexture(atlas.texture);
+        uniform1i(getUniformLocationCached(program, "u_texture0"), 0);
+        drawSpriteBatch(batch, records, count, atlas.atlasSize);
+        this.count = 0;
+    }
+}
@@ -1,8 +1,8 @@
-import { getProgram, getUniformLocationCached } from "../engine.js";
+import { getProgram, getUniformLocationCached, textureUniforms } from "../engine.js";
 import { activeTexture, bindEBO, bindTexture, bindVAO, bindVBO, bufferData, bufferDataElement, createBuffer, createTexture, createVAO, drawElements, enableVertexAttribute, setVertexAttributePointer, uniform1f, uniform1i, updateTexture, useProgram, vec2, vec3 } from "../libs.js";
-import { cHalfSizeX, cHalfSizeY, cTileSize } from "../misc/constants.js";
-import { TileCollisionType } from "../misc/enums.js";
-import { Map as GameMap } from "../object/Map.js";
+import { cHalfSizeX, cHalfSizeY } from "../misc/constants.js";
+import { random } from "../misc/math.js";
+import { SpriteBatch } from "./SpriteBatch.js";
 
 
 export class SpriteRenderer {
@@ -15,6 +15,8 @@ export class SpriteRenderer {
         this.frames = 0;
         this.count = 6;
         this.visible = true;
+        /** @type {SpriteQuad | undefined} */
+        this.quad = undefined;
     }
     /**
      * 
@@ -49,6 +51,7 @@ export class SpriteRenderer {
         bindVAO(vao);
         bindVBO(vbo);
         const rect = atlas.atlasData["atlas/platform/movingPlatform"];
+        this.quad = { offsetX: 0, offsetY: 0, width: 64, height: 16, rect, rotated: !!rect.rotated };
         const u0 = rect.x;
         const v0 = rect.y;
         const u1 = rect.x + rect.width;
@@ -124,6 +127,10 @@ export class SpriteRenderer {
 
         const rect = atlas.atlasData["atlas/platform/character"];
         const maxFrames = this.maxFrames = Math.floor(rect.width / (cHalfSizeX * 2));
+        this.quad = {
+            offsetX: 0, offsetY: 0, width: cHalfSizeX * 2, height: cHalfSizeY * 2,
+            rect: { x: rect.x, y: rect.y, width: rect.width / maxFrames, height: rect.height }, rotated: !!rect.rotated
+        };
         const u0 = rect.x;
         const v0 = rect.y;
         const u1 = rect.x + rect.width / maxFrames;
@@ -162,7 +169,7 @@ export class SpriteRenderer {
         bufferData(buffer);
         bindEBO(ebo);
         bufferDataElement(indices);
-        this.offset = Math.floor(Math.random() * maxFrames);
+        this.offset = Math.floor(random() * maxFrames);
         setVertexAttributePointer(0, 3, false, 8, 0);
         enableVertexAttribute(0);
         setVertexAttributePointer(1, 3, false, 8, 3);
@@ -182,6 +189,8 @@ export class SpriteRenderer {
 
         const rect = atlas.atlasData["atlas/icon/question"];
         const maxFrames = this.maxFrames = Math.floor(rect.width / (rect.width));
+        // the icon quad runs its corners right to left, hence the negative width
+        this.quad = { offsetX: 0, offsetY: cHalfSizeY * 2, width: -rect.width, height: rect.height, rect, rotated: !!rect.rotated };
         const u0 = rect.x;
         const v0 = rect.y;
         const u1 = rect.x + rect.width / maxFrames;
@@ -220,7 +229,7 @@ export class SpriteRenderer {
         bufferData(buffer);
         bindEBO(ebo);
         bufferDataElement(indices);
-        this.offset = Math.floor(Math.random() * maxFrames);
+        this.offset = Math.floor(random() * maxFrames);
         setVertexAttributePointer(0, 3, false, 8, 0);
         enableVertexAttribute(0);
         setVertexAttributePointer(1, 3, false, 8, 3);
@@ -228,83 +237,6 @@ export class SpriteRenderer {
         setVertexAttributePointer(2, 2, false, 8, 6);
         enableVertexAttribute(2);
     }
-    /**
-     * 
-     * @param {GameMap} map 
-     */
-    initMap(map) {
-        this.vao = createVAO();
-        this.vbo = createBuffer();
-        this.ebo = createBuffer();
-        const { vao, vbo, ebo, program, textures, atlas } = this;
-        if (!atlas) {
-            throw new Error("Atlas not initialized");
-        }
-        this.textures = [atlas.texture];
-        const blockRect = atlas.atlasData["atlas/platform/block"];
-        const onewayRect = atlas.atlasData["atlas/platform/slope45oneway"];
-        const blocku0 = blockRect.x;
-        const blockv0 = blockRect.y;
-        const blocku1 = blockRect.x + blockRect.width;
-        const blockv1 = blockRect.y + blockRect.height;
-        const onewayu0 = onewayRect.x;
-        const onewayv0 = onewayRect.y;
-        const onewayu1 = onewayRect.x + onewayRect.width;
-        const onewayv1 = onewayRect.y + onewayRect.height;
-        /** @type {[number, number][]} */
-        const blockuv = [
-            [blocku1 / atlas.atlasSize, blockv1 / atlas.atlasSize],
-            [blocku1 / atlas.atlasSize, blockv0 / atlas.atlasSize],
-            [blocku0 / atlas.atlasSize, blockv0 / atlas.atlasSize],
-            [blocku0 / atlas.atlasSize, blockv1 / atlas.atlasSize]
-        ];
-        /** @type {[number, number][]} */
-        const onewayuv = [
-            [onewayu1 / atlas.atlasSize, onewayv1 / atlas.atlasSize],
-            [onewayu1 / atlas.atlasSize, onewayv0 / atlas.atlasSize],
-            [onewayu0 / atlas.atlasSize, onewayv0 / atlas.atlasSize],
-            [onewayu0 / atlas.atlasSize, onewayv1 / atlas.atlasSize]
-        ];
-        const buffers = new Float32Array(map.mWidth * map.mHeight * 4 * 8);
-        const indices = new Uint32Array(map.mWidth * map.mHeight * 6);
-        this.count = map.mWidth * map.mHeight * 6;
-        for (let i = 0; i < map.mHeight; i++) {
-            for (let j = 0; j < map.mWidth; j++) {
-                const position = map.getMapTilePosition(j, i);
-                const tile = map.getCollisionType(j, i);
-                buffers.set([
-                    ...vec3.rotateZ(vec3.create(), [+cTileSize / 2 + position[0], +cTileSize / 2 + position[1], 0.0], [position[0], position[1], 0], 0), 1.0, 1.0, 1.0, ...(tile === TileCollisionType.Full ? blockuv[0] : tile === TileCollisionType.OneWaySlope45 ? onewayuv[0] : [0, 0]),
-                    ...vec3.rotateZ(vec3.create(), [+cTileSize / 2 + position[0], -cTileSize / 2 + position[1], 0.0], [position[0], position[1], 0], 0), 1.0, 1.0, 1.0, ...(tile === TileCollisionType.Full ? blockuv[1] : tile === TileCollisionType.OneWaySlope45 ? onewayuv[1] : [0, 0]),
-                    ...vec3.rotateZ(vec3.create(), [-cTileSize / 2 + position[0], -cTileSize / 2 + position[1], 0.0], [position[0], position[1], 0], 0), 1.0, 1.0, 1.0, ...(tile === TileCollisionType.Full ? blockuv[2] : tile === TileCollisionType.OneWaySlope45 ? onewayuv[2] : [0, 0]),
-                    ...vec3.rotateZ(vec3.create(), [-cTileSize / 2 + position[0], +cTileSize / 2 + position[1], 0.0], [position[0], position[1], 0], 0), 1.0, 1.0, 1.0, ...(tile === TileCollisionType.Full ? blockuv[3] : tile === TileCollisionType.OneWaySlope45 ? onewayuv[3] : [0, 0]),
-                ], (i * map.mWidth + j) * 4 * 8);
-                if (tile) {
-                    indices.set([
-                        (i * map.mWidth + j) * 4 + 0,
-                        (i * map.mWidth + j) * 4 + 1,
-                        (i * map.mWidth + j) * 4 + 2,
-                        (i * map.mWidth + j) * 4 + 0,
-                        (i * map.mWidth + j) * 4 + 2,
-                        (i * map.mWidth + j) * 4 + 3
-                    ], (i * map.mWidth + j) * 6);
-                } else {
-                    indices.set([0, 0, 0, 0, 0, 0], (i * map.mWidth + j) * 6);
-                }
-            }
-        }
-        bindVAO(vao);
-        bindVBO(vbo);
-        bufferData(buffers);
-        bindEBO(ebo);
-        bufferDataElement(indices);
-        setVertexAttributePointer(0, 3, false, 8, 0);
-        enableVertexAttribute(0);
-        setVertexAttributePointer(1, 3, false, 8, 3);
-        enableVertexAttribute(1);
-        setVertexAttributePointer(2, 2, false, 8, 6);
-        enableVertexAttribute(2);
-
-    }
     render() {
         if (!this.visible) {
             return;
@@ -326,7 +258,7 @@ export class SpriteRenderer {
             const element = textures[index];
             activeTexture(index);
             bindTexture(element);
-            uniform1i(getUniformLocationCached(program, `u_texture${index}`), index);
+            uniform1i(getUniformLocationCached(program, textureUniforms[index]), index);
         }
         if (this.frames % 10 === 0) {
             this.frames = 0;
@@ -335,5 +267,28 @@ export class SpriteRenderer {
         drawElements(this.offset * 6, this.count);
         this.frames++;
     }
+    /**
+     * Queue this sprite into a batch instead of drawing it on its own.
+     * @param {SpriteBatch} spriteBatch 
+     * @param {number} x 
+     * @param {number} y 
+     * @param {number} scaleX 
+     * @param {number} scaleY 
+     */
+    batch(spriteBatch, x, y, scaleX, scaleY) {
+        if (!this.visible) {
+            return;
+        }
+        const { quad } = this;
+        if (!quad) {
+            throw new Error("Sprite quad not initialized");
+        }
+        if (this.frames % 10 === 0) {
+            this.frames = 0;
+            this.offset = (this.offset + 1) % this.maxFrames;
+        }
+        spriteBatch.push(x, y, scaleX, scaleY, quad, this.offset);
+        this.frames++;
+    }
 }
 
@@ -0,0 +1,183 @@
+import { bindEBO, bindVAO, bindVBO, bufferData, bufferDataElement, bufferSubData, createBuffer, createVAO, enableVertexAttribute, setVertexAttributePointer } from "../libs.js";
+import { MTSDFText } from "../object/MTSDFText.js";
+
+/** Glyph runs kept across all text meshes, least recently used runs go first */
+const MAX_CACHED_GLYPHS = 16384;
+
+/**
+ * Size-bounded LRU of laid out text, one entry per line of text and style.
+ */
+class GlyphRunCache {
+    constructor() {
+        /** @type {Map<string, MTSDFText>} */
+        this.runs = new Map();
+        this.glyphs = 0;
+    }
+    /**
+     * @param {string} text
+     * @param {TextOptions["font"]} font
+     * @param {number} size
+     * @param {"left" | "right" | "center"} align
+     * @param {number} width
+     * @returns {MTSDFText}
+     */
+    get(text, font, size, align, width) {
+        const key = `${size}_${align}_${width}_${text}`;
+        const { runs } = this;
+        let run = runs.get(key);
+        if (run) {
+            // re-insert so Map order stays least recently used first
+            runs.delete(key);
+        } else {
+            run = new MTSDFText({ font, text, size, align, width, wordBreak: true });
+            this.glyphs += text.length;
+            for (const [oldest, oldRun] of runs) {
+                if (this.glyphs <= MAX_CACHED_GLYPHS) {
+                    break;
+                }
+                runs.delete(oldest);
+                this.glyphs -= oldRun.buffers.id.length / 4;
+            }
+        }
+        runs.set(key, run);
+        return run;
+    }
+}
+
+const glyphRunCache = new GlyphRunCache();
+
+/**
+ * GPU geometry for a list of text runs stacked top to bottom. Runs that did not change keep
+ * their vertices, a change re-uploads only from the first moved run onwards with bufferSubData.
+ * Indices follow the same quad pattern for any text, so the element buffer is only written
+ * when the mesh grows.
+ */
+export class TextMesh {
+    /**
+     * @param {number} capacity glyphs the buffers start with, they grow on demand
+     */
+    constructor(capacity = 256) {
+        this.capacity = capacity;
+        this.positions = new Float32Array(capacity * 4 * 3);
+        this.uvs = new Float32Array(capacity * 4 * 2);
+        /** @type {MTSDFText[]} */
+        this.runs = [];
+        /** first glyph and y offset of every run */
+        this.firsts = [0];
+        /** @type {number[]} */
+        this.offsets = [0];
+        this.glyphCount = 0;
+        this.height = 0;
+    }
+    init() {
+        this.vao = createVAO();
+        this.vboPositions = createBuffer();
+        this.vboTexcoords = createBuffer();
+        this.ebo = createBuffer();
+        bindVAO(this.vao);
+        bindVBO(this.vboPositions);
+        setVertexAttributePointer(0, 3, false, 3, 0);
+        enableVertexAttribute(0);
+        bindVBO(this.vboTexcoords);
+        setVertexAttributePointer(1, 2, false, 2, 0);
+        enableVertexAttribute(1);
+        this.allocate(this.capacity);
+    }
+    /**
+     * @param {number} capacity
+     */
+    allocate(capacity) {
+        const { vao, vboPositions, vboTexcoords, ebo } = this;
+        if (!vao || !vboPositions || !vboTexcoords || !ebo) {
+            throw new Error("Text mesh not initialized");
+        }
+        const positions = new Float32Array(capacity * 4 * 3);
+        const uvs = new Float32Array(capacity * 4 * 2);
+        positions.set(this.positions.subarray(0, positions.length));
+        uvs.set(this.uvs.subarray(0, uvs.length));
+        const indices = new Uint32Array(capacity * 6);
+        for (let i = 0; i < capacity; i++) {
+            indices.set([i * 4, i * 4 + 2, i * 4 + 1, i * 4 + 1, i * 4 + 2, i * 4 + 3], i * 6);
+        }
+        this.capacity = capacity;
+        this.positions = positions;
+        this.uvs = uvs;
+        bindVAO(vao);
+        bindVBO(vboPositions);
+        bufferData(positions);
+        bindVBO(vboTexcoords);
+        bufferData(uvs);
+        bindEBO(ebo);
+        bufferDataElement(indices);
+    }
+    /**
+     * Lays out `texts` as consecutive runs, reusing cached runs and unchanged vertices.
+     * @param {string[]} texts
+     * @param {TextOptions["font"]} font
+     * @param {number} size
+     * @param {"left" | "right" | "center"} align
+     * @param {number} width
+     */
+    setTexts(texts, font, size, align, width) {
+        const { runs, firsts, offsets } = this;
+        let dirty = -1;
+        let first = 0;
+        let offset = 0;
+        for (let i = 0; i < texts.length; i++) {
+            const run = glyphRunCache.get(texts[i], font, size, align, width);
+            if (dirty === -1 && (runs[i] !== run || firsts[i] !== first || offsets[i] !== offset)) {
+                dirty = i;
+            }
+            runs[i] = run;
+            firsts[i] = first;
+            offsets[i] = offset;
+            first += run.buffers.id.length / 4;
+            offset += Math.max(1, run.numLines) * size * run.lineHeight;
+        }
+        if (dirty === -1 && runs.length === texts.length) {
+            return;
+        }
+        runs.length = texts.length;
+        firsts.length = offsets.length = texts.length + 1;
+        firsts[texts.length] = first;
+        offsets[texts.length] = offset;
+        this.glyphCount = first;
+        this.height = offset;
+        if (dirty === -1) {
+            // only trailing runs went away
+            return;
+        }
+        if (first > this.capacity) {
+            let capacity = this.capacity;
+            while (capacity < first) {
+                capacity *= 2;
+            }
+            this.allocate(capacity);
+        }
+        const { positions, uvs } = this;
+        for (let i = dirty; i < texts.length; i++) {
+            const { position, uv } = runs[i].buffers;
+            const base = firsts[i] * 4;
+            const y = offsets[i];
+            for (let v = 0; v < position.length; v += 3) {
+                positions[base * 3 + v] = position[v];
+                positions[base * 3 + v + 1] = position[v + 1] + y;
+                positions[base * 3 + v + 2] = position[v + 2];
+            }
+            uvs.set(uv, base * 2);
+        }
+        const start = firsts[dirty] * 4;
+        bindVBO(this.vboPositions);
+        bufferSubData(start * 3 * 4, positions.subarray(start * 3, first * 4 * 3));
+        bindVBO(this.vboTexcoords);
+        bufferSubData(start * 2 * 4, uvs.subarray(start * 2, first * 4 * 2));
+    }
+    /**
+     * Index range of a run for drawElements.
+     * @param {number} index
+     * @returns {{offset: number, count: number}}
+     */
+    getRange(index) {
+        return { offset: this.firsts[index] * 6, count: (this.firsts[index + 1] - this.firsts[index]) * 6 };
+    }
+}
@@ -1,24 +1,6 @@
-import { getProgram, getUniformLocationCached } from "../engine.js";
-import { activeTexture, bindEBO, bindTexture, bindVAO, bindVBO, bufferData, bufferDataElement, createBuffer, createTexture, createVAO, drawElements, enableVertexAttribute, getScreenHeight, getScreenWidth, mat4, setVertexAttributePointer, uniform1i, uniform3f, uniform4f, uniformMatrix4fv, updateTexture, useProgram } from "../libs.js";
-import { MTSDFText } from "../object/MTSDFText.js";
-/** @type {Record<string, MTSDFText>} */
-const mtsdfTexts = {}
-/**
- * 
- * @param {string} content 
- * @param {TextOptions["font"]} fontData 
- * @param {number} size 
- * @param {"left" | "right" | "center"} align 
- * @param {number} width 
- * @returns {MTSDFText}
- */
-function cacheMTSDFText(content, fontData, size, align, width) {
-    const key = `${content}_${size}_${align}_${width}`;
-    if (mtsdfTexts[key] === undefined) {
-        mtsdfTexts[key] = new MTSDFText({ font: fontData, text: content, size, align, width, wordBreak: true });
-    }
-    return mtsdfTexts[key];
-}
+import { getProgram, getUniformLocationCached, textureUniforms } from "../engine.js";
+import { activeTexture, bindTexture, bindVAO, drawElements, getScreenHeight, getScreenWidth, mat4, uniform1i, uniform3f, uniform4f, uniformMatrix4fv, uploadTexture, useProgram, vec3 } from "../libs.js";
+import { TextMesh } from "./TextMesh.js";
 
 export class TextRenderer {
     constructor() {
@@ -28,18 +10,22 @@ export class TextRenderer {
         this.status = "init";
         this.message = "Hello World";
         this.height = 0;
+        this.mesh = new TextMesh();
+        /** @type {string | undefined} message and status the mesh holds */
+        this.shownMessage = undefined;
+        /** @type {string | undefined} */
+        this.shownStatus = undefined;
     }
     /**
      * 
-     * @param {ImageContainer[]} imgs 
+     * @param {TextureObject[]} imgs 
      */
     initImageTexture(...imgs) {
         for (let index = 0; index < imgs.length; index++) {
             const img = imgs[index];
-            const tex = createTexture();
             activeTexture(index);
-            bindTexture(tex);
-            updateTexture(img);
+            // renderers sharing a texture object share its GL texture
+            const tex = uploadTexture(img.id);
             /** @type {[number, number, number]} */
             this.unitRange = [img.width, img.height, 0];
             this.textures.push(tex);
@@ -53,64 +39,30 @@ export class TextRenderer {
         this.font = font;
     }
     initText() {
-        this.vao = createVAO();
-        this.vboPositions = createBuffer();
-        this.vboTexcoords = createBuffer();
-        this.ebo = createBuffer();
-        const { vao, vboPositions, vboTexcoords, ebo, program, textures, font } = this;
+        const { mesh, font } = this;
         if (!font) {
             throw new Error("Font not initialized");
         }
-        const mtsdfText = cacheMTSDFText("Hello", font, 24, "left", Infinity);
-        const positions = mtsdfText.buffers.position;
-        const texcoords = mtsdfText.buffers.uv;
-        const indices = mtsdfText.buffers.index;
-        bindVAO(vao);
-        bindVBO(vboPositions);
-        bufferData(positions);
-        setVertexAttributePointer(0, 3, false, 3, 0);
-        enableVertexAttribute(0);
-        bindEBO(ebo);
-        bufferDataElement(indices);
-        bindVBO(vboTexcoords);
-        bufferData(texcoords);
-        setVertexAttributePointer(1, 2, false, 2, 0);
-        enableVertexAttribute(1);
-        this.count = indices.length;
+        mesh.init();
+        mesh.setTexts(["Hello"], font, 24, "left", Infinity);
     }
     updateText() {
-        const { vao, vboPositions, vboTexcoords, ebo, program, textures, font } = this;
+        const { mesh, font } = this;
         if (!font) {
             throw new Error("Font not initialized");
         }
-        if (!vao) {
-            throw new Error("VAO not initialized");
+        if (this.message === this.shownMessage && this.status === this.shownStatus) {
+            return;
         }
-        if (!ebo) {
-            throw new Error("EBO not initialized");
-        }
-        if (!vboPositions) {
-            throw new Error("VBO not initialized");
-        }
-        if (!vboTexcoords) {
-            throw new Error("VBO not initialized");
-        }
-        const mtsdfText = cacheMTSDFText([this.message, this.status].join("\n"), font, 12, "left", Infinity);
-        const positions = mtsdfText.buffers.position;
-        const texcoords = mtsdfText.buffers.uv;
-        const indices = mtsdfText.buffers.index;
-        bindVAO(vao);
-        bindVBO(vboPositions);
-        bufferData(positions);
-        bindVBO(vboTexcoords);
-        bufferData(texcoords);
-        bindEBO(ebo);
-        bufferDataElement(indices);
-        this.height = mtsdfText.height;
-        this.count = indices.length;
+        this.shownMessage = this.message;
+        this.shownStatus = this.status;
+        // one run per line so a changing status line leaves the message vertices alone
+        mesh.setTexts([...this.message.split("\n"), this.status], font, 12, "left", Infinity);
+        this.height = mesh.height;
     }
     render() {
-        const { vao, program, textures, unitRange } = this;
+        const { mesh, program, textures, unitRange } = this;
+        const { vao } = mesh;
         if (!vao) {
             throw new Error("VAO not initialized");
         }
@@ -120,20 +72,21 @@ export class TextRenderer {
         useProgram(getProgram(program));
         bindVAO(vao);
         uniformMatrix4fv(getUniformLocationCached(program, "u_projection"), false, mat4.ortho(m, 0, getScreenWidth(), getScreenHeight(), 0, -1, 1));
-        uniformMatrix4fv(getUniformLocationCached(program, "u_modelView"), false, mat4.multiply(m, mat4.identity(m), mat4.fromTranslation(m, [0, (getScreenHeight() - this.height) / window.devicePixelRatio, 0])));
-        uniform3f(getUniformLocationCached(program, "u_unitRange"), ...unitRange);
+        uniformMatrix4fv(getUniformLocationCached(program, "u_modelView"), false, mat4.multiply(m, mat4.identity(m), mat4.fromTranslation(m, vec3.set(translation, 0, (getScreenHeight() - this.height) / window.devicePixelRatio, 0))));
+        uniform3f(getUniformLocationCached(program, "u_unitRange"), unitRange[0], unitRange[1], unitRange[2]);
         uniform4f(getUniformLocationCached(program, "u_color"), 0, 0, 0, 1);
         for (let index = 0; index < textures.length; index++) {
             const element = textures[index];
             activeTexture(index);
             bindTexture(element);
-            uniform1i(getUniformLocationCached(program, `u_texture${index}`), index);
+            uniform1i(getUniformLocationCached(program, textureUniforms[index]), index);
         }
-        if (this.count) {
-            drawElements(0, this.count);
+        if (mesh.glyphCount) {
+            drawElements(0, mesh.glyphCount * 6);
         }
     }
 }
 
 
-const m = mat4.create();
\ No newline at end of file
+const m = mat4.create();
+const translation = vec3.create();
\ No newline at end of file
@@ -0,0 +1,195 @@
+import { getProgram, getUniformLocationCached, textureUniforms } from "../engine.js";
+import { activeTexture, bindEBO, bindTexture, bindVAO, bindVBO, bufferData, bufferDataElement, createBuffer, createVAO, drawElementsInstanced, enableVertexAttribute, setVertexAttributeDivisor, setVertexAttributePointer, uniform1f, uniform1i, useProgram, vec2 } from "../libs.js";
+import { cTileSize } from "../misc/constants.js";
+import { TileCollisionType } from "../misc/enums.js";
+import { Map as GameMap } from "../object/Map.js";
+import { FrameUniforms } from "./FrameUniforms.js";
+
+/** Tiles per chunk side, chunks are the unit of visibility culling */
+const CHUNK_SIZE = 16;
+/** x, y, u0, v0, u1, v1 */
+const INSTANCE_SIZE = 6;
+
+/**
+ * Draws the non-empty map tiles as instanced quads, culled per chunk against the camera.
+ */
+export class TileMapRenderer {
+    constructor() {
+        this.program = "tile";
+        /** @type {WebGLTexture[]} */
+        this.textures = [];
+        this.chunksX = 0;
+        this.chunksY = 0;
+        /** first instance and instance count of every chunk, row-major */
+        this.chunks = new Uint32Array(0);
+        this.instanceCount = 0;
+        this.mapWidth = 0;
+        this.mapHeight = 0;
+        /** map copies wrapped into view this frame and the transform of the first one */
+        this.copy0 = 0;
+        this.copy1 = -1;
+        this.firstTransform = 0;
+    }
+    /**
+     *
+     * @param {AtlasContainer} atlas
+     */
+    setAtlas(atlas) {
+        this.atlas = atlas;
+    }
+    /**
+     *
+     * @param {GameMap} map
+     */
+    initMap(map) {
+        this.vao = createVAO();
+        this.vbo = createBuffer();
+        this.ebo = createBuffer();
+        this.instanceVbo = createBuffer();
+        const { vao, vbo, ebo, instanceVbo, atlas } = this;
+        if (!atlas) {
+            throw new Error("Atlas not initialized");
+        }
+        this.textures = [atlas.texture];
+        /** @type {Partial<Record<EnumValue<typeof TileCollisionType>, Rectangle>>} */
+        const rects = {
+            [TileCollisionType.Full]: atlas.atlasData["atlas/platform/block"],
+            [TileCollisionType.OneWaySlope45]: atlas.atlasData["atlas/platform/slope45oneway"],
+        };
+        const chunksX = this.chunksX = Math.ceil(map.mWidth / CHUNK_SIZE);
+        const chunksY = this.chunksY = Math.ceil(map.mHeight / CHUNK_SIZE);
+        const chunks = this.chunks = new Uint32Array(chunksX * chunksY * 2);
+        this.mapWidth = map.mWidth;
+        this.mapHeight = map.mHeight;
+        let instanceCount = 0;
+        for (const tile of map.mTilesCollision) {
+            if (rects[tile]) {
+                instanceCount++;
+            }
+        }
+        // instances are stored chunk by chunk so a row of chunks is one contiguous range
+        const instances = new Float32Array(instanceCount * INSTANCE_SIZE);
+        const position = vec2.create();
+        let n = 0;
+        for (let cy = 0; cy < chunksY; cy++) {
+            for (let cx = 0; cx < chunksX; cx++) {
+                const chunk = (cy * chunksX + cx) * 2;
+                chunks[chunk] = n;
+                for (let i = cy * CHUNK_SIZE; i < Math.min(map.mHeight, (cy + 1) * CHUNK_SIZE); i++) {
+                    for (let j = cx * CHUNK_SIZE; j < Math.min(map.mWidth, (cx + 1) * CHUNK_SIZE); j++) {
+                        const rect = rects[map.getCollisionType(j, i)];
+                        if (!rect) {
+                            continue;
+                        }
+                        map.getMapTilePosition(position, j, i);
+                        const k = n * INSTANCE_SIZE;
+                        instances[k + 0] = position[0];
+                        instances[k + 1] = position[1];
+                        instances[k + 2] = rect.x / atlas.atlasSize;
+                        instances[k + 3] = rect.y / atlas.atlasSize;
+                        instances[k + 4] = (rect.x + rect.width) / atlas.atlasSize;
+                        instances[k + 5] = (rect.y + rect.height) / atlas.atlasSize;
+                        n++;
+                    }
+                }
+                chunks[chunk + 1] = n - chunks[chunk];
+            }
+        }
+        this.instanceCount = n;
+        bindVAO(vao);
+        bindVBO(vbo);
+        bufferData(new Float32Array([
+            +0.5, +0.5,
+            +0.5, -0.5,
+            -0.5, -0.5,
+            -0.5, +0.5,
+        ]));
+        setVertexAttributePointer(0, 2, false, 2, 0);
+        enableVertexAttribute(0);
+        bindEBO(ebo);
+        bufferDataElement(new Uint32Array([
+            0, 1, 2,
+            0, 2, 3
+        ]));
+        bindVBO(instanceVbo);
+        bufferData(instances);
+        setVertexAttributePointer(1, 2, false, INSTANCE_SIZE, 0);
+        enableVertexAttribute(1);
+        setVertexAttributeDivisor(1, 1);
+        setVertexAttributePointer(2, 4, false, INSTANCE_SIZE, 2);
+        enableVertexAttribute(2);
+        setVertexAttributeDivisor(2, 1);
+    }
+    /**
+     * Queues one transform per copy of the map that is wrapped horizontally into view,
+     * before the frame's transforms are uploaded.
+     * @param {FrameUniforms} uniforms
+     * @param {number} left visible rect in map space
+     * @param {number} right
+     */
+    pushTransforms(uniforms, left, right) {
+        // tile centers sit on multiples of cTileSize, so tile j covers [(j - 0.5), (j + 0.5)) * cTileSize
+        this.copy0 = Math.floor(Math.floor(left / cTileSize + 0.5) / this.mapWidth);
+        this.copy1 = Math.min(Math.floor(Math.floor(right / cTileSize + 0.5) / this.mapWidth), this.copy0 + uniforms.freeTransforms - 1);
+        for (let copy = this.copy0; copy <= this.copy1; copy++) {
+            const transform = uniforms.pushTransform(copy * this.mapWidth * cTileSize, 0);
+            if (copy === this.copy0) {
+                this.firstTransform = transform;
+            }
+        }
+    }
+    /**
+     * Draws the copies queued by `pushTransforms`, the Camera and Transforms blocks must be bound.
+     * @param {number} left visible rect in map space
+     * @param {number} bottom
+     * @param {number} right
+     * @param {number} top
+     */
+    render(left, bottom, right, top) {
+        const { vao, instanceVbo, program, textures, chunks, chunksX, chunksY } = this;
+        if (!vao) {
+            throw new Error("VAO not initialized");
+        }
+        if (!instanceVbo) {
+            throw new Error("VBO not initialized");
+        }
+        if (this.instanceCount === 0) {
+            return;
+        }
+        useProgram(getProgram(program));
+        bindVAO(vao);
+        uniform1f(getUniformLocationCached(program, "u_tileSize"), cTileSize);
+        for (let index = 0; index < textures.length; index++) {
+            const element = textures[index];
+            activeTexture(index);
+            bindTexture(element);
+            uniform1i(getUniformLocationCached(program, textureUniforms[index]), index);
+        }
+        bindVBO(instanceVbo);
+        const tileLeft = Math.floor(left / cTileSize + 0.5);
+        const tileRight = Math.floor(right / cTileSize + 0.5);
+        const cy0 = Math.max(0, Math.floor(Math.floor(bottom / cTileSize + 0.5) / CHUNK_SIZE));
+        const cy1 = Math.min(chunksY - 1, Math.floor(Math.floor(top / cTileSize + 0.5) / CHUNK_SIZE));
+        const { copy0, copy1 } = this;
+        for (let copy = copy0; copy <= copy1; copy++) {
+            const cx0 = Math.max(0, Math.floor((tileLeft - copy * this.mapWidth) / CHUNK_SIZE));
+            const cx1 = Math.min(chunksX - 1, Math.floor((tileRight - copy * this.mapWidth) / CHUNK_SIZE));
+            if (cx0 > cx1 || cy0 > cy1) {
+                continue;
+            }
+            uniform1i(getUniformLocationCached(program, "u_transform"), this.firstTransform + copy - copy0);
+            for (let cy = cy0; cy <= cy1; cy++) {
+                const first = chunks[(cy * chunksX + cx0) * 2];
+                const last = (cy * chunksX + cx1) * 2;
+                const count = chunks[last] + chunks[last + 1] - first;
+                if (count === 0) {
+                    continue;
+                }
+                setVertexAttributePointer(1, 2, false, INSTANCE_SIZE, first * INSTANCE_SIZE);
+                setVertexAttributePointer(2, 4, false, INSTANCE_SIZE, first * INSTANCE_SIZE + 2);
+                drawElementsInstanced(0, 6, count);
+            }
+        }
+    }
+}
+
@@ -0,0 +1,111 @@
+import { SpriteBatch } from "../component/SpriteBatch.js";
+import { cGravity, cHalfSizeX, cHalfSizeY, cJumpSpeed, cMaxFallingSpeed, cTileSize, cWalkSpeed } from "../misc/constants.js";
+import { PhysicsFlags } from "../misc/enums.js";
+import { random } from "../misc/math.js";
+import { Map as GameMap } from "../object/Map.js";
+import { EntityWorld } from "./EntityWorld.js";
+
+/** Fixed updates per animation frame, the same pace as SpriteRenderer */
+const TICKS_PER_FRAME = 10;
+
+/**
+ * NPCs that only walk, turn at walls and hop now and then. They live in an EntityWorld
+ * instead of Character objects, so a crowd is a handful of native columns.
+ */
+export class Crowd {
+    /**
+     * @param {number} capacity
+     */
+    constructor(capacity) {
+        this.world = new EntityWorld(capacity, {
+            // same columns and order as the native physics world
+            Body: { x: "f32", y: "f32", oldX: "f32", oldY: "f32", speedX: "f32", speedY: "f32", halfX: "f32", halfY: "f32", flags: "u32" },
+            Walker: { direction: "f32", jumpTimer: "f32" },
+            Sprite: { frame: "u32", ticks: "u32" },
+        });
+        const { Body, Walker, Sprite } = this.world.components;
+        this.walkers = Body.bit | Walker.bit;
+        this.sprites = Body.bit | Sprite.bit;
+    }
+    /**
+     * Drops walkers at random spots in the open rows of the map.
+     * @param {GameMap} map
+     * @param {number} count
+     * @param {number} maxFrames animation frames of the sprite
+     */
+    spawn(map, count, maxFrames) {
+        const { world } = this;
+        const { Body, Walker, Sprite } = world.components;
+        const { x, y, oldX, oldY, halfX, halfY, flags } = Body.columns;
+        const { direction, jumpTimer } = Walker.columns;
+        const { frame } = Sprite.columns;
+        for (let i = 0; i < count; i++) {
+            const row = world.row(world.create(this.walkers | this.sprites));
+            x[row] = oldX[row] = (1 + random() * (map.mWidth - 2)) * cTileSize;
+            y[row] = oldY[row] = (5 + random() * (map.mHeight - 6)) * cTileSize;
+            halfX[row] = cHalfSizeX;
+            halfY[row] = cHalfSizeY;
+            flags[row] = PhysicsFlags.Active | PhysicsFlags.Dynamic;
+            direction[row] = random() < 0.5 ? -1 : 1;
+            jumpTimer[row] = random() * 4;
+            frame[row] = Math.floor(random() * maxFrames);
+        }
+    }
+    /**
+     * @param {GameMap} map
+     * @param {number} dt
+     * @param {number} maxFrames
+     */
+    fixedUpdate(map, dt, maxFrames) {
+        const { world, walkers, sprites } = this;
+        const { Body, Walker, Sprite } = world.components;
+        const { speedX, speedY, flags } = Body.columns;
+        const { direction, jumpTimer } = Walker.columns;
+        const { frame, ticks } = Sprite.columns;
+        const { ranges } = world;
+        let count = world.query(walkers);
+        for (let r = 0; r < count; r++) {
+            for (let i = ranges[r * 2]; i < ranges[r * 2 + 1]; i++) {
+                const bodyFlags = flags[i];
+                if (bodyFlags & (direction[i] > 0 ? PhysicsFlags.PushesRight : PhysicsFlags.PushesLeft)) {
+                    direction[i] = -direction[i];
+                }
+                speedX[i] = direction[i] * cWalkSpeed * 0.5;
+                jumpTimer[i] -= dt;
+                if (jumpTimer[i] <= 0 && bodyFlags & PhysicsFlags.PushesBottom) {
+                    speedY[i] = cJumpSpeed;
+                    jumpTimer[i] = 1 + random() * 3;
+                }
+            }
+        }
+        world.stepPhysics(map.mPhysics, walkers, Body, dt, cGravity, cMaxFallingSpeed);
+        count = world.query(sprites);
+        for (let r = 0; r < count; r++) {
+            for (let i = ranges[r * 2]; i < ranges[r * 2 + 1]; i++) {
+                if (++ticks[i] === TICKS_PER_FRAME) {
+                    ticks[i] = 0;
+                    frame[i] = (frame[i] + 1) % maxFrames;
+                }
+            }
+        }
+    }
+    /**
+     * Batches every sprite between its last two fixed-step positions.
+     * @param {SpriteBatch} spriteBatch
+     * @param {SpriteQuad} quad
+     * @param {number} alpha
+     */
+    render(spriteBatch, quad, alpha) {
+        const { world, sprites } = this;
+        const { x, y, oldX, oldY } = world.components.Body.columns;
+        const { direction } = world.components.Walker.columns;
+        const { frame } = world.components.Sprite.columns;
+        const { ranges } = world;
+        const count = world.query(sprites);
+        for (let r = 0; r < count; r++) {
+            for (let i = ranges[r * 2]; i < ranges[r * 2 + 1]; i++) {
+                spriteBatch.push(oldX[i] + (x[i] - oldX[i]) * alpha, oldY[i] + (y[i] - oldY[i]) * alpha, direction[i] < 0 ? -1 : 1, 1, quad, frame[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,118 @@
+import { createECSWorld, createEntity, destroyEntity, queryEntities, stepEntityPhysics } from "../libs.js";
+import { PhysicsWorld } from "../object/PhysicsWorld.js";
+
+/** Cells before the row tables, must match ECS_HEADER_SIZE in libs/context.c */
+const ECS_HEADER_SIZE = 4;
+
+/**
+ * @typedef {"f32" | "u32"} ColumnType
+ * @typedef {{ bit: number, first: number, columns: Record<string, Float32Array | Uint32Array> }} Component
+ */
+
+/**
+ * Entity table shared with the native ecs module. Every component column is a view on
+ * native memory and rows stay packed, so systems index the columns by row directly.
+ */
+export class EntityWorld {
+    /**
+     * @param {number} capacity
+     * @param {Record<string, Record<string, ColumnType>>} schema columns of every component, at most 32 components
+     */
+    constructor(capacity, schema) {
+        const names = Object.keys(schema);
+        if (names.length > 32) {
+            throw new RangeError("An entity world holds at most 32 components");
+        }
+        let columns = 0;
+        for (const name of names) {
+            columns += Object.keys(schema[name]).length;
+        }
+        const { id, buffer } = createECSWorld(capacity, columns);
+        const table = (/** @type {number} */ index, /** @type {number} */ length) => new Uint32Array(buffer, (ECS_HEADER_SIZE + index * capacity) * 4, length);
+        this.id = id;
+        this.capacity = capacity;
+        this.header = new Uint32Array(buffer, 0, ECS_HEADER_SIZE);
+        /** component bits per row */
+        this.masks = table(0, capacity);
+        /** entity id per row */
+        this.entities = table(1, capacity);
+        /** row per entity id */
+        this.rows = table(2, capacity);
+        /** [start, end) row pairs of the last query */
+        this.ranges = table(3, capacity * 2);
+        /** @type {Record<string, Component>} */
+        this.components = {};
+        let first = 0;
+        names.forEach((name, bit) => {
+            /** @type {Component} */
+            const component = { bit: (1 << bit) >>> 0, first, columns: {} };
+            for (const [column, type] of Object.entries(schema[name])) {
+                const offset = (ECS_HEADER_SIZE + (5 + first) * capacity) * 4;
+                component.columns[column] = type === "u32" ? new Uint32Array(buffer, offset, capacity) : new Float32Array(buffer, offset, capacity);
+                first++;
+            }
+            this.components[name] = component;
+        });
+    }
+    /** rows in use, they are always the first `count` */
+    get count() {
+        return this.header[0];
+    }
+    /**
+     * @param {number} mask component bits
+     * @returns {number} entity id, its row starts zeroed
+     */
+    create(mask) {
+        return createEntity(this.id, mask);
+    }
+    /**
+     * Moves the last row into the freed one, rows read before this call may be stale.
+     * @param {number} entity
+     */
+    destroy(entity) {
+        destroyEntity(this.id, entity);
+    }
+    /**
+     * @param {number} entity
+     * @returns {number}
+     */
+    row(entity) {
+        return this.rows[entity];
+    }
+    /**
+     * @param {number} entity
+     * @param {number} mask
+     */
+    add(entity, mask) {
+        this.masks[this.rows[entity]] |= mask;
+    }
+    /**
+     * @param {number} entity
+     * @param {number} mask
+     */
+    remove(entity, mask) {
+        this.masks[this.rows[entity]] &= ~mask;
+    }
+    /**
+     * Writes the row ranges holding every component in `mask` to `ranges`.
+     * @param {number} mask
+     * @returns {number} ranges written
+     */
+    query(mask) {
+        return queryEntities(this.id, mask);
+    }
+    /**
+     * Integrates the bodies in `mask` against the tiles of `physics` in native code, and
+     * leaves their ranges in `ranges` like `query`.
+     * @param {PhysicsWorld} physics
+     * @param {number} mask
+     * @param {Component} body component with the physics world's columns, in its order
+     * @param {number} dt
+     * @param {number} gravity
+     * @param {number} maxFallingSpeed
+     * @returns {number} ranges written
+     */
+    stepPhysics(physics, mask, body, dt, gravity = 0, maxFallingSpeed = -Infinity) {
+        return stepEntityPhysics(this.id, physics.id, mask, body.first, dt, gravity, maxFallingSpeed);
+    }
+}
@@ -1,9 +1,14 @@
 import { DialogRenderer } from "./component/DialogRenderer.js";
+import { FrameUniforms } from "./component/FrameUniforms.js";
+import { Profiler } from "./component/Profiler.js";
+import { SpriteBatch } from "./component/SpriteBatch.js";
 import { SpriteRenderer } from "./component/SpriteRenderer.js";
 import { TextRenderer } from "./component/TextRenderer.js";
-import { clear, clearColor, createShaderProgram, getKey, getScreenHeight, getScreenWidth, getTime, getUniformLocation, initContext, loadAudio, loadImage, loadText, mat4, playAudio, pollEvents, resize, shouldCloseWindow, stopAudio, swapBuffers, terminate, uniformMatrix4fv, useProgram, vec2 } from "./libs.js";
-import { cTileSize, FPS, zoom } from "./misc/constants.js";
+import { beginGPUZone, beginProfileZone, clear, clearColor, collectGarbage, createShaderProgram, endGPUZone, endProfileFrame, endProfileZone, getGLStateStats, getKey, getScreenHeight, getScreenWidth, getTime, getUniformLocation, initContext, loadAudio, loadText, loadTexture, mat4, playAudio, pollEvents, resize, setManualGC, shouldCloseWindow, startRenderThread, stopAudio, swapBuffers, terminate, uniform1i, useProgram, vec2, vec3 } from "./libs.js";
+import { Crowd } from "./ecs/Crowd.js";
+import { cMaxCrowd, cTileSize, FPS, zoom } from "./misc/constants.js";
 import { KeyCode, KeyCodeGLFW, KeyInput, ObjectType } from "./misc/enums.js";
+import { random, setRandomSeed } from "./misc/math.js";
 import { buildAtlas, addAtlas as loadAtlasImages, loadAtlasShaderSource } from "./object/atlas.js";
 import { Character } from "./object/Character.js";
 import { CollisionData } from "./object/CollisionData.js";
@@ -20,11 +25,13 @@ let vertexShaderSource;
 /** @type {string}*/
 let fragmentShaderSource;
 /** @type {string}*/
+let tileVertexShaderSource;
+/** @type {string}*/
 let textVertexShaderSource;
 /** @type {string}*/
 let textFragmentShaderSource;
 
-/** @type {ImageContainer} */
+/** @type {TextureObject} */
 let imageFont;
 /** @type {MovingObject} */
 let character;
@@ -56,14 +63,21 @@ export function addProgramCache(name, program) {
  * @returns
  */
 export function getUniformLocationCached(program, name) {
-
-    const key = `${program}-${name}`;
-    if (cacheUniformLocation.has(key)) {
-        return cacheUniformLocation.get(key);
+    // keyed by program, then name, so a lookup builds no key string
+    let locations = cacheUniformLocation.get(program);
+    if (locations === undefined) {
+        locations = new Map();
+        cacheUniformLocation.set(program, locations);
+    }
+    if (locations.has(name)) {
+        return locations.get(name);
     }
     const location = getUniformLocation(programCache.get(program), name);
-    cacheUniformLocation.set(key, location);
+    locations.set(name, location);
+    return location;
 }
+/** `u_texture${index}` per texture unit, built once so binding textures builds no strings */
+export const textureUniforms = Object.freeze(Array.from({ length: 8 }, (_, index) => `u_texture${index}`));
 /**
  * @param {string} name
  * @returns {WebGLProgram}
@@ -77,35 +91,75 @@ export function getProgram(name) {
 
 
 export async function load() {
-    dialogRenderer.initStory(await loadText("resources/story/story.txt"));
-    vertexShaderSource = await loadText("resources/glsl/sprite.vert.sk");
-    fragmentShaderSource = await loadText("resources/glsl/sprite.frag.sk");
-    textVertexShaderSource = await loadText("resources/glsl/text.vert.sk");
-    textFragmentShaderSource = await loadText("resources/glsl/text.frag.sk");
-    fontSource = await loadText("resources/font/NotoSansSC-Regular.json");
-    imageFont = await loadImage("resources/font/NotoSansSC-Regular.png");
-    await loadAudio("resources/audio/song18.mp3");
-    await loadAudio("resources/audio/bleep.mp3");
-    await loadAtlasShaderSource();
-    await loadAtlasImages();
+    // every file is in flight at once, the native loader reads and decodes them on worker threads
+    const [story] = await Promise.all([
+        loadText("resources/story/story.json"),
+        loadText("resources/glsl/sprite.vert.sk").then(text => vertexShaderSource = text),
+        loadText("resources/glsl/sprite.frag.sk").then(text => fragmentShaderSource = text),
+        loadText("resources/glsl/tile.vert.sk").then(text => tileVertexShaderSource = text),
+        loadText("resources/glsl/text.vert.sk").then(text => textVertexShaderSource = text),
+        loadText("resources/glsl/text.frag.sk").then(text => textFragmentShaderSource = text),
+        loadText("resources/font/NotoSansSC-Regular.json").then(text => fontSource = text),
+        loadTexture("resources/font/NotoSansSC-Regular.png").then(texture => imageFont = texture),
+        loadAudio("resources/audio/song18.mp3"),
+        loadAudio("resources/audio/bleep.mp3"),
+        loadAtlasShaderSource(),
+        loadAtlasImages(),
+    ]);
+    dialogRenderer.initStory(story);
 }
 
-const m = mat4.create();
+/** Camera and model transforms shared by the sprite and tile programs */
+const frameUniforms = new FrameUniforms();
 /** @type {Array<MovingObject>} */
 const mObjects = new Array();
 /** @type {Array<MovingObject>} */
 const mMovingPlatforms = new Array();
-const map = new GameMap();
+/**
+ * Platforms, the character, then the NPCs, in the order fixedUpdate steps them.
+ * @type {Array<MovingObject>}
+ */
+const mAllObjects = new Array();
+/**
+ * The character, then the NPCs.
+ * @type {Array<MovingObject>}
+ */
+const mCharacters = new Array();
+/** @type {GameMap} */
+let map;
 
 const atlasRenderer = new SpriteRenderer();
+const spriteBatch = new SpriteBatch();
 const textRenderer = new TextRenderer();
 const dialogRenderer = new DialogRenderer();
-export function init() {
-    initContext();
+const crowd = new Crowd(cMaxCrowd);
+const profiler = new Profiler();
+const zones = {
+    update: profiler.zone("update"),
+    fixedUpdate: profiler.zone("fixedUpdate"),
+    render: profiler.zone("render"),
+    swapBuffers: profiler.zone("swapBuffers"),
+    pollEvents: profiler.zone("pollEvents"),
+    gc: profiler.zone("gc"),
+    tiles: profiler.gpuZone("tiles"),
+    platforms: profiler.gpuZone("platforms"),
+    sprites: profiler.gpuZone("sprites"),
+    atlas: profiler.gpuZone("atlas"),
+    text: profiler.gpuZone("text"),
+    dialog: profiler.gpuZone("dialog"),
+};
+/**
+ * @param {number} [seed] fixes the map and animation offsets, a new layout every run by default
+ */
+export function init(seed = Date.now()) {
+    setRandomSeed(seed);
+    map = new GameMap();
     playAudio(0, 1, true);
     const atlas = buildAtlas();
     atlasRenderer.setAtlas(atlas);
     atlasRenderer.initQuad(0, 0, atlas.atlasSize, atlas.atlasSize);
+    spriteBatch.setAtlas(atlas);
+    spriteBatch.init();
     Slopes.init();
     {
         const program = createShaderProgram(textVertexShaderSource, textFragmentShaderSource);
@@ -125,7 +179,14 @@ export function init() {
         const program = createShaderProgram(vertexShaderSource, fragmentShaderSource);
         addProgramCache("sprite", program);
         useProgram(program);
+        frameUniforms.bindBlocks(program);
+    }
+    {
+        const program = createShaderProgram(tileVertexShaderSource, fragmentShaderSource);
+        addProgramCache("tile", program);
+        frameUniforms.bindBlocks(program);
     }
+    frameUniforms.init();
     {
         character = new Character(map, inputs, prevInputs);
         character.mSpriteRenderer.setAtlas(atlas);
@@ -161,13 +222,47 @@ export function init() {
         o.mPosition[1] = 200;
         mMovingPlatforms.push(o);
     }
-    map.spriteRenderer.setAtlas(atlas);
-    map.spriteRenderer.initMap(map);
+    map.tileMapRenderer.setAtlas(atlas);
+    map.tileMapRenderer.initMap(map);
+    collectObjects();
 
     clearColor(0.5, 1, 0.5, 1.0);
 
 
 
+}
+/**
+ * Adds NPCs at random open spots above the floor.
+ * @param {number} count
+ */
+export function spawnNPCs(count) {
+    const atlas = character.mSpriteRenderer.atlas;
+    for (let i = 0; i < count; i++) {
+        const o = new Character(map);
+        o.mSpriteRenderer.setAtlas(atlas);
+        o.init();
+        o.mType = ObjectType.NPC;
+        o.mPosition[0] = (1 + random() * (map.mWidth - 2)) * cTileSize;
+        o.mPosition[1] = (5 + random() * (map.mHeight - 6)) * cTileSize;
+        mObjects.push(o);
+    }
+    collectObjects();
+}
+/**
+ * Rebuilds the update and draw lists after objects are added, so frames reuse them.
+ */
+function collectObjects() {
+    mAllObjects.length = 0;
+    mAllObjects.push(...mMovingPlatforms, character, ...mObjects);
+    mCharacters.length = 0;
+    mCharacters.push(character, ...mObjects);
+}
+/**
+ * Adds walkers to the ECS crowd, they share the player's sprite.
+ * @param {number} count
+ */
+export function spawnCrowd(count) {
+    crowd.spawn(map, count, character.mSpriteRenderer.maxFrames);
 }
 let audioOn = true;
 export function fixedUpdate() {
@@ -183,27 +278,28 @@ export function fixedUpdate() {
         }
     }
     dialogRenderer.updateSelection(inputs, prevInputs);
-    const objs = mMovingPlatforms.concat([character]).concat(mObjects);
-    for (const obj of objs) {
+    const objs = mAllObjects;
+    for (let i = 0; i < objs.length; i++) {
+        const obj = objs[i];
         switch (obj.mType) {
             case ObjectType.Player:
             case ObjectType.NPC:
             case ObjectType.MovingPlatform:
                 obj.deltaTime = 1 / FPS;
                 obj.customUpdate();
-                map.updateAreas(obj);
-                obj.mAllCollidingObjects.splice(0, obj.mAllCollidingObjects.length);
+                obj.mAllCollidingObjects.length = 0;
                 break;
         }
 
     }
-    map.checkCollisions();
-    for (const element of objs) {
-        element.updatePhysicsP2();
-        element.tickPosition();
+    map.checkCollisions(objs);
+    for (let i = 0; i < objs.length; i++) {
+        objs[i].updatePhysicsP2();
+        objs[i].tickPosition();
     }
+    crowd.fixedUpdate(map, 1 / FPS, character.mSpriteRenderer.maxFrames);
     const collisions = character.mAllCollidingObjects;
-    textRenderer.message = `${collectCollisions()}\nCollisions: ${collisions.length}\nMuted: ${!audioOn}, DialogOn: ${dialogRenderer.visible}`;
+    updateMessage(collisions);
     textRenderer.updateText();
     toggleCharacterIconVisibility(collisions);
 }
@@ -225,80 +321,128 @@ function toggleCharacterIconVisibility(collisions) {
     }
 }
 
+const objectTypeNames = Object.keys(ObjectType);
+/** collisions of the character per ObjectType */
+const collisionCounts = new Uint32Array(objectTypeNames.length);
+/** what the message shows, it is only rebuilt when something here changes */
+const shownCounts = new Uint32Array(objectTypeNames.length);
+/** @type {boolean | undefined} */
+let shownAudioOn;
+/** @type {boolean | undefined} */
+let shownDialogOn;
+/**
+ * @param {CollisionData[]} collisions
+ */
+function updateMessage(collisions) {
+    collisionCounts.fill(0);
+    for (let i = 0; i < collisions.length; i++) {
+        collisionCounts[collisions[i].other.mType]++;
+    }
+    let changed = audioOn !== shownAudioOn || dialogRenderer.visible !== shownDialogOn;
+    for (let i = 0; i < collisionCounts.length && !changed; i++) {
+        changed = collisionCounts[i] !== shownCounts[i];
+    }
+    if (!changed) {
+        return;
+    }
+    shownCounts.set(collisionCounts);
+    shownAudioOn = audioOn;
+    shownDialogOn = dialogRenderer.visible;
+    textRenderer.message = `${collectCollisions()}\nCollisions: ${collisions.length}\nMuted: ${!audioOn}, DialogOn: ${dialogRenderer.visible}`;
+}
 function collectCollisions() {
-    const collisions = character.mAllCollidingObjects;
-    /** @type {Record<string, number>} */
-    const info = {};
-    for (const collision of collisions) {
-        const type = Object.keys(ObjectType)[collision.other.mType];
-        if (info[type] === undefined) {
-            info[type] = 0;
+    /** @type {string[]} */
+    const lines = [];
+    for (let type = 0; type < collisionCounts.length; type++) {
+        if (collisionCounts[type] !== 0) {
+            lines.push(`${objectTypeNames[type]}: ${collisionCounts[type]}`);
         }
-        info[type]++;
     }
-    return Object.keys(info).map((key) => `${key}: ${info[key]}`).join("\n");
+    return lines.join("\n");
 }
 const viewOffset = vec2.fromValues(0, 0);
+// scratch vectors of render, so a frame allocates nothing
+const viewTarget = vec2.create();
+const rounded = vec2.create();
+const eye = vec3.create();
+const center = vec3.create();
+const up = vec3.fromValues(0, 1, 0);
+const zoomScale = vec3.fromValues(zoom, zoom, 1);
 /** @param {number} alpha  */
 export function render(alpha) {
     resize();
     clear();
     const program = "sprite";
-    useProgram(getProgram(program));
-    mat4.identity(m)
-    mat4.ortho(m, -getScreenWidth() / 2, getScreenWidth() / 2, -getScreenHeight() / 2, getScreenHeight() / 2, 1, -1);
-    uniformMatrix4fv(getUniformLocationCached(program, "u_projection"), false, m);
-    mat4.identity(m);
-    vec2.lerp(viewOffset, viewOffset, vec2.scale(vec2.create(), [character.position[0], character.position[1]], zoom), 0.05);
+    const { projection, view, world } = frameUniforms;
+    mat4.ortho(projection, -getScreenWidth() / 2, getScreenWidth() / 2, -getScreenHeight() / 2, getScreenHeight() / 2, 1, -1);
+    vec2.lerp(viewOffset, viewOffset, vec2.scale(viewTarget, character.position, zoom), 0.05);
     clampViewOffset(viewOffset);
-    const rounded = vec2.round(vec2.create(), viewOffset);
-    mat4.lookAt(m, [...rounded, 1], [...rounded, -1], [0, 1, 0]);
-    uniformMatrix4fv(getUniformLocationCached(program, "u_view"), false, m);
-    mat4.identity(m)
-    mat4.scale(m, m, [zoom, zoom, 1]);
-    uniformMatrix4fv(getUniformLocationCached(program, "u_world"), false, m);
-    const currentX = Math.floor(character.position[0] / (map.mWidth * cTileSize));
-    for (let i = currentX - 2; i < currentX + 3; ++i) {
-        mat4.identity(m);
-        mat4.translate(m, m, [i * map.mWidth * cTileSize, 0, 0]);
-        uniformMatrix4fv(getUniformLocationCached(program, "u_model"), false, m);
-        map.spriteRenderer.render();
-    }
+    vec2.round(rounded, viewOffset);
+    mat4.lookAt(view, vec3.set(eye, rounded[0], rounded[1], 1), vec3.set(center, rounded[0], rounded[1], -1), up);
+    mat4.identity(world)
+    mat4.scale(world, world, zoomScale);
+    frameUniforms.reset();
+    // sprites are batched in world space, so their model matrix is identity
+    const worldSpace = frameUniforms.pushTransform(0, 0);
+    // characters follow the unrounded view, which is the rounded one moved by the rounding error
+    const dx = (rounded[0] - viewOffset[0]) / zoom;
+    const dy = (rounded[1] - viewOffset[1]) / zoom;
+    const smooth = frameUniforms.pushTransform(dx, dy);
+    const atlasPreview = frameUniforms.pushTransform(dx + 100, dy + getScreenHeight() - 128);
+    const left = (rounded[0] - getScreenWidth() / 2) / zoom;
+    const bottom = (rounded[1] - getScreenHeight() / 2) / zoom;
+    const right = (rounded[0] + getScreenWidth() / 2) / zoom;
+    const top = (rounded[1] + getScreenHeight() / 2) / zoom;
+    map.tileMapRenderer.pushTransforms(frameUniforms, left, right);
+    frameUniforms.upload();
+    beginGPUZone(zones.tiles);
+    map.tileMapRenderer.render(left, bottom, right, top);
+    endGPUZone();
 
+    useProgram(getProgram(program));
+    uniform1i(getUniformLocationCached(program, "u_transform"), worldSpace);
     for (let i = 0; i < mMovingPlatforms.length; ++i) {
         const obj = mMovingPlatforms[i];
         obj.mAlpha = alpha;
-        mat4.identity(m);
-        mat4.translate(m, m, [obj.position[0], obj.position[1], 0]);
-        mat4.scale(m, m, [obj.scale[0], obj.scale[1], 1]);
-        uniformMatrix4fv(getUniformLocationCached(program, "u_model"), false, m);
-        obj.mSpriteRenderer.render();
+        const position = obj.position;
+        const scale = obj.scale;
+        obj.mSpriteRenderer.batch(spriteBatch, position[0], position[1], scale[0], scale[1]);
     }
+    beginGPUZone(zones.platforms);
+    spriteBatch.flush();
+    endGPUZone();
 
-    mat4.lookAt(m, [...viewOffset, 1], [...viewOffset, -1], [0, 1, 0]);
-    uniformMatrix4fv(getUniformLocationCached(program, "u_view"), false, m);
-    const objects = [character].concat(mObjects);
+    uniform1i(getUniformLocationCached(program, "u_transform"), smooth);
+    const objects = mCharacters;
     for (let i = 0; i < objects.length; ++i) {
         const obj = objects[i];
         obj.mAlpha = alpha;
-        mat4.identity(m);
-        mat4.translate(m, m, [obj.position[0], obj.position[1], 0]);
-        mat4.scale(m, m, [obj.scale[0], obj.scale[1], 1]);
-        uniformMatrix4fv(getUniformLocationCached(program, "u_model"), false, m);
-        obj.mSpriteRenderer.render();
+        const position = obj.position;
+        const scale = obj.scale;
+        obj.mSpriteRenderer.batch(spriteBatch, position[0], position[1], scale[0], scale[1]);
         if (obj instanceof Character) {
-            obj.mIconSpriteRenderer.render();
+            obj.mIconSpriteRenderer.batch(spriteBatch, position[0], position[1], scale[0], scale[1]);
         }
-        obj.mSpriteRenderer.render();
     }
+    const quad = character.mSpriteRenderer.quad;
+    if (quad) {
+        crowd.render(spriteBatch, quad, alpha);
+    }
+    beginGPUZone(zones.sprites);
+    spriteBatch.flush();
+    endGPUZone();
     {
-        mat4.identity(m);
-        mat4.translate(m, m, [100, getScreenHeight() - 128, 0]);
-        uniformMatrix4fv(getUniformLocationCached(program, "u_model"), false, m);
+        uniform1i(getUniformLocationCached(program, "u_transform"), atlasPreview);
+        beginGPUZone(zones.atlas);
         atlasRenderer.render();
+        endGPUZone();
     }
+    beginGPUZone(zones.text);
     textRenderer.render();
+    endGPUZone();
+    beginGPUZone(zones.dialog);
     dialogRenderer.render();
+    endGPUZone();
 }
 /**
  * 
@@ -319,10 +463,15 @@ function clampViewOffset(viewOffset) {
  * @type {typeof KeyCodeGLFW | typeof KeyCode}
  */
 let keys;
+const keyInputs = Object.values(KeyInput);
 function update() {
-    prevInputs.clear();
-    for (const input of inputs) {
-        prevInputs.add(input);
+    // mirrored in place, so held keys do not drop and re-add set entries every frame
+    for (let i = 0; i < keyInputs.length; i++) {
+        if (inputs.has(keyInputs[i])) {
+            prevInputs.add(keyInputs[i]);
+        } else {
+            prevInputs.delete(keyInputs[i]);
+        }
     }
     if (getKey(keys.RightKey)) {
         inputs.add(KeyInput.GoRight)
@@ -384,44 +533,95 @@ function update() {
     } else {
         inputs.delete(KeyInput.Confirm)
     }
+    if (getKey(keys.PKey)) {
+        inputs.add(KeyInput.DumpProfile);
+    } else {
+        inputs.delete(KeyInput.DumpProfile)
+    }
+    if (getKey(keys.AKey)) {
+        inputs.add(KeyInput.TrackAllocations);
+    } else {
+        inputs.delete(KeyInput.TrackAllocations)
+    }
+    if (inputs.has(KeyInput.DumpProfile) && !prevInputs.has(KeyInput.DumpProfile)) {
+        profiler.dump("profile.json");
+    }
+    if (inputs.has(KeyInput.TrackAllocations) && !prevInputs.has(KeyInput.TrackAllocations)) {
+        profiler.trackAllocations = !profiler.trackAllocations;
+    }
 }
-export async function mainQuickjs() {
+/**
+ * @param {{ renderThread?: boolean }} [options] renderThread: publish a frame per fixed step
+ * and let the native render thread interpolate between them at the display rate
+ */
+export async function mainQuickjs({ renderThread = false } = {}) {
     keys = KeyCodeGLFW;
+    initContext();
     await load();
     init();
+    const threaded = renderThread && startRenderThread();
+    // the GC only runs between frames, see collectGarbage below
+    setManualGC(true);
     let acc = 0;
     let lastTime = getTime();
     let timer = lastTime;
     let frames = 0;
     let updates = 0;
+    // frames whose idle time was too short for a due whole heap collection
+    let gcDeferred = 0;
     while (!shouldCloseWindow()) {
         const currentTime = getTime();
         const delta = (currentTime - lastTime) / (1 / FPS);
         acc += delta;
         lastTime = currentTime;
+        beginProfileZone(zones.update);
         update();
+        endProfileZone();
+        let ticks = 0;
         while (acc >= 1) {
+            beginProfileZone(zones.fixedUpdate);
             fixedUpdate();
+            endProfileZone();
             updates++;
+            ticks++;
             acc--;
         }
-        render(acc);
-        swapBuffers();
-        pollEvents();
-        frames++;
+        // threaded, a frame is the state after the last tick and the render thread blends
+        // between the last two; nothing changed without a tick
+        if (!threaded || ticks > 0) {
+            beginProfileZone(zones.render);
+            render(threaded ? 1 : acc);
+            endProfileZone();
+            beginProfileZone(zones.swapBuffers);
+            swapBuffers();
+            endProfileZone();
+            frames++;
+        }
+        // collect in the time left before the next tick rather than in the middle of render()
+        beginProfileZone(zones.gc);
+        if (!collectGarbage(Math.max(0, currentTime + (1 - acc) / FPS - getTime()))) {
+            gcDeferred++;
+        }
+        endProfileZone();
+        beginProfileZone(zones.pollEvents);
+        pollEvents(threaded ? (1 - acc) / FPS : 0);
+        endProfileZone();
+        endProfileFrame();
         // - Reset after one second
         if (getTime() - timer > 1.0) {
             timer++;
-            const msg = `FPS: ${frames} Updates: ${updates}`;
-            textRenderer.status = (msg);
+            const gl = getGLStateStats(true);
+            const msg = `FPS: ${frames} Updates: ${updates} GL calls: ${gl.issued} issued, ${gl.skipped} skipped GC deferred: ${gcDeferred}`;
+            textRenderer.status = `${msg}\n${profiler.summarize(frames)}`;
             textRenderer.updateText();
-            updates = 0, frames = 0;
+            updates = 0, frames = 0, gcDeferred = 0;
         }
     }
     terminate();
 }
 export async function main() {
     keys = KeyCode;
+    initContext();
     await load();
     init();
     let acc = 0;
@@ -434,20 +634,28 @@ export async function main() {
         const delta = (currentTime - lastTime) / (1 / FPS);
         acc += delta;
         lastTime = currentTime;
+        beginProfileZone(zones.update);
         update();
+        endProfileZone();
         while (acc >= 1) {
+            beginProfileZone(zones.fixedUpdate);
             fixedUpdate();
+            endProfileZone();
             updates++;
             acc--;
         }
+        beginProfileZone(zones.render);
         render(acc);
+        endProfileZone();
+        endProfileFrame();
         frames++;
 
         // - Reset after one second
         if (getTime() - timer > 1.0) {
             timer++;
-            const msg = `FPS: ${frames} Updates: ${updates}`;
-            textRenderer.status = (msg);
+            const gl = getGLStateStats(true);
+            const msg = `FPS: ${frames} Updates: ${updates} GL calls: ${gl.issued} issued, ${gl.skipped} skipped`;
+            textRenderer.status = `${msg}\n${profiler.summarize(frames)}`;
             textRenderer.updateText();
             updates = 0, frames = 0;
         }
@@ -455,4 +663,54 @@ export async function main() {
     }
     loop();
 
-}
\ No newline at end of file
+}
+/**
+ * Runs the game headless on the fixed clock, one update, fixedUpdate and render per frame,
+ * and returns the mean wall time of each phase in nanoseconds.
+ * @param {{frames: number, warmup: number, objects: number, crowd: number, seed: number, input: Array<[number, number, number]>}} options
+ * @param {() => number} now wall clock in milliseconds
+ */
+export async function benchmark({ frames, warmup, objects, crowd: walkers, seed, input }, now) {
+    keys = KeyCodeGLFW;
+    initContext({ headless: true, timestep: 1 / FPS, input });
+    await load();
+    init(seed);
+    spawnNPCs(objects);
+    spawnCrowd(walkers);
+    let fixedUpdateTime = 0;
+    let renderTime = 0;
+    let start = now();
+    for (let frame = -warmup; frame < frames; frame++) {
+        if (frame === 0) {
+            fixedUpdateTime = 0;
+            renderTime = 0;
+            start = now();
+        }
+        update();
+        const t0 = now();
+        fixedUpdate();
+        const t1 = now();
+        render(0);
+        const t2 = now();
+        swapBuffers();
+        pollEvents();
+        endProfileFrame();
+        fixedUpdateTime += t1 - t0;
+        renderTime += t2 - t1;
+    }
+    const total = now() - start;
+    const ns = 1e6 / Math.max(1, frames);
+    return {
+        frames,
+        objects: mObjects.length + mMovingPlatforms.length + 1,
+        crowd: crowd.world.count,
+        seed,
+        frameNs: Math.round(total * ns),
+        fixedUpdateNs: Math.round(fixedUpdateTime * ns),
+        renderNs: Math.round(renderTime * ns),
+        // QuickJS allocations of a steady frame, anything above 0 feeds the GC
+        allocationsPerFrame: profiler.allocationsPerFrame(frames),
+        // the same seed and input track must land here on every machine
+        position: [character.mPosition[0], character.mPosition[1]],
+    };
+}
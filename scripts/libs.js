@@ -1,4 +1,19 @@
+import { mat4 as glMat4 } from "../libs/gl-matrix/index.js";
+import { mat4FromTranslation, mat4Identity, mat4LookAt, mat4Multiply, mat4Ortho, mat4Scale, mat4Translate } from "../libs/context.so";
 export * from "../libs/context.so";
 export * from "../libs/gl-matrix/index.js";
 export * as ink from "../libs/inkjs/ink.js";
 // export * from "../bitECS/dist/core/index.js"
+
+/** gl-matrix's mat4 with the calls on the render path swapped for the native kernels */
+export const mat4 = Object.freeze({
+    ...glMat4,
+    identity: mat4Identity,
+    multiply: mat4Multiply,
+    mul: mat4Multiply,
+    translate: mat4Translate,
+    scale: mat4Scale,
+    fromTranslation: mat4FromTranslation,
+    ortho: mat4Ortho,
+    lookAt: mat4LookAt,
+});
@@ -9,6 +9,8 @@ export const cHalfSizeX = 6.0;
 
 export const cWalkSfxTime = 0.5;
 export const cTileSize = 16;
+export const cMaxPhysicsBodies = 4096;
+export const cMaxCrowd = 16384;
 
 export const cOneWayPlatformThreshold = 2.0;
 
@@ -17,6 +17,23 @@ export const KeyInput = Object.freeze({
     Up: 9,
     Action: 10,
     Confirm: 11,
+    DumpProfile: 12,
+    TrackAllocations: 13,
+});
+/** Body flag bits of the native physics world, must match PHYSICS_* in libs/context.c */
+export const PhysicsFlags = Object.freeze({
+    Active: 0x1,
+    Dynamic: 0x2,
+    PushesLeft: 0x10,
+    PushesRight: 0x20,
+    PushesBottom: 0x40,
+    PushesTop: 0x80,
+});
+/** Tile classes the native physics world collides against */
+export const PhysicsTile = Object.freeze({
+    Empty: 0,
+    Solid: 1,
+    OneWay: 2,
 });
 export const KeyCode = Object.freeze({
 
@@ -32,6 +49,8 @@ export const KeyCode = Object.freeze({
     Backspace: 8,
     XKey: 88,
     CKey: 67,
+    PKey: 80,
+    AKey: 65,
 })
 
 export const KeyCodeGLFW = Object.freeze({
@@ -47,6 +66,8 @@ export const KeyCodeGLFW = Object.freeze({
     Backspace: 259,
     XKey: 88,
     CKey: 67,
+    PKey: 80,
+    AKey: 65,
 })
 export const ObjectType = Object.freeze({
     None: 0,
@@ -16,4 +16,24 @@ export function sign(x) {
  */
 export function clamp(value, min, max) {
     return Math.max(min, Math.min(value, max));
-}
\ No newline at end of file
+}
+
+let seed = Date.now() >>> 0;
+/**
+ * Reseeds `random`, a run with the same seed builds the same map and animation offsets.
+ * @param {number} value
+ */
+export function setRandomSeed(value) {
+    seed = value >>> 0;
+}
+/**
+ * Seeded replacement for Math.random (mulberry32).
+ * @returns {number} in [0, 1)
+ */
+export function random() {
+    seed = (seed + 0x6D2B79F5) >>> 0;
+    let t = seed;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+}
@@ -2,19 +2,18 @@ import { vec2 } from "../libs.js";
 import { sign } from "../misc/math.js";
 
 export class AABB {
+    /** scaled half size, the vector is reused so copy it to keep it */
     get halfSize() {
-        return vec2.fromValues(
-            this.mHalfSize[0] * this.scale[0],
-            this.mHalfSize[1] * this.scale[1]
-        );
+        return vec2.mul(this.mScaledHalfSize, this.mHalfSize, this.scale);
     }
     set halfSize(value) {
-        this.mHalfSize = vec2.fromValues(value[0], value[1]);
+        vec2.copy(this.mHalfSize, value);
     }
     constructor() {
         this.scale = vec2.fromValues(1, 1);
         this.center = vec2.create();
         this.mHalfSize = vec2.create();
+        this.mScaledHalfSize = vec2.create();
     }
     /**
      * 
@@ -42,11 +41,19 @@ export class AABB {
         out.overlap[1] = sign(this.center[1] - other.center[1]) * ((other.halfSize[1] + this.halfSize[1]) - Math.abs(this.center[1] - other.center[1]));
         return true;
     }
-    max() {
-        return vec2.add(vec2.create(), this.center, this.halfSize);
+    /**
+     * @param {vec2} out
+     * @returns {vec2} out
+     */
+    max(out) {
+        return vec2.add(out, this.center, this.halfSize);
     }
-    min() {
-        return vec2.sub(vec2.create(), this.center, this.halfSize);
+    /**
+     * @param {vec2} out
+     * @returns {vec2} out
+     */
+    min(out) {
+        return vec2.sub(out, this.center, this.halfSize);
     }
 }
 
@@ -8,6 +8,12 @@ import { sign } from "../misc/math.js";
 import { AudioClip } from "./AudioClip.js";
 import { Map } from "./Map.js";
 import { MovingObject } from "./MovingObject.js";
+
+const largeScale = vec2.fromValues(2, 2);
+const smallScale = vec2.fromValues(0.5, 0.5);
+const normalScale = vec2.fromValues(1, 1);
+const aabbCornerOffset = vec2.create();
+const tileCorner = vec2.create();
 export class Character extends MovingObject {
     /**
      * @param {Map} map
@@ -45,21 +51,21 @@ export class Character extends MovingObject {
     }
     customUpdate() {
         if (this.keyState(KeyInput.ScaleUp)) {
-            if (!vec2.equals(this.scale, vec2.fromValues(2, 2))) {
+            if (!vec2.equals(this.mScale, largeScale)) {
                 const oldHeight = this.mAABB.halfSize[1];
-                this.scale = vec2.fromValues(2, 2);
+                this.scale = largeScale;
                 this.mPosition[1] -= oldHeight - this.mAABB.halfSize[1];
             }
         } else if (this.keyState(KeyInput.ScaleDown)) {
-            if (!vec2.equals(this.scale, vec2.fromValues(0.5, 0.5))) {
+            if (!vec2.equals(this.mScale, smallScale)) {
                 const oldHeight = this.mAABB.halfSize[1];
-                this.scale = vec2.fromValues(0.5, 0.5);
+                this.scale = smallScale;
                 this.mPosition[1] -= oldHeight - this.mAABB.halfSize[1];
             }
         } else if (this.keyState(KeyInput.ScaleNormal)) {
-            if (!vec2.equals(this.scale, vec2.fromValues(1, 1))) {
+            if (!vec2.equals(this.mScale, normalScale)) {
                 const oldHeight = this.mAABB.halfSize[1];
-                this.scale = vec2.fromValues(1, 1);
+                this.scale = normalScale;
                 this.mPosition[1] -= oldHeight - this.mAABB.halfSize[1];
             }
         }
@@ -177,7 +183,6 @@ export class Character extends MovingObject {
                 if (this.mSpeed[1] <= 0.0
                     && !this.mPS.pushesTop
                     && ((this.mPS.pushesRight && this.keyState(KeyInput.GoRight)) || (this.mPS.pushesLeft && this.keyState(KeyInput.GoLeft)))) {
-                    const aabbCornerOffset = vec2.create();
 
                     if (this.mPS.pushesRight && this.keyState(KeyInput.GoRight))
                         vec2.copy(aabbCornerOffset, this.mAABB.halfSize);
@@ -197,13 +202,13 @@ export class Character extends MovingObject {
                     for (let y = topY; y >= bottomY; --y) {
                         if (!this.mMap.isObstacle(tileX, y)
                             && this.mMap.isObstacle(tileX, y - 1)) {
-                            const tileCorner = this.mMap.getMapTilePosition(tileX, y - 1);
+                            this.mMap.getMapTilePosition(tileCorner, tileX, y - 1);
                             tileCorner[0] -= sign(aabbCornerOffset[0]) * cTileSize / 2;
                             tileCorner[1] += cTileSize / 2;
                             if (y > bottomY ||
                                 ((this.mAABB.center[1] + aabbCornerOffset[1]) - tileCorner[1] <= cGrabLedgeEndY
                                     && tileCorner[1] - (this.mAABB.center[1] + aabbCornerOffset[1]) >= cGrabLedgeStartY)) {
-                                vec2.floor(this.mLedgeTile, [tileX, y - 1]);
+                                vec2.set(this.mLedgeTile, tileX, y - 1);
                                 this.mPosition[1] = tileCorner[1] - aabbCornerOffset[1] - cGrabLedgeStartY + cGrabLedgeTileOffsetY;
                                 vec2.zero(this.mSpeed)
                                 this.mCurrentState = CharacterState.GrabLedge;
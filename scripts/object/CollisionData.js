@@ -23,4 +23,27 @@ export class CollisionData {
         this.pos1 = vec2.clone(pos1);
         this.pos2 = vec2.clone(pos2);
     }
+    /**
+     * Refills a pooled instance in place.
+     * @param {MovingObject} other 
+     * @param {vec2} overlap 
+     * @param {vec2} speed1 
+     * @param {vec2} speed2 
+     * @param {vec2} oldPos1 
+     * @param {vec2} oldPos2 
+     * @param {vec2} pos1 
+     * @param {vec2} pos2 
+     * @returns {this}
+     **/
+    set(other, overlap, speed1, speed2, oldPos1, oldPos2, pos1, pos2) {
+        this.other = other;
+        vec2.copy(this.overlap, overlap);
+        vec2.copy(this.speed1, speed1);
+        vec2.copy(this.speed2, speed2);
+        vec2.copy(this.oldPos1, oldPos1);
+        vec2.copy(this.oldPos2, oldPos2);
+        vec2.copy(this.pos1, pos1);
+        vec2.copy(this.pos2, pos2);
+        return this;
+    }
 }
\ No newline at end of file
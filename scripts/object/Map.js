@@ -1,171 +1,116 @@
-import { SpriteRenderer } from "../component/SpriteRenderer.js";
+import { TileMapRenderer } from "../component/TileMapRenderer.js";
 import { vec2, vec3 } from "../libs.js";
-import { cTileSize } from "../misc/constants.js";
-import { TileCollisionType } from "../misc/enums.js";
+import { cMaxPhysicsBodies, cTileSize } from "../misc/constants.js";
+import { PhysicsFlags, PhysicsTile, TileCollisionType } from "../misc/enums.js";
+import { random } from "../misc/math.js";
 import { CollisionData } from "./CollisionData.js";
 import { MovingObject } from "./MovingObject.js";
+import { PHYSICS_CONTACT_SIZE, PhysicsWorld } from "./PhysicsWorld.js";
 const mw = 80;
 const mh = 50;
-const collisionsData = Object.freeze(new Array(mw * mh).fill(TileCollisionType.Empty).map((tile, index) => {
-    // add border
-    if (index % mw === 0 || index % mw === mw - 1 || Math.floor(index / mw) === 0 || Math.floor(index / mw) === mh - 1) {
-        return TileCollisionType.Full;
-    }
-    if (Math.floor(index / mw) < 5) {
-        return TileCollisionType.Full;
-    } else if (Math.floor(index / mw) < 30) {
-        return Math.random() < 0.02 ? TileCollisionType.Full : Math.random() < 0.02 ? TileCollisionType.OneWaySlope45 : TileCollisionType.Empty;
-    }
-    return TileCollisionType.Empty;
-}));
+/**
+ * Builds the tile layout from `random`, so the map follows the seed.
+ * @returns {Readonly<EnumValue<typeof TileCollisionType>[]>}
+ */
+function generateTiles() {
+    return Object.freeze(new Array(mw * mh).fill(TileCollisionType.Empty).map((tile, index) => {
+        // add border
+        if (index % mw === 0 || index % mw === mw - 1 || Math.floor(index / mw) === 0 || Math.floor(index / mw) === mh - 1) {
+            return TileCollisionType.Full;
+        }
+        if (Math.floor(index / mw) < 5) {
+            return TileCollisionType.Full;
+        } else if (Math.floor(index / mw) < 30) {
+            return random() < 0.02 ? TileCollisionType.Full : random() < 0.02 ? TileCollisionType.OneWaySlope45 : TileCollisionType.Empty;
+        }
+        return TileCollisionType.Empty;
+    }));
+}
+const overlap = vec2.create();
 export class Map {
     constructor() {
-        this.spriteRenderer = new SpriteRenderer();
+        this.tileMapRenderer = new TileMapRenderer();
         this.mPosition = vec3.create();
         this.mWidth = mw;
         this.mHeight = mh;
-        this.mGridAreaWidth = 16;
-        this.mGridAreaHeight = 16;
-        this.mHorizontalAreasCount = Math.ceil(this.mWidth / this.mGridAreaWidth);
-        this.mVerticalAreasCount = Math.ceil(this.mHeight / this.mGridAreaHeight);
-        /** @type {(MovingObject[])[]} */
-        this.mObjectsInArea = [];
-        for (let y = 0; y < this.mVerticalAreasCount; ++y) {
-            for (let x = 0; x < this.mHorizontalAreasCount; ++x)
-                this.mObjectsInArea[y * this.mHorizontalAreasCount + x] = [];
-        }
-        /** @type {vec2[]} */
-        this.mOverlappingAreas = [];
         /** @type {Readonly<EnumValue<typeof TileCollisionType>[]>} */
-        this.mTilesCollision = collisionsData;
-    }
-    checkCollisions() {
-        /** @type {{overlap: vec2}} */
-        const out = { overlap: vec2.create() };
-        for (let y = 0; y < this.mVerticalAreasCount; ++y) {
-            for (let x = 0; x < this.mHorizontalAreasCount; ++x) {
-                const objectsInArea = this.mObjectsInArea[y * this.mHorizontalAreasCount + x];
-                for (let i = 0; i < objectsInArea.length - 1; ++i) {
-                    const obj1 = objectsInArea[i];
-                    for (let j = i + 1; j < objectsInArea.length; ++j) {
-                        const obj2 = objectsInArea[j];
-                        if (obj1.mAABB.overlapsSigned(obj2.mAABB, out) && !obj1.hasCollisionDataFor(obj2)) {
-                            obj1.mAllCollidingObjects.push(new CollisionData(obj2, out.overlap, obj1.mSpeed, obj2.mSpeed, obj1.mOldPosition, obj2.mOldPosition, obj1.mPosition, obj2.mPosition));
-                            obj2.mAllCollidingObjects.push(new CollisionData(obj1, [-out.overlap[0], -out.overlap[1]], obj2.mSpeed, obj1.mSpeed, obj2.mOldPosition, obj1.mOldPosition, obj2.mPosition, obj1.mPosition));
-                        }
-                    }
-                }
-            }
+        this.mTilesCollision = generateTiles();
+        const collisionsData = this.mTilesCollision;
+        this.mPhysics = new PhysicsWorld(cMaxPhysicsBodies, cMaxPhysicsBodies * 4);
+        const tiles = new Uint8Array(collisionsData.length);
+        for (let i = 0; i < collisionsData.length; i++) {
+            const tile = collisionsData[i];
+            // the native world has no slope shapes, a sloped tile is solid for it
+            tiles[i] = tile === TileCollisionType.Empty ? PhysicsTile.Empty
+                : tile > TileCollisionType.OneWayStart && tile < TileCollisionType.OneWayEnd ? PhysicsTile.OneWay
+                    : PhysicsTile.Solid;
         }
+        this.mPhysics.setTiles(tiles, this.mWidth, this.mHeight, cTileSize, this.mPosition[0], this.mPosition[1]);
+        /** @type {CollisionData[]} */
+        this.mCollisionPool = [];
+        this.mCollisionPoolUsed = 0;
     }
     /**
-     * 
-     * @param {MovingObject} obj 
+     * Finds every overlapping pair with the native broadphase and fills mAllCollidingObjects.
+     * @param {MovingObject[]} objects
      */
-    updateAreas(obj) {
-        const topLeft = this.getMapTileAtPoint(vec2.add(vec2.create(), obj.mAABB.center, [-obj.mAABB.halfSize[0], obj.mAABB.halfSize[1]]));
-        const topRight = this.getMapTileAtPoint(vec2.add(vec2.create(), obj.mAABB.center, obj.mAABB.halfSize));
-        const bottomLeft = this.getMapTileAtPoint(vec2.sub(vec2.create(), obj.mAABB.center, obj.mAABB.halfSize));
-        const bottomRight = vec2.create();
-        topLeft[0] /= this.mGridAreaWidth;
-        topLeft[1] /= this.mGridAreaHeight;
-        vec2.floor(topLeft, topLeft);
-        topRight[0] /= this.mGridAreaWidth;
-        topRight[1] /= this.mGridAreaHeight;
-        vec2.floor(topRight, topRight);
-        bottomLeft[0] /= this.mGridAreaWidth;
-        bottomLeft[1] /= this.mGridAreaHeight;
-        vec2.floor(bottomLeft, bottomLeft);
-        bottomRight[0] = topRight[0];
-        bottomRight[1] = bottomLeft[1];
-
-        if (topLeft[0] === topRight[0] && topLeft[1] === bottomLeft[1]) {
-            this.mOverlappingAreas.push(topLeft);
-        } else if (topLeft[0] === topRight[0]) {
-            this.mOverlappingAreas.push(topLeft);
-            this.mOverlappingAreas.push(bottomLeft);
-        } else if (topLeft[1] === bottomLeft[1]) {
-            this.mOverlappingAreas.push(topLeft);
-            this.mOverlappingAreas.push(topRight);
-        } else {
-            this.mOverlappingAreas.push(topLeft);
-            this.mOverlappingAreas.push(bottomLeft);
-            this.mOverlappingAreas.push(topRight);
-            this.mOverlappingAreas.push(bottomRight);
+    checkCollisions(objects) {
+        const physics = this.mPhysics;
+        const { x, y, halfX, halfY, flags, contacts } = physics;
+        for (let i = 0; i < objects.length; i++) {
+            const aabb = objects[i].mAABB;
+            x[i] = aabb.center[0];
+            y[i] = aabb.center[1];
+            halfX[i] = aabb.mHalfSize[0] * aabb.scale[0];
+            halfY[i] = aabb.mHalfSize[1] * aabb.scale[1];
+            flags[i] = PhysicsFlags.Active;
         }
-        const areas = obj.mAreas;
-        const ids = obj.mIdsInAreas;
-        // if (obj.mType === ObjectType.Player) {
-        //     console.log("++++++++++++++++++++++++++++++");
-        //     console.log(obj.mType, areas.length, ...areas);
-        // }
-        for (let i = 0; i < areas.length; ++i) {
-
-            // if (obj.mType === ObjectType.Player) {
-            //     console.log(i, areas[i], ...this.mOverlappingAreas, this.mOverlappingAreas.every((a) => a[0] !== areas[i][0] || a[1] !== areas[i][1]));
-            // }
-            if (this.mOverlappingAreas.every((a) => a[0] !== areas[i][0] || a[1] !== areas[i][1])) {
-                this.removeObjectFromArea(areas[i], ids[i], obj);
-                //object no longer has an index in the area 
-                areas.splice(i, 1);
-                ids.splice(i, 1);
-                --i;
-            }
-        }
-        for (let i = 0; i < this.mOverlappingAreas.length; ++i) {
-            const area = this.mOverlappingAreas[i];
-            if (areas.every((a) => a[0] !== area[0] || a[1] !== area[1])) {
-                this.addObjectToArea(area, obj);
-            }
+        physics.count = objects.length;
+        const count = physics.step(0);
+        // collision data only lives until the next step, so the objects are reused
+        this.mCollisionPoolUsed = 0;
+        for (let k = 0; k < count; k++) {
+            const c = k * PHYSICS_CONTACT_SIZE;
+            // contact ids are read as floats, `| 0` keeps the lookup on QuickJS's int index path
+            const obj1 = objects[contacts[c] | 0];
+            const obj2 = objects[contacts[c + 1] | 0];
+            overlap[0] = contacts[c + 2];
+            overlap[1] = contacts[c + 3];
+            obj1.mAllCollidingObjects.push(this.acquireCollisionData(obj2, overlap, obj1.mSpeed, obj2.mSpeed, obj1.mOldPosition, obj2.mOldPosition, obj1.mPosition, obj2.mPosition));
+            vec2.negate(overlap, overlap);
+            obj2.mAllCollidingObjects.push(this.acquireCollisionData(obj1, overlap, obj2.mSpeed, obj1.mSpeed, obj2.mOldPosition, obj1.mOldPosition, obj2.mPosition, obj1.mPosition));
         }
-        this.mOverlappingAreas.splice(0, this.mOverlappingAreas.length);
-
     }
     /**
-     * @param {vec2} areaIndex
-     * @param {MovingObject} obj 
+     * @param {MovingObject} other 
+     * @param {vec2} overlap 
+     * @param {vec2} speed1 
+     * @param {vec2} speed2 
+     * @param {vec2} oldPos1 
+     * @param {vec2} oldPos2 
+     * @param {vec2} pos1 
+     * @param {vec2} pos2 
+     * @returns {CollisionData}
      */
-    addObjectToArea(areaIndex, obj) {
-        const area = this.mObjectsInArea[areaIndex[1] * this.mHorizontalAreasCount + areaIndex[0]];
-        //save the index of the object in the area 
-        obj.mAreas.push(areaIndex);
-        obj.mIdsInAreas.push(area.length);
-        //add the object to the area 
-        area.push(obj);
-    }
-    /**
-     * 
-     * @param {vec2} areaIndex 
-     * @param {number} objIndexInArea 
-     * @param {MovingObject} obj 
-     */
-    removeObjectFromArea(areaIndex, objIndexInArea, obj) {
-        const area = this.mObjectsInArea[areaIndex[1] * this.mHorizontalAreasCount + areaIndex[0]];
-        //swap the last item with the one we are removing
-        const tmp = area[area.length - 1];
-        area[area.length - 1] = obj;
-        area[objIndexInArea] = tmp;
-        const tmpIds = tmp.mIdsInAreas;
-        const tmpAreas = tmp.mAreas;
-        for (let i = 0; i < tmpAreas.length; ++i) {
-            if (tmpAreas[i][0] === areaIndex[0] && tmpAreas[i][1] === areaIndex[1]) {
-                tmpIds[i] = objIndexInArea;
-                break;
-            }
+    acquireCollisionData(other, overlap, speed1, speed2, oldPos1, oldPos2, pos1, pos2) {
+        const pool = this.mCollisionPool;
+        if (this.mCollisionPoolUsed < pool.length) {
+            return pool[this.mCollisionPoolUsed++].set(other, overlap, speed1, speed2, oldPos1, oldPos2, pos1, pos2);
         }
-        //remove the last item
-        area.pop();
+        const data = new CollisionData(other, overlap, speed1, speed2, oldPos1, oldPos2, pos1, pos2);
+        pool.push(data);
+        this.mCollisionPoolUsed++;
+        return data;
     }
     /**
      * 
-     * @param {vec2} point 
-     * @returns {vec2}
+     * @param {vec2} out 
+     * @param {number} x 
+     * @param {number} y 
+     * @returns {vec2} out
      */
-    getMapTileAtPoint(point) {
-        return [
-            Math.floor((point[0] - this.mPosition[0] + cTileSize / 2.0) / (cTileSize)),
-            Math.floor((point[1] - this.mPosition[1] + cTileSize / 2.0) / (cTileSize))
-        ];
+    getMapTileAtPoint(out, x, y) {
+        return vec2.set(out, this.getMapTileXAtPoint(x), this.getMapTileYAtPoint(y));
     }
 
     /**
@@ -186,13 +131,14 @@ export class Map {
     }
 
     /**
+     * @param {vec2} out
      * @param {number} tileIndexX
      * @param {number} tileIndexY
-     * @returns {vec2}
+     * @returns {vec2} out
      */
 
-    getMapTilePosition(tileIndexX, tileIndexY) {
-        return vec2.fromValues(this.mPosition[0] + tileIndexX * cTileSize, this.mPosition[1] + tileIndexY * cTileSize);
+    getMapTilePosition(out, tileIndexX, tileIndexY) {
+        return vec2.set(out, this.mPosition[0] + tileIndexX * cTileSize, this.mPosition[1] + tileIndexY * cTileSize);
     }
 
     /**
@@ -205,7 +151,7 @@ export class Map {
         if (x < 0 || x >= this.mWidth || y < 0 || y >= this.mHeight) {
             return true;
         }
-        return this.mTilesCollision[y * this.mWidth + x] === TileCollisionType.Full;
+        return this.mTilesCollision[(y * this.mWidth + x) | 0] === TileCollisionType.Full;
     }
     /**
      * 
@@ -217,7 +163,9 @@ export class Map {
         if (x <= -1 || x >= this.mWidth
             || y <= -1 || y >= this.mHeight)
             return TileCollisionType.Empty;
-        return this.mTilesCollision[y * this.mWidth + x];
+        // tile coordinates often come out of Float32Array vectors, and QuickJS turns a
+        // float index into a key string before the lookup
+        return this.mTilesCollision[(y * this.mWidth + x) | 0];
     }
 }
 
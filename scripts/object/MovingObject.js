@@ -9,16 +9,58 @@ import { Map } from "./Map.js";
 import { PositionState } from "./PositionState.js";
 import { Slopes } from "./Slopes.js";
 
+/**
+ * Scratch storage of one tile check. Left and right run top and bottom on a shifted copy of
+ * their ref, so every check has its own and a nested check leaves the caller's alone.
+ */
+function createTileScratch() {
+    return {
+        topRightTile: vec2.create(),
+        bottomLeftTile: vec2.create(),
+        tileCenter: vec2.create(),
+        prevPos: vec2.create(),
+        nextPos: vec2.create(),
+        ref: { position: vec2.create(), topRight: vec2.create(), bottomLeft: vec2.create(), state: new PositionState() },
+    };
+}
+const leftScratch = createTileScratch();
+const rightScratch = createTileScratch();
+const topScratch = createTileScratch();
+const bottomScratch = createTileScratch();
+/**
+ * The ref updatePhysics and updatePhysicsP2 hand to the tile checks, objects update one at a time.
+ * @type {{position: vec2, topRight: vec2, bottomLeft: vec2, state: PositionState, remainder: vec2, foundObstacleX: boolean, foundObstacleY: boolean}}
+ */
+const physicsRef = {
+    position: vec2.create(),
+    topRight: vec2.create(),
+    bottomLeft: vec2.create(),
+    state: new PositionState(),
+    remainder: vec2.create(),
+    foundObstacleX: false,
+    foundObstacleY: false,
+};
+const moveStep = vec2.create();
+const moveLeft = vec2.create();
+const offsetSum = vec2.create();
+const overlap = vec2.create();
+const absSpeed1 = vec2.create();
+const absSpeed2 = vec2.create();
+const speedSum = vec2.create();
+const delta = vec2.create();
+
 export class MovingObject {
+    /** interpolated render position, the vector is reused so copy it to keep it */
     get position() {
-        return vec2.lerp(vec2.create(), this.mPositionRenderPrev, this.mPositionRender, this.mAlpha);
+        return vec2.lerp(this.mLerpedPosition, this.mPositionRenderPrev, this.mPositionRender, this.mAlpha);
     }
+    /** the vector is reused so copy it to keep it */
     get scale() {
-        return vec2.fromValues(this.mScale[0], this.mScale[1]);
+        return vec2.copy(this.mScaleCopy, this.mScale);
     }
     set scale(value) {
-        this.mScale = vec2.fromValues(value[0], value[1]);
-        this.mAABB.scale = [Math.abs(this.mScale[0]), Math.abs(this.mScale[1])];
+        vec2.copy(this.mScale, value);
+        vec2.set(this.mAABB.scale, Math.abs(this.mScale[0]), Math.abs(this.mScale[1]));
     }
     tickPosition() {
         vec2.copy(this.mPositionRenderPrev, this.mPositionRender);
@@ -29,6 +71,7 @@ export class MovingObject {
         this.mAlpha = 0;
         this.mPositionRender = vec2.create();
         this.mPositionRenderPrev = vec2.create();
+        this.mLerpedPosition = vec2.create();
         this.mOldPosition = vec2.create();
         this.mPosition = vec2.create();
         this.mRemainder = vec2.create();
@@ -37,16 +80,13 @@ export class MovingObject {
         this.mSpeed = vec2.create();
 
         this.mScale = vec2.fromValues(1, 1);
+        this.mScaleCopy = vec2.create();
         this.mAABB = new AABB();
 
         this.mSpriteRenderer = new SpriteRenderer();;
 
         this.deltaTime = 0;
         this.mMap = map;
-        /** @type {vec2[]} */
-        this.mAreas = [];
-        /** @type {number[]} */
-        this.mIdsInAreas = [];
         /** @type {EnumValue<typeof ObjectType>} */
         this.mType = ObjectType.None;
 
@@ -83,10 +123,9 @@ export class MovingObject {
      * @returns {boolean}
      */
     collidesWithTileLeft(ref, move = false) {
-        const topRightTile = this.mMap.getMapTileAtPoint([ref.topRight[0] - 0.5, ref.topRight[1] - 0.5]);
-        vec2.floor(topRightTile, topRightTile);
-        const bottomLeftTile = this.mMap.getMapTileAtPoint([ref.bottomLeft[0] - 0.5, ref.bottomLeft[1] + 0.5]);
-        vec2.floor(bottomLeftTile, bottomLeftTile);
+        const { topRightTile, bottomLeftTile, tileCenter, prevPos, nextPos } = leftScratch;
+        this.mMap.getMapTileAtPoint(topRightTile, ref.topRight[0] - 0.5, ref.topRight[1] - 0.5);
+        this.mMap.getMapTileAtPoint(bottomLeftTile, ref.bottomLeft[0] - 0.5, ref.bottomLeft[1] + 0.5);
         let slopeOffset = 0.0, oldSlopeOffset = 0.0;
         let wasOneWay = false, isOneWay;
         /** @type {EnumValue<TileCollisionType>} */
@@ -100,7 +139,7 @@ export class MovingObject {
                 continue;
             switch (tileCollisionType) {
                 default://slope 
-                    const tileCenter = this.mMap.getMapTilePosition(bottomLeftTile[0], y);
+                    this.mMap.getMapTilePosition(tileCenter, bottomLeftTile[0], y);
                     const leftTileEdge = (tileCenter[0] - cTileSize / 2);
                     const rightTileEdge = (leftTileEdge + cTileSize);
                     const bottomTileEdge = (tileCenter[1] - cTileSize / 2);
@@ -109,13 +148,13 @@ export class MovingObject {
                     slopeOffset = Math.abs(offset.freeUp) < Math.abs(offset.freeDown) ? offset.freeUp : offset.freeDown;
                     if (!isOneWay && (Math.abs(slopeOffset) >= this.mSlopeWallHeight || (slopeOffset < 0 && ref.state.pushesBottomTile) || (slopeOffset > 0 && ref.state.pushesTopTile))) {
                         ref.state.pushesLeftTile = true;
-                        vec2.floor(ref.state.leftTile, [bottomLeftTile[0], y]);
+                        vec2.set(ref.state.leftTile, bottomLeftTile[0], y);
                         return true;
                     }
                     else if (Math.abs(slopeOffset) > Math.abs(oldSlopeOffset)) {
                         wasOneWay = isOneWay;
                         slopeCollisionType = tileCollisionType;
-                        vec2.floor(ref.state.leftTile, [bottomLeftTile[0], y]);
+                        vec2.set(ref.state.leftTile, bottomLeftTile[0], y);
                     }
                     else
                         slopeOffset = oldSlopeOffset;
@@ -126,14 +165,15 @@ export class MovingObject {
         }
         if (slopeCollisionType != TileCollisionType.Empty && slopeOffset != 0) {
             if (slopeOffset > 0 && slopeOffset < this.mSlopeWallHeight) {
-                const pos = vec2.clone(ref.position);
-                const tr = vec2.clone(ref.topRight);
-                const bl = vec2.clone(ref.bottomLeft);
+                const newRef = leftScratch.ref;
+                const { position: pos, topRight: tr, bottomLeft: bl } = newRef;
+                vec2.copy(pos, ref.position);
+                vec2.copy(tr, ref.topRight);
+                vec2.copy(bl, ref.bottomLeft);
+                newRef.state.reset();
                 pos[1] += slopeOffset - sign(slopeOffset);
                 tr[1] += slopeOffset - sign(slopeOffset);
                 bl[1] += slopeOffset - sign(slopeOffset);
-                const s = new PositionState();
-                const newRef = { position: pos, topRight: tr, bottomLeft: bl, state: s }
                 if (this.collidesWithTileTop(newRef)) {
                     ref.state.pushesLeftTile = true;
                     return true;
@@ -155,8 +195,8 @@ export class MovingObject {
             const nextX = this.mMap.getMapTileXAtPoint(ref.topRight[0] - 1.5);
             const bottomY = this.mMap.getMapTileYAtPoint(ref.bottomLeft[1] + 1.0) - 1;
 
-            const prevPos = this.mMap.getMapTilePosition(topRightTile[0], bottomLeftTile[1]);
-            const nextPos = this.mMap.getMapTilePosition(nextX, bottomY);
+            this.mMap.getMapTilePosition(prevPos, topRightTile[0], bottomLeftTile[1]);
+            this.mMap.getMapTilePosition(nextPos, nextX, bottomY);
 
             const prevCollisionType = this.mMap.getCollisionType(topRightTile[0], bottomLeftTile[1]);
             const nextCollisionType = this.mMap.getCollisionType(nextX, bottomY);
@@ -170,16 +210,17 @@ export class MovingObject {
             const offset = slopeHeight + cTileSize - nextSlopeHeight;
 
             if (offset < this.mSlopeWallHeight && offset > 0) {
-                const pos = vec2.clone(ref.position);
-                const tr = vec2.clone(ref.topRight);
-                const bl = vec2.clone(ref.bottomLeft);
+                const newRef = leftScratch.ref;
+                const { position: pos, topRight: tr, bottomLeft: bl } = newRef;
+                vec2.copy(pos, ref.position);
+                vec2.copy(tr, ref.topRight);
+                vec2.copy(bl, ref.bottomLeft);
+                newRef.state.reset();
                 pos[1] -= offset - sign(offset);
                 tr[1] -= offset - sign(offset);
                 bl[1] -= offset - sign(offset);
                 bl[0] -= 1.0;
                 tr[0] -= 1.0;
-                const s = new PositionState();
-                const newRef = { position: pos, topRight: tr, bottomLeft: bl, state: s }
                 if (!this.collidesWithTileBottom(newRef)) {
                     ref.position[1] -= offset;
                     ref.bottomLeft[1] -= offset;
@@ -202,10 +243,9 @@ export class MovingObject {
      * @returns {boolean}
      */
     collidesWithTileRight(ref, move = false) {
-        const topRightTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.topRight[0] + 0.5, ref.topRight[1] - 0.5));
-        vec2.floor(topRightTile, topRightTile);
-        const bottomLeftTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] + 0.5));
-        vec2.floor(bottomLeftTile, bottomLeftTile);
+        const { topRightTile, bottomLeftTile, tileCenter, prevPos, nextPos } = rightScratch;
+        this.mMap.getMapTileAtPoint(topRightTile, ref.topRight[0] + 0.5, ref.topRight[1] - 0.5);
+        this.mMap.getMapTileAtPoint(bottomLeftTile, ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] + 0.5);
         let slopeOffset = 0.0;
         let oldSlopeOffset = 0.0;
         let wasOneWay = false, isOneWay;
@@ -221,7 +261,7 @@ export class MovingObject {
 
             switch (tileCollisionType) {
                 default://slope 
-                    const tileCenter = this.mMap.getMapTilePosition(topRightTile[0], y);
+                    this.mMap.getMapTilePosition(tileCenter, topRightTile[0], y);
                     const leftTileEdge = (tileCenter[0] - cTileSize / 2);
                     const rightTileEdge = (leftTileEdge + cTileSize);
                     const bottomTileEdge = (tileCenter[1] - cTileSize / 2);
@@ -233,13 +273,13 @@ export class MovingObject {
                     slopeOffset = Math.abs(offset.freeUp) < Math.abs(offset.freeDown) ? offset.freeUp : offset.freeDown;
                     if (!isOneWay && (Math.abs(slopeOffset) >= this.mSlopeWallHeight || (slopeOffset < 0 && ref.state.pushesBottomTile) || (slopeOffset > 0 && ref.state.pushesTopTile))) {
                         ref.state.pushesRightTile = true;
-                        vec2.floor(ref.state.rightTile, [topRightTile[0], y]);
+                        vec2.set(ref.state.rightTile, topRightTile[0], y);
                         return true;
                     }
                     else if (Math.abs(slopeOffset) > Math.abs(oldSlopeOffset)) {
                         wasOneWay = isOneWay;
                         slopeCollisionType = tileCollisionType;
-                        vec2.floor(ref.state.rightTile, [topRightTile[0], y]);
+                        vec2.set(ref.state.rightTile, topRightTile[0], y);
                     }
                     else
                         slopeOffset = oldSlopeOffset;
@@ -250,14 +290,15 @@ export class MovingObject {
         }
         if (slopeCollisionType != TileCollisionType.Empty && slopeOffset != 0.0) {
             if (slopeOffset > 0 && slopeOffset < this.mSlopeWallHeight) {
-                const pos = vec2.clone(ref.position);
-                const tr = vec2.clone(ref.topRight);
-                const bl = vec2.clone(ref.bottomLeft);
+                const newRef = rightScratch.ref;
+                const { position: pos, topRight: tr, bottomLeft: bl } = newRef;
+                vec2.copy(pos, ref.position);
+                vec2.copy(tr, ref.topRight);
+                vec2.copy(bl, ref.bottomLeft);
+                newRef.state.reset();
                 pos[1] += slopeOffset - sign(slopeOffset);
                 tr[1] += slopeOffset - sign(slopeOffset);
                 bl[1] += slopeOffset - sign(slopeOffset);
-                const s = new PositionState();
-                const newRef = { position: pos, topRight: tr, bottomLeft: bl, state: s }
                 if (this.collidesWithTileTop(newRef)) {
                     ref.state.pushesRightTile = true;
                     return true;
@@ -278,8 +319,8 @@ export class MovingObject {
             const nextX = this.mMap.getMapTileXAtPoint(ref.bottomLeft[0] + 1.0);
             const bottomY = this.mMap.getMapTileYAtPoint(ref.bottomLeft[1] + 1.0) - 1;
 
-            const prevPos = this.mMap.getMapTilePosition(bottomLeftTile[0], bottomLeftTile[1]);
-            const nextPos = this.mMap.getMapTilePosition(nextX, bottomY);
+            this.mMap.getMapTilePosition(prevPos, bottomLeftTile[0], bottomLeftTile[1]);
+            this.mMap.getMapTilePosition(nextPos, nextX, bottomY);
             const prevCollisionType = this.mMap.getCollisionType(bottomLeftTile[0], bottomLeftTile[1]);
             const nextCollisionType = this.mMap.getCollisionType(nextX, bottomY);
 
@@ -292,16 +333,17 @@ export class MovingObject {
             const offset = slopeHeight + cTileSize - nextSlopeHeight;
 
             if (offset < this.mSlopeWallHeight && offset > 0) {
-                const pos = vec2.clone(ref.position);
-                const tr = vec2.clone(ref.topRight);
-                const bl = vec2.clone(ref.bottomLeft);
+                const newRef = rightScratch.ref;
+                const { position: pos, topRight: tr, bottomLeft: bl } = newRef;
+                vec2.copy(pos, ref.position);
+                vec2.copy(tr, ref.topRight);
+                vec2.copy(bl, ref.bottomLeft);
+                newRef.state.reset();
                 pos[1] -= offset - sign(offset);
                 tr[1] -= offset - sign(offset);
                 bl[1] -= offset - sign(offset);
                 bl[0] += 1.0;
                 tr[0] += 1.0;
-                const s = new PositionState();
-                const newRef = { position: pos, topRight: tr, bottomLeft: bl, state: s }
                 if (!this.collidesWithTileBottom(newRef)) {
                     ref.position[1] -= offset;
                     ref.bottomLeft[1] -= offset;
@@ -324,8 +366,9 @@ export class MovingObject {
      * @returns {boolean}
      */
     collidesWithTileTop(ref) {
-        const topRightTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.topRight[0] - 0.5, ref.topRight[1] + 0.5));
-        const bottomleftTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] + 0.5));
+        const { topRightTile, bottomLeftTile: bottomleftTile, tileCenter } = topScratch;
+        this.mMap.getMapTileAtPoint(topRightTile, ref.topRight[0] - 0.5, ref.topRight[1] + 0.5);
+        this.mMap.getMapTileAtPoint(bottomleftTile, ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] + 0.5);
         let freeDown = Infinity;
         let slopeX = -1;
         for (let x = bottomleftTile[0]; x <= topRightTile[0]; ++x) {
@@ -335,7 +378,7 @@ export class MovingObject {
 
             switch (tileCollisionType) {
                 default://slope
-                    const tileCenter = this.mMap.getMapTilePosition(x, topRightTile[1]);
+                    this.mMap.getMapTilePosition(tileCenter, x, topRightTile[1]);
                     const sf = Slopes.getOffset6p(tileCenter, ref.bottomLeft[0] + 0.5, ref.topRight[0] - 0.5, ref.bottomLeft[1] + 0.5, ref.topRight[1] + 0.5, tileCollisionType);
                     sf.freeDown += 1;
                     sf.collidingTop += 1;
@@ -349,13 +392,13 @@ export class MovingObject {
                     break;
                 case TileCollisionType.Full:
                     ref.state.pushesTopTile = true;
-                    vec2.floor(ref.state.topTile, [x, topRightTile[1]]);
+                    vec2.set(ref.state.topTile, x, topRightTile[1]);
                     return true;
             }
         }
         if (slopeX != -1) {
             ref.state.pushesTopTile = true;
-            vec2.floor(ref.state.topTile, [slopeX, topRightTile[1]]);
+            vec2.set(ref.state.topTile, slopeX, topRightTile[1]);
             ref.position[1] += freeDown;
             ref.topRight[1] += freeDown;
             ref.bottomLeft[1] += freeDown;
@@ -375,8 +418,9 @@ export class MovingObject {
      * @returns {boolean}
      */
     collidesWithTileBottom(ref) {
-        const topRightTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.topRight[0] - 0.5, ref.topRight[1] - 0.5));
-        const bottomleftTile = this.mMap.getMapTileAtPoint(vec2.fromValues(ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] - 0.5));
+        const { topRightTile, bottomLeftTile: bottomleftTile, tileCenter } = bottomScratch;
+        this.mMap.getMapTileAtPoint(topRightTile, ref.topRight[0] - 0.5, ref.topRight[1] - 0.5);
+        this.mMap.getMapTileAtPoint(bottomleftTile, ref.bottomLeft[0] + 0.5, ref.bottomLeft[1] - 0.5);
         let collidingBottom = -Infinity;
         let slopeX = -1;
         let wasOneWay = false;
@@ -393,7 +437,7 @@ export class MovingObject {
             switch (tileCollisionType) {
                 default://slope
 
-                    const tileCenter = this.mMap.getMapTilePosition(x, bottomleftTile[1]);
+                    this.mMap.getMapTilePosition(tileCenter, x, bottomleftTile[1]);
 
                     const sf = Slopes.getOffset6p(tileCenter, ref.bottomLeft[0] + 0.5, ref.topRight[0] - 0.5, ref.bottomLeft[1] - 0.5, ref.topRight[1] - 0.5, tileCollisionType);
                     sf.freeUp -= 1;
@@ -414,7 +458,7 @@ export class MovingObject {
                 case TileCollisionType.Full:
                     ref.state.onOneWay = false;
                     ref.state.pushesBottomTile = true;
-                    vec2.floor(ref.state.bottomTile, [x, bottomleftTile[1]]);
+                    vec2.set(ref.state.bottomTile, x, bottomleftTile[1]);
                     ref.state.tmpIgnoresOneWay = false;
                     return true;
             }
@@ -424,7 +468,7 @@ export class MovingObject {
                 ref.state.onOneWay = wasOneWay;
                 ref.state.oneWayY = bottomleftTile[1];
                 ref.state.pushesBottomTile = true;
-                vec2.floor(ref.state.bottomTile, [slopeX, bottomleftTile[1]]);
+                vec2.set(ref.state.bottomTile, slopeX, bottomleftTile[1]);
             }
             ref.position[1] += collidingBottom;
             ref.topRight[1] += collidingBottom;
@@ -511,14 +555,14 @@ export class MovingObject {
     move(offset, speed, aabb, ref) {
         vec2.add(ref.remainder, ref.remainder, offset);
 
-        vec2.copy(ref.topRight, aabb.max());
-        vec2.copy(ref.bottomLeft, aabb.min());
+        aabb.max(ref.topRight);
+        aabb.min(ref.bottomLeft);
 
         ref.foundObstacleX = false;
         ref.foundObstacleY = false;
-        const step = vec2.fromValues(sign(offset[0]), sign(offset[1]));
+        const step = vec2.set(moveStep, sign(offset[0]), sign(offset[1]));
 
-        const move = vec2.fromValues(Math.round(ref.remainder[0]), Math.round(ref.remainder[1]));
+        const move = vec2.set(moveLeft, Math.round(ref.remainder[0]), Math.round(ref.remainder[1]));
         vec2.sub(ref.remainder, ref.remainder, move);
         if (move[0] == 0.0 && move[1] == 0.0)
             return;
@@ -581,13 +625,13 @@ export class MovingObject {
         this.mPS.pushesRightObject = false;
         this.mPS.pushesLeftObject = false;
         this.mPS.pushesTopObject = false;
-        const offsetSum = vec2.create();
+        vec2.zero(offsetSum);
         for (let i = 0; i < this.mAllCollidingObjects.length; ++i) {
             if ((this.mType == ObjectType.Player && this.mAllCollidingObjects[i].other.mType == ObjectType.NPC) || this.mType === ObjectType.NPC)
                 continue;
             const other = this.mAllCollidingObjects[i].other;
             const data = this.mAllCollidingObjects[i];
-            const overlap = vec2.sub(vec2.create(), data.overlap, offsetSum);
+            vec2.sub(overlap, data.overlap, offsetSum);
             if (overlap[0] === 0.0) {
                 if (other.mAABB.center[0] > this.mAABB.center[0]) {
                     this.mPS.pushesRightObject = true;
@@ -612,9 +656,9 @@ export class MovingObject {
             }
 
 
-            const absSpeed1 = [Math.abs(data.pos1[0] - data.oldPos1[0]), Math.abs(data.pos1[1] - data.oldPos1[1])];
-            const absSpeed2 = [Math.abs(data.pos2[0] - data.oldPos2[0]), Math.abs(data.pos2[1] - data.oldPos2[1])];
-            const speedSum = vec2.add(vec2.create(), absSpeed1, absSpeed2);
+            vec2.set(absSpeed1, Math.abs(data.pos1[0] - data.oldPos1[0]), Math.abs(data.pos1[1] - data.oldPos1[1]));
+            vec2.set(absSpeed2, Math.abs(data.pos2[0] - data.oldPos2[0]), Math.abs(data.pos2[1] - data.oldPos2[1]));
+            vec2.add(speedSum, absSpeed1, absSpeed2);
             let speedRatioX, speedRatioY;
             if (other.mIsKinematic)
                 speedRatioX = speedRatioY = 1.0;
@@ -699,12 +743,11 @@ export class MovingObject {
         this.mPS.pushesBottomTile = this.mPS.pushesLeftTile = this.mPS.pushesRightTile = this.mPS.pushesTopTile =
             this.mPS.pushesBottomObject = this.mPS.pushesLeftObject = this.mPS.pushesRightObject = this.mPS.pushesTopObject = false;
 
-        const ref = {
-            position: this.mPosition,
-            topRight: this.mAABB.max(),
-            bottomLeft: this.mAABB.min(),
-            state: this.mPS,
-        }
+        const ref = physicsRef;
+        ref.position = this.mPosition;
+        ref.state = this.mPS;
+        this.mAABB.max(ref.topRight);
+        this.mAABB.min(ref.bottomLeft);
         this.collidesWithTiles(ref);
         vec2.copy(this.mOldSpeed, this.mSpeed);
         if (this.mPS.pushesBottomTile)
@@ -721,7 +764,7 @@ export class MovingObject {
         vec2.scale(this.mOffset, this.mSpeed, this.deltaTime);
         if (this.mMountParent != null) {
             if (this.hasCollisionDataFor(this.mMountParent)) {
-                vec2.add(this.mOffset, this.mOffset, vec2.sub(vec2.create(), this.mMountParent.mPosition, this.mMountParent.mOldPosition));
+                vec2.add(this.mOffset, this.mOffset, vec2.sub(delta, this.mMountParent.mPosition, this.mMountParent.mOldPosition));
             }
             else {
                 this.mMountParent = null;
@@ -729,26 +772,21 @@ export class MovingObject {
         }
 
 
-        vec2.add(this.mPosition, this.mPosition, vec2.round(vec2.create(), vec2.add(vec2.create(), this.mOffset, this.mRemainder)));
+        vec2.add(this.mPosition, this.mPosition, vec2.round(delta, vec2.add(delta, this.mOffset, this.mRemainder)));
 
         vec2.copy(this.mAABB.center, this.mPosition);
     }
     updatePhysicsP2() {
-        vec2.sub(this.mPosition, this.mPosition, vec2.round(vec2.create(), vec2.add(vec2.create(), this.mOffset, this.mRemainder)));
+        vec2.sub(this.mPosition, this.mPosition, vec2.round(delta, vec2.add(delta, this.mOffset, this.mRemainder)));
         vec2.copy(this.mAABB.center, this.mPosition);
 
         this.updatePhysicsResponse();
 
         if (this.mOffset[0] != 0.0 || this.mOffset[1] != 0.0) {
-            const ref = {
-                position: this.mPosition,
-                state: this.mPS,
-                remainder: this.mRemainder,
-                topRight: this.mAABB.max(),
-                bottomLeft: this.mAABB.min(),
-                foundObstacleX: false,
-                foundObstacleY: false,
-            }
+            const ref = physicsRef;
+            ref.position = this.mPosition;
+            ref.state = this.mPS;
+            ref.remainder = this.mRemainder;
             this.move(this.mOffset, this.mSpeed, this.mAABB, ref);
         }
 
@@ -772,7 +810,7 @@ export class MovingObject {
         }
     }
     crush() {
-        vec2.add(this.mPosition, this.mMap.mPosition, vec2.fromValues(this.mMap.mWidth / 2 * cTileSize, this.mMap.mHeight / 2 * cTileSize));
+        vec2.add(this.mPosition, this.mMap.mPosition, vec2.set(delta, this.mMap.mWidth / 2 * cTileSize, this.mMap.mHeight / 2 * cTileSize));
     }
     /**
      * 
@@ -0,0 +1,56 @@
+import { createPhysicsWorld, setPhysicsTiles, stepPhysics } from "../libs.js";
+
+/** Columns before the contact list, must match PHYSICS_COLUMNS in libs/context.c */
+const PHYSICS_COLUMNS = 9;
+/** body a, body b, overlapX, overlapY */
+export const PHYSICS_CONTACT_SIZE = 4;
+
+/**
+ * Body table shared with the native physics module. Every column is a view on native
+ * memory, so writing a body and reading the contacts never copies.
+ */
+export class PhysicsWorld {
+    /**
+     * @param {number} capacity
+     * @param {number} maxContacts
+     */
+    constructor(capacity, maxContacts) {
+        const { id, buffer } = createPhysicsWorld(capacity, maxContacts);
+        const column = (/** @type {number} */ index) => new Float32Array(buffer, index * capacity * 4, capacity);
+        this.id = id;
+        this.capacity = capacity;
+        /** bodies in use, they are always the first `count` entries */
+        this.count = 0;
+        this.x = column(0);
+        this.y = column(1);
+        this.oldX = column(2);
+        this.oldY = column(3);
+        this.speedX = column(4);
+        this.speedY = column(5);
+        this.halfX = column(6);
+        this.halfY = column(7);
+        this.flags = new Uint32Array(buffer, 8 * capacity * 4, capacity);
+        this.contacts = new Float32Array(buffer, PHYSICS_COLUMNS * capacity * 4, maxContacts * PHYSICS_CONTACT_SIZE);
+    }
+    /**
+     * @param {Uint8Array} tiles one PhysicsTile class per tile, row-major
+     * @param {number} width
+     * @param {number} height
+     * @param {number} tileSize
+     * @param {number} originX center of tile 0, 0
+     * @param {number} originY
+     */
+    setTiles(tiles, width, height, tileSize, originX, originY) {
+        setPhysicsTiles(this.id, tiles, width, height, tileSize, originX, originY);
+    }
+    /**
+     * Integrates the dynamic bodies and runs the broadphase.
+     * @param {number} dt
+     * @param {number} gravity
+     * @param {number} maxFallingSpeed
+     * @returns {number} contacts written to `contacts`
+     */
+    step(dt, gravity = 0, maxFallingSpeed = -Infinity) {
+        return stepPhysics(this.id, this.count, dt, gravity, maxFallingSpeed);
+    }
+}
@@ -78,9 +78,9 @@ export class PositionState {
         this.tmpSticksToSlope = false;
         this.oneWayY = -1;
 
-        this.leftTile = vec2.fromValues(-1, -1);
-        this.rightTile = vec2.fromValues(-1, -1);
-        this.topTile = vec2.fromValues(-1, -1);
-        this.bottomTile = vec2.fromValues(-1, -1);
+        vec2.set(this.leftTile, -1, -1);
+        vec2.set(this.rightTile, -1, -1);
+        vec2.set(this.topTile, -1, -1);
+        vec2.set(this.bottomTile, -1, -1);
     }
 }
\ No newline at end of file
@@ -21,6 +21,22 @@ export class SlopeOffsetI {
         this.collidingBottom = Math.floor(collidingBottom);
         this.collidingTop = Math.floor(collidingTop);
     }
+    /**
+     * 
+     * @param {SlopeOffsetSB} other 
+     * @returns {SlopeOffsetI}
+     */
+    copy(other) {
+        this.freeLeft = Math.floor(other.freeLeft);
+        this.freeRight = Math.floor(other.freeRight);
+        this.freeDown = Math.floor(other.freeDown);
+        this.freeUp = Math.floor(other.freeUp);
+        this.collidingLeft = Math.floor(other.collidingLeft);
+        this.collidingRight = Math.floor(other.collidingRight);
+        this.collidingBottom = Math.floor(other.collidingBottom);
+        this.collidingTop = Math.floor(other.collidingTop);
+        return this;
+    }
     /**
      * 
      * @param {SlopeOffsetSB} other 
@@ -4,6 +4,11 @@ import { clamp } from "../misc/math.js";
 import { SlopeOffsetI } from "./SlopeOffsetI.js";
 import { SlopeOffsetSB } from "./SlopeOffsetSB.js";
 
+/** scratch results of the per-move slope queries, getOffset6p hands out `offset6p` */
+const offset5p = new SlopeOffsetSB(0, 0, 0, 0, 0, 0, 0, 0);
+const offset6p = new SlopeOffsetI(0, 0, 0, 0, 0, 0, 0, 0);
+const heightOffset = new SlopeOffsetI(0, 0, 0, 0, 0, 0, 0, 0);
+
 export const Slopes = {
     empty: new Uint8Array([0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]),
     full: new Uint8Array([16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16]),
@@ -97,9 +102,10 @@ export const Slopes = {
      * @param {number} posY 
      * @param {number} w 
      * @param {number} h 
+     * @param {SlopeOffsetSB} [out]
      * @returns {SlopeOffsetSB}
      */
-    getOffset5p(slopeExtended, posX, posY, w, h) {
+    getOffset5p(slopeExtended, posX, posY, w, h, out = new SlopeOffsetSB(0, 0, 0, 0, 0, 0, 0, 0)) {
         const len = Math.sqrt(slopeExtended.length);
         let freeUp = 0, freeDown = 0, collidingTop = 0, collidingBottom = 0;
         let freeLeft = 0, freeRight = 0, collidingLeft = 0, collidingRight = 0;
@@ -206,7 +212,7 @@ export const Slopes = {
         else
             collidingRight = freeLeft;
 
-        return new SlopeOffsetSB(freeLeft, freeRight, freeDown, freeUp, collidingLeft, collidingRight, collidingBottom, collidingTop);
+        return out.set(freeLeft, freeRight, freeDown, freeUp, collidingLeft, collidingRight, collidingBottom, collidingTop);
 
     },
     /** 
@@ -216,7 +222,7 @@ export const Slopes = {
      * @param {number} bottomY
      * @param {number} topY
      * @param {EnumValue<TileCollisionType>} tileCollisionType
-     * @returns {SlopeOffsetSB}
+     * @returns {SlopeOffsetI} reused by the next call
     */
     getOffset6p(tileCenter, leftX, rightX, bottomY, topY, tileCollisionType) {
 
@@ -247,7 +253,7 @@ export const Slopes = {
                 sizeY = Math.floor(clamp(topY - (bottomTileEdge + posY), 0.0, cTileSize - 1));
             }
 
-            offset = SlopeOffsetI.from(this.getOffset5p(this.slopesExtended[tileCollisionType], posX, posY, sizeX, sizeY));
+            offset = offset6p.copy(this.getOffset5p(this.slopesExtended[tileCollisionType], posX, posY, sizeX, sizeY, offset5p));
 
             if (this.isFlippedY(tileCollisionType)) {
                 let tmp = offset.freeDown;
@@ -277,7 +283,7 @@ export const Slopes = {
                 sizeY = Math.floor(clamp(rightX - (leftTileEdge + posY), 0.0, cTileSize - 1));
             }
 
-            offset = SlopeOffsetI.from(this.getOffset5p(this.slopesExtended[tileCollisionType], posX, posY, sizeX, sizeY));
+            offset = offset6p.copy(this.getOffset5p(this.slopesExtended[tileCollisionType], posX, posY, sizeX, sizeY, offset5p));
 
             if (this.isFlippedY(tileCollisionType)) {
                 offset.collidingBottom = offset.collidingLeft;
@@ -357,10 +363,10 @@ export const Slopes = {
             x = cTileSize - 1 - x;
 
         if (!this.isFlipped90(type)) {
-            const offset = SlopeOffsetI.from(this.getOffset5p(this.slopesExtended[type], x, 0, 1, cTileSize));
+            const offset = heightOffset.copy(this.getOffset5p(this.slopesExtended[type], x, 0, 1, cTileSize, offset5p));
             return this.isFlippedY(type) ? -offset.collidingTop : offset.collidingBottom;
         } else {
-            const offset = SlopeOffsetI.from(this.getOffset5p(this.slopesExtended[type], 0, x, cTileSize, 1));
+            const offset = heightOffset.copy(this.getOffset5p(this.slopesExtended[type], 0, x, cTileSize, 1, offset5p));
             return this.isFlippedY(type) ? offset.collidingLeft : -offset.collidingRight;
         }
     },
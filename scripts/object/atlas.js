@@ -1,4 +1,4 @@
-import { activeTexture, beginFramebuffer, bindEBO, bindTexture, bindVAO, bindVBO, bufferData, bufferDataElement, clear, clearColor, createBuffer, createFramebuffer, createShaderProgram, createTexture, createVAO, drawElements, enableVertexAttribute, endFramebuffer, getScreenHeight, getScreenWidth, getUniformLocation, loadImage, loadText, mat4, setVertexAttributePointer, uniform1i, uniform4f, uniformMatrix4fv, updateTexture, useProgram, vec2, vec3, vec4 } from "../libs.js";
+import { activeTexture, beginFramebuffer, bindEBO, bindTexture, bindVAO, bindVBO, bufferData, bufferDataElement, clear, clearColor, createBuffer, createFramebuffer, createShaderProgram, createVAO, drawElements, enableVertexAttribute, endFramebuffer, getScreenHeight, getScreenWidth, getUniformLocation, loadText, loadTexture, mat4, readAtlasCache, releaseTexture, setVertexAttributePointer, uniform1i, uniform4f, uniformMatrix4fv, uploadAtlasCache, uploadTexture, useProgram, vec2, vec3, vec4, writeAtlasCache } from "../libs.js";
 
 /**
  * 
@@ -54,7 +54,7 @@ export function splitNode(node, w, h, padding) {
 
 
 /**
- * @type {Map<string, ImageContainer & {name:string}>}
+ * @type {Map<string, TextureObject & {name:string}>}
  */
 const imageCache = new Map();
 
@@ -62,30 +62,41 @@ let vert = "";
 let frag = "";
 
 export async function loadAtlasShaderSource() {
-    vert = await loadText("resources/glsl/atlas.vert.sk");
-    frag = await loadText("resources/glsl/atlas.frag.sk");
+    [vert, frag] = await Promise.all([
+        loadText("resources/glsl/atlas.vert.sk"),
+        loadText("resources/glsl/atlas.frag.sk"),
+    ]);
 }
 
-export async function addAtlas() {
+const ATLAS_CACHE = "resources/atlas.cache";
+const atlasNames = [
+    "atlas/platform/movingPlatform",
+    "atlas/platform/slope45oneway",
+    "atlas/platform/block",
+    "atlas/platform/character",
+    "atlas/icon/question",
+];
+const atlasSources = atlasNames.map(name => `resources/${name}.png`);
+/**
+ * @type {{ atlasSize: number, atlasData: AtlasContainer["atlasData"], data: ArrayBuffer } | null}
+ */
+let atlasCache = null;
 
-    const urls = new Set([
-        "atlas/platform/movingPlatform",
-        "atlas/platform/slope45oneway",
-        "atlas/platform/movingPlatform",
-        "atlas/platform/block",
-        "atlas/platform/character",
-        "atlas/icon/question",
-    ]);
-    for (const name of urls) {
-        imageCache.set(name, { ...await loadImage(`resources/${name}.png`), name });
+export async function addAtlas() {
+    // a baked atlas newer than every source PNG replaces the decode and the packing
+    atlasCache = readAtlasCache(ATLAS_CACHE, atlasSources);
+    if (atlasCache) {
+        return imageCache;
     }
+    const images = await Promise.all(atlasSources.map(source => loadTexture(source)));
+    atlasNames.forEach((name, index) => imageCache.set(name, { ...images[index], name }));
     return imageCache;
 }
 
 
 /**
  * @param {WebGLBuffer} vbo 
- * @param {ImageContainer} data 
+ * @param {TextureObject} data 
  * @param {number} x
  * @param {number} y
  * @param {number} angle 
@@ -145,6 +156,12 @@ function draw(vbo, data, x, y, angle) {
 
 }
 export function buildAtlas() {
+    if (atlasCache) {
+        const { atlasData, atlasSize } = atlasCache;
+        const texture = uploadAtlasCache(atlasCache);
+        atlasCache = null;
+        return { texture, atlasData, atlasSize };
+    }
     const vao = createVAO();
     const ebo = createBuffer();
     const vbo = createBuffer();
@@ -199,10 +216,8 @@ export function buildAtlas() {
         return img
     });
     images.sort((a, b) => b.width - a.width);
-    const texture = createTexture();
     /** @type {AtlasContainer["atlasData"]} */
     const atlasData = {};
-    bindTexture(texture);
     for (const image of images) {
         let rotated = false;
         const w = image.width;
@@ -221,7 +236,7 @@ export function buildAtlas() {
             dest.y = n.y;
             dest.width = n.w;
             dest.height = n.h;
-            updateTexture(image);
+            uploadTexture(image.id);
             if (!rotated) {
                 draw(vbo, image, dest.x, dest.y, 0);
                 dest.y = atlasSize - dest.y - h;
@@ -246,5 +261,10 @@ export function buildAtlas() {
 
     }
     endFramebuffer();
+    for (const image of images) {
+        releaseTexture(image.id);
+    }
+    imageCache.clear();
+    writeAtlasCache(ATLAS_CACHE, framebuffer, atlasData, atlasSources);
     return { texture: framebuffer.texture, atlasData, atlasSize };
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+// Runs the game headless on a null GL backend and a fixed clock, and prints ns per frame.
+// usage: qjs tools/bench.js [frames] [objects] [crowd] [seed] [result.json]
+import * as std from "std";
+import * as os from "os";
+import { benchmark } from "../scripts/engine.js";
+import { KeyCodeGLFW } from "../scripts/misc/enums.js";
+
+const [, frames = "10000", objects = "200", crowd = "2000", seed = "1", output] = scriptArgs;
+
+/**
+ * Runs right and left in turns and jumps now and then, so the character crosses slopes,
+ * one-way platforms and the NPCs.
+ * @param {number} count
+ * @returns {Array<[number, number, number]>} [frame, key, down] sorted by frame
+ */
+function inputTrack(count) {
+    /** @type {Array<[number, number, number]>} */
+    const track = [];
+    for (let frame = 0; frame < count; frame += 600) {
+        const key = (frame / 600) % 2 === 0 ? KeyCodeGLFW.RightKey : KeyCodeGLFW.LeftKey;
+        track.push([frame, key, 1]);
+        for (let jump = frame + 90; jump < frame + 600; jump += 90) {
+            track.push([jump, KeyCodeGLFW.JumpKey, 1]);
+            track.push([jump + 10, KeyCodeGLFW.JumpKey, 0]);
+        }
+        track.push([frame + 599, key, 0]);
+    }
+    return track;
+}
+
+const warmup = 120;
+const result = await benchmark({
+    frames: Number(frames),
+    warmup,
+    objects: Number(objects),
+    crowd: Number(crowd),
+    seed: Number(seed),
+    input: inputTrack(warmup + Number(frames)),
+}, os.now);
+const json = JSON.stringify(result);
+print(json);
+if (output) {
+    const file = std.open(output, "w");
+    if (!file) {
+        throw new Error(`Cannot write ${output}`);
+    }
+    file.puts(json + "\n");
+    file.close();
+}
+std.exit(0);
@@ -0,0 +1,20 @@
+// Compiles an ink story to the runtime JSON format, so the game never runs the ink compiler.
+// usage: qjs tools/compileStory.js <story.ink> <story.json>
+import * as std from "std";
+import { Compiler } from "../libs/inkjs/ink.js";
+
+const [, source, target] = scriptArgs;
+if (!source || !target) {
+    throw new Error("usage: qjs tools/compileStory.js <story.ink> <story.json>");
+}
+const text = std.loadFile(source);
+if (text === null) {
+    throw new Error(`Cannot read ${source}`);
+}
+const story = new Compiler(text).Compile();
+const file = std.open(target, "w");
+if (!file) {
+    throw new Error(`Cannot write ${target}`);
+}
+file.puts(story.ToJson() ?? "");
+file.close();
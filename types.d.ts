@@ -48,6 +48,14 @@ type Rectangle = {
   height: number;
   rotated?: boolean;
 }
+type SpriteQuad = {
+  offsetX: number;
+  offsetY: number;
+  width: number;
+  height: number;
+  rect: Rectangle;
+  rotated: boolean;
+}
 type AtlasContainer = {
   texture: WebGLTexture,
   atlasData: Record<string, Rectangle>,
@@ -2433,4 +2441,9 @@ type ImageContainer = {
   width: number
   height: number
   data: Image
+}
+type TextureObject = {
+  id: number
+  width: number
+  height: number
 }
\ No newline at end of file